@@ -0,0 +1,133 @@
+#include "inc/Admission.h"
+
+#include <string.h>
+#include <float.h>
+
+/*	ad_key:
+ * 		Packs the address and port (both kept in network order) like the peer table, with the low bit set
+ * 		so no source packs to the empty key.
+ *	returns: the key bits
+ */
+static unsigned long long ad_key(const struct sockaddr_in* addr){
+	return ((unsigned long long)(unsigned)(addr->sin_addr.S_un.S_addr) << 32) | ((unsigned long long)(addr->sin_port) << 16) | 1ULL;
+}
+
+/*	ad_set:
+ * 		Mixes the key bits so neighbouring addresses and ports spread across the sets.
+ *	returns: first entry of the key's set
+ */
+static Admit_Entry_t* ad_set(const Admit_Table_t* at, unsigned long long key){
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return &(at->entries[((unsigned)key & at->mask) * AD_WAYS]);
+}
+
+/*	ad_init:
+ * 		Allocates an empty table with about twice max_sources buckets. Every class admits everything until
+ * 		given a rate with ad_rate.
+ *	returns: 0 on success, -1 on error
+ */
+int ad_init(Admit_Table_t* at, unsigned max_sources, unsigned idle_ms){
+	if(at == NULL || max_sources == 0 || idle_ms == 0){
+		return -1;
+	}
+	
+	unsigned sets = 4;
+	while(sets * AD_WAYS < (max_sources * 2)){
+		sets <<= 1;
+	}
+	
+	//one spare line so the sets can start on a cache line
+	unsigned spare = 64 / sizeof(Admit_Entry_t);
+	at->base = new Admit_Entry_t[sets * AD_WAYS + spare];
+	memset((char*)at->base, 0, (sets * AD_WAYS + spare) * sizeof(Admit_Entry_t));
+	at->entries = (Admit_Entry_t*)(((size_t)at->base + 63) & ~(size_t)63);
+	at->mask = sets - 1;
+	for(int c=0; c<AD_CLASSES; c++){
+		at->per_ms[c] = FLT_MAX;
+		at->burst[c] = FLT_MAX;
+	}
+	at->idle_ms = idle_ms;
+	at->admitted = 0;
+	at->dropped = 0;
+	at->evicted = 0;
+	return 0;
+}
+
+/*	ad_rate:
+ * 		Sets the datagrams a second a source of the class may send, and how many it may send at once.
+ *	returns: 0 on success, -1 on error
+ */
+int ad_rate(Admit_Table_t* at, int cls, double pps, double burst){
+	if(at == NULL || cls < 0 || cls >= AD_CLASSES || pps <= 0.0 || burst < 1.0){
+		return -1;
+	}
+	at->per_ms[cls] = (float)(pps / 1000.0);
+	at->burst[cls] = (float)burst;
+	return 0;
+}
+
+/*	ad_destroy:
+ * 		Frees the table storage.
+ */
+void ad_destroy(Admit_Table_t* at){
+	if(at == NULL || at->base == NULL){
+		return;
+	}
+	delete[] at->base;
+	at->base = NULL;
+	at->entries = NULL;
+}
+
+/*	ad_admit:
+ * 		Refills the source's bucket at its class rate for the time since it was last seen and takes a token
+ * 		from it.
+ * 		A source not in its set replaces an empty or aged out bucket, or the stalest one (counted as
+ * 		evicted), and starts with a full bucket.
+ *	returns: 1 if the datagram may be handled, 0 if the source is over its rate (drop it)
+ */
+int ad_admit(Admit_Table_t* at, const struct sockaddr_in* addr, int cls, unsigned long long now_ms){
+	unsigned long long key = ad_key(addr);
+	unsigned now = (unsigned)now_ms;
+	Admit_Entry_t* set = ad_set(at, key);
+	
+	Admit_Entry_t* e = NULL;
+	Admit_Entry_t* victim = NULL;
+	for(int w=0; w<AD_WAYS; w++){
+		if(set[w].key == key){
+			e = &(set[w]);
+			break;
+		}
+		//an empty bucket first, else the one idle the longest
+		if(victim == NULL || (victim->key != 0 && (set[w].key == 0 || now - set[w].stamp > now - victim->stamp))){
+			victim = &(set[w]);
+		}
+	}
+	
+	if(e == NULL){
+		//new source (or one aged out) starts with a full bucket
+		if(victim->key != 0 && now - victim->stamp < at->idle_ms){
+			(at->evicted)++;
+		}
+		e = victim;
+		e->key = key;
+		e->tokens = at->burst[cls];
+	} else if(e->tokens < at->burst[cls]){
+		float gain = (float)(now - e->stamp) * at->per_ms[cls];
+		e->tokens = (gain < at->burst[cls] - e->tokens) ? e->tokens + gain : at->burst[cls];
+	} else{
+		e->tokens = at->burst[cls];
+	}
+	e->stamp = now;
+	
+	if(e->tokens < 1.0f){
+		(at->dropped)++;
+		return 0;
+	}
+	e->tokens -= 1.0f;
+	(at->admitted)++;
+	return 1;
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+
+#include "inc/AssetPack.h"
+
+/*	ap_load:
+ * 		Maps a pack read only and checks that its header and tables fit the file, so drawing can index
+ * 		straight into the mapping (no parsing, no per asset allocation).
+ *	returns: 0 on success, -1 on error
+ */
+int ap_load(Asset_Pack_t* pack, std::string path){
+	LARGE_INTEGER size;
+	if(pack == NULL){
+		return -1;
+	}
+	pack->base = NULL;
+	
+	pack->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(pack->file == INVALID_HANDLE_VALUE){
+		return -1;
+	}
+	if(!GetFileSizeEx(pack->file, &size) || (unsigned long long)size.QuadPart < sizeof(Pack_Head_t)){
+		CloseHandle(pack->file);
+		return -1;
+	}
+	pack->map = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(pack->map == NULL){
+		CloseHandle(pack->file);
+		return -1;
+	}
+	pack->base = (const char*)MapViewOfFile(pack->map, FILE_MAP_READ, 0, 0, 0);
+	if(pack->base == NULL){
+		CloseHandle(pack->map);
+		CloseHandle(pack->file);
+		return -1;
+	}
+	pack->size = (unsigned long long)size.QuadPart;
+	
+	//header, then every table and page has to lie inside the file
+	const Pack_Head_t* head = (const Pack_Head_t*)pack->base;
+	unsigned long long page_bytes = (unsigned long long)head->page_size * head->page_size * 4;
+	if(memcmp(head->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || head->version != PACK_VERSION
+			|| head->page_size == 0 || head->page_size > 16384 || head->file_size > pack->size
+			|| head->sprite_off + ((unsigned long long)head->sprite_count * sizeof(Pack_Sprite_t)) > head->file_size
+			|| head->anim_off + ((unsigned long long)head->anim_count * sizeof(Pack_Anim_t)) > head->file_size
+			|| head->pixel_off % PACK_ALIGN != 0 || head->pixel_off + (head->page_count * page_bytes) > head->file_size
+			|| head->sprite_off % 4 != 0 || head->anim_off % 4 != 0){
+		ap_unload(pack);
+		return -1;
+	}
+	pack->head = head;
+	pack->sprites = (const Pack_Sprite_t*)(pack->base + head->sprite_off);
+	pack->anims = (const Pack_Anim_t*)(pack->base + head->anim_off);
+	for(unsigned int i=0; i<head->sprite_count; i++){
+		if(pack->sprites[i].page >= head->page_count){
+			ap_unload(pack);
+			return -1;
+		}
+	}
+	for(unsigned int i=0; i<head->anim_count; i++){
+		if((unsigned long long)pack->anims[i].first + pack->anims[i].count > head->sprite_count){
+			ap_unload(pack);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*	ap_unload:
+ * 		Unmaps a loaded pack.
+ */
+void ap_unload(Asset_Pack_t* pack){
+	if(pack == NULL || pack->base == NULL){
+		return;
+	}
+	UnmapViewOfFile(pack->base);
+	CloseHandle(pack->map);
+	CloseHandle(pack->file);
+	pack->base = NULL;
+}
+
+/*	ap_page:
+ * 		Finds the pixels of an atlas page (page_size rows of page_size rgba pixels, top row first).
+ *	returns: the pixels in the mapping, NULL if there is no such page
+ */
+const unsigned char* ap_page(const Asset_Pack_t* pack, unsigned int page){
+	if(pack == NULL || pack->base == NULL || page >= pack->head->page_count){
+		return NULL;
+	}
+	unsigned long long page_bytes = (unsigned long long)pack->head->page_size * pack->head->page_size * 4;
+	return (const unsigned char*)(pack->base + pack->head->pixel_off + (page * page_bytes));
+}
+
+/*	ap_find_anim:
+ * 		Looks up an animation by name (a pack holds a handful, so a scan is enough).
+ *	returns: the animation, NULL if the pack has none by that name
+ */
+const Pack_Anim_t* ap_find_anim(const Asset_Pack_t* pack, const char* name){
+	if(pack == NULL || pack->base == NULL || name == NULL){
+		return NULL;
+	}
+	for(unsigned int i=0; i<pack->head->anim_count; i++){
+		if(strncmp(pack->anims[i].name, name, PACK_NAME_LEN) == 0){
+			return &(pack->anims[i]);
+		}
+	}
+	return NULL;
+}
+
+/*	ap_frame:
+ * 		Picks the frame of a looping animation shown t_ms into it.
+ *	returns: the frame's sprite, NULL for an empty animation
+ */
+const Pack_Sprite_t* ap_frame(const Asset_Pack_t* pack, const Pack_Anim_t* anim, unsigned long long t_ms){
+	if(pack == NULL || anim == NULL || anim->count == 0){
+		return NULL;
+	}
+	unsigned long long frame = (t_ms / (anim->frame_ms ? anim->frame_ms : 1)) % anim->count;
+	return &(pack->sprites[anim->first + frame]);
+}
+
+//little endian fields of a bmp header
+static unsigned int bmp_u32(const unsigned char* p){
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+static unsigned short bmp_u16(const unsigned char* p){
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+/*	ap_load_bmp:
+ * 		Reads an uncompressed 24 or 32 bit bmp (bottom up or top down) into rgba rows, top row first.
+ * 		32 bit images keep their alpha only when stored with bitfields, plain rgb ones are opaque.
+ *	returns: the pixels (free with delete[]), NULL on error
+ */
+unsigned char* ap_load_bmp(std::string path, int* w, int* h){
+	FILE* f = fopen(path.c_str(), "rb");
+	if(f == NULL){
+		return NULL;
+	}
+	std::vector<unsigned char> file;
+	unsigned char chunk[65536];
+	size_t got;
+	while((got = fread(chunk, 1, sizeof(chunk), f)) > 0){
+		file.insert(file.end(), chunk, chunk + got);
+	}
+	fclose(f);
+	
+	//file header (14 bytes) and info header (at least 40, and all there for as long as it says it is)
+	if(file.size() < 54 || file[0] != 'B' || file[1] != 'M'){
+		return NULL;
+	}
+	const unsigned char* b = &(file[0]);
+	unsigned int pixels = bmp_u32(b + 10);
+	unsigned int info = bmp_u32(b + 14);
+	if(info < 40 || file.size() < 14 + (unsigned long long)info){
+		return NULL;
+	}
+	int width = (int)bmp_u32(b + 18);
+	int height = (int)bmp_u32(b + 22);
+	unsigned short bpp = bmp_u16(b + 28);
+	unsigned int comp = bmp_u32(b + 30);
+	int top_down = height < 0;
+	if(top_down){
+		height = -height;
+	}
+	if(width <= 0 || height <= 0 || width > 16384 || height > 16384 || !((bpp == 24 && comp == 0)
+			|| (bpp == 32 && (comp == 0 || comp == 3)))){
+		return NULL;
+	}
+	int alpha = (bpp == 32 && comp == 3 && info >= 56 && bmp_u32(b + 66) == 0xFF000000u);
+	unsigned long long stride = (((unsigned long long)width * bpp + 31) / 32) * 4;
+	if(pixels + (stride * height) > file.size()){
+		return NULL;
+	}
+	
+	unsigned char* rgba = new unsigned char[(size_t)width * height * 4];
+	int step = bpp / 8;
+	for(int y=0; y<height; y++){
+		const unsigned char* row = b + pixels + (stride * (top_down ? y : (height - 1 - y)));
+		unsigned char* out = rgba + ((size_t)y * width * 4);
+		for(int x=0; x<width; x++){
+			out[(x * 4) + 0] = row[(x * step) + 2];
+			out[(x * 4) + 1] = row[(x * step) + 1];
+			out[(x * 4) + 2] = row[(x * step) + 0];
+			out[(x * 4) + 3] = alpha ? row[(x * step) + 3] : 255;
+		}
+	}
+	*w = width;
+	*h = height;
+	return rgba;
+}
+
+//a frame waiting to be placed
+typedef struct Pack_Frame {
+	unsigned char* pixels;
+	int w, h;
+} Pack_Frame_t;
+
+static bool taller(const std::pair<int, int>& a, const std::pair<int, int>& b){
+	return a.first > b.first;
+}
+
+/*	ap_build:
+ * 		Builds a pack from image files: places every frame on shelves of PACK_PAGE_SIZE atlas pages
+ * 		(tallest first) and writes the header, tables and pages in the layout ap_load maps.
+ *	returns: 0 on success, -1 on error (with the reason in error)
+ */
+int ap_build(const std::vector<Pack_Input_t>& anims, std::string path, std::string* error){
+	std::vector<Pack_Frame_t> frames;
+	std::vector<Pack_Anim_t> anim_table;
+	std::string reason;
+	int ret = -1;
+	
+	//read every frame
+	for(size_t a=0; a<anims.size() && reason.empty(); a++){
+		Pack_Anim_t anim;
+		memset((char*)&anim, 0, sizeof(anim));
+		if(anims[a].name.size() == 0 || anims[a].name.size() >= PACK_NAME_LEN){
+			reason = "animation name must be 1 to " + std::to_string(PACK_NAME_LEN - 1) + " characters: " + anims[a].name;
+			break;
+		}
+		strncpy(anim.name, anims[a].name.c_str(), PACK_NAME_LEN - 1);
+		anim.first = (unsigned int)frames.size();
+		anim.count = (unsigned int)anims[a].files.size();
+		anim.frame_ms = anims[a].frame_ms;
+		anim_table.push_back(anim);
+		for(size_t i=0; i<anims[a].files.size(); i++){
+			Pack_Frame_t frame;
+			frame.pixels = ap_load_bmp(anims[a].files[i], &(frame.w), &(frame.h));
+			if(frame.pixels == NULL){
+				reason = "cannot read " + anims[a].files[i] + " (uncompressed 24 or 32 bit bmp)";
+				break;
+			}
+			frames.push_back(frame);
+			if(frame.w + (2 * PACK_PAD) > PACK_PAGE_SIZE || frame.h + (2 * PACK_PAD) > PACK_PAGE_SIZE){
+				reason = anims[a].files[i] + " does not fit an atlas page";
+				break;
+			}
+		}
+	}
+	
+	if(reason.empty()){
+		//shelf packing, tallest frames first so each shelf wastes little height
+		std::vector<std::pair<int, int> > order;
+		for(size_t i=0; i<frames.size(); i++){
+			order.push_back(std::make_pair(frames[i].h, (int)i));
+		}
+		std::stable_sort(order.begin(), order.end(), taller);
+		std::vector<Pack_Sprite_t> sprites(frames.size());
+		int page = 0, x = 0, shelf_y = 0, shelf_h = 0;
+		for(size_t o=0; o<order.size(); o++){
+			const Pack_Frame_t* f = &(frames[order[o].second]);
+			int w = f->w + (2 * PACK_PAD), h = f->h + (2 * PACK_PAD);
+			if(x + w > PACK_PAGE_SIZE){
+				shelf_y += shelf_h;
+				x = 0;
+				shelf_h = 0;
+			}
+			if(shelf_y + h > PACK_PAGE_SIZE){
+				page++;
+				shelf_y = 0;
+				x = 0;
+				shelf_h = 0;
+			}
+			Pack_Sprite_t* s = &(sprites[order[o].second]);
+			memset((char*)s, 0, sizeof(*s));
+			s->page = (unsigned short)page;
+			s->x = (unsigned short)(x + PACK_PAD);
+			s->y = (unsigned short)(shelf_y + PACK_PAD);
+			s->w = (unsigned short)f->w;
+			s->h = (unsigned short)f->h;
+			s->u0 = (float)s->x / PACK_PAGE_SIZE;
+			s->v0 = (float)s->y / PACK_PAGE_SIZE;
+			s->u1 = (float)(s->x + s->w) / PACK_PAGE_SIZE;
+			s->v1 = (float)(s->y + s->h) / PACK_PAGE_SIZE;
+			x += w;
+			shelf_h = std::max(shelf_h, h);
+		}
+		unsigned int page_count = frames.size() ? (unsigned int)page + 1 : 0;
+		
+		//layout
+		Pack_Head_t head;
+		memset((char*)&head, 0, sizeof(head));
+		memcpy(head.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+		head.version = PACK_VERSION;
+		head.page_size = PACK_PAGE_SIZE;
+		head.page_count = page_count;
+		head.sprite_count = (unsigned int)sprites.size();
+		head.anim_count = (unsigned int)anim_table.size();
+		head.sprite_off = sizeof(Pack_Head_t);
+		head.anim_off = head.sprite_off + (sprites.size() * sizeof(Pack_Sprite_t));
+		head.pixel_off = (head.anim_off + (anim_table.size() * sizeof(Pack_Anim_t)) + PACK_ALIGN - 1) & ~(unsigned long long)(PACK_ALIGN - 1);
+		unsigned long long page_bytes = (unsigned long long)PACK_PAGE_SIZE * PACK_PAGE_SIZE * 4;
+		head.file_size = head.pixel_off + (page_count * page_bytes);
+		
+		//pages (transparent where no sprite was placed)
+		std::vector<unsigned char> pages(page_count * page_bytes, 0);
+		for(size_t i=0; i<frames.size(); i++){
+			const Pack_Sprite_t* s = &(sprites[i]);
+			unsigned char* dst = &(pages[0]) + (s->page * page_bytes);
+			for(int y=0; y<s->h; y++){
+				memcpy(dst + ((((size_t)(s->y + y) * PACK_PAGE_SIZE) + s->x) * 4), frames[i].pixels + ((size_t)y * s->w * 4), (size_t)s->w * 4);
+			}
+		}
+		
+		std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+		if(!out.is_open()){
+			reason = "cannot write " + path;
+		} else{
+			std::vector<char> pad(head.pixel_off - head.anim_off - (anim_table.size() * sizeof(Pack_Anim_t)), 0);
+			out.write((const char*)&head, sizeof(head));
+			if(sprites.size()){
+				out.write((const char*)&(sprites[0]), sprites.size() * sizeof(Pack_Sprite_t));
+			}
+			if(anim_table.size()){
+				out.write((const char*)&(anim_table[0]), anim_table.size() * sizeof(Pack_Anim_t));
+			}
+			if(pad.size()){
+				out.write(&(pad[0]), pad.size());
+			}
+			if(pages.size()){
+				out.write((const char*)&(pages[0]), pages.size());
+			}
+			out.close();
+			if(out.fail()){
+				reason = "write to " + path + " failed";
+			} else{
+				ret = 0;
+			}
+		}
+	}
+	
+	for(size_t i=0; i<frames.size(); i++){
+		delete[] frames[i].pixels;
+	}
+	if(error != NULL){
+		*error = reason;
+	}
+	return ret;
+}
@@ -0,0 +1,338 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "inc/Collision.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COL_X86 1
+#include <immintrin.h>
+#else
+#define COL_X86 0
+#endif
+
+//moves an array to a larger allocation (keeping the first count entries)
+template <typename T> static void col_grow(T*& arr, int count, int capacity){
+	T* bigger = new T[capacity];
+	if(arr != NULL){
+		memcpy((void*)bigger, (void*)arr, sizeof(T) * count);
+		delete[] arr;
+	}
+	arr = bigger;
+}
+
+//records a contact between two boxes in sweep order (boxes of one id never touch themselves)
+static inline void col_pair(Collision_World_t* col, int i, int j){
+	unsigned int a = col->boxes[col->order[i]].id, b = col->boxes[col->order[j]].id;
+	if(a == b){
+		return;
+	}
+	if(col->pair_count == col->pair_capacity){
+		col->pair_capacity = col->pair_capacity ? col->pair_capacity * 2 : 64;
+		col_grow(col->pairs, col->pair_count, col->pair_capacity);
+	}
+	col->pairs[(col->pair_count)++] = (a < b) ? (((unsigned long long)a << 32) | b) : (((unsigned long long)b << 32) | a);
+}
+
+static void col_event(Collision_World_t* col, unsigned long long key, int type){
+	if(col->event_count == col->event_capacity){
+		col->event_capacity = col->event_capacity ? col->event_capacity * 2 : 64;
+		col_grow(col->events, col->event_count, col->event_capacity);
+	}
+	Col_Event_t* ev = &(col->events[(col->event_count)++]);
+	ev->a = (unsigned int)(key >> 32);
+	ev->b = (unsigned int)key;
+	ev->type = type;
+}
+
+//keeps the sweep order sorted by min_x: boxes move a little between steps so an insertion sort of last
+//step's order is close to linear, a changed box count or a large reshuffle sorts from scratch
+static void col_sort(Collision_World_t* col){
+	const Col_Box_t* boxes = col->boxes;
+	int n = col->count;
+	if(col->order_count == n){
+		long long shifts = 0, limit = (long long)COL_RESORT * n;
+		for(int k=1; k<n && shifts <= limit; k++){
+			int idx = col->order[k];
+			float key = boxes[idx].min_x;
+			int j = k - 1;
+			for(; j>=0 && boxes[col->order[j]].min_x > key; j--){
+				col->order[j + 1] = col->order[j];
+				shifts++;
+			}
+			col->order[j + 1] = idx;
+		}
+		if(shifts <= limit){
+			return;
+		}
+	}
+	for(int k=0; k<n; k++){
+		col->order[k] = k;
+	}
+	std::sort(col->order, col->order + n, [boxes](int a, int b){ return boxes[a].min_x < boxes[b].min_x; });
+	col->order_count = n;
+}
+
+// ##################################################################### narrowphase sweeps
+
+//each sweeps box i against the boxes after it in sweep order until one starts past its right edge
+//(the padding starts at +inf so every run ends inside the arrays)
+static void col_sweep_scalar(Collision_World_t* col){
+	for(int i=0; i<col->count; i++){
+		float max_x = col->max_x[i], min_y = col->min_y[i], max_y = col->max_y[i];
+		unsigned int layers = col->layers[i], hits = col->hits[i];
+		for(int j=i+1; col->min_x[j] <= max_x; j++){
+			(col->tested)++;
+			if(col->min_y[j] <= max_y && col->max_y[j] >= min_y && ((hits & col->layers[j]) | (layers & col->hits[j]))){
+				col_pair(col, i, j);
+			}
+		}
+	}
+}
+
+#if COL_X86
+__attribute__((target("avx2,popcnt"))) static void col_sweep_avx2(Collision_World_t* col){
+	const __m256i zero = _mm256_setzero_si256();
+	for(int i=0; i<col->count; i++){
+		__m256 max_x = _mm256_set1_ps(col->max_x[i]);
+		__m256 min_y = _mm256_set1_ps(col->min_y[i]);
+		__m256 max_y = _mm256_set1_ps(col->max_y[i]);
+		__m256i layers = _mm256_set1_epi32((int)col->layers[i]);
+		__m256i hits = _mm256_set1_epi32((int)col->hits[i]);
+		for(int j=i+1; ; j+=8){
+			//the run is sorted, so the lanes still overlapping on x are a prefix
+			int in_x = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(col->min_x + j), max_x, _CMP_LE_OQ));
+			if(in_x == 0){
+				break;
+			}
+			__m256 in_y = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(col->min_y + j), max_y, _CMP_LE_OQ),
+					_mm256_cmp_ps(_mm256_loadu_ps(col->max_y + j), min_y, _CMP_GE_OQ));
+			__m256i match = _mm256_or_si256(_mm256_and_si256(hits, _mm256_loadu_si256((const __m256i*)(col->layers + j))),
+					_mm256_and_si256(layers, _mm256_loadu_si256((const __m256i*)(col->hits + j))));
+			int none = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(match, zero)));
+			int m = in_x & _mm256_movemask_ps(in_y) & ~none;
+			col->tested += __builtin_popcount(in_x);
+			while(m){
+				col_pair(col, i, j + __builtin_ctz(m));
+				m &= m - 1;
+			}
+			if(in_x != 0xFF){
+				break;
+			}
+		}
+	}
+}
+
+__attribute__((target("avx512f,popcnt"))) static void col_sweep_avx512(Collision_World_t* col){
+	for(int i=0; i<col->count; i++){
+		__m512 max_x = _mm512_set1_ps(col->max_x[i]);
+		__m512 min_y = _mm512_set1_ps(col->min_y[i]);
+		__m512 max_y = _mm512_set1_ps(col->max_y[i]);
+		__m512i layers = _mm512_set1_epi32((int)col->layers[i]);
+		__m512i hits = _mm512_set1_epi32((int)col->hits[i]);
+		for(int j=i+1; ; j+=16){
+			__mmask16 in_x = _mm512_cmp_ps_mask(_mm512_loadu_ps(col->min_x + j), max_x, _CMP_LE_OQ);
+			if(in_x == 0){
+				break;
+			}
+			__mmask16 in_y = _mm512_mask_cmp_ps_mask(in_x, _mm512_loadu_ps(col->min_y + j), max_y, _CMP_LE_OQ);
+			in_y = _mm512_mask_cmp_ps_mask(in_y, _mm512_loadu_ps(col->max_y + j), min_y, _CMP_GE_OQ);
+			__m512i match = _mm512_or_si512(_mm512_and_si512(hits, _mm512_loadu_si512(col->layers + j)),
+					_mm512_and_si512(layers, _mm512_loadu_si512(col->hits + j)));
+			unsigned int m = _mm512_mask_test_epi32_mask(in_y, match, match);
+			col->tested += __builtin_popcount(in_x);
+			while(m){
+				col_pair(col, i, j + __builtin_ctz(m));
+				m &= m - 1;
+			}
+			if(in_x != 0xFFFF){
+				break;
+			}
+		}
+	}
+}
+#endif
+
+// ##################################################################### world
+
+/*	col_init:
+ * 		Sets up an empty collision world using the widest narrowphase the cpu supports.
+ *	returns: 0 for success, -1 for error
+ */
+int col_init(Collision_World_t* col){
+	if(col == NULL){
+		return -1;
+	}
+	memset((char*)col, 0, sizeof(*col));
+	col->simd = col_simd_available();
+	return 0;
+}
+
+/*	col_destroy:
+ * 		Frees the boxes, contacts and events of a collision world.
+ */
+void col_destroy(Collision_World_t* col){
+	if(col == NULL){
+		return;
+	}
+	delete[] col->boxes;
+	delete[] col->order;
+	delete[] col->min_x;
+	delete[] col->min_y;
+	delete[] col->max_x;
+	delete[] col->max_y;
+	delete[] col->layers;
+	delete[] col->hits;
+	delete[] col->pairs;
+	delete[] col->prev;
+	delete[] col->events;
+	memset((char*)col, 0, sizeof(*col));
+}
+
+/*	col_simd_available:
+ *	returns: the widest narrowphase the cpu supports (COL_AVX512, COL_AVX2 or COL_SCALAR)
+ */
+int col_simd_available(){
+	#if COL_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")){
+		return COL_AVX512;
+	}
+	if(__builtin_cpu_supports("avx2")){
+		return COL_AVX2;
+	}
+	#endif
+	return COL_SCALAR;
+}
+
+/*	col_use_simd:
+ * 		Picks a narrowphase (for benchmarks and checks), when the cpu supports it.
+ *	returns: 0 for success, -1 if the cpu does not support it
+ */
+int col_use_simd(Collision_World_t* col, int simd){
+	if(col == NULL || simd < COL_SCALAR || simd > col_simd_available()){
+		return -1;
+	}
+	col->simd = simd;
+	return 0;
+}
+
+/*	col_simd_name:
+ *	returns: a printable name of a narrowphase
+ */
+const char* col_simd_name(int simd){
+	switch(simd){
+		case COL_AVX2:
+			return "avx2 (8 wide)";
+		case COL_AVX512:
+			return "avx512 (16 wide)";
+		default:
+			return "scalar";
+	}
+}
+
+/*	col_clear:
+ * 		Empties the boxes ahead of adding a step's boxes (contacts of the last step are kept for its events).
+ */
+void col_clear(Collision_World_t* col){
+	col->count = 0;
+}
+
+/*	col_add:
+ * 		Adds a box for this step by its center and half extents.
+ *	returns: 0 for success, -1 for error
+ */
+int col_add(Collision_World_t* col, unsigned int id, float cx, float cy, float half_w, float half_h, unsigned int layers, unsigned int hits){
+	if(col == NULL || half_w < 0 || half_h < 0){
+		return -1;
+	}
+	if(col->count == col->capacity){
+		int capacity = col->capacity ? col->capacity * 2 : 64;
+		col_grow(col->boxes, col->count, capacity);
+		col_grow(col->order, col->order_count, capacity);
+		float** soa[] = {&(col->min_x), &(col->min_y), &(col->max_x), &(col->max_y)};
+		for(int s=0; s<4; s++){
+			delete[] *(soa[s]);
+			*(soa[s]) = new float[capacity + COL_PAD];
+		}
+		delete[] col->layers;
+		delete[] col->hits;
+		col->layers = new unsigned int[capacity + COL_PAD];
+		col->hits = new unsigned int[capacity + COL_PAD];
+		col->capacity = capacity;
+	}
+	Col_Box_t* box = &(col->boxes[(col->count)++]);
+	box->min_x = cx - half_w;
+	box->max_x = cx + half_w;
+	box->min_y = cy - half_h;
+	box->max_y = cy + half_h;
+	box->id = id;
+	box->layers = layers;
+	box->hits = hits;
+	return 0;
+}
+
+/*	col_step:
+ * 		Finds every contact between the step's boxes: sorts them on x, sweeps each against the boxes
+ * 		starting inside it, then compares the contacts with the last step's for the begin and end events.
+ * 		The step's contacts are left in prev (prev_count) and its events in events (event_count).
+ *	returns: the number of contacts (pairs of ids) this step
+ */
+int col_step(Collision_World_t* col){
+	//sweep order and the sorted copy with its padding
+	col_sort(col);
+	int n = col->count;
+	for(int k=0; k<n; k++){
+		const Col_Box_t* box = &(col->boxes[col->order[k]]);
+		col->min_x[k] = box->min_x;
+		col->min_y[k] = box->min_y;
+		col->max_x[k] = box->max_x;
+		col->max_y[k] = box->max_y;
+		col->layers[k] = box->layers;
+		col->hits[k] = box->hits;
+	}
+	for(int k=n; k<n+COL_PAD && col->capacity > 0; k++){
+		col->min_x[k] = HUGE_VALF;
+		col->min_y[k] = HUGE_VALF;
+		col->max_x[k] = -HUGE_VALF;
+		col->max_y[k] = -HUGE_VALF;
+		col->layers[k] = 0;
+		col->hits[k] = 0;
+	}
+	
+	//contacts (an id pair touching through several boxes counts once)
+	col->pair_count = 0;
+	if(n > 0){
+		#if COL_X86
+		if(col->simd == COL_AVX512){
+			col_sweep_avx512(col);
+		} else if(col->simd == COL_AVX2){
+			col_sweep_avx2(col);
+		} else{
+			col_sweep_scalar(col);
+		}
+		#else
+		col_sweep_scalar(col);
+		#endif
+	}
+	std::sort(col->pairs, col->pairs + col->pair_count);
+	col->pair_count = (int)(std::unique(col->pairs, col->pairs + col->pair_count) - col->pairs);
+	
+	//events from the two sorted contact lists
+	col->event_count = 0;
+	int p = 0, q = 0;
+	while(p < col->pair_count || q < col->prev_count){
+		if(q == col->prev_count || (p < col->pair_count && col->pairs[p] < col->prev[q])){
+			col_event(col, col->pairs[p++], COL_BEGIN);
+		} else if(p == col->pair_count || col->prev[q] < col->pairs[p]){
+			col_event(col, col->prev[q++], COL_END);
+		} else{
+			p++;
+			q++;
+		}
+	}
+	std::swap(col->pairs, col->prev);
+	std::swap(col->pair_capacity, col->prev_capacity);
+	col->prev_count = col->pair_count;
+	return col->pair_count;
+}
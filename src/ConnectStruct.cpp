@@ -10,6 +10,39 @@ unsigned long get_timestamp(){
 	return out;
 }
 
+/*	get_mono_ns:
+ * 		Monotonic high resolution clock (unaffected by the hour wrap of get_timestamp).
+ *	returns: nanoseconds since an arbitrary fixed point
+ */
+unsigned long long get_mono_ns(){
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return qpc_to_ns(count.QuadPart);
+}
+
+/*	qpc_to_ns:
+ * 		Converts a performance counter reading (e.g. a receive timestamp from the network stack) to the get_mono_ns clock.
+ *	returns: nanoseconds since the get_mono_ns fixed point
+ */
+unsigned long long qpc_to_ns(unsigned long long count){
+	static LARGE_INTEGER freq = {};
+	if(freq.QuadPart == 0){
+		QueryPerformanceFrequency(&freq);
+	}
+	//split the conversion so the multiply cannot overflow
+	unsigned long long sec = count / freq.QuadPart;
+	unsigned long long rem = count % freq.QuadPart;
+	return (sec * 1000000000ULL) + ((rem * 1000000000ULL) / freq.QuadPart);
+}
+
+/*	get_mono_ms:
+ * 		Millisecond version of the monotonic clock, used as the tick of the timer wheels.
+ *	returns: milliseconds since an arbitrary fixed point
+ */
+unsigned long long get_mono_ms(){
+	return get_mono_ns() / 1000000ULL;
+}
+
 void err_out(std::ofstream* err, std::string text){
 	#if ERR
 	if(!err->is_open()){
@@ -29,3 +62,134 @@ void log_out(std::ofstream* log, std::string text){
 	#endif
 	return;
 }
+
+/*	parse_addr:
+ * 		Fills a socket address from "address" or "address:port" (the given port by default).
+ *	returns: 0 for success, -1 for an improper address
+ */
+int parse_addr(std::string text, unsigned short port, struct sockaddr_in* addr){
+	if(addr == NULL){
+		return -1;
+	}
+	size_t colon = text.find(':');
+	if(colon != std::string::npos){
+		port = (unsigned short)atoi(text.c_str() + colon + 1);
+		text = text.substr(0, colon);
+	}
+	memset((char*)addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.S_un.S_addr = inet_addr(text.c_str());
+	addr->sin_port = htons(port);
+	if(port == 0 || addr->sin_addr.S_un.S_addr == INADDR_NONE){
+		return -1;
+	}
+	return 0;
+}
+
+/*	same_addr:
+ * 		Compares the address and port of two socket addresses.
+ *	returns: 1 if they match, 0 if not
+ */
+int same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b){
+	return (a->sin_addr.S_un.S_addr == b->sin_addr.S_un.S_addr) && (a->sin_port == b->sin_port);
+}
+
+/*	udp_bind:
+ * 		Starts winsock and opens a non-blocking UDP socket bound to port on every address (0 for any free
+ * 		port), as the servers, nodes and spectators all listen. The bound address goes in server and any
+ * 		failure in err (either may be NULL).
+ *	returns: 0 on success, the winsock error code on error
+ */
+int udp_bind(WSADATA* wsa, SOCKET* s, struct sockaddr_in* server, unsigned short port, std::ofstream* err){
+	struct sockaddr_in local;
+	if(server == NULL){
+		server = &local;
+	}
+	
+	//initializing winsock
+	if(WSAStartup(MAKEWORD(2,2), wsa)!=0){
+		if(err != NULL){
+			err_out(err, "Initialization Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		return WSAGetLastError();
+	}
+	
+	//creating a non-blocking UDP socket
+	if((*s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == SOCKET_ERROR){
+		if(err != NULL){
+			err_out(err, "Socket Not Created. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		return WSAGetLastError();
+	}
+	unsigned long ul = 1;
+	if(ioctlsocket(*s, FIONBIO, &ul) == SOCKET_ERROR){
+		if(err != NULL){
+			err_out(err, "Non-Blocking Mode Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		return WSAGetLastError();
+	}
+	
+	//fill server sockaddr structure and bind the socket
+	memset((char*)server, 0, sizeof(*server));
+	server->sin_family = AF_INET;
+	server->sin_addr.s_addr = INADDR_ANY;
+	server->sin_port = htons(port);
+	if(bind(*s, (struct sockaddr*)server, sizeof(*server)) == SOCKET_ERROR){
+		if(err != NULL){
+			err_out(err, "Socket Bind Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		return WSAGetLastError();
+	}
+	return 0;
+}
+
+/*	relay_wrap:
+ * 		Adds the relay trailer after a packet (peer is the join a host is sending to, NULL from a join).
+ * 		The message buffer needs room for relay_trailer_len bytes past len.
+ *	returns: length to send
+ */
+int relay_wrap(char* message, int len, unsigned int token, const struct sockaddr_in* peer, unsigned short flags){
+	Relay_Trailer_t t;
+	t.token = token;
+	t.addr = (peer != NULL) ? (unsigned int)peer->sin_addr.S_un.S_addr : 0;
+	t.port = (peer != NULL) ? peer->sin_port : 0;
+	t.flags = flags;
+	//the trailer can land at any offset
+	memcpy(message + len, (char*)&t, relay_trailer_len);
+	return len + relay_trailer_len;
+}
+
+/*	relay_unwrap:
+ * 		Reads the relay trailer off a datagram from the relay.
+ *	returns: length of the packet before the trailer, -1 if the datagram is too short
+ */
+int relay_unwrap(char* buf, int len, Relay_Trailer_t* trailer){
+	if(buf == NULL || len < (int)relay_trailer_len){
+		return -1;
+	}
+	len -= relay_trailer_len;
+	if(trailer != NULL){
+		memcpy((char*)trailer, buf + len, relay_trailer_len);
+	}
+	return len;
+}
+
+/*	recv_handler_join:
+ * 		Joins the last handler thread started in a recv thread slot, if it has not been joined yet.
+ */
+void recv_handler_join(Recv_Thread_t* rt){
+	if(rt->t_handler == 0){
+		pthread_join(rt->handler_thread, NULL);
+		rt->t_handler = -1;
+	}
+}
+
+/*	recv_drain:
+ * 		Waits for the handler threads of a recv thread's slots to finish, so nothing still uses the slots
+ * 		(kept on the recv thread's stack) or the connection state once the recv thread exits.
+ */
+void recv_drain(Recv_Thread_t* rt, int count){
+	for(int i=0; i<count; i++){
+		recv_handler_join(&(rt[i]));
+	}
+}
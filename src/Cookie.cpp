@@ -0,0 +1,165 @@
+#include "inc/Cookie.h"
+
+#include <string.h>
+
+//SHA-256 round constants and initial hash state
+static const unsigned int ck_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+static const unsigned int ck_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define CK_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*	ck_compress:
+ * 		Runs the SHA-256 compression function over one 64 byte block.
+ */
+static void ck_compress(unsigned int* st, const unsigned char* block){
+	unsigned int w[64];
+	for(int i=0; i<16; i++){
+		w[i] = ((unsigned int)block[4*i] << 24) | ((unsigned int)block[4*i + 1] << 16) | ((unsigned int)block[4*i + 2] << 8) | block[4*i + 3];
+	}
+	for(int i=16; i<64; i++){
+		unsigned int s0 = CK_ROR(w[i - 15], 7) ^ CK_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		unsigned int s1 = CK_ROR(w[i - 2], 17) ^ CK_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	
+	unsigned int a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+	for(int i=0; i<64; i++){
+		unsigned int t1 = h + (CK_ROR(e, 6) ^ CK_ROR(e, 11) ^ CK_ROR(e, 25)) + ((e & f) ^ (~e & g)) + ck_k[i] + w[i];
+		unsigned int t2 = (CK_ROR(a, 2) ^ CK_ROR(a, 13) ^ CK_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	st[0] += a;
+	st[1] += b;
+	st[2] += c;
+	st[3] += d;
+	st[4] += e;
+	st[5] += f;
+	st[6] += g;
+	st[7] += h;
+}
+
+/*	ck_finish:
+ * 		Hashes the rest of a message into a state that has already taken prefix bytes (whole blocks), adds
+ * 		the padding and writes the digest.
+ */
+static void ck_finish(unsigned int* st, const unsigned char* msg, int len, unsigned long long prefix, unsigned char* out){
+	unsigned char block[CK_BLOCK_LEN];
+	unsigned long long bits = (prefix + len) * 8;
+	for(; len >= CK_BLOCK_LEN; len -= CK_BLOCK_LEN, msg += CK_BLOCK_LEN){
+		ck_compress(st, msg);
+	}
+	
+	//last bytes, the 0x80 marker and the bit length (in a second block when they do not fit)
+	memset(block, 0, CK_BLOCK_LEN);
+	memcpy(block, msg, len);
+	block[len] = 0x80;
+	if(len >= CK_BLOCK_LEN - 8){
+		ck_compress(st, block);
+		memset(block, 0, CK_BLOCK_LEN);
+	}
+	for(int i=0; i<8; i++){
+		block[CK_BLOCK_LEN - 1 - i] = (unsigned char)(bits >> (8*i));
+	}
+	ck_compress(st, block);
+	
+	for(int i=0; i<8; i++){
+		out[4*i] = (unsigned char)(st[i] >> 24);
+		out[4*i + 1] = (unsigned char)(st[i] >> 16);
+		out[4*i + 2] = (unsigned char)(st[i] >> 8);
+		out[4*i + 3] = (unsigned char)st[i];
+	}
+}
+
+/*	ck_set_key:
+ * 		Takes the padded key blocks of an HMAC-SHA256 key (keys over a block long are hashed first).
+ */
+void ck_set_key(Cookie_Key_t* ck, const unsigned char* key, int key_len){
+	unsigned char k[CK_BLOCK_LEN], pad[CK_BLOCK_LEN];
+	memset(k, 0, CK_BLOCK_LEN);
+	if(key_len > CK_BLOCK_LEN){
+		unsigned int st[8];
+		memcpy(st, ck_iv, sizeof(st));
+		ck_finish(st, key, key_len, 0, k);
+	} else{
+		memcpy(k, key, key_len);
+	}
+	
+	memcpy(ck->inner, ck_iv, sizeof(ck->inner));
+	memcpy(ck->outer, ck_iv, sizeof(ck->outer));
+	for(int i=0; i<CK_BLOCK_LEN; i++){
+		pad[i] = k[i] ^ 0x36;
+	}
+	ck_compress(ck->inner, pad);
+	for(int i=0; i<CK_BLOCK_LEN; i++){
+		pad[i] = k[i] ^ 0x5c;
+	}
+	ck_compress(ck->outer, pad);
+}
+
+/*	ck_hmac:
+ * 		HMAC-SHA256 of a message under the key.
+ */
+void ck_hmac(const Cookie_Key_t* ck, const unsigned char* msg, int len, unsigned char* out){
+	unsigned int st[8];
+	unsigned char inner[CK_HASH_LEN];
+	memcpy(st, ck->inner, sizeof(st));
+	ck_finish(st, msg, len, CK_BLOCK_LEN, inner);
+	memcpy(st, ck->outer, sizeof(st));
+	ck_finish(st, inner, CK_HASH_LEN, CK_BLOCK_LEN, out);
+}
+
+/*	ck_mac:
+ * 		MAC of an address, port and stamp, cut to the bytes a cookie keeps.
+ */
+static void ck_mac(const Cookie_Key_t* ck, const struct sockaddr_in* addr, unsigned int stamp, unsigned char* mac){
+	unsigned char msg[10], out[CK_HASH_LEN];
+	memcpy(msg, &(addr->sin_addr.S_un.S_addr), 4);
+	memcpy(msg + 4, &(addr->sin_port), 2);
+	memcpy(msg + 6, &stamp, 4);
+	ck_hmac(ck, msg, sizeof(msg), out);
+	memcpy(mac, out, CK_MAC_LEN);
+}
+
+/*	ck_mint:
+ * 		Makes the cookie for a join request from this address and port at this time.
+ */
+void ck_mint(const Cookie_Key_t* ck, const struct sockaddr_in* addr, unsigned int now_ms, Cookie_t* cookie){
+	cookie->stamp = now_ms;
+	ck_mac(ck, addr, now_ms, cookie->mac);
+}
+
+/*	ck_check:
+ * 		Checks a cookie handed back from this address and port was minted with the key at most life_ms
+ * 		ago (the MAC is compared in constant time).
+ *	returns: 1 if the cookie is good, 0 if it is forged, for another source or too old
+ */
+int ck_check(const Cookie_Key_t* ck, const struct sockaddr_in* addr, unsigned int now_ms, unsigned int life_ms, const Cookie_t* cookie){
+	if(now_ms - cookie->stamp > life_ms){
+		return 0;
+	}
+	unsigned char mac[CK_MAC_LEN];
+	ck_mac(ck, addr, cookie->stamp, mac);
+	unsigned char diff = 0;
+	for(int i=0; i<CK_MAC_LEN; i++){
+		diff |= mac[i] ^ cookie->mac[i];
+	}
+	return diff == 0;
+}
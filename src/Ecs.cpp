@@ -0,0 +1,350 @@
+#include <string.h>
+
+#include "inc/Ecs.h"
+
+#define ECS_START_ROWS 16			// first capacity of a new archetype (doubles as it fills)
+
+//sizes of the game components, registered by ecs_init so their ids match the ECS_* defines
+static const unsigned int game_sizes[ECS_GAME_COMPONENTS] = {sizeof(Ecs_Pos_t), sizeof(Ecs_Vel_t), sizeof(Ecs_Player_t),
+		sizeof(Ecs_Hitbox_t), sizeof(Ecs_Sprite_t), sizeof(Ecs_Lifetime_t)};
+
+//moves an array to a larger allocation (keeping the first count entries)
+template <typename T> static void ecs_grow(T*& arr, int count, int capacity){
+	T* bigger = new T[capacity];
+	if(arr != NULL){
+		memcpy((void*)bigger, (void*)arr, sizeof(T) * count);
+		delete[] arr;
+	}
+	arr = bigger;
+}
+
+//makes room for one more row in an archetype
+static void ecs_arch_reserve(Ecs_World_t* w, Ecs_Archetype_t* a){
+	if(a->count < a->capacity){
+		return;
+	}
+	int capacity = a->capacity ? a->capacity * 2 : ECS_START_ROWS;
+	ecs_grow(a->entities, a->count, capacity);
+	for(int c=0; c<w->comp_count; c++){
+		if(a->mask & ECS_BIT(c)){
+			char* col = new char[(size_t)capacity * w->comp_size[c]];
+			memcpy(col, a->columns[c], (size_t)a->count * w->comp_size[c]);
+			delete[] a->columns[c];
+			a->columns[c] = col;
+		}
+	}
+	a->capacity = capacity;
+}
+
+//finds the archetype of a component set, adding it the first time the set is seen
+static int ecs_arch_find(Ecs_World_t* w, unsigned int mask){
+	for(int i=0; i<w->arch_count; i++){
+		if(w->archs[i].mask == mask){
+			return i;
+		}
+	}
+	if(w->arch_count == w->arch_capacity){
+		w->arch_capacity = w->arch_capacity ? w->arch_capacity * 2 : 8;
+		ecs_grow(w->archs, w->arch_count, w->arch_capacity);
+	}
+	Ecs_Archetype_t* a = &(w->archs[w->arch_count]);
+	memset((char*)a, 0, sizeof(*a));
+	a->mask = mask;
+	for(int c=0; c<w->comp_count; c++){
+		if(mask & ECS_BIT(c)){
+			a->columns[c] = new char[0];
+		}
+	}
+	return (w->arch_count)++;
+}
+
+//appends a zeroed row for an entity
+static int ecs_arch_push(Ecs_World_t* w, int arch, Ecs_Entity_t e){
+	Ecs_Archetype_t* a = &(w->archs[arch]);
+	ecs_arch_reserve(w, a);
+	int row = (a->count)++;
+	a->entities[row] = e;
+	for(int c=0; c<w->comp_count; c++){
+		if(a->mask & ECS_BIT(c)){
+			memset(a->columns[c] + ((size_t)row * w->comp_size[c]), 0, w->comp_size[c]);
+		}
+	}
+	return row;
+}
+
+//removes a row by moving the archetype's last row into it
+static void ecs_arch_pop(Ecs_World_t* w, int arch, int row){
+	Ecs_Archetype_t* a = &(w->archs[arch]);
+	int last = --(a->count);
+	if(row != last){
+		for(int c=0; c<w->comp_count; c++){
+			if(a->mask & ECS_BIT(c)){
+				memcpy(a->columns[c] + ((size_t)row * w->comp_size[c]), a->columns[c] + ((size_t)last * w->comp_size[c]), w->comp_size[c]);
+			}
+		}
+		Ecs_Entity_t moved = a->entities[last];
+		a->entities[row] = moved;
+		w->records[moved & (ECS_MAX_ENTITIES - 1)].row = row;
+	}
+}
+
+//record of a live entity, NULL for a stale or unknown id
+static Ecs_Record_t* ecs_record(const Ecs_World_t* w, Ecs_Entity_t e){
+	int slot = (int)(e & (ECS_MAX_ENTITIES - 1));
+	if(e == 0 || slot >= w->record_count || w->records[slot].arch < 0 || w->records[slot].gen != (e >> ECS_INDEX_BITS)){
+		return NULL;
+	}
+	return &(w->records[slot]);
+}
+
+//moves an entity to the archetype of a new component set, keeping the components both sets share
+static int ecs_move(Ecs_World_t* w, Ecs_Entity_t e, unsigned int mask){
+	Ecs_Record_t* rec = ecs_record(w, e);
+	if(rec == NULL){
+		return -1;
+	}
+	if(w->archs[rec->arch].mask == mask){
+		return 0;
+	}
+	int to = ecs_arch_find(w, mask);
+	int row = ecs_arch_push(w, to, e);
+	Ecs_Archetype_t* src = &(w->archs[rec->arch]);
+	Ecs_Archetype_t* dst = &(w->archs[to]);
+	for(int c=0; c<w->comp_count; c++){
+		if(src->mask & dst->mask & ECS_BIT(c)){
+			memcpy(dst->columns[c] + ((size_t)row * w->comp_size[c]), src->columns[c] + ((size_t)rec->row * w->comp_size[c]), w->comp_size[c]);
+		}
+	}
+	ecs_arch_pop(w, rec->arch, rec->row);
+	rec->arch = to;
+	rec->row = row;
+	return 0;
+}
+
+/*	ecs_init:
+ * 		Sets up an empty world with the game components registered.
+ *	returns: 0 for success, -1 for error
+ */
+int ecs_init(Ecs_World_t* w){
+	if(w == NULL){
+		return -1;
+	}
+	memset((char*)w, 0, sizeof(*w));
+	for(int c=0; c<ECS_GAME_COMPONENTS; c++){
+		ecs_register(w, game_sizes[c]);
+	}
+	return 0;
+}
+
+/*	ecs_destroy:
+ * 		Frees every archetype and entity of a world.
+ */
+void ecs_destroy(Ecs_World_t* w){
+	if(w == NULL){
+		return;
+	}
+	for(int i=0; i<w->arch_count; i++){
+		for(int c=0; c<ECS_MAX_COMPONENTS; c++){
+			delete[] w->archs[i].columns[c];
+		}
+		delete[] w->archs[i].entities;
+	}
+	delete[] w->archs;
+	delete[] w->records;
+	delete[] w->free_slots;
+	memset((char*)w, 0, sizeof(*w));
+}
+
+/*	ecs_register:
+ * 		Adds a component type (before any archetype uses it).
+ *	returns: the component id, -1 when the world has ECS_MAX_COMPONENTS already
+ */
+int ecs_register(Ecs_World_t* w, unsigned int size){
+	if(w == NULL || w->comp_count == ECS_MAX_COMPONENTS){
+		return -1;
+	}
+	w->comp_size[w->comp_count] = size;
+	return (w->comp_count)++;
+}
+
+/*	ecs_create:
+ * 		Creates an entity holding the mask's components (zeroed), reusing a freed slot when there is one.
+ *	returns: the entity, 0 on error
+ */
+Ecs_Entity_t ecs_create(Ecs_World_t* w, unsigned int mask){
+	if(w == NULL || (mask >> w->comp_count) != 0){
+		return 0;
+	}
+	int slot;
+	if(w->free_count > 0){
+		slot = w->free_slots[--(w->free_count)];
+	} else{
+		if(w->record_count == ECS_MAX_ENTITIES){
+			return 0;
+		}
+		if(w->record_count == w->record_capacity){
+			w->record_capacity = w->record_capacity ? w->record_capacity * 2 : 64;
+			ecs_grow(w->records, w->record_count, w->record_capacity);
+			ecs_grow(w->free_slots, w->free_count, w->record_capacity);
+		}
+		slot = (w->record_count)++;
+		w->records[slot].gen = 0;
+	}
+	
+	//generations wrap inside the id's upper bits and skip 0 so no live entity is 0
+	Ecs_Record_t* rec = &(w->records[slot]);
+	rec->gen = (rec->gen + 1) & ((1u << (32 - ECS_INDEX_BITS)) - 1);
+	if(rec->gen == 0){
+		rec->gen = 1;
+	}
+	Ecs_Entity_t e = (rec->gen << ECS_INDEX_BITS) | (unsigned int)slot;
+	rec->arch = ecs_arch_find(w, mask);
+	rec->row = ecs_arch_push(w, rec->arch, e);
+	(w->alive)++;
+	return e;
+}
+
+/*	ecs_delete:
+ * 		Deletes an entity (its archetype's last row moves into its place).
+ *	returns: 0 for success, -1 for a stale or unknown entity
+ */
+int ecs_delete(Ecs_World_t* w, Ecs_Entity_t e){
+	Ecs_Record_t* rec = (w == NULL) ? NULL : ecs_record(w, e);
+	if(rec == NULL){
+		return -1;
+	}
+	ecs_arch_pop(w, rec->arch, rec->row);
+	rec->arch = -1;
+	w->free_slots[(w->free_count)++] = (int)(e & (ECS_MAX_ENTITIES - 1));
+	(w->alive)--;
+	return 0;
+}
+
+/*	ecs_alive:
+ * 		Checks an entity id against its slot's generation.
+ *	returns: 1 for a live entity, 0 otherwise
+ */
+int ecs_alive(const Ecs_World_t* w, Ecs_Entity_t e){
+	return (w != NULL && ecs_record(w, e) != NULL);
+}
+
+/*	ecs_get:
+ * 		Finds one component of an entity (valid until the next create, delete, add or remove).
+ *	returns: the component, NULL if the entity is stale or lacks it
+ */
+void* ecs_get(Ecs_World_t* w, Ecs_Entity_t e, int comp){
+	Ecs_Record_t* rec = (w == NULL) ? NULL : ecs_record(w, e);
+	if(rec == NULL || comp < 0 || comp >= ECS_MAX_COMPONENTS || !(w->archs[rec->arch].mask & ECS_BIT(comp))){
+		return NULL;
+	}
+	return w->archs[rec->arch].columns[comp] + ((size_t)rec->row * w->comp_size[comp]);
+}
+
+/*	ecs_add:
+ * 		Gives an entity a component (zeroed), moving it to the archetype with that component.
+ *	returns: 0 for success (or if it had it already), -1 on error
+ */
+int ecs_add(Ecs_World_t* w, Ecs_Entity_t e, int comp){
+	Ecs_Record_t* rec = (w == NULL) ? NULL : ecs_record(w, e);
+	if(rec == NULL || comp < 0 || comp >= w->comp_count){
+		return -1;
+	}
+	return ecs_move(w, e, w->archs[rec->arch].mask | ECS_BIT(comp));
+}
+
+/*	ecs_remove:
+ * 		Takes a component from an entity, moving it to the archetype without that component.
+ *	returns: 0 for success (or if it did not have it), -1 on error
+ */
+int ecs_remove(Ecs_World_t* w, Ecs_Entity_t e, int comp){
+	Ecs_Record_t* rec = (w == NULL) ? NULL : ecs_record(w, e);
+	if(rec == NULL || comp < 0 || comp >= w->comp_count){
+		return -1;
+	}
+	return ecs_move(w, e, w->archs[rec->arch].mask & ~ECS_BIT(comp));
+}
+
+/*	ecs_query_init:
+ * 		Sets up a query for the archetypes with every all component and no none component.
+ */
+void ecs_query_init(Ecs_Query_t* q, unsigned int all, unsigned int none){
+	q->all = all;
+	q->none = none;
+	q->matches = NULL;
+	q->match_count = 0;
+	q->match_capacity = 0;
+	q->seen = 0;
+}
+
+/*	ecs_query_destroy:
+ * 		Frees a query's archetype list.
+ */
+void ecs_query_destroy(Ecs_Query_t* q){
+	delete[] q->matches;
+	q->matches = NULL;
+	q->match_count = 0;
+	q->match_capacity = 0;
+	q->seen = 0;
+}
+
+/*	ecs_query_update:
+ * 		Matches the archetypes added to the world since the last update (call before iterating).
+ * 		Iterate with for each of q->matches: w->archs[match], its count rows and ecs_column pointers.
+ *	returns: the number of matching archetypes
+ */
+int ecs_query_update(const Ecs_World_t* w, Ecs_Query_t* q){
+	for(; q->seen < w->arch_count; (q->seen)++){
+		unsigned int mask = w->archs[q->seen].mask;
+		if((mask & q->all) != q->all || (mask & q->none) != 0){
+			continue;
+		}
+		if(q->match_count == q->match_capacity){
+			q->match_capacity = q->match_capacity ? q->match_capacity * 2 : 8;
+			ecs_grow(q->matches, q->match_count, q->match_capacity);
+		}
+		q->matches[(q->match_count)++] = q->seen;
+	}
+	return q->match_count;
+}
+
+/*	ecs_column:
+ * 		Finds the column of one component in an archetype (row i is the archetype's entity i).
+ *	returns: the column, NULL if the archetype lacks the component
+ */
+void* ecs_column(const Ecs_Archetype_t* a, int comp){
+	if(comp < 0 || comp >= ECS_MAX_COMPONENTS){
+		return NULL;
+	}
+	return a->columns[comp];
+}
+
+/*	ecs_sync_slots:
+ * 		Mirrors n player slots into the world: a player entity (position and player components) is made
+ * 		for each slot coming into use, deleted when the slot clears and given the slot's position.
+ * 		ents holds each slot's entity (0 for none) between calls.
+ *	returns: the number of player entities
+ */
+int ecs_sync_slots(Ecs_World_t* w, Ecs_Entity_t* ents, int n, const float* x, const float* y, const unsigned char* alive){
+	int players = 0;
+	for(int i=0; i<n; i++){
+		if(!alive[i]){
+			if(ents[i] != 0){
+				ecs_delete(w, ents[i]);
+				ents[i] = 0;
+			}
+			continue;
+		}
+		if(ents[i] == 0 || !ecs_alive(w, ents[i])){
+			ents[i] = ecs_create(w, ECS_BIT(ECS_POS) | ECS_BIT(ECS_PLAYER));
+			if(ents[i] == 0){
+				continue;
+			}
+			((Ecs_Player_t*)ecs_get(w, ents[i], ECS_PLAYER))->slot = i;
+		}
+		Ecs_Pos_t* pos = (Ecs_Pos_t*)ecs_get(w, ents[i], ECS_POS);
+		pos->x = x[i];
+		pos->y = y[i];
+		players++;
+	}
+	return players;
+}
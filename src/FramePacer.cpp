@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <mmsystem.h>
+
+#include "inc/FramePacer.h"
+#include "inc/ConnectStruct.h"
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/*	fp_init:
+ * 		Sets up a pacer for fps frames a second, on a high resolution timer where the os has one
+ * 		(otherwise Sleep with the system timer raised to 1 ms plus a short yield at the end).
+ *	returns: 0 for success, -1 for error
+ */
+int fp_init(Frame_Pacer_t* fp, double fps){
+	if(fp == NULL || fps <= 0){
+		return -1;
+	}
+	fp->period_ns = (unsigned long long)(1e9 / fps);
+	fp->vsync = 0;
+	fp->timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	fp->coarse = 0;
+	if(fp->timer == NULL && timeBeginPeriod(1) == TIMERR_NOERROR){
+		fp->coarse = 1;
+	}
+	fp->next_ns = 0;
+	fp->begin_ns = 0;
+	lh_init(&(fp->interval));
+	lh_init(&(fp->work));
+	fp->frames = 0;
+	fp->missed = 0;
+	fp->slept_ns = 0;
+	fp->window_ns = get_mono_ns();
+	return 0;
+}
+
+/*	fp_set_vsync:
+ * 		Marks the buffer swap as the frame wait (the pacer then only measures), with the display refresh
+ * 		as the target frame time when it is known (displays may report 0 or 1 for a default rate).
+ */
+void fp_set_vsync(Frame_Pacer_t* fp, double refresh_hz){
+	fp->vsync = 1;
+	if(refresh_hz > 1){
+		fp->period_ns = (unsigned long long)(1e9 / refresh_hz);
+	}
+}
+
+/*	fp_quit:
+ * 		Releases the timer (and the raised system timer resolution).
+ */
+void fp_quit(Frame_Pacer_t* fp){
+	if(fp->timer != NULL){
+		CloseHandle(fp->timer);
+		fp->timer = NULL;
+	}
+	if(fp->coarse){
+		timeEndPeriod(1);
+		fp->coarse = 0;
+	}
+}
+
+/*	fp_wait:
+ * 		Sleeps until the next frame is due (returns at once with vsync or when the frame is late).
+ *	returns: the time (get_mono_ns) the wait ended
+ */
+unsigned long long fp_wait(Frame_Pacer_t* fp){
+	unsigned long long start = get_mono_ns();
+	if(fp->vsync || fp->next_ns == 0 || start >= fp->next_ns){
+		return start;
+	}
+	unsigned long long remaining = fp->next_ns - start;
+	
+	//sleep through most of the wait, then yield the core until the frame is due
+	if(fp->timer != NULL){
+		if(remaining > FRAME_SPIN_NS){
+			LARGE_INTEGER due;
+			due.QuadPart = -(LONGLONG)((remaining - FRAME_SPIN_NS) / 100);
+			if(SetWaitableTimer(fp->timer, &due, 0, NULL, NULL, FALSE)){
+				WaitForSingleObject(fp->timer, INFINITE);
+			}
+		}
+	} else if(remaining > FRAME_SLEEP_SLACK_NS + 1000000){
+		Sleep((DWORD)((remaining - FRAME_SLEEP_SLACK_NS) / 1000000));
+	}
+	unsigned long long now;
+	while((now = get_mono_ns()) < fp->next_ns){
+		SwitchToThread();
+	}
+	fp->slept_ns += now - start;
+	return now;
+}
+
+/*	fp_begin:
+ * 		Starts a frame: counts its interval from the last frame (a miss when it is over one and a half
+ * 		frame times) and schedules the next one, restarting the schedule after a stall instead of
+ * 		rushing frames to catch up.
+ */
+void fp_begin(Frame_Pacer_t* fp, unsigned long long now_ns){
+	if(fp->begin_ns != 0){
+		unsigned long long interval = now_ns - fp->begin_ns;
+		lh_record(&(fp->interval), interval);
+		if(interval > fp->period_ns + (fp->period_ns / 2)){
+			(fp->missed)++;
+		}
+	}
+	fp->begin_ns = now_ns;
+	(fp->frames)++;
+	if(fp->next_ns == 0 || now_ns > fp->next_ns + fp->period_ns){
+		fp->next_ns = now_ns + fp->period_ns;
+	} else{
+		fp->next_ns += fp->period_ns;
+	}
+}
+
+/*	fp_end:
+ * 		Ends the cpu work of a frame (called before the buffer swap so a vsync wait is not counted).
+ */
+void fp_end(Frame_Pacer_t* fp, unsigned long long now_ns){
+	lh_record(&(fp->work), now_ns - fp->begin_ns);
+}
+
+/*	fp_report:
+ * 		Report of the frames since the last report (rate, misses, interval and work percentiles), then
+ * 		starts a new window.
+ *	returns: the report lines
+ */
+std::string fp_report(Frame_Pacer_t* fp){
+	unsigned long long now = get_mono_ns();
+	double window_s = (double)(now - fp->window_ns) / 1e9;
+	char head[160];
+	snprintf(head, sizeof(head), "Frames: %.1f fps (target %.1f, %s), %llu missed, asleep %.1f%%\n", fp->frames / window_s,
+			1e9 / fp->period_ns, fp->vsync ? "vsync" : (fp->timer != NULL ? "timer" : "sleep"), fp->missed,
+			(double)fp->slept_ns / (window_s * 1e7));
+	std::string line = std::string(head) + "\tinterval " + lh_summary(&(fp->interval)) + "\n\twork " + lh_summary(&(fp->work)) + "\n";
+	
+	lh_init(&(fp->interval));
+	lh_init(&(fp->work));
+	fp->frames = 0;
+	fp->missed = 0;
+	fp->slept_ns = 0;
+	fp->window_ns = now;
+	return line;
+}
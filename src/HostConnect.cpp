@@ -1,10 +1,12 @@
 #include "inc/HostConnect.h"
+#include "inc/Lobby.h"
 
 /*	HostConnect:
  * 		Constructor for the host connection class.
  * 		This function does not initiaate host threads.
  */
 HostConnect::HostConnect(){
+	jobs.workers = NULL;
 	prev_init = 0;
 }
 
@@ -41,6 +43,13 @@ int HostConnect::init_host(Conn_Info_t* conn){
 		return WSAGetLastError();
 	}
 	
+	//room for a burst of datagrams while the recv thread is off the cpu, so a flood the rate limit drops
+	//does not push players' datagrams out of the socket buffer first
+	int rcvbuf = HOST_RECV_BUF;
+	if(setsockopt(conn->s, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Receive Buffer Not Set. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+	}
+	
 	//fill server sockaddr structure
 	memset((char*)&(conn->server), 0, sizeof(conn->server));
 	conn->server.sin_family = AF_INET;
@@ -54,36 +63,38 @@ int HostConnect::init_host(Conn_Info_t* conn){
 	}
 	
 	log_out(&(conn->log), "Socket successfully created and bound to self address\n");
+	log_out(&(conn->log), "Receive timestamps from the " + std::string(rs_source_name(rs_init(&(conn->stamp), conn->s))) + "\n");
 	
-	//initialize the conn info player values
-	for(int i=0; i<MAX_PLAYER; i++){
-		conn->players[i].px_loc = 0.0;
-		conn->players[i].py_loc = 0.0;
-		memset((char*)&(conn->players[i].p_addr), 0, sizeof(conn->players[i].p_addr));
+	//player slots, locks, peer index and timers
+	if(host_init_state(conn) == -1){
+		return -1;
 	}
-	conn->self_x_loc = 0.0;
-	conn->self_y_loc = 0.0;
-	conn->exit = 0;
-	conn->send_p = 0;
-	conn->pkt_num = 0;
 	
-	//set the values for the self player
-	conn->self_player_num = 0;
-	conn->players[0].px_loc = 0.0;
-	conn->players[0].py_loc = 0.0;
-	conn->players[0].in_use = 1;
-	conn->players[0].p_addr = conn->server;
-	
-	//initialize mutex states
-	for(int i=0; i<MAX_PLAYER; i++){
-		pthread_mutex_init(&(conn->players[i].lock), NULL);
+	//per source rate limit on everything the recv thread reads
+	if(ad_init(&(conn->admit), ADMIT_SOURCES, ADMIT_IDLE) == -1){
+		err_out(&(conn->err), "Admission Table Not Created\n");
+		return -1;
 	}
-	pthread_mutex_init(&(conn->exit_lock), NULL);
-	pthread_mutex_init(&(conn->send_p_lock), NULL);
+	ad_rate(&(conn->admit), AD_STRANGER, ADMIT_NEW_PPS, ADMIT_NEW_BURST);
+	ad_rate(&(conn->admit), AD_PLAYER, ADMIT_PPS, ADMIT_BURST);
 	
-	//create the send and recv threads
-	t_send = pthread_create(&send_thread, NULL, host_send, (void*)conn);
-	t_recv = pthread_create(&recv_thread, NULL, host_recv, (void*)conn);
+	//per tick send work is spread over a job system sized to the cores (the send thread is worker 0)
+	js_init(&jobs, 0);
+	conn->jobs = &jobs;
+	log_out(&(conn->log), "Job system started with " + std::to_string(jobs.count) + " workers\n");
+	
+	//create the send and recv threads (each pins itself and sets its priority as it starts)
+	pthread_attr_t send_attr, recv_attr;
+	if(tc_apply_process(&(conn->threads)) == -1){
+		err_out(&(conn->err), "Process Priority Class Not Set\n");
+	}
+	tc_attr(&(conn->threads), THREAD_SEND, &send_attr);
+	tc_attr(&(conn->threads), THREAD_RECV, &recv_attr);
+	t_send = pthread_create(&send_thread, &send_attr, host_send, (void*)conn);
+	t_recv = pthread_create(&recv_thread, &recv_attr, host_recv, (void*)conn);
+	pthread_attr_destroy(&send_attr);
+	pthread_attr_destroy(&recv_attr);
+	log_out(&(conn->log), tc_describe(&(conn->threads), THREAD_RECV) + "\n" + tc_describe(&(conn->threads), THREAD_SEND) + "\n");
 	
 	log_out(&(conn->log), "Send and Receive threads successfully created\n");
 	
@@ -91,15 +102,61 @@ int HostConnect::init_host(Conn_Info_t* conn){
 	return 0;
 }
 
+/*	host_log_thread_lat:
+ * 		Logs where received packets waited (socket buffer, handler thread start), how long handling took,
+ * 		how late the send thread ran its sends, what the per source rate limit dropped and how many join
+ * 		requests were answered with a cookie.
+ */
+static void host_log_thread_lat(Conn_Info_t* conn){
+	if(conn->kernel_lat.total > 0){
+		log_out(&(conn->log), "Socket arrival to recv latency: " + lh_summary(&(conn->kernel_lat)) + "\n");
+	}
+	if(conn->wake_lat.total > 0){
+		log_out(&(conn->log), "Recv wakeup to handle latency: " + lh_summary(&(conn->wake_lat)) + "\n");
+		log_out(&(conn->log), "Handler duration: " + lh_summary(&(conn->handle_lat)) + "\n");
+	}
+	if(conn->stamp.missing > 0){
+		log_out(&(conn->log), std::to_string(conn->stamp.missing) + " datagrams arrived without a network stack timestamp\n");
+	}
+	if(conn->send_lat.total > 0){
+		log_out(&(conn->log), "Send lateness: " + lh_summary(&(conn->send_lat)) + "\n");
+	}
+	if(conn->admit.dropped > 0){
+		log_out(&(conn->log), "Dropped " + std::to_string(conn->admit.dropped) + " datagrams over their source rate (" + std::to_string(conn->admit.admitted)
+				+ " admitted, " + std::to_string(conn->admit.evicted) + " sources evicted)\n");
+	}
+	if(conn->cookies > 0){
+		log_out(&(conn->log), "Answered " + std::to_string(conn->cookies) + " join requests with a cookie\n");
+	}
+}
+
+/*	host_log_batches:
+ * 		Logs how many messages the send thread sent the players and in how many packets, and what went to
+ * 		the spectator node.
+ */
+static void host_log_batches(Conn_Info_t* conn){
+	unsigned long long msgs = 0, packets = 0;
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(conn->players[i].lock));
+		msgs += conn->players[i].out.msgs;
+		packets += conn->players[i].out.packets;
+		pthread_mutex_unlock(&(conn->players[i].lock));
+	}
+	if(packets > 0){
+		log_out(&(conn->log), "Sent " + std::to_string(msgs) + " player messages in " + std::to_string(packets) + " packets\n");
+	}
+	if(conn->feed.frames > 0){
+		log_out(&(conn->log), "Spectator stream: " + std::to_string(conn->feed.frames) + " frames, " + std::to_string(conn->feed.bytes) + " bytes\n");
+	}
+}
+
 /*	quit_host:
  * 		Called by the user to quit hosting a multiplayer game.
- * 		First sending a quit request to each connected player and checks to see all disconnected
- * 		before quitting itself.
+ * 		Arms a quit retransmit timer for each connected player (resent by the send thread until
+ * 		acked or the player times out) and checks to see all disconnected before quitting itself.
  *	returns: 0 for success, other for error
  */
 int HostConnect::quit_host(Conn_Info_t* conn){
-	unsigned long last_sent = 0;
-	char message[MAX_PACKET_LEN];
 	int all_quit = 0;
 	
 	//null check
@@ -112,9 +169,7 @@ int HostConnect::quit_host(Conn_Info_t* conn){
 	if(conn->exit){
 		pthread_mutex_unlock(&(conn->exit_lock));
 		log_out(&(conn->log), "Connection Already Terminated. Game Ended.\n");
-		closesocket(conn->s);
-		WSACleanup();
-		return 0;
+		return close_host(conn);
 	} else{
 		pthread_mutex_unlock(&(conn->exit_lock));
 	}
@@ -124,51 +179,74 @@ int HostConnect::quit_host(Conn_Info_t* conn){
 	conn->send_p = 1;
 	pthread_mutex_unlock(&(conn->send_p_lock));
 	
+	//start the quit request retransmits for each connected player
+	unsigned long long now = get_mono_ms();
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(conn->players[i].lock));
+		if(conn->store.in_use[i]){
+			tw_add(&(conn->wheel), &(conn->players[i].retx_timer), now);
+		}
+		pthread_mutex_unlock(&(conn->players[i].lock));
+	}
+	
+	//wait for every player to ack (or time out) unless the threads have already stopped
 	while(!all_quit){
-		if(last_sent + REQ_TIMEOUT < get_timestamp()){
-			all_quit = 1;
-			last_sent = get_timestamp();
-			for(int i=1; i<MAX_PLAYER; i++){
-				pthread_mutex_lock(&(conn->players[i].lock));
-				if(conn->players[i].in_use){
-					pthread_mutex_unlock(&(conn->players[i].lock));
-					all_quit = 0;
-					
-					//build the quit request for each player and wait for an ack
-					((Header_t*)message)->flags = PF_QUIT;
-					((Header_t*)message)->player_id = i;
-					((Header_t*)message)->packet_num = conn->pkt_num;
-					((Header_t*)message)->timestamp = get_timestamp();
-					pthread_mutex_lock(&(conn->players[i].lock));
-					if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)&(conn->players[i].p_addr), sizeof(conn->players[i].p_addr)) == SOCKET_ERROR){
-						err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
-						return -1;
-					}
-					(conn->pkt_num)++;
-					pthread_mutex_unlock(&(conn->players[i].lock));
-				} else{
-					pthread_mutex_unlock(&(conn->players[i].lock));
-				}
+		all_quit = 1;
+		for(int i=1; i<MAX_PLAYER; i++){
+			pthread_mutex_lock(&(conn->players[i].lock));
+			if(conn->store.in_use[i]){
+				all_quit = 0;
 			}
+			pthread_mutex_unlock(&(conn->players[i].lock));
+		}
+		
+		pthread_mutex_lock(&(conn->exit_lock));
+		if(conn->exit){
+			all_quit = 1;
 		}
+		pthread_mutex_unlock(&(conn->exit_lock));
 	}
 	pthread_mutex_lock(&(conn->exit_lock));
 	conn->exit = 1;
 	pthread_mutex_unlock(&(conn->exit_lock));
 	
 	log_out(&(conn->log), "All players successfully disconnected\n");
-	
+	return close_host(conn);
+}
+
+/*	close_host:
+ * 		Tears the host down once its exit bit is set (by quit_host, or by the threads ending the game
+ * 		themselves): joins the threads, takes the game off the lobby, closes the socket and frees the tables.
+ *	returns: 0 for success, other for error
+ */
+int HostConnect::close_host(Conn_Info_t* conn){
 	//wait here for the threads to quit (always close send first)
 	if(pthread_join(send_thread, NULL) != 0){
 		err_out(&(conn->err), "Error ending send thread\n");
 	}
+	js_quit(&jobs);
+	conn->jobs = NULL;
 	if(pthread_join(recv_thread, NULL) != 0){
 		err_out(&(conn->err), "Error ending recv thread\n");
 	}
+	host_log_thread_lat(conn);
+	host_log_batches(conn);
 	
-	//close the socket
+	//take the game off the lobby and close the socket
+	host_lobby_remove(conn);
 	closesocket(conn->s);
 	WSACleanup();
+	tw_destroy(&(conn->wheel));
+	pt_destroy(&(conn->peers));
+	ad_destroy(&(conn->admit));
+	sh_destroy(&(conn->snaps));
+	pthread_mutex_lock(&(conn->world_lock));
+	ecs_query_destroy(&(conn->player_query));
+	ecs_query_destroy(&(conn->hitbox_query));
+	ecs_destroy(&(conn->world));
+	pthread_mutex_unlock(&(conn->world_lock));
+	col_destroy(&(conn->col));
+	rec_close(&(conn->rec));
 	
 	log_out(&(conn->log), "Send and Receive threads successfully closed\n");
 	
@@ -204,6 +282,7 @@ pthread_t HostConnect::get_recv_thread(){
 /*	host_recv:
  * 		Recv thread function for the host.
  * 		Non-blocking UDP recv calls that gets player packets and forks the process to handle the packets
+ * 		Sources over their datagram rate (see Admission) are dropped before a handler is taken
  * 		*** add backlog limit to the number of packets that can be handled at a time
  *	returns: N/A (thread functions have no return value)
  */
@@ -213,11 +292,13 @@ void* host_recv(void* input){
 	struct sockaddr_in si_other;
 	int slen = sizeof(si_other);
 	int numbytes;
+	unsigned long long arrive_ns;
 	
 	//thread stuff
 	Recv_Thread_t rt[MAX_BACKLOG];
 	for(int i=0; i<MAX_BACKLOG; i++){
 		rt[i].use_handler = 0;
+		rt[i].t_handler = -1;
 		pthread_mutex_init(&(rt[i].use_lock), NULL);
 	}
 	
@@ -226,26 +307,62 @@ void* host_recv(void* input){
 		pthread_exit(NULL);
 	}
 	
+	//this thread and its handler threads are placed by the recv thread settings
+	pthread_attr_t handler_attr;
+	tc_apply(&(conn->threads), THREAD_RECV);
+	tc_attr(&(conn->threads), THREAD_RECV, &handler_attr);
+	
+	trace_thread("recv");
 	while(1){
-		memset(buf, '\0', MAX_PACKET_LEN);
 		//non blocking call to receive UDP data
-		if((numbytes = recvfrom(conn->s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+		unsigned long long trace_ns = TRACE_NOW();
+		if((numbytes = rs_recvfrom(&(conn->stamp), conn->s, buf, MAX_PACKET_LEN, &si_other, &slen, &arrive_ns)) != SOCKET_ERROR){
+			//time the datagram sat in the socket buffer (only known with network stack timestamps)
+			unsigned long long recv_ns = get_mono_ns();
+			if(conn->stamp.source == RS_KERNEL){
+				pthread_mutex_lock(&(conn->lat_lock));
+				lh_record(&(conn->kernel_lat), (recv_ns > arrive_ns) ? recv_ns - arrive_ns : 0);
+				pthread_mutex_unlock(&(conn->lat_lock));
+			}
+			
+			//behind a relay the player address comes from the trailer (relay answers and drops leave -1)
+			if(conn->use_relay){
+				numbytes = host_relay_recv(conn, buf, numbytes, &si_other);
+			}
+			
+			//a source over its rate is dropped here, before the copy and the handler thread (sources without a
+			//player slot only get enough for their join requests)
+			if(numbytes != -1 && !conn->admit_off){
+				int cls = (pt_find(&(conn->peers), &si_other) != -1) ? AD_PLAYER : AD_STRANGER;
+				if(!ad_admit(&(conn->admit), &si_other, cls, recv_ns / 1000000)){
+					numbytes = -1;
+				}
+			}
+			if(numbytes != -1){
+				memset(buf + numbytes, '\0', MAX_PACKET_LEN - numbytes);
+			}
+			
 			//action after receiving data (find an open thread)
 			int i;
-			for(i=0; i<MAX_BACKLOG; i++){
+			for(i=0; i<MAX_BACKLOG && numbytes != -1; i++){
 				pthread_mutex_lock(&(rt[i].use_lock));
 				if(!rt[i].use_handler){
 					rt[i].use_handler = 1;
 					pthread_mutex_unlock(&(rt[i].use_lock));
 					
+					//the slot's last handler has let it go, so it is at its exit (join it before reusing the slot)
+					recv_handler_join(&(rt[i]));
+					
 					//fill the info struct
 					rt[i].conn = conn;
+					rt[i].arrive_ns = arrive_ns;
+					rt[i].recv_ns = recv_ns;
 					rt[i].numbytes = numbytes;
 					memcpy(rt[i].buf, buf, MAX_PACKET_LEN);
 					memcpy(&(rt[i].si_other), &si_other, slen);
 					
 					//set up the thread for packet handling here (it will return on its own)
-					rt[i].t_handler = pthread_create(&(rt[i].handler_thread), NULL, host_pkt_handle_wrap, (void*)(&rt[i]));
+					rt[i].t_handler = pthread_create(&(rt[i].handler_thread), &handler_attr, host_pkt_handle_wrap, (void*)(&rt[i]));
 					break;
 					
 				} else{
@@ -257,6 +374,7 @@ void* host_recv(void* input){
 			if(i == MAX_BACKLOG){
 				err_out(&(conn->err), "Packet not handled. Max backlog exceeded.\n");
 			}
+			TRACE_SPAN("recv", trace_ns, (numbytes >= PACKET_HEAD_LEN) ? ((Header_t*)buf)->packet_num : 0, 0);
 		} else if(WSAGetLastError() != WSAEWOULDBLOCK){
 			err_out(&(conn->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
 			pthread_mutex_lock(&(conn->exit_lock));
@@ -268,6 +386,8 @@ void* host_recv(void* input){
 		pthread_mutex_lock(&(conn->exit_lock));
 		if(conn->exit){
 			pthread_mutex_unlock(&(conn->exit_lock));
+			recv_drain(rt, MAX_BACKLOG);
+			pthread_attr_destroy(&handler_attr);
 			pthread_exit(NULL);
 		} else{
 			pthread_mutex_unlock(&(conn->exit_lock));
@@ -281,10 +401,25 @@ void* host_recv(void* input){
  */
 void* host_pkt_handle_wrap(void* input){
 	Recv_Thread_t* rt_in = (Recv_Thread_t*) input;
+	Conn_Info_t* conn = rt_in->conn;
+	
+	//handlers are placed like the recv thread, then time the wait for one to run and the handling itself
+	tc_apply(&(conn->threads), THREAD_RECV);
+	unsigned long long start_ns = get_mono_ns();
+	unsigned int trace_pkt = (rt_in->numbytes >= PACKET_HEAD_LEN) ? ((Header_t*)rt_in->buf)->packet_num : 0;
+	trace_thread("handler");
+	TRACE_SPAN("dispatch", (TRACE_NOW() != 0) ? rt_in->recv_ns : 0, trace_pkt, 0);
+	
 	//if the input is null then cannot free the space up and want error to be thrown
 	if(host_pkt_handle(rt_in->conn, rt_in->numbytes, rt_in->buf, &(rt_in->si_other)) == -1){
 		err_out(&(rt_in->conn->err), "Packet handled incorrectly\n");
 	}
+	unsigned long long end_ns = get_mono_ns();
+	TRACE_SPAN("handle", (TRACE_NOW() != 0) ? start_ns : 0, trace_pkt, 0);
+	pthread_mutex_lock(&(conn->lat_lock));
+	lh_record(&(conn->wake_lat), start_ns - rt_in->recv_ns);
+	lh_record(&(conn->handle_lat), end_ns - start_ns);
+	pthread_mutex_unlock(&(conn->lat_lock));
 	pthread_mutex_lock(&(rt_in->use_lock));
 	rt_in->use_handler = 0;
 	pthread_mutex_unlock(&(rt_in->use_lock));
@@ -293,8 +428,8 @@ void* host_pkt_handle_wrap(void* input){
 
 /*	host_pkt_handle:
  * 		Incoming packet handler for the host recv thread.
- * 		Determines the type of packet, confirms the sender's address, and performs necessary operations for the pkt.
- * 		This function can also send an ACK for join or quit requests
+ * 		Authenticates and records the packet, then handles the message it holds (or each message of a multi
+ * 		packet) with host_msg_handle.
  *	returns: 0 on success, -1 on failure
  */
 int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other){
@@ -302,46 +437,150 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 		return -1;
 	}
 	
+	//drop anything that does not authenticate (bytes becomes the plain length, replayed packets are already plain)
+	int plain = (conn->crypt.enabled && !conn->replay) ? host_open_packet(conn, bytes, buf) : bytes;
+	if(plain == -1){
+		rec_write(&(conn->rec), REC_DROP, si_other, buf, bytes);
+		return -1;
+	}
+	bytes = plain;
+	rec_write(&(conn->rec), REC_IN, si_other, buf, bytes);
+	
+	//a multi packet is handled one message at a time, as if each had come alone (join requests are sealed
+	//with the pre-shared key so never come in one)
+	if((((Header_t*)buf)->flags & PF_MULTI) == PF_MULTI){
+		char message[MAX_PACKET_LEN];
+		int offset = 0, len, ret = 0;
+		while((len = pb_next(buf, bytes, &offset, message)) > 0){
+			if((((Header_t*)message)->flags & PF_JOIN) == PF_JOIN || host_msg_handle(conn, len, message, si_other) == -1){
+				ret = -1;
+			}
+		}
+		return (len == -1) ? -1 : ret;
+	}
+	return host_msg_handle(conn, bytes, buf, si_other);
+}
+
+/*	host_cookie_good:
+ * 		Checks the cookie field on the end of a join request (zeroed before the join has a cookie) holds one
+ * 		minted by this host for the source less than COOKIE_LIFE ago.
+ *	returns: 1 if it does, 0 otherwise
+ */
+static int host_cookie_good(Conn_Info_t* conn, const char* cookie, const struct sockaddr_in* si_other){
+	Cookie_t c;
+	memcpy(&c, cookie, COOKIE_LEN);
+	return ck_check(&(conn->cookie), si_other, (unsigned int)get_mono_ms(), COOKIE_LIFE, &c);
+}
+
+/*	host_send_cookie:
+ * 		Answers a join request with a fresh cookie for its source, to be sent back in the next request.
+ *	returns: 0 for success, -1 for error
+ */
+static int host_send_cookie(Conn_Info_t* conn, const char* request, struct sockaddr_in* si_other){
+	char message[MAX_PACKET_LEN];
+	Cookie_t c;
+	ck_mint(&(conn->cookie), si_other, (unsigned int)get_mono_ms(), &c);
+	((Header_t*)message)->flags = PF_JOIN | PF_COOKIE;
+	((Header_t*)message)->player_id = 0xFF;
+	((Header_t*)message)->packet_num = ((const Header_t*)request)->packet_num;
+	((Header_t*)message)->timestamp = get_timestamp();
+	memcpy(message + PACKET_HEAD_LEN, &c, COOKIE_LEN);
+	(conn->cookies)++;
+	return host_sendto(conn, -1, message, cookie_answer_len, si_other);
+}
+
+/*	host_msg_handle:
+ * 		Handles one plain message from a player (a whole packet, or one message of a multi packet).
+ * 		Determines the type of message, confirms the sender's address, and performs necessary operations for it.
+ * 		This function can also send an ACK for join or quit requests
+ *	returns: 0 for success, -1 for error
+ */
+int host_msg_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other){
 	//check the flags for the message type
 	if((((Header_t*)buf)->flags & PF_JOIN) == PF_JOIN){
 		char player_num;
+		unsigned char* client_rand = (unsigned char*)buf + PACKET_HEAD_LEN;
+		unsigned char host_rand[CRYPT_RAND_LEN];
 		
-		//check for proper join request size
-		if(bytes != PACKET_HEAD_LEN){
+		//check for proper join request size (encrypted requests carry the client handshake random, and every
+		//request ends in a cookie field, so a cookie answer is never bigger than the request that drew it)
+		int request_len = conn->crypt.enabled ? join_crypt_len : PACKET_HEAD_LEN;
+		if(bytes != request_len + COOKIE_LEN){
 			return -1;
 		}
 		
-		//check if this source is already connected
-		int i;
-		for(i=1; i<MAX_PLAYER; i++){
+		//check if this source (address and port) is already connected
+		int i = pt_find(&(conn->peers), si_other);
+		if(i == -1 && !conn->replay && !host_cookie_good(conn, buf + request_len, si_other)){
+			//a new source without a good cookie is sent one, nothing is kept or locked until it comes back
+			return host_send_cookie(conn, buf, si_other);
+		} else if(i != -1){
 			pthread_mutex_lock(&(conn->players[i].lock));
-			if(conn->players[i].p_addr.sin_addr.S_un.S_addr == si_other->sin_addr.S_un.S_addr){
-				player_num = i;
-				pthread_mutex_unlock(&(conn->players[i].lock));
-				break;
-			} else{
+			conn->players[i].last_recv = get_mono_ms();
+			if(conn->crypt.enabled && host_join_session(conn, i, client_rand, host_rand) == -1){
 				pthread_mutex_unlock(&(conn->players[i].lock));
+				return -1;
 			}
-		}
-		if(i == MAX_PLAYER){
+			pthread_mutex_unlock(&(conn->players[i].lock));
+			player_num = i;
+		} else{
 			//check if there is a currently open spot
 			for(i=1; i<MAX_PLAYER; i++){
 				pthread_mutex_lock(&(conn->players[i].lock));
-				if(!conn->players[i].in_use){
+				if(!conn->store.in_use[i]){
 					//set up the player in this spot
-					conn->players[i].px_loc = 0.0;
-					conn->players[i].py_loc = 0.0;
-					conn->players[i].in_use = 1;
+					ps_post(&(conn->store.pos[i]), 0.0, 0.0);
+					conn->store.in_use[i] = 1;
 					conn->players[i].p_addr = (*si_other);
+					pthread_mutex_unlock(&(conn->players[i].lock));
+					break;
 				}
 				pthread_mutex_unlock(&(conn->players[i].lock));
-				break;
 			}
 			player_num = i; //if player num is MAX_PLAYER then no space
+			
+			if(i < MAX_PLAYER){
+				//register the source, another handler may have registered the same source first
+				int slot = pt_insert(&(conn->peers), si_other, i);
+				pthread_mutex_lock(&(conn->players[i].lock));
+				if(slot == i){
+					if(conn->crypt.enabled && host_join_session(conn, i, client_rand, host_rand) == -1){
+						host_clear_player(conn, i);
+						pthread_mutex_unlock(&(conn->players[i].lock));
+						return -1;
+					}
+					
+					//start the liveness timeout and the disp sends (at full rate) for the new player
+					unsigned long long now = get_mono_ms();
+					rc_init(&(conn->players[i].rate), MIN_SERVER_PPS, MAX_SERVER_PPS, get_mono_ns() / 1000);
+					conn->players[i].last_recv = now;
+					conn->players[i].keys_in = 0;
+					tw_add(&(conn->wheel), &(conn->players[i].live_timer), now + PLAYER_LOST);
+					tw_add(&(conn->wheel), &(conn->players[i].send_timer), now + max_server_time);
+					conn->players[i].send_due_us = (now + max_server_time) * 1000;
+				} else{
+					//give the spot back
+					memset((char*)&(conn->players[i].p_addr), 0, sizeof(conn->players[i].p_addr));
+					conn->store.in_use[i] = 0;
+					player_num = (slot == -1) ? MAX_PLAYER : slot;
+				}
+				pthread_mutex_unlock(&(conn->players[i].lock));
+				
+				//the ack for the other handler's slot carries that slot's session random, like a repeated request
+				if(slot != i && slot != -1 && conn->crypt.enabled){
+					pthread_mutex_lock(&(conn->players[slot].lock));
+					if(host_join_session(conn, slot, client_rand, host_rand) == -1){
+						pthread_mutex_unlock(&(conn->players[slot].lock));
+						return -1;
+					}
+					pthread_mutex_unlock(&(conn->players[slot].lock));
+				}
+			}
 		}
 		
-		//send the ack
-		char message[PACKET_HEAD_LEN];
+		//send the ack (encrypted acks carry the host random and echo the client random)
+		char message[MAX_PACKET_LEN];
+		int len = PACKET_HEAD_LEN;
 		((Header_t*)message)->flags = PF_JOIN | PF_ACK;
 		if(player_num == MAX_PLAYER){
 			((Header_t*)message)->flags = ((Header_t*)message)->flags | PF_DENY;
@@ -349,19 +588,19 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 		((Header_t*)message)->player_id = player_num;
 		((Header_t*)message)->packet_num = ((Header_t*)buf)->packet_num;
 		((Header_t*)message)->timestamp = get_timestamp();
-		pthread_mutex_lock(&(conn->players[(int)player_num].lock));
-		if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)&(conn->players[(int)player_num].p_addr), sizeof(conn->players[(int)player_num].p_addr)) == SOCKET_ERROR){
-			err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
-			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
+		if(player_num != MAX_PLAYER && conn->crypt.enabled){
+			memcpy(message + PACKET_HEAD_LEN, host_rand, CRYPT_RAND_LEN);
+			memcpy(message + PACKET_HEAD_LEN + CRYPT_RAND_LEN, client_rand, CRYPT_RAND_LEN);
+			len = ack_crypt_len;
+		}
+		if(host_sendto(conn, -1, message, len, si_other) == -1){
 			return -1;
-		} else{
-			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 		}
 		
 	} else if((((Header_t*)buf)->flags & PF_QUIT) == PF_QUIT){
 		//check for valid player number
 		char player_num = ((Header_t*)buf)->player_id;
-		if(player_num > 10){
+		if(player_num < 1 || player_num >= MAX_PLAYER){
 			return -1;
 		}
 		
@@ -370,10 +609,11 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 			return -1;
 		}
 		
+		int registered = pt_find(&(conn->peers), si_other);
 		pthread_mutex_lock(&(conn->players[(int)player_num].lock));
-		if(conn->players[(int)player_num].in_use){
-			if(conn->players[(int)player_num].p_addr.sin_addr.S_un.S_addr != si_other->sin_addr.S_un.S_addr){
-				//source address does not match the player setup address
+		if(conn->store.in_use[(int)player_num]){
+			if(registered != player_num){
+				//source address and port do not match the player setup address
 				pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 				return -1;
 			} else{
@@ -385,15 +625,14 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 		
 		//otherwise proper request, only send the ack if this is not an ack
 		if((((Header_t*)buf)->flags & PF_ACK) != PF_ACK){
-			char message[PACKET_HEAD_LEN];
+			char message[MAX_PACKET_LEN];
 			((Header_t*)message)->flags = PF_QUIT | PF_ACK;
 			((Header_t*)message)->player_id = player_num;
 			((Header_t*)message)->packet_num = ((Header_t*)buf)->packet_num;
 			((Header_t*)message)->timestamp = get_timestamp();
 			pthread_mutex_lock(&(conn->players[(int)player_num].lock));
-			if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)si_other, sizeof(*(si_other))) == SOCKET_ERROR){
+			if(host_sendto(conn, player_num, message, PACKET_HEAD_LEN, si_other) == -1){
 				pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
-				err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
 				return -1;
 			} else{
 				pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
@@ -402,21 +641,18 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 		
 		//clear the proper data
 		pthread_mutex_lock(&(conn->players[(int)player_num].lock));
-		if(!conn->players[(int)player_num].in_use){
+		if(!conn->store.in_use[(int)player_num]){
 			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 		} else{
 			//clear the player info
-			memset((char*)&(conn->players[(int)player_num].p_addr), 0, sizeof(conn->players[(int)player_num].p_addr));
-			conn->players[(int)player_num].px_loc = 0.0;
-			conn->players[(int)player_num].py_loc = 0.0;
-			conn->players[(int)player_num].in_use = 0;
+			host_clear_player(conn, player_num);
 			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 		}
 		
 	} else if((((Header_t*)buf)->flags & PF_KEYS) == PF_KEYS){
 		//check for valid player number
 		char player_num = ((Header_t*)buf)->player_id;
-		if(player_num> 10){
+		if(player_num < 1 || player_num >= MAX_PLAYER){
 			return -1;
 		}
 		
@@ -425,19 +661,29 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 			return -1;
 		}
 		
+		int registered = pt_find(&(conn->peers), si_other);
 		pthread_mutex_lock(&(conn->players[(int)player_num].lock));
-		if(!conn->players[(int)player_num].in_use){
+		if(!conn->store.in_use[(int)player_num]){
 			//this player has not yet joined the game or already left
 			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 			return -1;
-		} else if(conn->players[(int)player_num].p_addr.sin_addr.S_un.S_addr != si_other->sin_addr.S_un.S_addr){
-			//source address does not match the player setup address
+		} else if(registered != player_num){
+			//source address and port do not match the player setup address
 			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
 			return -1;
 		} else{
-			conn->players[(int)player_num].px_loc = ((Keys_Packet_t*)buf)->px_loc;
-			conn->players[(int)player_num].py_loc = ((Keys_Packet_t*)buf)->py_loc;
+			unsigned long long trace_ns = TRACE_NOW();
+			ps_post(&(conn->store.pos[(int)player_num]), ((Keys_Packet_t*)buf)->px_loc, ((Keys_Packet_t*)buf)->py_loc);
+			conn->players[(int)player_num].last_recv = get_mono_ms();
+			(conn->players[(int)player_num].keys_in)++;
+			
+			//feed the echo of our newest disp packet to the player's send rate controller
+			if(((Keys_Packet_t*)buf)->echo_seq != 0){
+				rc_on_feedback(&(conn->players[(int)player_num].rate), ((Keys_Packet_t*)buf)->echo_seq, ((Keys_Packet_t*)buf)->echo_us,
+						((Keys_Packet_t*)buf)->echo_hold, ((Keys_Packet_t*)buf)->recv_count, get_mono_ns() / 1000);
+			}
 			pthread_mutex_unlock(&(conn->players[(int)player_num].lock));
+			TRACE_SPAN("state update", trace_ns, ((Header_t*)buf)->packet_num, 0);
 		}
 		//no ack sent for key updates
 		
@@ -451,68 +697,32 @@ int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 
 /*	host_send:
  * 		Send thread function for the host.
- * 		Builds the packet holding the display information and sends it to each connected player
+ * 		Turns the timer wheel which runs the scheduled disp sends, quit retransmits and liveness timeouts
  *	returns: N/A (thread functions have no return value)
  */
 void* host_send(void* input){
 	Conn_Info_t* conn = (Conn_Info_t*) input;
-	char* message = new char[MAX_PACKET_LEN];
-	unsigned long last_sent = 0;
 	
 	//null check
 	if(conn == NULL){
-		delete(message);
 		pthread_exit(NULL);
 	}
 	
+	tc_apply(&(conn->threads), THREAD_SEND);
+	trace_thread("send");
+	
 	while(1){
-		//sending to each player only done based on max server pkt per sec
-		if(last_sent + max_server_time < get_timestamp()){
-			last_sent = get_timestamp();
-			//only send messages if pause bit not set
-			pthread_mutex_lock(&(conn->send_p_lock));
-			if(!conn->send_p){
-				pthread_mutex_unlock(&(conn->send_p_lock));
-				//build the display message
-				if(host_build_disp_message(conn, message) == -1){
-					err_out(&(conn->err), "Error Building Disp Message\n");
-					pthread_mutex_lock(&(conn->exit_lock));
-					conn->exit = 1;
-					pthread_mutex_unlock(&(conn->exit_lock));
-				} else{
-					//send message to each connected player (skip 0 since don't need to send to self)
-					for(int i=1; i<MAX_PLAYER; i++){
-						//check if the player is in use
-						pthread_mutex_lock(&(conn->players[i].lock));
-						if(conn->players[i].in_use){
-							((Disp_Packet_t*)message)->head.player_id = i;
-							((Disp_Packet_t*)message)->head.timestamp = get_timestamp();
-							//send the message
-							if(sendto(conn->s, message, disp_packet_len, 0, (struct sockaddr*)&(conn->players[i].p_addr), sizeof(conn->players[i].p_addr)) == SOCKET_ERROR){
-								err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
-								pthread_mutex_unlock(&(conn->players[i].lock));
-								pthread_mutex_lock(&(conn->exit_lock));
-								conn->exit = 1;
-								pthread_mutex_unlock(&(conn->exit_lock));
-							} else{
-								pthread_mutex_unlock(&(conn->players[i].lock));
-							}
-						} else{
-							pthread_mutex_unlock(&(conn->players[i].lock));
-						}
-					}
-					(conn->pkt_num)++;
-				}
-			} else{
-				pthread_mutex_unlock(&(conn->send_p_lock));
-			}
+		//run every timer that has come due
+		tw_advance(&(conn->wheel), get_mono_ms());
+		if(conn->send_count > 0){
+			host_send_batch(conn);
 		}
+		host_flush(conn);
 		
 		//check the status of the other threads and terminate if necessary
 		pthread_mutex_lock(&(conn->exit_lock));
 		if(conn->exit){
 			pthread_mutex_unlock(&(conn->exit_lock));
-			delete(message);
 			pthread_exit(NULL);
 		} else{
 			pthread_mutex_unlock(&(conn->exit_lock));
@@ -520,6 +730,783 @@ void* host_send(void* input){
 	}
 }
 
+/*	host_send_timer:
+ * 		Scheduled send timer callback (one per player) run by the host send thread.
+ * 		Queues the player for host_send_batch, or without a job system builds the packet holding the
+ * 		display information and sends it to the player (host_send_player re-arms the timer).
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_send_timer(void* input){
+	Player_Info_t* player = (Player_Info_t*) input;
+	Conn_Info_t* conn = player->conn;
+	char message[MAX_PACKET_LEN];
+	
+	//how late the send thread got to it (the wheel deadline is a whole ms)
+	unsigned long long now_us = get_mono_ns() / 1000;
+	if(player->send_due_us != 0){
+		pthread_mutex_lock(&(conn->lat_lock));
+		lh_record(&(conn->send_lat), (now_us > player->send_due_us) ? (now_us - player->send_due_us) * 1000 : 0);
+		pthread_mutex_unlock(&(conn->lat_lock));
+	}
+	
+	//with a job system the send thread sends to every player due in this advance at once (host_send_batch)
+	if(conn->jobs != NULL){
+		conn->send_batch[(conn->send_count)++] = player;
+		return;
+	}
+	
+	//only send messages if pause bit not set
+	pthread_mutex_lock(&(conn->send_p_lock));
+	int paused = conn->send_p;
+	pthread_mutex_unlock(&(conn->send_p_lock));
+	
+	if(!paused){
+		//build the display message
+		if(host_build_disp_message(conn, message) == -1){
+			err_out(&(conn->err), "Error Building Disp Message\n");
+			pthread_mutex_lock(&(conn->exit_lock));
+			conn->exit = 1;
+			pthread_mutex_unlock(&(conn->exit_lock));
+			return;
+		}
+	}
+	host_send_player(conn, player, message, paused);
+}
+
+/*	host_send_batch:
+ * 		Sends the disp to every player whose send timer came due in the last wheel advance. The send thread
+ * 		builds the disp once, then stamping, sealing and sending each player's copy runs as a job (the send
+ * 		thread is worker 0 and helps until they are all done).
+ *	returns: 0 for success, -1 for error
+ */
+int host_send_batch(Conn_Info_t* conn){
+	Host_Send_Job_t jobs[MAX_PLAYER];
+	char disp[MAX_PACKET_LEN];
+	Job_Group_t group;
+	int count = conn->send_count;
+	conn->send_count = 0;
+	
+	//only send messages if pause bit not set
+	pthread_mutex_lock(&(conn->send_p_lock));
+	int paused = conn->send_p;
+	pthread_mutex_unlock(&(conn->send_p_lock));
+	
+	if(!paused && host_build_disp_message(conn, disp) == -1){
+		err_out(&(conn->err), "Error Building Disp Message\n");
+		pthread_mutex_lock(&(conn->exit_lock));
+		conn->exit = 1;
+		pthread_mutex_unlock(&(conn->exit_lock));
+		return -1;
+	}
+	
+	js_group_init(&group);
+	for(int i=0; i<count; i++){
+		jobs[i].conn = conn;
+		jobs[i].player = conn->send_batch[i];
+		jobs[i].disp = disp;
+		jobs[i].paused = paused;
+		js_spawn(conn->jobs, 0, &group, host_send_job, (void*)&(jobs[i]));
+	}
+	js_wait(conn->jobs, 0, &group);
+	return 0;
+}
+
+/*	host_send_job:
+ * 		Job of host_send_batch sending the shared disp to one player.
+ *	returns: N/A (jobs have no return value)
+ */
+void host_send_job(Job_System_t*, int, void* input){
+	Host_Send_Job_t* job = (Host_Send_Job_t*) input;
+	char message[MAX_PACKET_LEN];
+	
+	if(!job->paused){
+		memcpy(message, job->disp, MAX_PACKET_LEN);
+	}
+	host_send_player(job->conn, job->player, message, job->paused);
+}
+
+/*	host_send_player:
+ * 		Stamps a built disp message for a player and sends it in one packet with any other messages queued
+ * 		for the player (see host_queue), then re-arms the player's send timer
+ * 		at the player's current send rate (see RateControl). Stops once the player is no longer in use.
+ *	returns: 0 for success, -1 for error (the exit bit is set)
+ */
+int host_send_player(Conn_Info_t* conn, Player_Info_t* player, char* message, int paused){
+	pthread_mutex_lock(&(player->lock));
+	if(!conn->store.in_use[player->id]){
+		pthread_mutex_unlock(&(player->lock));
+		return 0;
+	}
+	unsigned long long now_us = get_mono_ns() / 1000;
+	if(!paused){
+		((Disp_Packet_t*)message)->head.player_id = player->id;
+		((Disp_Packet_t*)message)->head.packet_num = (conn->pkt_num)++;
+		((Disp_Packet_t*)message)->head.timestamp = get_timestamp();
+		((Disp_Packet_t*)message)->seq = rc_next_seq(&(player->rate));
+		((Disp_Packet_t*)message)->send_us = (unsigned int)now_us;
+	}
+	
+	//send the message with anything else queued for the player
+	if((!paused && host_queue(conn, player, message, disp_packet_len) == -1) || host_flush_player(conn, player) == -1){
+		pthread_mutex_unlock(&(player->lock));
+		pthread_mutex_lock(&(conn->exit_lock));
+		conn->exit = 1;
+		pthread_mutex_unlock(&(conn->exit_lock));
+		return -1;
+	}
+	//wheel ticks are whole ms so round the due time up
+	unsigned long long due_us = rc_next_send(&(player->rate), now_us);
+	player->send_due_us = ((due_us + 999) / 1000) * 1000;
+	tw_add(&(conn->wheel), &(player->send_timer), player->send_due_us / 1000);
+	pthread_mutex_unlock(&(player->lock));
+	return 0;
+}
+
+/*	host_retx_timer:
+ * 		Quit request retransmit timer callback (armed per player by quit_host).
+ * 		Queues the quit request (it goes out with the player's disp if that comes due in the same tick) and
+ * 		re-arms itself until the player's ack clears the slot.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_retx_timer(void* input){
+	Player_Info_t* player = (Player_Info_t*) input;
+	Conn_Info_t* conn = player->conn;
+	char message[MAX_PACKET_LEN];
+	
+	pthread_mutex_lock(&(player->lock));
+	if(!conn->store.in_use[player->id]){
+		pthread_mutex_unlock(&(player->lock));
+		return;
+	}
+	
+	//build the quit request for the player and wait for an ack
+	((Header_t*)message)->flags = PF_QUIT;
+	((Header_t*)message)->player_id = player->id;
+	((Header_t*)message)->packet_num = conn->pkt_num;
+	((Header_t*)message)->timestamp = get_timestamp();
+	host_queue(conn, player, message, PACKET_HEAD_LEN);
+	conn->out_pending = 1;
+	(conn->pkt_num)++;
+	tw_add(&(conn->wheel), &(player->retx_timer), get_mono_ms() + REQ_TIMEOUT);
+	pthread_mutex_unlock(&(player->lock));
+}
+
+/*	host_live_timeout:
+ * 		Liveness timer callback (one per player) run by the host send thread.
+ * 		Packets from the player only refresh last_recv, so when this fires it either pushes the deadline
+ * 		out to match the latest packet or reclaims the slot of a player that has gone silent.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_live_timeout(void* input){
+	Player_Info_t* player = (Player_Info_t*) input;
+	Conn_Info_t* conn = player->conn;
+	
+	pthread_mutex_lock(&(player->lock));
+	if(!conn->store.in_use[player->id]){
+		pthread_mutex_unlock(&(player->lock));
+		return;
+	}
+	
+	if(player->last_recv + PLAYER_LOST > get_mono_ms()){
+		//heard from the player since the timer was armed
+		tw_add(&(conn->wheel), &(player->live_timer), player->last_recv + PLAYER_LOST);
+		pthread_mutex_unlock(&(player->lock));
+	} else{
+		host_clear_player(conn, player->id);
+		pthread_mutex_unlock(&(player->lock));
+		log_out(&(conn->log), "Player " + std::to_string(player->id) + " timed out\n");
+	}
+}
+
+/*	host_rate_log:
+ * 		Periodic timer callback that logs the current send rate, rtt and loss of every connected player.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_rate_log(void* input){
+	Conn_Info_t* conn = (Conn_Info_t*) input;
+	
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(conn->players[i].lock));
+		if(conn->store.in_use[i]){
+			Rate_Ctrl_t* rc = &(conn->players[i].rate);
+			std::string line = "Player " + std::to_string(i) + " send rate " + std::to_string((int)rc->rate) + " pps, rtt "
+					+ std::to_string(rc->srtt_us / 1000) + " ms (min " + std::to_string(rc->min_rtt_us / 1000) + "), loss "
+					+ std::to_string((int)(rc->loss * 100.0)) + "%\n";
+			pthread_mutex_unlock(&(conn->players[i].lock));
+			log_out(&(conn->log), line);
+		} else{
+			pthread_mutex_unlock(&(conn->players[i].lock));
+		}
+	}
+	if(conn->contacts > 0){
+		log_out(&(conn->log), std::to_string(conn->contacts) + " contacts began (" + col_simd_name(conn->col.simd) + " narrowphase)\n");
+		conn->contacts = 0;
+	}
+	tw_add(&(conn->wheel), &(conn->rate_log_timer), get_mono_ms() + RATE_LOG_TIME);
+}
+
+/*	host_world_players:
+ * 		Brings the world's player entities up to date from the player store, then reads them back out by
+ * 		player slot for the disp packets and snapshots (slots without an entity are not alive).
+ *	returns: the number of players
+ */
+int host_world_players(Conn_Info_t* conn, float* x, float* y, unsigned char* alive){
+	float sx[MAX_PLAYER], sy[MAX_PLAYER];
+	unsigned char in_use[MAX_PLAYER];
+	int players = 0;
+	
+	ps_gather(conn->store.pos, conn->store.in_use, MAX_PLAYER, sx, sy, in_use);
+	memset(alive, 0, MAX_PLAYER);
+	pthread_mutex_lock(&(conn->world_lock));
+	ecs_sync_slots(&(conn->world), conn->player_ents, MAX_PLAYER, sx, sy, in_use);
+	ecs_query_update(&(conn->world), &(conn->player_query));
+	for(int m=0; m<conn->player_query.match_count; m++){
+		const Ecs_Archetype_t* a = &(conn->world.archs[conn->player_query.matches[m]]);
+		const Ecs_Pos_t* pos = (const Ecs_Pos_t*)ecs_column(a, ECS_POS);
+		const Ecs_Player_t* player = (const Ecs_Player_t*)ecs_column(a, ECS_PLAYER);
+		for(int i=0; i<a->count; i++){
+			int slot = player[i].slot;
+			x[slot] = pos[i].x;
+			y[slot] = pos[i].y;
+			alive[slot] = 1;
+			players++;
+		}
+	}
+	pthread_mutex_unlock(&(conn->world_lock));
+	return players;
+}
+
+/*	host_collide:
+ * 		Runs the collision step over the world: every player entity is a PLAYER_SIZE body and hurtbox, every
+ * 		other entity with a hitbox an attack. The step's contact events are passed to the game logic.
+ *	returns: the number of contacts
+ */
+int host_collide(Conn_Info_t* conn){
+	Collision_World_t* col = &(conn->col);
+	
+	pthread_mutex_lock(&(conn->world_lock));
+	col_clear(col);
+	ecs_query_update(&(conn->world), &(conn->player_query));
+	for(int m=0; m<conn->player_query.match_count; m++){
+		const Ecs_Archetype_t* a = &(conn->world.archs[conn->player_query.matches[m]]);
+		const Ecs_Pos_t* pos = (const Ecs_Pos_t*)ecs_column(a, ECS_POS);
+		for(int i=0; i<a->count; i++){
+			col_add(col, a->entities[i], pos[i].x, pos[i].y, PLAYER_SIZE, PLAYER_SIZE, COL_BODY | COL_HURT, COL_BODY);
+		}
+	}
+	ecs_query_update(&(conn->world), &(conn->hitbox_query));
+	for(int m=0; m<conn->hitbox_query.match_count; m++){
+		const Ecs_Archetype_t* a = &(conn->world.archs[conn->hitbox_query.matches[m]]);
+		const Ecs_Pos_t* pos = (const Ecs_Pos_t*)ecs_column(a, ECS_POS);
+		const Ecs_Hitbox_t* box = (const Ecs_Hitbox_t*)ecs_column(a, ECS_HITBOX);
+		for(int i=0; i<a->count; i++){
+			col_add(col, a->entities[i], pos[i].x, pos[i].y, box[i].half_w, box[i].half_h, COL_HIT, COL_HURT);
+		}
+	}
+	int contacts = col_step(col);
+	pthread_mutex_unlock(&(conn->world_lock));
+	
+	//the events are only touched by the thread running the step
+	for(int i=0; i<col->event_count; i++){
+		if(col->events[i].type == COL_BEGIN){
+			(conn->contacts)++;
+		}
+		if(conn->on_contact != NULL){
+			conn->on_contact(conn, &(col->events[i]));
+		}
+	}
+	return contacts;
+}
+
+/*	host_snap_timer:
+ * 		Periodic timer callback that adds the current position of every player to the snapshot history.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_snap_timer(void* input){
+	Conn_Info_t* conn = (Conn_Info_t*) input;
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	unsigned long long trace_ns = TRACE_NOW();
+	
+	host_world_players(conn, x, y, alive);
+	sh_record(&(conn->snaps), get_mono_ns() / 1000, x, y, alive);
+	host_collide(conn);
+	TRACE_SPAN("snapshot", trace_ns, 0, (unsigned int)conn->snaps.head);
+	tw_add(&(conn->wheel), &(conn->snap_timer), get_mono_ms() + SNAP_TIME);
+}
+
+/*	host_lobby_send:
+ * 		Sends a lobby register or remove packet for this game from the game socket, so the lobby lists the
+ * 		address and port joins reach the game on. Lobby packets are never sealed or recorded.
+ *	returns: 0 for success, -1 for error
+ */
+static int host_lobby_send(Conn_Info_t* conn, char flags){
+	Lobby_Register_Packet_t reg;
+	memset((char*)&reg, 0, sizeof(reg));
+	reg.head.flags = flags;
+	reg.head.session_id = conn->session_id;
+	reg.head.timestamp = get_timestamp();
+	
+	//slot 0 is the host's own player unless this is a session server game
+	reg.max_players = conn->store.in_use[0] ? MAX_PLAYER : MAX_PLAYER - 1;
+	for(int i=0; i<MAX_PLAYER; i++){
+		if(conn->store.in_use[i]){
+			(reg.players)++;
+		}
+	}
+	memcpy(reg.name, conn->game_name, LOBBY_NAME_LEN);
+	reg.name[LOBBY_NAME_LEN - 1] = '\0';
+	
+	if(conn->replay){
+		return 0;
+	}
+	if(sendto(conn->s, (char*)&reg, lobby_register_len, 0, (struct sockaddr*)&(conn->lobby), sizeof(conn->lobby)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Lobby Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*	host_lobby_beat:
+ * 		Periodic timer callback (armed by host_init_state when the game is listed) that sends the lobby
+ * 		heartbeat keeping the game and its player count listed.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_lobby_beat(void* input){
+	Conn_Info_t* conn = (Conn_Info_t*) input;
+	
+	host_lobby_send(conn, LB_REGISTER);
+	tw_add(&(conn->wheel), &(conn->lobby_timer), get_mono_ms() + LOBBY_BEAT);
+}
+
+/*	host_lobby_remove:
+ * 		Stops the heartbeats and tells the lobby the game has closed (if it is lost the lobby drops the
+ * 		game once its ttl runs out).
+ *	returns: 0 for success, -1 for error
+ */
+int host_lobby_remove(Conn_Info_t* conn){
+	if(conn == NULL){
+		return -1;
+	}
+	if(!conn->use_lobby){
+		return 0;
+	}
+	tw_cancel(&(conn->wheel), &(conn->lobby_timer));
+	return host_lobby_send(conn, LB_REMOVE);
+}
+
+/*	host_relay_beat:
+ * 		Periodic timer callback (armed by host_init_state behind a relay) that asks the relay for a token,
+ * 		every REQ_TIMEOUT ms until one comes back, then keeps the token's room alive every RELAY_BEAT ms.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_relay_beat(void* input){
+	Conn_Info_t* conn = (Conn_Info_t*) input;
+	char message[MAX_PACKET_LEN];
+	
+	int len = relay_wrap(message, 0, conn->relay_token, NULL, RELAY_BIND);
+	if(!conn->replay && sendto(conn->s, message, len, 0, (struct sockaddr*)&(conn->relay), sizeof(conn->relay)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Relay Bind Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+	}
+	tw_add(&(conn->wheel), &(conn->relay_timer), get_mono_ms() + (conn->relay_token ? RELAY_BEAT : REQ_TIMEOUT));
+}
+
+/*	host_relay_recv:
+ * 		Takes the relay trailer off a datagram. Joins reach the host only through the relay, so anything
+ * 		else is dropped, relay bind answers set the token and player datagrams get the join's address.
+ *	returns: packet length for the handlers, -1 if there is nothing to handle
+ */
+int host_relay_recv(Conn_Info_t* conn, char* buf, int bytes, struct sockaddr_in* si_other){
+	Relay_Trailer_t t;
+	if(!same_addr(si_other, &(conn->relay)) || (bytes = relay_unwrap(buf, bytes, &t)) == -1){
+		return -1;
+	}
+	
+	if(t.flags == RELAY_BIND){
+		if(t.token != conn->relay_token){
+			conn->relay_token = t.token;
+			log_out(&(conn->log), "Relay token " + std::to_string(t.token) + " (join address:port#" + std::to_string(t.token) + ")\n");
+		}
+		return -1;
+	}
+	si_other->sin_addr.S_un.S_addr = t.addr;
+	si_other->sin_port = t.port;
+	return bytes;
+}
+
+/*	host_spec_timer:
+ * 		Periodic timer callback (armed by host_init_state with a spectator node set) that sends the node the
+ * 		world as it was SPEC_DELAY ms ago, from the snapshot history: a keyframe every SPEC_KEY_EVERY frames
+ * 		and deltas against it between. There is one stream however many spectators the nodes serve.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+void host_spec_timer(void* input){
+	Conn_Info_t* conn = (Conn_Info_t*) input;
+	Spec_Feed_t* feed = &(conn->feed);
+	Spec_Frame_t frame;
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	unsigned long long now = get_mono_ms();
+	tw_add(&(conn->wheel), &(conn->spec_timer), now + SPEC_TIME);
+	
+	//nothing to show until the history reaches back far enough
+	unsigned long long view_us = (now - SPEC_DELAY) * 1000;
+	if(now < SPEC_DELAY || conn->snaps.head == 0 || sh_rewind(&(conn->snaps), view_us, x, y, alive) == -1){
+		return;
+	}
+	
+	//a keyframe takes every player in the game, a delta the ones that differ from the keyframe
+	int key = ((feed->frame % SPEC_KEY_EVERY) == 0);
+	(feed->frame)++;
+	if(key){
+		feed->key = feed->frame;
+		memcpy(feed->kx, x, sizeof(x));
+		memcpy(feed->ky, y, sizeof(y));
+		memcpy(feed->kalive, alive, sizeof(alive));
+	}
+	frame.flags = key ? SPEC_KEY : SPEC_DELTA;
+	frame.in_use = 0;
+	frame.changed = 0;
+	frame.pad = 0;
+	frame.frame = feed->frame;
+	frame.key = feed->key;
+	frame.game_ms = (unsigned int)(now - SPEC_DELAY);
+	int n = 0;
+	for(int i=0; i<MAX_PLAYER; i++){
+		char bit = 0x01;
+		if(!alive[i]){
+			continue;
+		}
+		frame.in_use |= (bit << i);
+		if(key || !feed->kalive[i] || x[i] != feed->kx[i] || y[i] != feed->ky[i]){
+			frame.changed |= (bit << i);
+			frame.loc[2*n] = x[i];
+			frame.loc[2*n + 1] = y[i];
+			n++;
+		}
+	}
+	
+	int len = spec_head_len + 2*n*sizeof(float);
+	if(!conn->replay && sendto(conn->s, (char*)&frame, len, 0, (struct sockaddr*)&(conn->spec), sizeof(conn->spec)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Spectator Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		return;
+	}
+	(feed->frames)++;
+	feed->bytes += len;
+}
+
+/*	host_resolve_action:
+ * 		Resolves an attack by a player against the world as that player saw it (rewound by its measured rtt
+ * 		and the join draw delay, at most MAX_REWIND) rather than the host's current positions.
+ * 		The attack is a circle of the given reach around (cx, cy), tested against the player squares.
+ *	returns: number of players hit (their numbers in hits, at most max_hits), -1 on error
+ */
+int host_resolve_action(Conn_Info_t* conn, int player_num, float cx, float cy, float reach, int* hits, int max_hits){
+	if(conn == NULL || hits == NULL || player_num < 0 || player_num >= MAX_PLAYER){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(conn->players[player_num].lock));
+	if(!conn->store.in_use[player_num]){
+		pthread_mutex_unlock(&(conn->players[player_num].lock));
+		return -1;
+	}
+	unsigned long long rtt_us = conn->players[player_num].rate.srtt_us;
+	pthread_mutex_unlock(&(conn->players[player_num].lock));
+	
+	unsigned long long view_us = sh_view_time(get_mono_ns() / 1000, rtt_us, INTERP_TIME * 1000ULL, MAX_REWIND * 1000ULL);
+	return sh_hit_test(&(conn->snaps), view_us, player_num, cx, cy, reach, PLAYER_SIZE, hits, max_hits);
+}
+
+/*	host_clear_player:
+ * 		Frees a player slot and stops all of its timers. The caller must hold the player lock.
+ *	returns: 0 for success, -1 for error
+ */
+int host_clear_player(Conn_Info_t* conn, int player_num){
+	if(conn == NULL || player_num < 0 || player_num >= MAX_PLAYER){
+		return -1;
+	}
+	
+	Player_Info_t* player = &(conn->players[player_num]);
+	if(pt_find(&(conn->peers), &(player->p_addr)) == player_num){
+		pt_remove(&(conn->peers), &(player->p_addr));
+	}
+	memset((char*)&(player->p_addr), 0, sizeof(player->p_addr));
+	ps_post(&(conn->store.pos[player_num]), 0.0, 0.0);
+	conn->store.in_use[player_num] = 0;
+	tw_cancel(&(conn->wheel), &(player->live_timer));
+	tw_cancel(&(conn->wheel), &(player->send_timer));
+	tw_cancel(&(conn->wheel), &(player->retx_timer));
+	return 0;
+}
+
+/*	host_init_state:
+ * 		Sets up the player slots, locks, peer index, timer wheel and per player timers of a host.
+ * 		Called by init_host once the socket is bound (and by the replay tool, which has no socket).
+ *	returns: 0 for success, -1 for error
+ */
+int host_init_state(Conn_Info_t* conn){
+	if(conn == NULL){
+		return -1;
+	}
+	
+	//initialize the conn info player values
+	for(int i=0; i<MAX_PLAYER; i++){
+		ps_post(&(conn->store.pos[i]), 0.0, 0.0);
+		conn->store.in_use[i] = 0;
+		memset((char*)&(conn->players[i].p_addr), 0, sizeof(conn->players[i].p_addr));
+	}
+	conn->self_x_loc = 0.0;
+	conn->self_y_loc = 0.0;
+	conn->exit = 0;
+	conn->send_p = 0;
+	conn->pkt_num = 0;
+	
+	//set the values for the self player
+	conn->self_player_num = 0;
+	ps_post(&(conn->store.pos[0]), 0.0, 0.0);
+	conn->store.in_use[0] = 1;
+	conn->players[0].p_addr = conn->server;
+	
+	//initialize mutex states
+	for(int i=0; i<MAX_PLAYER; i++){
+		pthread_mutex_init(&(conn->players[i].lock), NULL);
+	}
+	pthread_mutex_init(&(conn->exit_lock), NULL);
+	pthread_mutex_init(&(conn->send_p_lock), NULL);
+	
+	//secret for the join cookies (new each time the host starts, so old cookies are no good)
+	unsigned char secret[CK_KEY_LEN];
+	if(crypt_random(secret, CK_KEY_LEN) == -1){
+		err_out(&(conn->err), "Cookie Secret Not Created\n");
+		return -1;
+	}
+	ck_set_key(&(conn->cookie), secret, CK_KEY_LEN);
+	conn->cookies = 0;
+	
+	//set up the peer index (address and port to player slot) and the world snapshot history
+	if(pt_init(&(conn->peers), MAX_PLAYER) == -1){
+		err_out(&(conn->err), "Peer Table Not Created\n");
+		return -1;
+	}
+	if(sh_init(&(conn->snaps), SNAP_HISTORY, MAX_PLAYER) == -1){
+		err_out(&(conn->err), "Snapshot History Not Created\n");
+		return -1;
+	}
+	ecs_init(&(conn->world));
+	pthread_mutex_init(&(conn->world_lock), NULL);
+	memset((char*)conn->player_ents, 0, sizeof(conn->player_ents));
+	ecs_query_init(&(conn->player_query), ECS_BIT(ECS_POS) | ECS_BIT(ECS_PLAYER), 0);
+	col_init(&(conn->col));
+	ecs_query_init(&(conn->hitbox_query), ECS_BIT(ECS_POS) | ECS_BIT(ECS_HITBOX), ECS_BIT(ECS_PLAYER));
+	conn->on_contact = NULL;
+	conn->contacts = 0;
+	pthread_mutex_init(&(conn->lat_lock), NULL);
+	lh_init(&(conn->kernel_lat));
+	lh_init(&(conn->wake_lat));
+	lh_init(&(conn->handle_lat));
+	lh_init(&(conn->send_lat));
+	conn->jobs = NULL;
+	conn->send_count = 0;
+	conn->out_pending = 0;
+	
+	//set up the timer wheel and the per player timers it drives
+	tw_init(&(conn->wheel), get_mono_ms());
+	for(int i=0; i<MAX_PLAYER; i++){
+		conn->players[i].conn = conn;
+		conn->players[i].id = i;
+		conn->players[i].last_recv = 0;
+		conn->players[i].send_due_us = 0;
+		timer_init(&(conn->players[i].live_timer), host_live_timeout, (void*)&(conn->players[i]));
+		timer_init(&(conn->players[i].send_timer), host_send_timer, (void*)&(conn->players[i]));
+		timer_init(&(conn->players[i].retx_timer), host_retx_timer, (void*)&(conn->players[i]));
+		crypt_session_init(&(conn->players[i].sess));
+		rc_init(&(conn->players[i].rate), MIN_SERVER_PPS, MAX_SERVER_PPS, 0);
+		pb_init(&(conn->players[i].out), batch_cap);
+	}
+	timer_init(&(conn->rate_log_timer), host_rate_log, (void*)conn);
+	tw_add(&(conn->wheel), &(conn->rate_log_timer), get_mono_ms() + RATE_LOG_TIME);
+	timer_init(&(conn->snap_timer), host_snap_timer, (void*)conn);
+	tw_add(&(conn->wheel), &(conn->snap_timer), get_mono_ms() + SNAP_TIME);
+	timer_init(&(conn->lobby_timer), host_lobby_beat, (void*)conn);
+	if(conn->use_lobby){
+		tw_add(&(conn->wheel), &(conn->lobby_timer), get_mono_ms());
+	}
+	timer_init(&(conn->spec_timer), host_spec_timer, (void*)conn);
+	memset((char*)&(conn->feed), 0, sizeof(conn->feed));
+	if(conn->use_spec){
+		tw_add(&(conn->wheel), &(conn->spec_timer), get_mono_ms() + SPEC_TIME);
+	}
+	timer_init(&(conn->relay_timer), host_relay_beat, (void*)conn);
+	if(conn->use_relay){
+		conn->relay_token = 0;
+		tw_add(&(conn->wheel), &(conn->relay_timer), get_mono_ms());
+	}
+	if(conn->crypt.enabled){
+		log_out(&(conn->log), std::string("Packet encryption enabled (") + (crypt_init() ? "AES-NI" : "portable AES") + ")\n");
+	}
+	return 0;
+}
+
+/*	host_queue:
+ * 		Queues a whole message for a player, to go out with the player's other messages of this send tick
+ * 		(the disp send or the send thread's host_flush takes them). The caller must hold the player lock.
+ *	returns: 0 for success, -1 for error
+ */
+int host_queue(Conn_Info_t* conn, Player_Info_t* player, const char* message, int len){
+	if(conn == NULL || player == NULL || message == NULL){
+		return -1;
+	}
+	
+	//a full batch goes out now to make room
+	if(pb_add(&(player->out), message, len) == -1){
+		if(host_flush_player(conn, player) == -1 || pb_add(&(player->out), message, len) == -1){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*	host_flush_player:
+ * 		Sends everything queued for a player in one packet (dropped if the slot has cleared since).
+ * 		The caller must hold the player lock.
+ *	returns: 0 for success, -1 for error
+ */
+int host_flush_player(Conn_Info_t* conn, Player_Info_t* player){
+	char message[MAX_PACKET_LEN];
+	int len = pb_take(&(player->out), message);
+	if(len == 0 || !conn->store.in_use[player->id]){
+		return 0;
+	}
+	return host_sendto(conn, player->id, message, len, &(player->p_addr));
+}
+
+/*	host_flush:
+ * 		Sends the messages timers queued this tick that no disp send took (run by the send thread after
+ * 		each wheel advance, does nothing unless one was queued).
+ *	returns: 0 for success, -1 for error
+ */
+int host_flush(Conn_Info_t* conn){
+	if(conn == NULL){
+		return -1;
+	}
+	if(!conn->out_pending.exchange(0)){
+		return 0;
+	}
+	int ret = 0;
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(conn->players[i].lock));
+		if(host_flush_player(conn, &(conn->players[i])) == -1){
+			ret = -1;
+		}
+		pthread_mutex_unlock(&(conn->players[i].lock));
+	}
+	return ret;
+}
+
+/*	host_sendto:
+ * 		Sends a packet to a player, sealing it first when encryption is on (player_num -1 seals a join
+ * 		ack with the pre-shared key, otherwise the player's session is used).
+ * 		Every packet is stamped with the game's session id.
+ * 		The message buffer needs room for CRYPT_OVERHEAD (and the relay trailer) bytes past len.
+ *	returns: 0 for success, -1 for error
+ */
+int host_sendto(Conn_Info_t* conn, int player_num, char* message, int len, struct sockaddr_in* addr){
+	if(conn == NULL || message == NULL || addr == NULL || player_num >= MAX_PLAYER){
+		return -1;
+	}
+	((Header_t*)message)->session_id = conn->session_id;
+	rec_write(&(conn->rec), REC_OUT, addr, message, len);
+	
+	//replays run the handlers without a socket
+	if(conn->replay){
+		return 0;
+	}
+	unsigned int trace_pkt = ((Header_t*)message)->packet_num;
+	unsigned long long trace_ns = TRACE_NOW();
+	if(conn->crypt.enabled){
+		if(player_num < 0){
+			len = pkt_seal(&(conn->crypt.base), NULL, CRYPT_DIR_HOST, message, PACKET_HEAD_LEN, len);
+		} else{
+			Crypt_Session_t* sess = &(conn->players[player_num].sess);
+			len = pkt_seal(&(sess->key), sess, CRYPT_DIR_HOST, message, PACKET_HEAD_LEN, len);
+		}
+		if(len == -1){
+			err_out(&(conn->err), "Packet Seal Failed\n");
+			return -1;
+		}
+	}
+	
+	//behind a relay the player's address goes in the trailer
+	if(conn->use_relay){
+		len = relay_wrap(message, len, conn->relay_token, addr, RELAY_DATA);
+		addr = &(conn->relay);
+	}
+	TRACE_SPAN("encode", trace_ns, trace_pkt, 0);
+	
+	trace_ns = TRACE_NOW();
+	if(sendto(conn->s, message, len, 0, (struct sockaddr*)addr, sizeof(*addr)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		return -1;
+	}
+	TRACE_SPAN("send", trace_ns, trace_pkt, 0);
+	return 0;
+}
+
+/*	host_open_packet:
+ * 		Authenticates and decrypts a packet from a player in place. Join requests are sealed with the
+ * 		pre-shared key, everything else with the session of the player slot named in the header.
+ *	returns: plain packet length, -1 if the packet is not authentic
+ */
+int host_open_packet(Conn_Info_t* conn, int bytes, char* buf){
+	if(conn == NULL || buf == NULL || bytes < PACKET_HEAD_LEN){
+		return -1;
+	}
+	
+	if((((Header_t*)buf)->flags & PF_JOIN) == PF_JOIN){
+		return pkt_open(&(conn->crypt.base), NULL, CRYPT_DIR_JOIN, buf, PACKET_HEAD_LEN, bytes);
+	}
+	
+	int player_num = ((Header_t*)buf)->player_id;
+	if(player_num < 1 || player_num >= MAX_PLAYER){
+		return -1;
+	}
+	
+	//the session can be re-derived by a join for the slot so open under the player lock
+	Player_Info_t* player = &(conn->players[player_num]);
+	pthread_mutex_lock(&(player->lock));
+	if(!player->sess.ready){
+		bytes = -1;
+	} else{
+		bytes = pkt_open(&(player->sess.key), &(player->sess), CRYPT_DIR_JOIN, buf, PACKET_HEAD_LEN, bytes);
+	}
+	pthread_mutex_unlock(&(player->lock));
+	return bytes;
+}
+
+/*	host_join_session:
+ * 		Sets up the player's session for a join request. A retransmitted request (same client random)
+ * 		keeps the session and gets the same host random back, a new client random restarts the session.
+ * 		The caller must hold the player lock.
+ *	returns: 0 for success (host random written to host_rand), -1 for error
+ */
+int host_join_session(Conn_Info_t* conn, int player_num, const unsigned char* client_rand, unsigned char* host_rand){
+	if(conn == NULL || client_rand == NULL || host_rand == NULL || player_num < 1 || player_num >= MAX_PLAYER){
+		return -1;
+	}
+	
+	Crypt_Session_t* sess = &(conn->players[player_num].sess);
+	if(!sess->ready || memcmp(sess->client_rand, client_rand, CRYPT_RAND_LEN) != 0){
+		if(crypt_random(host_rand, CRYPT_RAND_LEN) == -1 || crypt_derive_session(&(conn->crypt), sess, client_rand, host_rand) == -1){
+			err_out(&(conn->err), "Session Setup Failed\n");
+			return -1;
+		}
+	} else{
+		memcpy(host_rand, sess->host_rand, CRYPT_RAND_LEN);
+	}
+	return 0;
+}
+
 /*	host_build_disp_message:
  * 		Display packet builder for the host send thread
  * 		Adds all current player info to the packet
@@ -530,22 +1517,26 @@ int host_build_disp_message(Conn_Info_t* conn, char* message){
 		return -1;
 	}
 	
+	unsigned long long trace_ns = TRACE_NOW();
+	
 	//clear the message then fill the pkt (player_id specific to player)
 	memset(message, '\0', MAX_PACKET_LEN);
 	((Disp_Packet_t*)message)->head.flags = PF_DISP;
 	((Disp_Packet_t*)message)->head.packet_num = conn->pkt_num;
 	
-	//player info
+	//player info (from the world's player entities)
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	host_world_players(conn, x, y, alive);
 	((Disp_Packet_t*)message)->in_use = 0;
 	for(int i=0; i<MAX_PLAYER; i++){
-		pthread_mutex_lock(&(conn->players[i].lock));
-		if(conn->players[i].in_use){
+		if(alive[i]){
 			char bit = 0x01;
 			((Disp_Packet_t*)message)->in_use += (bit << i);
-			((Disp_Packet_t*)message)->px_loc[i] = conn->players[i].px_loc;
-			((Disp_Packet_t*)message)->py_loc[i] = conn->players[i].py_loc;
+			((Disp_Packet_t*)message)->px_loc[i] = x[i];
+			((Disp_Packet_t*)message)->py_loc[i] = y[i];
 		}
-		pthread_mutex_unlock(&(conn->players[i].lock));
 	}
+	TRACE_SPAN("disp build", trace_ns, ((Disp_Packet_t*)message)->head.packet_num, (unsigned int)conn->snaps.head);
 	return 0;
 }
@@ -0,0 +1,207 @@
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "inc/InputState.h"
+
+//key to held key bit (either case so a shift pressed mid hold cannot leave a key stuck down)
+static unsigned in_key_bit(unsigned char key){
+	switch(tolower(key)){
+		case W_ASCII:
+			return IN_UP;
+		case A_ASCII:
+			return IN_LEFT;
+		case S_ASCII:
+			return IN_DOWN;
+		case D_ASCII:
+			return IN_RIGHT;
+		default:
+			return 0;
+	}
+}
+
+//moves the position by the held keys up to now (called with the input lock held)
+static void in_advance(Input_State_t* in, unsigned long long now_ns){
+	if(now_ns <= in->last_ns){
+		return;
+	}
+	float dt = (float)(now_ns - in->last_ns) / 1e9f;
+	float dx = (float)(((in->keys & IN_RIGHT) != 0) - ((in->keys & IN_LEFT) != 0));
+	float dy = (float)(((in->keys & IN_UP) != 0) - ((in->keys & IN_DOWN) != 0));
+	in->x += dx * MOVE_SPEED * dt;
+	in->y += dy * MOVE_SPEED * dt;
+	in->last_ns = now_ns;
+}
+
+//flips a held key, closing the movement of the old keys at the time of the change
+static int in_key_change(Input_State_t* in, unsigned char key, int down, unsigned long long now_ns){
+	unsigned bit = in_key_bit(key);
+	if(in == NULL || bit == 0){
+		return 0;
+	}
+	pthread_mutex_lock(&(in->lock));
+	unsigned keys = down ? (in->keys | bit) : (in->keys & ~bit);
+	if(keys == in->keys){
+		pthread_mutex_unlock(&(in->lock));
+		return 0;
+	}
+	in_advance(in, now_ns);
+	in->keys = keys;
+	if(in->change_ns == 0){
+		in->change_ns = now_ns;
+	}
+	(in->changes)++;
+	pthread_cond_signal(&(in->wake));
+	pthread_mutex_unlock(&(in->lock));
+	return 1;
+}
+
+/*	in_init:
+ * 		Sets up the input state of the self player, starting from its current position.
+ * 		send_now is the urgent send path run by the sample thread on a key change (NULL for none).
+ *	returns: 0 for success, -1 for error
+ */
+int in_init(Input_State_t* in, Conn_Info_t* conn, int (*send_now)(Conn_Info_t* conn)){
+	if(in == NULL || conn == NULL){
+		return -1;
+	}
+	in->conn = conn;
+	pthread_mutex_init(&(in->lock), NULL);
+	pthread_cond_init(&(in->wake), NULL);
+	in->keys = 0;
+	pthread_mutex_lock(&(conn->players[(int)(conn->self_player_num)].lock));
+	in->x = conn->self_x_loc;
+	in->y = conn->self_y_loc;
+	pthread_mutex_unlock(&(conn->players[(int)(conn->self_player_num)].lock));
+	in->last_ns = get_mono_ns();
+	in->change_ns = 0;
+	in->urgent = 1;
+	in->send_now = send_now;
+	in->exit = 0;
+	in->samples = 0;
+	in->changes = 0;
+	return 0;
+}
+
+/*	in_start:
+ * 		Starts the sample thread.
+ *	returns: 0 for success, -1 for error
+ */
+int in_start(Input_State_t* in){
+	if(in == NULL || pthread_create(&(in->thread), NULL, in_run, (void*)in) != 0){
+		return -1;
+	}
+	return 0;
+}
+
+/*	in_stop:
+ * 		Stops the sample thread and waits for it.
+ *	returns: 0 for success, -1 for error
+ */
+int in_stop(Input_State_t* in){
+	if(in == NULL){
+		return -1;
+	}
+	pthread_mutex_lock(&(in->lock));
+	in->exit = 1;
+	pthread_cond_signal(&(in->wake));
+	pthread_mutex_unlock(&(in->lock));
+	pthread_join(in->thread, NULL);
+	pthread_mutex_destroy(&(in->lock));
+	pthread_cond_destroy(&(in->wake));
+	return 0;
+}
+
+/*	in_key_down:
+ * 		Key down callback (os key repeats of a held key change nothing).
+ *	returns: 1 if a direction key changed, 0 otherwise
+ */
+int in_key_down(Input_State_t* in, unsigned char key, unsigned long long now_ns){
+	return in_key_change(in, key, 1, now_ns);
+}
+
+/*	in_key_up:
+ * 		Key up callback.
+ *	returns: 1 if a direction key changed, 0 otherwise
+ */
+int in_key_up(Input_State_t* in, unsigned char key, unsigned long long now_ns){
+	return in_key_change(in, key, 0, now_ns);
+}
+
+/*	in_sample:
+ * 		Integrates the held keys up to now and publishes the self position (store and send copies).
+ * 		A key change seen here is marked on the connection so the next keys packet out counts its latency.
+ *	returns: 1 if a key changed since the last sample, 0 otherwise
+ */
+int in_sample(Input_State_t* in, unsigned long long now_ns){
+	Conn_Info_t* conn = in->conn;
+	pthread_mutex_lock(&(in->lock));
+	in_advance(in, now_ns);
+	float x = in->x, y = in->y;
+	unsigned keys = in->keys;
+	unsigned long long change = in->change_ns;
+	in->change_ns = 0;
+	(in->samples)++;
+	pthread_mutex_unlock(&(in->lock));
+	
+	//nothing held and nothing changed means the position has not moved
+	if(keys == 0 && change == 0){
+		return 0;
+	}
+	pthread_mutex_lock(&(conn->players[(int)(conn->self_player_num)].lock));
+	conn->self_x_loc = x;
+	conn->self_y_loc = y;
+	ps_post(&(conn->store.pos[(int)(conn->self_player_num)]), x, y);
+	pthread_mutex_unlock(&(conn->players[(int)(conn->self_player_num)].lock));
+	if(change == 0){
+		return 0;
+	}
+	
+	//keep the oldest unsent change so a burst is timed from its first key
+	unsigned long long none = 0;
+	conn->input_ns.compare_exchange_strong(none, change);
+	return 1;
+}
+
+/*	in_run:
+ * 		Sample thread: samples at INPUT_HZ and right away when a key changes, sending changes on the
+ * 		urgent path instead of leaving them for the next send tick.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* in_run(void* input){
+	Input_State_t* in = (Input_State_t*) input;
+	Conn_Info_t* conn = in->conn;
+	unsigned long long period = 1000000000ULL / INPUT_HZ;
+	
+	while(1){
+		//wait for the next sample or a key change
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += period;
+		if(ts.tv_nsec >= 1000000000){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_mutex_lock(&(in->lock));
+		if(in->change_ns == 0 && !(in->exit)){
+			pthread_cond_timedwait(&(in->wake), &(in->lock), &ts);
+		}
+		int stop = in->exit;
+		pthread_mutex_unlock(&(in->lock));
+		pthread_mutex_lock(&(conn->exit_lock));
+		stop |= conn->exit;
+		pthread_mutex_unlock(&(conn->exit_lock));
+		if(stop){
+			break;
+		}
+		
+		if(in_sample(in, get_mono_ns()) && in->urgent && in->send_now != NULL){
+			if(in->send_now(conn) == -1){
+				pthread_mutex_lock(&(conn->exit_lock));
+				conn->exit = 1;
+				pthread_mutex_unlock(&(conn->exit_lock));
+			}
+		}
+	}
+	pthread_exit(NULL);
+}
@@ -0,0 +1,224 @@
+#include <windows.h>
+
+#include "inc/JobSystem.h"
+
+//owner side: adds a job at the bottom (0 if the deque is full)
+static int js_push(Job_Deque_t* d, const Job_t* job){
+	long long b = d->bottom.load(std::memory_order_relaxed);
+	long long t = d->top.load(std::memory_order_acquire);
+	if(b - t >= JS_DEQUE_SIZE){
+		return 0;
+	}
+	d->jobs[b & (JS_DEQUE_SIZE - 1)] = *job;
+	std::atomic_thread_fence(std::memory_order_release);
+	d->bottom.store(b + 1, std::memory_order_relaxed);
+	return 1;
+}
+
+//owner side: takes the newest job (the last one races the thieves for it on top)
+static int js_pop(Job_Deque_t* d, Job_t* job){
+	long long b = d->bottom.load(std::memory_order_relaxed) - 1;
+	d->bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = d->top.load(std::memory_order_relaxed);
+	if(t > b){
+		d->bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+	*job = d->jobs[b & (JS_DEQUE_SIZE - 1)];
+	if(t == b){
+		int won = d->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		d->bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return 1;
+}
+
+//thief side: takes the oldest job (0 if empty or another thread got it first)
+static int js_steal(Job_Deque_t* d, Job_t* job){
+	long long t = d->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = d->bottom.load(std::memory_order_acquire);
+	if(t >= b){
+		return 0;
+	}
+	*job = d->jobs[t & (JS_DEQUE_SIZE - 1)];
+	return d->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+//finds a job for a worker: its own newest, otherwise the oldest of the next worker that has one
+static int js_take(Job_System_t* js, int worker, Job_t* job){
+	Job_Worker_t* w = &(js->workers[worker]);
+	if(js_pop(&(w->deque), job)){
+		(js->queued)--;
+		return 1;
+	}
+	for(int k=1; k<js->count; k++){
+		if(js_steal(&(js->workers[(worker + k) % js->count].deque), job)){
+			(js->queued)--;
+			(w->stolen)++;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void js_run(Job_System_t* js, int worker, Job_t* job){
+	job->func(js, worker, job->arg);
+	(js->workers[worker].ran)++;
+	job->group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+//worker thread: runs and steals jobs, yields for a while once there are none, then sleeps until a spawn
+static void* js_worker(void* input){
+	Job_Worker_t* w = (Job_Worker_t*) input;
+	Job_System_t* js = w->js;
+	Job_t job;
+	int idle = 0;
+	
+	while(!js->exit){
+		if(js_take(js, w->id, &job)){
+			js_run(js, w->id, &job);
+			idle = 0;
+			continue;
+		}
+		if(++idle < JS_SPIN){
+			SwitchToThread();
+			continue;
+		}
+		
+		//a spawn bumps queued before it checks sleepers, so either it sees this sleeper or this sees its job
+		pthread_mutex_lock(&(js->lock));
+		(js->sleepers)++;
+		while(js->queued == 0 && !js->exit){
+			pthread_cond_wait(&(js->wake), &(js->lock));
+		}
+		(js->sleepers)--;
+		pthread_mutex_unlock(&(js->lock));
+		idle = 0;
+	}
+	return NULL;
+}
+
+/*	js_cores:
+ * 		Counts the logical processors.
+ *	returns: the processor count (at least 1)
+ */
+int js_cores(){
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+/*	js_init:
+ * 		Sets up a scheduler with one deque per worker (workers 0 for one per core) and starts every
+ * 		worker's thread but worker 0's, which is the thread that spawns the top level jobs.
+ *	returns: 0 for success, -1 for error
+ */
+int js_init(Job_System_t* js, int workers){
+	if(js == NULL){
+		return -1;
+	}
+	if(workers <= 0){
+		workers = js_cores();
+	}
+	if(workers > JS_MAX_WORKERS){
+		workers = JS_MAX_WORKERS;
+	}
+	
+	js->count = workers;
+	js->queued = 0;
+	js->sleepers = 0;
+	js->exit = 0;
+	pthread_mutex_init(&(js->lock), NULL);
+	pthread_cond_init(&(js->wake), NULL);
+	js->workers = new Job_Worker_t[workers];
+	for(int i=0; i<workers; i++){
+		Job_Worker_t* w = &(js->workers[i]);
+		w->js = js;
+		w->id = i;
+		w->deque.top = 0;
+		w->deque.bottom = 0;
+		w->deque.jobs = new Job_t[JS_DEQUE_SIZE];
+		w->ran = 0;
+		w->stolen = 0;
+	}
+	for(int i=1; i<workers; i++){
+		pthread_create(&(js->workers[i].thread), NULL, js_worker, (void*)&(js->workers[i]));
+	}
+	return 0;
+}
+
+/*	js_quit:
+ * 		Stops the worker threads and frees the deques (wait on every group first, queued jobs are dropped).
+ */
+void js_quit(Job_System_t* js){
+	if(js == NULL || js->workers == NULL){
+		return;
+	}
+	pthread_mutex_lock(&(js->lock));
+	js->exit = 1;
+	pthread_cond_broadcast(&(js->wake));
+	pthread_mutex_unlock(&(js->lock));
+	for(int i=1; i<js->count; i++){
+		pthread_join(js->workers[i].thread, NULL);
+	}
+	for(int i=0; i<js->count; i++){
+		delete[] js->workers[i].deque.jobs;
+	}
+	delete[] js->workers;
+	js->workers = NULL;
+	pthread_mutex_destroy(&(js->lock));
+	pthread_cond_destroy(&(js->wake));
+}
+
+/*	js_group_init:
+ * 		Empties a fork/join group.
+ */
+void js_group_init(Job_Group_t* group){
+	group->pending = 0;
+}
+
+/*	js_spawn:
+ * 		Forks a job into a group on the calling worker's deque, where idle workers can steal it.
+ * 		A full deque runs the job before returning instead.
+ *	returns: 0 for success, -1 for error
+ */
+int js_spawn(Job_System_t* js, int worker, Job_Group_t* group, Job_Func_t func, void* arg){
+	if(js == NULL || group == NULL || func == NULL || worker < 0 || worker >= js->count){
+		return -1;
+	}
+	Job_t job;
+	job.func = func;
+	job.arg = arg;
+	job.group = group;
+	group->pending.fetch_add(1, std::memory_order_relaxed);
+	
+	//counted before the push so a thief never takes it below 0
+	(js->queued)++;
+	if(!js_push(&(js->workers[worker].deque), &job)){
+		(js->queued)--;
+		js_run(js, worker, &job);
+		return 0;
+	}
+	if(js->sleepers > 0){
+		pthread_mutex_lock(&(js->lock));
+		pthread_cond_signal(&(js->wake));
+		pthread_mutex_unlock(&(js->lock));
+	}
+	return 0;
+}
+
+/*	js_wait:
+ * 		Joins a group: the calling worker runs its own and stolen jobs until every job of the group is done.
+ */
+void js_wait(Job_System_t* js, int worker, Job_Group_t* group){
+	Job_t job;
+	while(group->pending.load(std::memory_order_acquire) > 0){
+		if(js_take(js, worker, &job)){
+			js_run(js, worker, &job);
+		} else{
+			SwitchToThread();
+		}
+	}
+}
@@ -41,17 +41,52 @@ int JoinConnect::init_join(Conn_Info_t* conn, std::string hostname){
 		return WSAGetLastError();
 	}
 	
-	//fill server sockaddr structure
+	//fill server sockaddr structure (hostname may name a port as address:port, e.g. to go through a test proxy,
+	//a game on a session server as address:port/session, and a host behind a relay as relay:port#token)
+	unsigned short port = SERVER_PORT;
+	conn->session_id = 0;
+	conn->use_relay = 0;
+	size_t hash = hostname.find('#');
+	if(hash != std::string::npos){
+		conn->relay_token = (unsigned int)strtoul(hostname.c_str() + hash + 1, NULL, 10);
+		hostname = hostname.substr(0, hash);
+		if(conn->relay_token == 0){
+			err_out(&(conn->err), "Improper Relay Token\n");
+			return -1;
+		}
+		conn->use_relay = 1;
+		port = RELAY_PORT;
+	}
+	size_t slash = hostname.find('/');
+	if(slash != std::string::npos){
+		int session = atoi(hostname.c_str() + slash + 1);
+		hostname = hostname.substr(0, slash);
+		if(session <= 0 || session > MAX_SESSIONS){
+			err_out(&(conn->err), "Improper Session Id\n");
+			return -1;
+		}
+		conn->session_id = (unsigned short)session;
+	}
+	size_t colon = hostname.find(':');
+	if(colon != std::string::npos){
+		port = (unsigned short)atoi(hostname.c_str() + colon + 1);
+		hostname = hostname.substr(0, colon);
+		if(port == 0){
+			err_out(&(conn->err), "Improper Host Port\n");
+			return -1;
+		}
+	}
 	memset((char*)&(conn->server), 0, sizeof(conn->server));
 	conn->server.sin_family = AF_INET;
 	conn->server.sin_addr.S_un.S_addr = inet_addr(hostname.c_str());
-	conn->server.sin_port = htons(SERVER_PORT);
+	conn->server.sin_port = htons(port);
+	conn->relay = conn->server;
 	
 	//fill client sockaddr structure
 	memset((char*)&(conn->client), 0, sizeof(conn->client));
 	conn->client.sin_family = AF_INET;
 	conn->client.sin_addr.s_addr = INADDR_ANY;
-	conn->client.sin_port = htons(CLIENT_PORT);
+	conn->client.sin_port = htons(conn->client_port ? conn->client_port : CLIENT_PORT);
 	
 	//bind the socket
 	if(bind(conn->s, (struct sockaddr*)&(conn->client), sizeof(conn->client)) == SOCKET_ERROR){
@@ -60,48 +95,42 @@ int JoinConnect::init_join(Conn_Info_t* conn, std::string hostname){
 	}
 	
 	log_out(&(conn->log), "Socket successfully created and bound to self address\n");
+	log_out(&(conn->log), "Receive timestamps from the " + std::string(rs_source_name(rs_init(&(conn->stamp), conn->s))) + "\n");
 	
-	//initialize the conn info player values
-	for(int i=0; i<MAX_PLAYER; i++){
-		conn->players[i].px_loc = 0.0;
-		conn->players[i].py_loc = 0.0;
-		memset((char*)&(conn->players[i].p_addr), 0, sizeof(conn->players[i].p_addr));
-	}
-	conn->self_x_loc = 0.0;
-	conn->self_y_loc = 0.0;
-	conn->exit = 0;
-	conn->send_p = 0;
-	conn->pkt_num = 0;
-	
-	//initialize mutex states
-	for(int i=0; i<MAX_PLAYER; i++){
-		pthread_mutex_init(&(conn->players[i].lock), NULL);
+	//player slots and locks
+	if(join_init_state(conn) == -1){
+		return -1;
 	}
-	pthread_mutex_init(&(conn->exit_lock), NULL);
-	pthread_mutex_init(&(conn->send_p_lock), NULL);
 	
 	//perform the join request operation
 	if((conn->self_player_num = join_request_handshake(conn)) == -1){
 		conn->self_player_num = 0;
-		conn->players[(int)(conn->self_player_num)].px_loc = 0.0;
-		conn->players[(int)(conn->self_player_num)].py_loc = 0.0;
-		conn->players[(int)(conn->self_player_num)].in_use = 1;
+		ps_post(&(conn->store.pos[(int)(conn->self_player_num)]), 0.0, 0.0);
+		conn->store.in_use[(int)(conn->self_player_num)] = 1;
 		conn->players[(int)(conn->self_player_num)].p_addr = conn->client;
 		return -1;
 	} else {
-		conn->players[(int)(conn->self_player_num)].px_loc = 0.0;
-		conn->players[(int)(conn->self_player_num)].py_loc = 0.0;
-		conn->players[(int)(conn->self_player_num)].in_use = 1;
+		ps_post(&(conn->store.pos[(int)(conn->self_player_num)]), 0.0, 0.0);
+		conn->store.in_use[(int)(conn->self_player_num)] = 1;
 		conn->players[(int)(conn->self_player_num)].p_addr = conn->client;
 		
 		log_out(&(conn->log), "Successfully joined host with player number: " + std::to_string(conn->self_player_num) + "\n");
 	}
 	
-	//create the send and recv threads
-	t_send = pthread_create(&send_thread, NULL, join_send, (void*)conn);
-	t_recv = pthread_create(&recv_thread, NULL, join_recv, (void*)conn);
+	//create the send and recv threads (each pins itself and sets its priority as it starts)
+	pthread_attr_t send_attr, recv_attr;
+	if(tc_apply_process(&(conn->threads)) == -1){
+		err_out(&(conn->err), "Process Priority Class Not Set\n");
+	}
+	tc_attr(&(conn->threads), THREAD_SEND, &send_attr);
+	tc_attr(&(conn->threads), THREAD_RECV, &recv_attr);
+	t_send = pthread_create(&send_thread, &send_attr, join_send, (void*)conn);
+	t_recv = pthread_create(&recv_thread, &recv_attr, join_recv, (void*)conn);
+	pthread_attr_destroy(&send_attr);
+	pthread_attr_destroy(&recv_attr);
 	
 	log_out(&(conn->log), "Send and Receive threads successfully created\n");
+	log_out(&(conn->log), tc_describe(&(conn->threads), THREAD_RECV) + "\n" + tc_describe(&(conn->threads), THREAD_SEND) + "\n");
 	
 	prev_init = 1;
 	return 0;
@@ -122,13 +151,34 @@ int JoinConnect::quit_join(Conn_Info_t* conn){
 		return -1;
 	}
 	
+	//input to wire latency of this game's key changes
+	if(conn->input_lat.total > 0){
+		log_out(&(conn->log), "Input to wire latency: " + lh_summary(&(conn->input_lat)) + "\n");
+	}
+	pthread_mutex_lock(&(conn->lat_lock));
+	if(conn->kernel_lat.total > 0){
+		log_out(&(conn->log), "Socket arrival to recv latency: " + lh_summary(&(conn->kernel_lat)) + "\n");
+	}
+	if(conn->wake_lat.total > 0){
+		log_out(&(conn->log), "Recv wakeup to handle latency: " + lh_summary(&(conn->wake_lat)) + "\n");
+		log_out(&(conn->log), "Handler duration: " + lh_summary(&(conn->handle_lat)) + "\n");
+	}
+	pthread_mutex_unlock(&(conn->lat_lock));
+	
 	//check if the connections have already been terminated with the exit bit
 	pthread_mutex_lock(&(conn->exit_lock));
 	if(conn->exit){
 		pthread_mutex_unlock(&(conn->exit_lock));
 		log_out(&(conn->log), "Connection Already Terminated. Game Ended.\n");
+		
+		//the threads (and the recv thread's handlers) may still be finishing, wait for them before closing
+		if(prev_init){
+			pthread_join(send_thread, NULL);
+			pthread_join(recv_thread, NULL);
+		}
 		closesocket(conn->s);
 		WSACleanup();
+		rec_close(&(conn->rec));
 		return 0;
 	} else{
 		pthread_mutex_unlock(&(conn->exit_lock));
@@ -148,8 +198,7 @@ int JoinConnect::quit_join(Conn_Info_t* conn){
 			//send request and wait for response (check for timeout before resending)
 			((Header_t*)message)->packet_num = conn->pkt_num;
 			((Header_t*)message)->timestamp = get_timestamp();
-			if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)&(conn->server), sizeof(conn->server)) == SOCKET_ERROR){
-				err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+			if(join_sendto(conn, message, PACKET_HEAD_LEN) == -1){
 				return -1;
 			}
 			(conn->pkt_num)++;
@@ -173,6 +222,7 @@ int JoinConnect::quit_join(Conn_Info_t* conn){
 			//close the socket
 			closesocket(conn->s);
 			WSACleanup();
+			rec_close(&(conn->rec));
 			
 			log_out(&(conn->log), "Send and Receive threads successfully closed\n");
 			
@@ -209,7 +259,8 @@ pthread_t JoinConnect::get_recv_thread(){
 
 /*	join_request_handshake:
  * 		Performs the joining request handshake to connect to a host.
- * 		Sends the join request to specified host ip then waits for the ack
+ * 		Sends the join request to specified host ip then waits for the ack (the host first answers with a
+ * 		cookie, which goes back in the request that gets the ack)
  *		this function called before starting threads as recv in two parallel threads not good
  *	returns: self player number assigned by host
  */
@@ -220,12 +271,23 @@ char JoinConnect::join_request_handshake(Conn_Info_t* conn){
 	struct sockaddr_in si_other;
 	int slen = sizeof(si_other);
 	int numbytes;
+	unsigned char client_rand[CRYPT_RAND_LEN];
+	Cookie_t cookie;
 	
 	//null check
 	if(conn == NULL){
 		return -1;
 	}
 	
+	//no cookie yet, the request carries the field zeroed (padding it to the size of the host's cookie answer)
+	memset((char*)&cookie, 0, sizeof(cookie));
+	
+	//the same client random goes in every retransmit so the host hands back the same host random
+	if(conn->crypt.enabled && crypt_random(client_rand, CRYPT_RAND_LEN) == -1){
+		err_out(&(conn->err), "Session Setup Failed\n");
+		return -1;
+	}
+	
 	//time of starting the request sending
 	unsigned long start_join_request = get_timestamp();
 	
@@ -238,8 +300,14 @@ char JoinConnect::join_request_handshake(Conn_Info_t* conn){
 			//send request and wait for response (check for timeout before resending)
 			((Header_t*)message)->packet_num = conn->pkt_num;
 			((Header_t*)message)->timestamp = get_timestamp();
-			if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)&(conn->server), sizeof(conn->server)) == SOCKET_ERROR){
-				err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+			int len = PACKET_HEAD_LEN;
+			if(conn->crypt.enabled){
+				memcpy(message + PACKET_HEAD_LEN, client_rand, CRYPT_RAND_LEN);
+				len = join_crypt_len;
+			}
+			memcpy(message + len, &cookie, COOKIE_LEN);
+			len += COOKIE_LEN;
+			if(join_sendto(conn, message, len) == -1){
 				return -1;
 			}
 			(conn->pkt_num)++;
@@ -248,10 +316,43 @@ char JoinConnect::join_request_handshake(Conn_Info_t* conn){
 			//check that the source matches the server address and player num matches our number
 			if(conn->server.sin_addr.S_un.S_addr != si_other.sin_addr.S_un.S_addr){
 				return -1;
-			} else if((((Header_t*)buf)->flags & PF_DENY) == PF_DENY){
+			}
+			if(conn->use_relay && (numbytes = relay_unwrap(buf, numbytes, NULL)) == -1){
+				continue;
+			}
+			
+			//acks that do not authenticate or answer a different request are ignored
+			if(conn->crypt.enabled){
+				int plain = pkt_open(&(conn->crypt.base), NULL, CRYPT_DIR_HOST, buf, PACKET_HEAD_LEN, numbytes);
+				if(plain == -1){
+					rec_write(&(conn->rec), REC_DROP, &si_other, buf, numbytes);
+					continue;
+				}
+				numbytes = plain;
+			}
+			rec_write(&(conn->rec), REC_IN, &si_other, buf, numbytes);
+			
+			//acks for another game on the same server are ignored
+			if(((Header_t*)buf)->session_id != conn->session_id){
+				continue;
+			}
+			if((((Header_t*)buf)->flags & PF_DENY) == PF_DENY){
 				err_out(&(conn->err), "Unable to join game at this time\n");
 				return -1;
+			} else if((((Header_t*)buf)->flags & (PF_JOIN | PF_COOKIE)) == (PF_JOIN | PF_COOKIE)){
+				//the host gives a slot once its cookie comes back, so send it at once (a newer one replaces it)
+				if(numbytes == (int)cookie_answer_len){
+					memcpy(&cookie, buf + PACKET_HEAD_LEN, COOKIE_LEN);
+					last_sent = 0;
+				}
 			} else if((((Header_t*)buf)->flags & (PF_JOIN | PF_ACK)) == (PF_JOIN | PF_ACK)){
+				if(conn->crypt.enabled){
+					unsigned char* host_rand = (unsigned char*)buf + PACKET_HEAD_LEN;
+					if(numbytes != ack_crypt_len || memcmp(host_rand + CRYPT_RAND_LEN, client_rand, CRYPT_RAND_LEN) != 0){
+						continue;
+					}
+					crypt_derive_session(&(conn->crypt), &(conn->crypt.host_sess), client_rand, host_rand);
+				}
 				return ((Header_t*)buf)->player_id;
 			}
 		} else if(WSAGetLastError() != WSAEWOULDBLOCK){
@@ -279,12 +380,14 @@ void* join_recv(void* input){
 	struct sockaddr_in si_other;
 	int slen = sizeof(si_other);
 	int numbytes;
+	unsigned long long arrive_ns;
 	unsigned long last_recv = 0;
 	
 	//thread stuff
 	Recv_Thread_t rt[MAX_BACKLOG];
 	for(int i=0; i<MAX_BACKLOG; i++){
 		rt[i].use_handler = 0;
+		rt[i].t_handler = -1;
 		pthread_mutex_init(&(rt[i].use_lock), NULL);
 	}
 	
@@ -293,27 +396,51 @@ void* join_recv(void* input){
 		pthread_exit(NULL);
 	}
 	
+	//this thread and its handler threads are placed by the recv thread settings
+	pthread_attr_t handler_attr;
+	tc_apply(&(conn->threads), THREAD_RECV);
+	tc_attr(&(conn->threads), THREAD_RECV, &handler_attr);
+	
+	trace_thread("recv");
 	while(1){
 		memset(buf, '\0', MAX_PACKET_LEN);
 		//non blocking call to receive UDP data
-		if((numbytes = recvfrom(conn->s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+		unsigned long long trace_ns = TRACE_NOW();
+		if((numbytes = rs_recvfrom(&(conn->stamp), conn->s, buf, MAX_PACKET_LEN, &si_other, &slen, &arrive_ns)) != SOCKET_ERROR){
+			//time the datagram sat in the socket buffer (only known with network stack timestamps)
+			unsigned long long recv_ns = get_mono_ns();
+			if(conn->stamp.source == RS_KERNEL){
+				pthread_mutex_lock(&(conn->lat_lock));
+				lh_record(&(conn->kernel_lat), (recv_ns > arrive_ns) ? recv_ns - arrive_ns : 0);
+				pthread_mutex_unlock(&(conn->lat_lock));
+			}
 			last_recv = get_timestamp();
+			//datagrams through a relay end with its trailer (too short ones leave -1 and are not handled)
+			if(conn->use_relay){
+				numbytes = relay_unwrap(buf, numbytes, NULL);
+			}
+			
 			//action after receiving data (find an open thread)
 			int i;
-			for(i=0; i<MAX_BACKLOG; i++){
+			for(i=0; i<MAX_BACKLOG && numbytes != -1; i++){
 				pthread_mutex_lock(&(rt[i].use_lock));
 				if(!rt[i].use_handler){
 					rt[i].use_handler = 1;
 					pthread_mutex_unlock(&(rt[i].use_lock));
 					
+					//the slot's last handler has let it go, so it is at its exit (join it before reusing the slot)
+					recv_handler_join(&(rt[i]));
+					
 					//fill the info struct
 					rt[i].conn = conn;
+					rt[i].arrive_ns = arrive_ns;
+					rt[i].recv_ns = recv_ns;
 					rt[i].numbytes = numbytes;
 					memcpy(rt[i].buf, buf, MAX_PACKET_LEN);
 					memcpy(&(rt[i].si_other), &si_other, slen);
 					
 					//set up the thread for packet handling here (it will return on its own)
-					rt[i].t_handler = pthread_create(&(rt[i].handler_thread), NULL, join_pkt_handle_wrap, (void*)(&rt[i]));
+					rt[i].t_handler = pthread_create(&(rt[i].handler_thread), &handler_attr, join_pkt_handle_wrap, (void*)(&rt[i]));
 					break;
 					
 				} else{
@@ -324,6 +451,7 @@ void* join_recv(void* input){
 			if(i == MAX_BACKLOG){
 				err_out(&(conn->err), "Packet not handled. Max backlog exceeded.\n");
 			}
+			TRACE_SPAN("recv", trace_ns, (numbytes >= PACKET_HEAD_LEN) ? ((Header_t*)buf)->packet_num : 0, 0);
 		} else if(WSAGetLastError() != WSAEWOULDBLOCK){
 			err_out(&(conn->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
 			pthread_mutex_lock(&(conn->exit_lock));
@@ -341,6 +469,8 @@ void* join_recv(void* input){
 		pthread_mutex_lock(&(conn->exit_lock));
 		if(conn->exit){
 			pthread_mutex_unlock(&(conn->exit_lock));
+			recv_drain(rt, MAX_BACKLOG);
+			pthread_attr_destroy(&handler_attr);
 			pthread_exit(NULL);
 		} else{
 			pthread_mutex_unlock(&(conn->exit_lock));
@@ -354,10 +484,25 @@ void* join_recv(void* input){
  */
 void* join_pkt_handle_wrap(void* input){
 	Recv_Thread_t* rt_in = (Recv_Thread_t*) input;
+	Conn_Info_t* conn = rt_in->conn;
+	
+	//handlers are placed like the recv thread, then time the wait for one to run and the handling itself
+	tc_apply(&(conn->threads), THREAD_RECV);
+	unsigned long long start_ns = get_mono_ns();
+	unsigned int trace_pkt = (rt_in->numbytes >= PACKET_HEAD_LEN) ? ((Header_t*)rt_in->buf)->packet_num : 0;
+	trace_thread("handler");
+	TRACE_SPAN("dispatch", (TRACE_NOW() != 0) ? rt_in->recv_ns : 0, trace_pkt, 0);
+	
 	//if the input is null then cannot free the space up and want error to be thrown
 	if(join_pkt_handle(rt_in->conn, rt_in->numbytes, rt_in->buf, &(rt_in->si_other)) == -1){
 		err_out(&(rt_in->conn->err), "Packet handled incorrectly\n");
 	}
+	unsigned long long end_ns = get_mono_ns();
+	TRACE_SPAN("handle", (TRACE_NOW() != 0) ? start_ns : 0, trace_pkt, 0);
+	pthread_mutex_lock(&(conn->lat_lock));
+	lh_record(&(conn->wake_lat), start_ns - rt_in->recv_ns);
+	lh_record(&(conn->handle_lat), end_ns - start_ns);
+	pthread_mutex_unlock(&(conn->lat_lock));
 	pthread_mutex_lock(&(rt_in->use_lock));
 	rt_in->use_handler = 0;
 	pthread_mutex_unlock(&(rt_in->use_lock));
@@ -366,8 +511,8 @@ void* join_pkt_handle_wrap(void* input){
 
 /*	join_pkt_handle:
  * 		Incoming packet handler for the join recv thread.
- * 		Determines the type of packet, confirms the server's address, and performs necessary operations for the pkt.
- * 		This function can also send an ACK for quit requests
+ * 		Confirms the server's address, authenticates and records the packet, then handles the message it holds
+ * 		(or each message of a multi packet) with join_msg_handle.
  *	returns: 0 for sucess, -1 for error
  */
 int join_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other){
@@ -375,33 +520,69 @@ int join_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 	if(buf == NULL || si_other == NULL){
 		return -1;
 	}
-	//check that the source matches the server address and player num matches our number
-	if(conn->server.sin_addr.S_un.S_addr != si_other->sin_addr.S_un.S_addr || conn->self_player_num != buf[1]){
+	//check that the source matches the server address and player num and session match ours
+	if(conn->server.sin_addr.S_un.S_addr != si_other->sin_addr.S_un.S_addr || conn->self_player_num != buf[1]
+			|| ((Header_t*)buf)->session_id != conn->session_id){
 		return -1;
 	}
 	
+	//drop anything that does not authenticate (bytes becomes the plain length, replayed packets are already plain)
+	int plain = bytes;
+	if(conn->crypt.enabled && !conn->replay){
+		plain = pkt_open(&(conn->crypt.host_sess.key), &(conn->crypt.host_sess), CRYPT_DIR_HOST, buf, PACKET_HEAD_LEN, bytes);
+	}
+	if(plain == -1){
+		rec_write(&(conn->rec), REC_DROP, si_other, buf, bytes);
+		return -1;
+	}
+	bytes = plain;
+	rec_write(&(conn->rec), REC_IN, si_other, buf, bytes);
+	
+	//a multi packet is handled one message at a time, as if each had come alone
+	if((((Header_t*)buf)->flags & PF_MULTI) == PF_MULTI){
+		char message[MAX_PACKET_LEN];
+		int offset = 0, len, ret = 0;
+		while((len = pb_next(buf, bytes, &offset, message)) > 0){
+			if(join_msg_handle(conn, len, message) != 0){
+				ret = -1;
+			}
+		}
+		return (len == -1) ? -1 : ret;
+	}
+	return join_msg_handle(conn, bytes, buf);
+}
+
+/*	join_msg_handle:
+ * 		Handles one plain message from the host (a whole packet, or one message of a multi packet).
+ * 		Determines the type of message and performs necessary operations for it.
+ * 		This function can also send an ACK for quit requests
+ *	returns: 0 for success, -1 for error (or the send error code of a quit ack)
+ */
+int join_msg_handle(Conn_Info_t* conn, int bytes, char* buf){
 	//check that it is a disp or quit packet because don't know any others
 	if((((Header_t*)buf)->flags & PF_DISP) == PF_DISP){
 		//check for proper disp packet size
 		if(bytes != disp_packet_len){
 			return -1;
 		}
+		rc_echo_record(&(conn->echo), ((Disp_Packet_t*)buf)->seq, ((Disp_Packet_t*)buf)->send_us, get_mono_ns() / 1000);
 		
+		//this join's own position is the one its input thread moves (the host only echoes it back later), so
+		//it is left as it is instead of snapping back to the echo
+		unsigned long long trace_ns = TRACE_NOW();
 		for(int i=0; i<MAX_PLAYER; i++){
 			char bit = 0x01;
 			if((((Disp_Packet_t*)buf)->in_use & (bit << i)) == (bit << i)){
-				pthread_mutex_lock(&(conn->players[i].lock));
-				conn->players[i].in_use = 1;
-				conn->players[i].px_loc = ((Disp_Packet_t*)buf)->px_loc[i];
-				conn->players[i].py_loc = ((Disp_Packet_t*)buf)->py_loc[i];
-				pthread_mutex_unlock(&(conn->players[i].lock));
+				if(i != conn->self_player_num){
+					ps_post(&(conn->store.pos[i]), ((Disp_Packet_t*)buf)->px_loc[i], ((Disp_Packet_t*)buf)->py_loc[i]);
+				}
+				conn->store.in_use[i] = 1;
 			}
 			else{
-				pthread_mutex_lock(&(conn->players[i].lock));
-				conn->players[i].in_use = 0;
-				pthread_mutex_unlock(&(conn->players[i].lock));
+				conn->store.in_use[i] = 0;
 			}
 		}
+		TRACE_SPAN("state update", trace_ns, ((Header_t*)buf)->packet_num, 0);
 		
 	} else if((((Header_t*)buf)->flags & PF_QUIT) == PF_QUIT){
 		//check for proper quit request packet size
@@ -411,13 +592,12 @@ int join_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in*
 		
 		//send the quit ack if this is not the ack
 		if((((Header_t*)buf)->flags & PF_ACK) != PF_ACK){
-			char message[PACKET_HEAD_LEN];
+			char message[MAX_PACKET_LEN];
 			((Header_t*)message)->flags = PF_QUIT | PF_ACK;
 			((Header_t*)message)->player_id = conn->self_player_num;
 			((Header_t*)message)->packet_num = ((Header_t*)buf)->packet_num;
 			((Header_t*)message)->timestamp = get_timestamp();
-			if(sendto(conn->s, message, PACKET_HEAD_LEN, 0, (struct sockaddr*)&(conn->server), sizeof(conn->server)) == SOCKET_ERROR){
-				err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+			if(join_sendto(conn, message, PACKET_HEAD_LEN) == -1){
 				return WSAGetLastError();
 			}
 			log_out(&(conn->log), "Host has ended the game\n");
@@ -453,33 +633,17 @@ void* join_send(void* input){
 		delete(message);
 		pthread_exit(NULL);
 	}
+	tc_apply(&(conn->threads), THREAD_SEND);
+	trace_thread("send");
 	
 	while(1){
 		//build and send keys message if the max fps timer passed
 		if(last_sent + max_client_time < get_timestamp()){
 			last_sent = get_timestamp();
-			//only send if pause bit is not set
-			pthread_mutex_lock(&(conn->send_p_lock));
-			if(!(conn->send_p)){
-				pthread_mutex_unlock(&(conn->send_p_lock));
-				if(join_build_keys_message(conn, message) == -1){
-					err_out(&(conn->err), "Error Building Keys Message\n");
-					pthread_mutex_lock(&(conn->exit_lock));
-					conn->exit = 1;
-					pthread_mutex_unlock(&(conn->exit_lock));
-				} else{
-					//send message to the server
-					((Keys_Packet_t*)message)->head.timestamp = get_timestamp();
-					if(sendto(conn->s, message, keys_packet_len, 0, (struct sockaddr*)&(conn->server), sizeof(conn->server)) == SOCKET_ERROR){
-						err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
-						pthread_mutex_lock(&(conn->exit_lock));
-						conn->exit = 1;
-						pthread_mutex_unlock(&(conn->exit_lock));
-					}
-					(conn->pkt_num)++;
-				}
-			} else{
-				pthread_mutex_unlock(&(conn->send_p_lock));
+			if(join_send_keys(conn, message) == -1){
+				pthread_mutex_lock(&(conn->exit_lock));
+				conn->exit = 1;
+				pthread_mutex_unlock(&(conn->exit_lock));
 			}
 		
 			//exit checking only performed once per frame like the sending
@@ -495,6 +659,156 @@ void* join_send(void* input){
 	}
 }
 
+/*	join_send_keys:
+ * 		Builds and sends one keys message unless sending is paused.
+ * 		Shared by the send thread tick and the urgent input path (the keys lock keeps their packet numbers
+ * 		and sealed sends in order), and times the oldest input change the packet carries.
+ * 		message is a MAX_PACKET_LEN buffer, NULL uses one on the stack.
+ *	returns: 0 for success (or paused), -1 for error
+ */
+int join_send_keys(Conn_Info_t* conn, char* message){
+	char buf[MAX_PACKET_LEN];
+	if(conn == NULL){
+		return -1;
+	}
+	if(message == NULL){
+		message = buf;
+	}
+	
+	//only send if pause bit is not set
+	pthread_mutex_lock(&(conn->send_p_lock));
+	int paused = conn->send_p;
+	pthread_mutex_unlock(&(conn->send_p_lock));
+	if(paused){
+		return 0;
+	}
+	
+	pthread_mutex_lock(&(conn->keys_lock));
+	unsigned long long input = conn->input_ns.exchange(0);
+	unsigned long long trace_ns = TRACE_NOW();
+	if(join_build_keys_message(conn, message) == -1){
+		pthread_mutex_unlock(&(conn->keys_lock));
+		err_out(&(conn->err), "Error Building Keys Message\n");
+		return -1;
+	}
+	TRACE_SPAN("keys build", trace_ns, ((Header_t*)message)->packet_num, 0);
+	
+	//send message to the server
+	((Keys_Packet_t*)message)->head.timestamp = get_timestamp();
+	if(join_sendto(conn, message, keys_packet_len) == -1){
+		pthread_mutex_unlock(&(conn->keys_lock));
+		return -1;
+	}
+	(conn->pkt_num)++;
+	if(input != 0){
+		lh_record(&(conn->input_lat), get_mono_ns() - input);
+	}
+	pthread_mutex_unlock(&(conn->keys_lock));
+	return 0;
+}
+
+/*	join_send_now:
+ * 		Urgent send path for input changes (run by the input sample thread outside the send tick).
+ *	returns: 0 for success, -1 for error
+ */
+int join_send_now(Conn_Info_t* conn){
+	return join_send_keys(conn, NULL);
+}
+
+/*	join_init_state:
+ * 		Sets up the player slots and locks of a joining player.
+ * 		Called by init_join once the socket is bound (and by the replay tool, which has no socket).
+ *	returns: 0 for success, -1 for error
+ */
+int join_init_state(Conn_Info_t* conn){
+	if(conn == NULL){
+		return -1;
+	}
+	
+	//initialize the conn info player values
+	for(int i=0; i<MAX_PLAYER; i++){
+		ps_post(&(conn->store.pos[i]), 0.0, 0.0);
+		conn->store.in_use[i] = 0;
+		memset((char*)&(conn->players[i].p_addr), 0, sizeof(conn->players[i].p_addr));
+	}
+	conn->self_x_loc = 0.0;
+	conn->self_y_loc = 0.0;
+	conn->exit = 0;
+	conn->send_p = 0;
+	conn->pkt_num = 0;
+	
+	//initialize mutex states
+	for(int i=0; i<MAX_PLAYER; i++){
+		pthread_mutex_init(&(conn->players[i].lock), NULL);
+	}
+	pthread_mutex_init(&(conn->exit_lock), NULL);
+	pthread_mutex_init(&(conn->send_p_lock), NULL);
+	pthread_mutex_init(&(conn->keys_lock), NULL);
+	conn->input_ns = 0;
+	lh_init(&(conn->input_lat));
+	pthread_mutex_init(&(conn->lat_lock), NULL);
+	lh_init(&(conn->kernel_lat));
+	lh_init(&(conn->wake_lat));
+	lh_init(&(conn->handle_lat));
+	lh_init(&(conn->send_lat));
+	rc_echo_init(&(conn->echo));
+	ecs_init(&(conn->world));
+	pthread_mutex_init(&(conn->world_lock), NULL);
+	memset((char*)conn->player_ents, 0, sizeof(conn->player_ents));
+	ecs_query_init(&(conn->player_query), ECS_BIT(ECS_POS) | ECS_BIT(ECS_PLAYER), 0);
+	if(conn->crypt.enabled){
+		log_out(&(conn->log), std::string("Packet encryption enabled (") + (crypt_init() ? "AES-NI" : "portable AES") + ")\n");
+	}
+	return 0;
+}
+
+/*	join_sendto:
+ * 		Sends a packet to the host, sealing it first when encryption is on (join requests with the
+ * 		pre-shared key, everything after the handshake with the session).
+ * 		Every packet is stamped with the session id of the game being joined.
+ * 		The message buffer needs room for CRYPT_OVERHEAD (and the relay trailer) bytes past len.
+ *	returns: 0 for success, -1 for error
+ */
+int join_sendto(Conn_Info_t* conn, char* message, int len){
+	if(conn == NULL || message == NULL){
+		return -1;
+	}
+	((Header_t*)message)->session_id = conn->session_id;
+	rec_write(&(conn->rec), REC_OUT, &(conn->server), message, len);
+	
+	//replays run the handlers without a socket
+	if(conn->replay){
+		return 0;
+	}
+	unsigned int trace_pkt = ((Header_t*)message)->packet_num;
+	unsigned long long trace_ns = TRACE_NOW();
+	if(conn->crypt.enabled){
+		if((((Header_t*)message)->flags & PF_JOIN) == PF_JOIN){
+			len = pkt_seal(&(conn->crypt.base), NULL, CRYPT_DIR_JOIN, message, PACKET_HEAD_LEN, len);
+		} else{
+			len = pkt_seal(&(conn->crypt.host_sess.key), &(conn->crypt.host_sess), CRYPT_DIR_JOIN, message, PACKET_HEAD_LEN, len);
+		}
+		if(len == -1){
+			err_out(&(conn->err), "Packet Seal Failed\n");
+			return -1;
+		}
+	}
+	
+	//through a relay the trailer names the host's token
+	if(conn->use_relay){
+		len = relay_wrap(message, len, conn->relay_token, NULL, RELAY_DATA);
+	}
+	TRACE_SPAN("encode", trace_ns, trace_pkt, 0);
+	
+	trace_ns = TRACE_NOW();
+	if(sendto(conn->s, message, len, 0, (struct sockaddr*)&(conn->server), sizeof(conn->server)) == SOCKET_ERROR){
+		err_out(&(conn->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		return -1;
+	}
+	TRACE_SPAN("send", trace_ns, trace_pkt, 0);
+	return 0;
+}
+
 /*	join_build_keys_message:
  * 		Builds the keys message to be sent by the join send thread
  *		Uses the self player info to fill the packet buffer
@@ -514,5 +828,9 @@ int join_build_keys_message(Conn_Info_t* conn, char* message){
 	((Keys_Packet_t*)message)->px_loc = conn->self_x_loc;
 	((Keys_Packet_t*)message)->py_loc = conn->self_y_loc;
 	pthread_mutex_unlock(&(conn->players[(int)(conn->self_player_num)].lock));
+	
+	//echo the newest disp packet so the host can measure rtt and loss (left zero until one arrives)
+	Keys_Packet_t* keys = (Keys_Packet_t*)message;
+	rc_echo_get(&(conn->echo), get_mono_ns() / 1000, &(keys->echo_seq), &(keys->echo_us), &(keys->echo_hold), &(keys->recv_count));
 	return 0;
 }
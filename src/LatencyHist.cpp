@@ -0,0 +1,92 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "inc/LatencyHist.h"
+
+//bucket of a value: its top bit picks the power of two, the next LH_SUB_BITS bits the bucket inside it
+static int lh_bucket(unsigned long long ns){
+	if(ns < LH_SUB){
+		return (int)ns;
+	}
+	int top = 63 - __builtin_clzll(ns);
+	int shift = top - LH_SUB_BITS;
+	return ((shift + 1) << LH_SUB_BITS) + (int)((ns >> shift) & (LH_SUB - 1));
+}
+
+//middle of a bucket's range
+static unsigned long long lh_value(int bucket){
+	if(bucket < LH_SUB){
+		return (unsigned long long)bucket;
+	}
+	int shift = (bucket >> LH_SUB_BITS) - 1;
+	unsigned long long low = ((unsigned long long)(LH_SUB | (bucket & (LH_SUB - 1)))) << shift;
+	return low + ((1ULL << shift) >> 1);
+}
+
+/*	lh_init:
+ * 		Empties a histogram.
+ */
+void lh_init(Latency_Hist_t* h){
+	memset((char*)h, 0, sizeof(*h));
+}
+
+/*	lh_record:
+ * 		Counts one latency sample.
+ */
+void lh_record(Latency_Hist_t* h, unsigned long long ns){
+	(h->counts[lh_bucket(ns)])++;
+	(h->total)++;
+	h->sum_ns += ns;
+	if(ns > h->max_ns){
+		h->max_ns = ns;
+	}
+}
+
+/*	lh_merge:
+ * 		Adds the samples of one histogram to another (e.g. per thread histograms into a report).
+ */
+void lh_merge(Latency_Hist_t* dst, const Latency_Hist_t* src){
+	for(int i=0; i<LH_BUCKETS; i++){
+		dst->counts[i] += src->counts[i];
+	}
+	dst->total += src->total;
+	dst->sum_ns += src->sum_ns;
+	if(src->max_ns > dst->max_ns){
+		dst->max_ns = src->max_ns;
+	}
+}
+
+/*	lh_percentile:
+ * 		Finds the latency pct percent of the samples are at or under (within a bucket width).
+ *	returns: the latency in ns, 0 when there are no samples
+ */
+unsigned long long lh_percentile(const Latency_Hist_t* h, double pct){
+	if(h->total == 0){
+		return 0;
+	}
+	unsigned long long rank = (unsigned long long)((pct / 100.0) * (double)h->total);
+	if(rank >= h->total){
+		return h->max_ns;
+	}
+	unsigned long long seen = 0;
+	for(int i=0; i<LH_BUCKETS; i++){
+		seen += h->counts[i];
+		if(seen > rank){
+			unsigned long long v = lh_value(i);
+			return v > h->max_ns ? h->max_ns : v;
+		}
+	}
+	return h->max_ns;
+}
+
+/*	lh_summary:
+ * 		One line report of a histogram for the logs and tools.
+ *	returns: the percentiles in us with the sample count
+ */
+std::string lh_summary(const Latency_Hist_t* h){
+	char line[160];
+	snprintf(line, sizeof(line), "p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us (%llu samples)",
+			lh_percentile(h, 50.0) / 1000.0, lh_percentile(h, 90.0) / 1000.0, lh_percentile(h, 99.0) / 1000.0,
+			h->max_ns / 1000.0, h->total);
+	return std::string(line);
+}
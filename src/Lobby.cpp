@@ -0,0 +1,548 @@
+#include <time.h>
+
+#include "inc/Lobby.h"
+
+/*	li_key:
+ * 		Packs a game's address, port (both in network order) and session id into one key.
+ *	returns: the key (0 for the unusable 0.0.0.0:0 address)
+ */
+static unsigned long long li_key(unsigned int addr, unsigned short port, unsigned short session_id){
+	return ((unsigned long long)addr << 32) | ((unsigned long long)port << 16) | (unsigned long long)session_id;
+}
+
+/*	li_hash:
+ * 		Mixes the key bits so neighbouring addresses, ports and ids spread across shards and table slots
+ * 		(the upper half picks the shard, the lower half the home slot in it).
+ *	returns: the mixed key
+ */
+static unsigned long long li_hash(unsigned long long key){
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/*	li_find_slot:
+ * 		Looks the key up in the shard's table. The caller must hold the shard lock.
+ *	returns: table index holding the key, -1 if the game is not listed
+ */
+static int li_find_slot(Lobby_Shard_t* shard, unsigned long long key){
+	unsigned idx = (unsigned)li_hash(key) & shard->mask;
+	for(unsigned probe=0; probe<=shard->mask; probe++){
+		if(shard->keys[idx] == LOBBY_KEY_EMPTY){
+			return -1;
+		}
+		if(shard->keys[idx] == key){
+			return (int)idx;
+		}
+		idx = (idx + 1) & shard->mask;
+	}
+	return -1;
+}
+
+/*	li_free_entry:
+ * 		Drops a game from its shard: deletes its table slot (shifting the rest of the probe chain back to
+ * 		fill the hole, as pt_remove does), takes it off the live list and the wheel and frees the entry.
+ * 		The caller must hold the shard lock.
+ */
+static void li_free_entry(Lobby_Shard_t* shard, int slot){
+	int e = shard->slots[slot];
+	Lobby_Entry_t* entry = &(shard->entries[e]);
+	
+	unsigned hole = (unsigned)slot;
+	unsigned next = (hole + 1) & shard->mask;
+	while(shard->keys[next] != LOBBY_KEY_EMPTY){
+		//an entry can fill the hole if its home is not cyclically within (hole, next]
+		unsigned home = (unsigned)li_hash(shard->keys[next]) & shard->mask;
+		if(((next - home) & shard->mask) >= ((next - hole) & shard->mask)){
+			shard->keys[hole] = shard->keys[next];
+			shard->slots[hole] = shard->slots[next];
+			hole = next;
+		}
+		next = (next + 1) & shard->mask;
+	}
+	shard->keys[hole] = LOBBY_KEY_EMPTY;
+	shard->slots[hole] = -1;
+	
+	//swap the last live entry into its place so queries walk a dense list
+	int last = shard->live[shard->live_count - 1];
+	shard->live[entry->live_pos] = last;
+	shard->entries[last].live_pos = entry->live_pos;
+	(shard->live_count)--;
+	entry->live_pos = -1;
+	
+	tw_cancel(&(shard->wheel), &(entry->ttl_timer));
+	entry->key = LOBBY_KEY_EMPTY;
+	shard->free_list[(shard->free_count)++] = e;
+}
+
+/*	li_ttl_timer:
+ * 		Ttl timer callback (one per game) run by li_expire with the shard lock held.
+ * 		Heartbeats only refresh last_seen, so when this fires it either pushes the deadline out to match
+ * 		the latest heartbeat or drops a game whose host has gone silent.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+static void li_ttl_timer(void* input){
+	Lobby_Entry_t* entry = (Lobby_Entry_t*) input;
+	Lobby_Shard_t* shard = entry->shard;
+	
+	if(entry->last_seen + shard->ttl > shard->now){
+		tw_add(&(shard->wheel), &(entry->ttl_timer), entry->last_seen + shard->ttl);
+		return;
+	}
+	int slot = li_find_slot(shard, entry->key);
+	if(slot != -1){
+		li_free_entry(shard, slot);
+	}
+}
+
+/*	li_init:
+ * 		Sets up an empty game index. Each shard holds a quarter more than its even share of max_games so an
+ * 		uneven spread of keys does not turn games away early, and its table is kept at most half full.
+ *	returns: 0 on success, -1 on error
+ */
+int li_init(Lobby_Index_t* li, unsigned max_games, unsigned long long ttl_ms){
+	if(li == NULL || max_games == 0 || ttl_ms == 0){
+		return -1;
+	}
+	
+	unsigned cap = (max_games + LOBBY_SHARDS - 1) / LOBBY_SHARDS;
+	cap += (cap / 4) + 1;
+	unsigned size = 16;
+	while(size < (cap * 2)){
+		size <<= 1;
+	}
+	unsigned long long now = get_mono_ms();
+	for(int i=0; i<LOBBY_SHARDS; i++){
+		Lobby_Shard_t* shard = &(li->shards[i]);
+		pthread_mutex_init(&(shard->lock), NULL);
+		shard->now = now;
+		shard->mask = size - 1;
+		shard->keys = new unsigned long long[size];
+		shard->slots = new int[size];
+		for(unsigned j=0; j<size; j++){
+			shard->keys[j] = LOBBY_KEY_EMPTY;
+			shard->slots[j] = -1;
+		}
+		shard->cap = cap;
+		shard->entries = new Lobby_Entry_t[cap];
+		shard->free_list = new int[cap];
+		shard->live = new int[cap];
+		for(unsigned j=0; j<cap; j++){
+			shard->entries[j].shard = shard;
+			shard->entries[j].key = LOBBY_KEY_EMPTY;
+			shard->entries[j].live_pos = -1;
+			timer_init(&(shard->entries[j].ttl_timer), li_ttl_timer, (void*)&(shard->entries[j]));
+			//hand out low entries first
+			shard->free_list[j] = cap - 1 - j;
+		}
+		shard->free_count = cap;
+		shard->live_count = 0;
+		shard->ttl = ttl_ms;
+		tw_init(&(shard->wheel), now);
+	}
+	li->cursor = 0;
+	return 0;
+}
+
+/*	li_destroy:
+ * 		Frees the index storage.
+ */
+void li_destroy(Lobby_Index_t* li){
+	if(li == NULL){
+		return;
+	}
+	for(int i=0; i<LOBBY_SHARDS; i++){
+		Lobby_Shard_t* shard = &(li->shards[i]);
+		if(shard->keys == NULL){
+			continue;
+		}
+		tw_destroy(&(shard->wheel));
+		delete[] shard->keys;
+		delete[] shard->slots;
+		delete[] shard->entries;
+		delete[] shard->free_list;
+		delete[] shard->live;
+		shard->keys = NULL;
+		pthread_mutex_destroy(&(shard->lock));
+	}
+}
+
+/*	li_register:
+ * 		Adds a game or refreshes a listed one (player count, name and last_seen) on a host heartbeat.
+ *	returns: 1 for a new game, 0 for a refresh, -1 on error or when the game's shard is full
+ */
+int li_register(Lobby_Index_t* li, const Lobby_Game_Info_t* info, unsigned long long now){
+	if(li == NULL || info == NULL){
+		return -1;
+	}
+	unsigned long long key = li_key(info->addr, info->port, info->session_id);
+	if(key == LOBBY_KEY_EMPTY){
+		return -1;
+	}
+	
+	Lobby_Shard_t* shard = &(li->shards[(unsigned)(li_hash(key) >> 32) % LOBBY_SHARDS]);
+	pthread_mutex_lock(&(shard->lock));
+	int slot = li_find_slot(shard, key);
+	if(slot != -1){
+		Lobby_Entry_t* entry = &(shard->entries[shard->slots[slot]]);
+		entry->info = *info;
+		entry->info.name[LOBBY_NAME_LEN - 1] = '\0';
+		if(now > entry->last_seen){
+			entry->last_seen = now;
+		}
+		pthread_mutex_unlock(&(shard->lock));
+		return 0;
+	}
+	if(shard->free_count == 0){
+		pthread_mutex_unlock(&(shard->lock));
+		return -1;
+	}
+	
+	int e = shard->free_list[--(shard->free_count)];
+	Lobby_Entry_t* entry = &(shard->entries[e]);
+	entry->key = key;
+	entry->info = *info;
+	entry->info.name[LOBBY_NAME_LEN - 1] = '\0';
+	entry->last_seen = now;
+	entry->live_pos = shard->live_count;
+	shard->live[(shard->live_count)++] = e;
+	unsigned idx = (unsigned)li_hash(key) & shard->mask;
+	while(shard->keys[idx] != LOBBY_KEY_EMPTY){
+		idx = (idx + 1) & shard->mask;
+	}
+	shard->keys[idx] = key;
+	shard->slots[idx] = e;
+	tw_add(&(shard->wheel), &(entry->ttl_timer), now + shard->ttl);
+	pthread_mutex_unlock(&(shard->lock));
+	return 1;
+}
+
+/*	li_remove:
+ * 		Drops a game its host has closed.
+ *	returns: 0 for success, -1 if the game was not listed
+ */
+int li_remove(Lobby_Index_t* li, unsigned int addr, unsigned short port, unsigned short session_id){
+	if(li == NULL){
+		return -1;
+	}
+	unsigned long long key = li_key(addr, port, session_id);
+	
+	Lobby_Shard_t* shard = &(li->shards[(unsigned)(li_hash(key) >> 32) % LOBBY_SHARDS]);
+	pthread_mutex_lock(&(shard->lock));
+	int slot = li_find_slot(shard, key);
+	if(slot != -1){
+		li_free_entry(shard, slot);
+	}
+	pthread_mutex_unlock(&(shard->lock));
+	return (slot != -1) ? 0 : -1;
+}
+
+/*	li_query:
+ * 		Copies out up to max games with room for another player. Each query starts at a different shard
+ * 		and live list position so joins asking at once are spread over the open games.
+ *	returns: number of games copied, -1 on error
+ */
+int li_query(Lobby_Index_t* li, Lobby_Game_Info_t* out, int max){
+	if(li == NULL || out == NULL || max < 0){
+		return -1;
+	}
+	
+	unsigned start = li->cursor.fetch_add(1, std::memory_order_relaxed);
+	int count = 0;
+	for(int i=0; i<LOBBY_SHARDS && count<max; i++){
+		Lobby_Shard_t* shard = &(li->shards[(start + i) % LOBBY_SHARDS]);
+		pthread_mutex_lock(&(shard->lock));
+		int n = shard->live_count;
+		for(int j=0; j<n && count<max; j++){
+			Lobby_Game_Info_t* info = &(shard->entries[shard->live[(start + j) % n]].info);
+			if(info->players < info->max_players){
+				out[count++] = *info;
+			}
+		}
+		pthread_mutex_unlock(&(shard->lock));
+	}
+	return count;
+}
+
+/*	li_count:
+ * 		Counts the listed games.
+ *	returns: number of games, -1 on error
+ */
+int li_count(Lobby_Index_t* li){
+	if(li == NULL){
+		return -1;
+	}
+	int count = 0;
+	for(int i=0; i<LOBBY_SHARDS; i++){
+		pthread_mutex_lock(&(li->shards[i].lock));
+		count += li->shards[i].live_count;
+		pthread_mutex_unlock(&(li->shards[i].lock));
+	}
+	return count;
+}
+
+/*	li_expire:
+ * 		Turns every shard's wheel up to now, dropping the games not heard from within the ttl.
+ * 		The ttl timers run with their shard locked, one shard at a time.
+ */
+void li_expire(Lobby_Index_t* li, unsigned long long now){
+	if(li == NULL){
+		return;
+	}
+	for(int i=0; i<LOBBY_SHARDS; i++){
+		Lobby_Shard_t* shard = &(li->shards[i]);
+		pthread_mutex_lock(&(shard->lock));
+		shard->now = now;
+		tw_advance(&(shard->wheel), now);
+		pthread_mutex_unlock(&(shard->lock));
+	}
+}
+
+// ##################################################################### Server Functions
+
+/*	lobby_init:
+ * 		Opens and binds the lobby's UDP socket, sets up the game index and starts the handler threads
+ * 		(all reading the one socket) and the expiry thread.
+ *	returns: 0 on success, other on error
+ */
+int lobby_init(Lobby_Server_t* ls, unsigned short port, int n_threads, unsigned max_games, unsigned long long ttl_ms){
+	//null check
+	if(ls == NULL || n_threads < 1 || max_games == 0){
+		return -1;
+	}
+	
+	//open the non-blocking UDP socket on the port
+	int ret = udp_bind(&(ls->wsa), &(ls->s), &(ls->server), port, &(ls->err));
+	if(ret != 0){
+		return ret;
+	}
+	
+	if(li_init(&(ls->idx), max_games, ttl_ms) == -1){
+		err_out(&(ls->err), "Game Index Not Created\n");
+		return -1;
+	}
+	ls->registers = 0;
+	ls->removes = 0;
+	ls->queries = 0;
+	ls->bad = 0;
+	ls->exit = 0;
+	
+	ls->n_threads = n_threads;
+	ls->threads = new pthread_t[n_threads];
+	for(int i=0; i<n_threads; i++){
+		pthread_create(&(ls->threads[i]), NULL, lobby_recv, (void*)ls);
+	}
+	pthread_create(&(ls->expire_thread), NULL, lobby_expire, (void*)ls);
+	
+	log_out(&(ls->log), "Lobby listening on port " + std::to_string(port) + " with " + std::to_string(n_threads) + " threads\n");
+	return 0;
+}
+
+/*	lobby_quit:
+ * 		Stops the threads, closes the socket and frees the index.
+ *	returns: 0 for success, -1 for error
+ */
+int lobby_quit(Lobby_Server_t* ls){
+	if(ls == NULL){
+		return -1;
+	}
+	
+	ls->exit = 1;
+	for(int i=0; i<ls->n_threads; i++){
+		if(pthread_join(ls->threads[i], NULL) != 0){
+			err_out(&(ls->err), "Error ending recv thread\n");
+		}
+	}
+	if(pthread_join(ls->expire_thread, NULL) != 0){
+		err_out(&(ls->err), "Error ending expire thread\n");
+	}
+	delete[] ls->threads;
+	
+	closesocket(ls->s);
+	WSACleanup();
+	li_destroy(&(ls->idx));
+	log_out(&(ls->log), "Lobby closed\n");
+	return 0;
+}
+
+/*	lobby_recv:
+ * 		Handler thread function for the lobby (several share the socket, whichever wakes first takes the
+ * 		datagram). Heartbeats and queries are short so each is handled inline.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* lobby_recv(void* input){
+	Lobby_Server_t* ls = (Lobby_Server_t*) input;
+	char buf[MAX_PACKET_LEN];
+	struct sockaddr_in si_other;
+	int slen = sizeof(si_other);
+	int numbytes;
+	
+	//null check
+	if(ls == NULL){
+		pthread_exit(NULL);
+	}
+	
+	while(!ls->exit){
+		//wait up to 10 ms so the exit flag is still seen on a quiet socket
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(ls->s, &ready);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 10000;
+		if(select((int)ls->s + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+			err_out(&(ls->err), "Select Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+			continue;
+		}
+		
+		while((numbytes = recvfrom(ls->s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+			lobby_handle(ls, numbytes, buf, &si_other);
+		}
+		//a join that has gone away resets the next recv on windows, which is not fatal here
+		if(WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAECONNRESET){
+			err_out(&(ls->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+	}
+	pthread_exit(NULL);
+}
+
+/*	lobby_expire:
+ * 		Expiry thread function for the lobby, turns the ttl wheels every LOBBY_EXPIRE_TIME ms.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* lobby_expire(void* input){
+	Lobby_Server_t* ls = (Lobby_Server_t*) input;
+	
+	while(!ls->exit){
+		li_expire(&(ls->idx), get_mono_ms());
+		Sleep(LOBBY_EXPIRE_TIME);
+	}
+	pthread_exit(NULL);
+}
+
+/*	lobby_handle:
+ * 		Handles one lobby datagram. A game is keyed by the address and port the heartbeat came from (so a
+ * 		host behind a nat is listed as joins will reach it) and the session id in its header. Queries
+ * 		shorter than lobby_query_len are dropped, so the answer is never larger than the query.
+ *	returns: 0 for success, -1 for a bad packet
+ */
+int lobby_handle(Lobby_Server_t* ls, int bytes, char* buf, struct sockaddr_in* si_other){
+	if(ls == NULL || buf == NULL || si_other == NULL || bytes < PACKET_HEAD_LEN){
+		if(ls != NULL){
+			(ls->bad)++;
+		}
+		return -1;
+	}
+	Header_t* head = (Header_t*)buf;
+	
+	if(head->flags == LB_REGISTER && bytes >= (int)lobby_register_len){
+		Lobby_Register_Packet_t* reg = (Lobby_Register_Packet_t*)buf;
+		Lobby_Game_Info_t info;
+		info.addr = (unsigned int)si_other->sin_addr.S_un.S_addr;
+		info.port = si_other->sin_port;
+		info.session_id = head->session_id;
+		info.players = reg->players;
+		info.max_players = reg->max_players;
+		memcpy(info.name, reg->name, LOBBY_NAME_LEN);
+		info.name[LOBBY_NAME_LEN - 1] = '\0';
+		if(li_register(&(ls->idx), &info, get_mono_ms()) == -1){
+			(ls->bad)++;
+			return -1;
+		}
+		(ls->registers)++;
+		return 0;
+	} else if(head->flags == LB_REMOVE){
+		li_remove(&(ls->idx), (unsigned int)si_other->sin_addr.S_un.S_addr, si_other->sin_port, head->session_id);
+		(ls->removes)++;
+		return 0;
+	} else if(head->flags == LB_QUERY && bytes >= (int)lobby_query_len){
+		Lobby_List_Packet_t list;
+		int count = li_query(&(ls->idx), list.games, LOBBY_LIST_MAX);
+		list.head.flags = LB_LIST;
+		list.head.player_id = 0;
+		list.head.session_id = 0;
+		list.head.packet_num = head->packet_num;
+		list.head.timestamp = get_timestamp();
+		list.count = (unsigned int)count;
+		int len = (int)(lobby_list_head_len + (count * sizeof(Lobby_Game_Info_t)));
+		if(sendto(ls->s, (char*)&list, len, 0, (struct sockaddr*)si_other, sizeof(*si_other)) == SOCKET_ERROR){
+			err_out(&(ls->err), "Send Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		(ls->queries)++;
+		return 0;
+	}
+	(ls->bad)++;
+	return -1;
+}
+
+// ##################################################################### Host and Join Helpers
+
+/*	lobby_addr:
+ * 		Fills the lobby's socket address from "address" or "address:port" (LOBBY_PORT by default).
+ *	returns: 0 for success, -1 for an improper address
+ */
+int lobby_addr(std::string lobby_host, struct sockaddr_in* addr){
+	return parse_addr(lobby_host, LOBBY_PORT, addr);
+}
+
+/*	lobby_find:
+ * 		Asks the lobby for open games from a throwaway socket (so the join socket's port is untouched),
+ * 		resending the query every REQ_TIMEOUT ms up to LOBBY_TRIES times.
+ *	returns: number of games copied (at most max), -1 on error or no answer
+ */
+int lobby_find(std::string lobby_host, Lobby_Game_Info_t* games, int max){
+	struct sockaddr_in lobby;
+	if(games == NULL || max < 0 || lobby_addr(lobby_host, &lobby) == -1){
+		return -1;
+	}
+	
+	WSADATA wsa;
+	if(WSAStartup(MAKEWORD(2,2), &wsa) != 0){
+		return -1;
+	}
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(s == INVALID_SOCKET){
+		WSACleanup();
+		return -1;
+	}
+	
+	//the query is padded to the size of a full answer or the lobby drops it
+	Lobby_List_Packet_t query;
+	memset((char*)&query, 0, sizeof(query));
+	query.head.flags = LB_QUERY;
+	query.head.packet_num = (int)(get_mono_ns() & 0x7FFFFFFF);
+	query.head.timestamp = get_timestamp();
+	Lobby_List_Packet_t list;
+	int found = -1;
+	for(int tries=0; tries<LOBBY_TRIES && found==-1; tries++){
+		if(sendto(s, (char*)&query, lobby_query_len, 0, (struct sockaddr*)&lobby, sizeof(lobby)) == SOCKET_ERROR){
+			break;
+		}
+		unsigned long long deadline = get_mono_ms() + REQ_TIMEOUT;
+		unsigned long long now;
+		while(found == -1 && (now = get_mono_ms()) < deadline){
+			fd_set ready;
+			FD_ZERO(&ready);
+			FD_SET(s, &ready);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = (long)(deadline - now) * 1000;
+			if(select((int)s + 1, &ready, NULL, NULL, &tv) <= 0){
+				continue;
+			}
+			int bytes = recvfrom(s, (char*)&list, sizeof(list), 0, NULL, NULL);
+			//only the answer to this query counts
+			if(bytes >= (int)lobby_list_head_len && list.head.flags == LB_LIST && list.head.packet_num == query.head.packet_num
+					&& list.count <= LOBBY_LIST_MAX && bytes >= (int)(lobby_list_head_len + list.count * sizeof(Lobby_Game_Info_t))){
+				found = ((int)list.count < max) ? (int)list.count : max;
+				memcpy((char*)games, (char*)list.games, found * sizeof(Lobby_Game_Info_t));
+			}
+		}
+	}
+	closesocket(s);
+	WSACleanup();
+	return found;
+}
@@ -15,82 +15,164 @@
 #include "inc/HostConnect.h"
 #include "inc/JoinConnect.h"
 #include "inc/ConnectStruct.h"
+#include "inc/Lobby.h"
+#include "inc/InputState.h"
+#include "inc/FramePacer.h"
+#include "inc/AssetPack.h"
+#include "inc/SpecWatch.h"
 
 //globals
 Conn_Info_t conn;
 HostConnect hc;
 JoinConnect jc;
-unsigned long last_frame = 0;
+Input_State_t input;
+Frame_Pacer_t pacer;
+unsigned long long last_frame_log = 0;
+Asset_Pack_t assets;
+std::vector<GLuint> atlas;
+const Pack_Anim_t* player_anim = NULL;
+Spec_Watch_t watch;
+int watching = 0;
 
-void processNormKey(unsigned char key, int x, int y){
-	
-	//maybe avoid glut key tracking with "GetAsyncKeyState" in "winuser.h"
-	
-	pthread_mutex_lock(&(conn.players[(int)(conn.self_player_num)].lock));
-	switch(key){
-		case ESC_ASCII:
-			if(hc.get_prev_init()){
-				hc.quit_host(&conn);
-			} else if(jc.get_prev_init()){
-				jc.quit_join(&conn);
-			}
-			//close the files before exit
-			#if ERR
-			conn.err.close();
-			#endif
-			#if LOG
-			conn.log.close();
-			#endif
+//writes the spans traced so far to log/<timestamp>.json (for Perfetto or chrome://tracing)
+void dump_trace(){
+	std::string path = "log/" + std::to_string(get_timestamp()) + ".json";
+	int spans = trace_dump(path);
+	if(spans == -1){
+		err_out(&(conn.err), "Trace Not Written To " + path + "\n");
+	} else{
+		log_out(&(conn.log), "Trace of " + std::to_string(spans) + " spans written to " + path + "\n");
+	}
+}
+
+void processNormKey(unsigned char key, int, int){
+	//only flips the held key state, the input thread turns held keys into movement at a fixed rate
+	unsigned long long now = get_mono_ns();
+	if(key == ESC_ASCII){
+		if(watching){
+			spec_watch_stop(&watch);
+			log_out(&(conn.log), "Watched " + std::to_string(watch.view.frames) + " frames (first after "
+					+ std::to_string(watch.first_ms) + " ms)\n");
+		} else{
+			in_stop(&input);
+		}
+		if(hc.get_prev_init()){
+			hc.quit_host(&conn);
+		} else if(jc.get_prev_init()){
+			jc.quit_join(&conn);
+		}
+		log_out(&(conn.log), fp_report(&pacer));
+		fp_quit(&pacer);
+		if(trace_on){
+			dump_trace();
+		}
+		
+		//close the files before exit
+		#if ERR
+		conn.err.close();
+		#endif
+		#if LOG
+		conn.log.close();
+		#endif
+
+		exit(0);
+	}
+	if(!watching){
+		in_key_down(&input, key, now);
+	}
+}
 
-			exit(0);
-			break;
-		case W_ASCII:
-			conn.players[(int)(conn.self_player_num)].py_loc += 0.05;
-			conn.self_y_loc += 0.05;
-			break;
-		case A_ASCII:
-			conn.players[(int)(conn.self_player_num)].px_loc -= 0.05;
-			conn.self_x_loc -= 0.05;
-			break;
-		case S_ASCII:
-			conn.players[(int)(conn.self_player_num)].py_loc -= 0.05;
-			conn.self_y_loc -= 0.05;
-			break;
-		case D_ASCII:
-			conn.players[(int)(conn.self_player_num)].px_loc += 0.05;
-			conn.self_x_loc += 0.05;
-		default:
-			break;
-	}
-	pthread_mutex_unlock(&(conn.players[(int)(conn.self_player_num)].lock));
+void processKeyUp(unsigned char key, int, int){
+	if(!watching){
+		in_key_up(&input, key, get_mono_ns());
+	}
+}
+
+void processSpecialKey(int key, int, int){
+	//F12 starts tracing, then dumps what has been traced each press after
+	if(key == GLUT_KEY_F12){
+		if(trace_on){
+			dump_trace();
+		} else{
+			trace_enable(1);
+			log_out(&(conn.log), "Tracing started (F12 again to dump)\n");
+		}
+	}
 }
 
 void display(){
-	//only update if max fps timer has passed
-	if(last_frame + max_fps_time < get_timestamp()){
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		for(int i=0; i<MAX_PLAYER; i++){
-			pthread_mutex_lock(&(conn.players[i].lock));
-			if(conn.players[i].in_use){
+	fp_begin(&pacer, get_mono_ns());
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	unsigned int frame = (unsigned int)pacer.frames;
+	unsigned long long trace_ns = TRACE_NOW();
+	ps_gather(conn.store.pos, conn.store.in_use, MAX_PLAYER, x, y, alive);
+	
+	//bring the player entities up to date, then draw every entity the player query matches straight from
+	//its archetype's position column
+	pthread_mutex_lock(&(conn.world_lock));
+	ecs_sync_slots(&(conn.world), conn.player_ents, MAX_PLAYER, x, y, alive);
+	ecs_query_update(&(conn.world), &(conn.player_query));
+	TRACE_SPAN("frame build", trace_ns, 0, frame);
+	trace_ns = TRACE_NOW();
+	
+	//players are sprites of the pack's animation when one is loaded, squares otherwise
+	const Pack_Sprite_t* sprite = ap_frame(&assets, player_anim, get_mono_ms());
+	float half_w = PLAYER_SIZE;
+	if(sprite != NULL){
+		half_w = PLAYER_SIZE * sprite->w / sprite->h;
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, atlas[sprite->page]);
+		glColor3f(1.0, 1.0, 1.0);
+	}
+	for(int m=0; m<conn.player_query.match_count; m++){
+		const Ecs_Archetype_t* a = &(conn.world.archs[conn.player_query.matches[m]]);
+		const Ecs_Pos_t* pos = (const Ecs_Pos_t*)ecs_column(a, ECS_POS);
+		for(int i=0; i<a->count; i++){
+			if(sprite != NULL){
+				glBegin(GL_QUADS);
+					glTexCoord2f(sprite->u0, sprite->v1);
+					glVertex2f((-1*half_w)+pos[i].x, (-1*PLAYER_SIZE)+pos[i].y);
+					glTexCoord2f(sprite->u0, sprite->v0);
+					glVertex2f((-1*half_w)+pos[i].x, PLAYER_SIZE+pos[i].y);
+					glTexCoord2f(sprite->u1, sprite->v0);
+					glVertex2f(half_w+pos[i].x, PLAYER_SIZE+pos[i].y);
+					glTexCoord2f(sprite->u1, sprite->v1);
+					glVertex2f(half_w+pos[i].x, (-1*PLAYER_SIZE)+pos[i].y);
+				glEnd();
+			} else{
 				glBegin(GL_POLYGON);
-					glVertex2f((-1*PLAYER_SIZE)+conn.players[i].px_loc, (-1*PLAYER_SIZE)+conn.players[i].py_loc);
-					glVertex2f((-1*PLAYER_SIZE)+conn.players[i].px_loc, PLAYER_SIZE+conn.players[i].py_loc);
-					glVertex2f(PLAYER_SIZE+conn.players[i].px_loc, PLAYER_SIZE+conn.players[i].py_loc);
-					glVertex2f(PLAYER_SIZE+conn.players[i].px_loc, (-1*PLAYER_SIZE)+conn.players[i].py_loc);
+					glVertex2f((-1*PLAYER_SIZE)+pos[i].x, (-1*PLAYER_SIZE)+pos[i].y);
+					glVertex2f((-1*PLAYER_SIZE)+pos[i].x, PLAYER_SIZE+pos[i].y);
+					glVertex2f(PLAYER_SIZE+pos[i].x, PLAYER_SIZE+pos[i].y);
+					glVertex2f(PLAYER_SIZE+pos[i].x, (-1*PLAYER_SIZE)+pos[i].y);
 				glEnd();
 			}
-			pthread_mutex_unlock(&(conn.players[i].lock));
 		}
-
-		glutSwapBuffers();
 	}
+	if(sprite != NULL){
+		glDisable(GL_TEXTURE_2D);
+	}
+	pthread_mutex_unlock(&(conn.world_lock));
+	TRACE_SPAN("draw", trace_ns, 0, frame);
+	
+	//the swap may wait for the display, so the frame's cpu work ends before it
+	fp_end(&pacer, get_mono_ns());
+	glutSwapBuffers();
+}
+
+void idle(){
 	//check on the connection threads to see if the game still going
 	pthread_mutex_lock(&(conn.exit_lock));
 	if(conn.exit){
 		pthread_mutex_unlock(&(conn.exit_lock));
 		
 		//wait here for the threads to quit (always close send first)
+		if(!watching){
+			in_stop(&input);
+		}
 		if(jc.get_prev_init()){
 			if(pthread_join(jc.get_send_thread(), NULL) != 0){
 				err_out(&(conn.err), "Error ending send thread\n");
@@ -106,6 +188,8 @@ void display(){
 				err_out(&(conn.err), "Error ending recv thread\n");
 			}
 		}
+		log_out(&(conn.log), fp_report(&pacer));
+		fp_quit(&pacer);
 		
 		//close the files before exit
 		#if ERR
@@ -120,6 +204,18 @@ void display(){
 	} else{
 		pthread_mutex_unlock(&(conn.exit_lock));
 	}
+	
+	//log the frame times now and then
+	if(get_mono_ms() > last_frame_log + FRAME_LOG_TIME){
+		if(last_frame_log != 0){
+			log_out(&(conn.log), fp_report(&pacer));
+		}
+		last_frame_log = get_mono_ms();
+	}
+	
+	//sleep out the rest of the frame instead of polling, then draw the next one
+	fp_wait(&pacer);
+	glutPostRedisplay();
 }
 
 void init(){
@@ -131,26 +227,181 @@ void init(){
 	gluOrtho2D(-1.0, 1.0, -1.0, 1.0);
 }
 
+/*	load_assets:
+ * 		Maps a sprite pack and uploads its atlas pages straight from the mapping (one texture per page).
+ *	returns: 0 for success, -1 for error
+ */
+int load_assets(std::string path){
+	unsigned long long start = get_mono_ns();
+	if(ap_load(&assets, path) == -1){
+		err_out(&(conn.err), "Asset Pack " + path + " Not Loaded\n");
+		return -1;
+	}
+	unsigned long long mapped = get_mono_ns();
+	
+	atlas.resize(assets.head->page_count);
+	if(atlas.size() > 0){
+		glGenTextures((GLsizei)atlas.size(), &(atlas[0]));
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for(unsigned int i=0; i<atlas.size(); i++){
+		glBindTexture(GL_TEXTURE_2D, atlas[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, assets.head->page_size, assets.head->page_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, ap_page(&assets, i));
+	}
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	
+	//the player animation (or the first one in the pack)
+	player_anim = ap_find_anim(&assets, "player");
+	if(player_anim == NULL && assets.head->anim_count > 0){
+		player_anim = &(assets.anims[0]);
+	}
+	log_out(&(conn.log), "Assets: " + std::to_string(assets.head->sprite_count) + " sprites on " + std::to_string(atlas.size())
+			+ " pages, mapped in " + std::to_string((mapped - start) / 1000) + " us, uploaded in "
+			+ std::to_string((get_mono_ns() - mapped) / 1000) + " us\n");
+	return 0;
+}
+
 int main(int argc, char** argv){
+	//a trailing -r records every datagram to log/<timestamp>.rec (for the replay tool),
+	//-l lobby[:port] lists a hosted game on that lobby and -R relay[:port] hosts through a relay
+	//(joins then use join relay:port#token with the token from the host log),
+	//-f fps draws at a fixed rate with vsync off (the default follows the display where vsync is available),
+	//-a file.pack draws the players with the sprites of a pack built by the asset_pack tool,
+	//-t threads.cfg pins and prioritizes the recv, send and render threads (format in ThreadConfig.h),
+	//-T traces from the start (F12 starts tracing otherwise, and dumps the trace once it is on),
+	//-p port binds a join to that port instead of the default (for several joins on one machine),
+	//-S node[:port] has a host send the spectator stream to that spectator node
+	//(watch node[:port] in place of host or join watches a game through a spectator node)
+	int record = 0;
+	double fps = 0;
+	std::string asset_path;
+	std::vector<std::string> args;
+	tc_init(&(conn.threads));
+	for(int i=2; i<argc; i++){
+		if(strcmp(argv[i], "-r") == 0){
+			record = 1;
+		} else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc){
+			if(lobby_addr(argv[++i], &(conn.lobby)) == -1){
+				err_out(&(conn.err), "Improper Input: Lobby must be address or address:port\n");
+				return -1;
+			}
+			conn.use_lobby = 1;
+			strncpy(conn.game_name, "Marvel Heros", LOBBY_NAME_LEN - 1);
+		} else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc){
+			fps = atof(argv[++i]);
+			if(fps <= 0){
+				err_out(&(conn.err), "Improper Input: Frame rate must be above 0\n");
+				return -1;
+			}
+		} else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc){
+			asset_path = argv[++i];
+		} else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc){
+			conn.client_port = (unsigned short)atoi(argv[++i]);
+			if(conn.client_port == 0){
+				err_out(&(conn.err), "Improper Input: Port must be 1 to 65535\n");
+				return -1;
+			}
+		} else if(strcmp(argv[i], "-T") == 0){
+			trace_enable(1);
+		} else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc){
+			std::string error;
+			if(tc_load(&(conn.threads), argv[++i], &error) == -1){
+				err_out(&(conn.err), "Improper Input: Thread config " + error + "\n");
+				return -1;
+			}
+		} else if(strcmp(argv[i], "-S") == 0 && i + 1 < argc){
+			if(parse_addr(argv[++i], SPEC_PORT, &(conn.spec)) == -1){
+				err_out(&(conn.err), "Improper Input: Spectator node must be address or address:port\n");
+				return -1;
+			}
+			conn.use_spec = 1;
+		} else if(strcmp(argv[i], "-R") == 0 && i + 1 < argc){
+			if(parse_addr(argv[++i], RELAY_PORT, &(conn.relay)) == -1){
+				err_out(&(conn.err), "Improper Input: Relay must be address or address:port\n");
+				return -1;
+			}
+			conn.use_relay = 1;
+		} else{
+			args.push_back(argv[i]);
+		}
+	}
+	
 	//check input validity and set up the host or join connect class
 	if(argc < 2){
-		err_out(&(conn.err), "Improper Input: Must specify host or join\n");
+		err_out(&(conn.err), "Improper Input: Must specify host, join or watch\n");
 		return -1;
 	} else if(strcmp(argv[1], "host") == 0){
+		//optional pre-shared key file turns on packet encryption
+		if(args.size() > 0 && crypt_load_psk(&(conn.crypt), args[0]) == -1){
+			err_out(&(conn.err), "Improper Input: Key file must hold 32 hex characters\n");
+			return -1;
+		}
+		if(record && rec_open(&(conn.rec), "log/" + std::to_string(get_timestamp()) + ".rec", REC_HOST, conn.crypt.enabled) == -1){
+			err_out(&(conn.err), "Recording Not Started\n");
+		}
 		hc.init_host(&conn);
 	} else if(strcmp(argv[1], "join") == 0){
-		if(argc < 3){
+		if(args.size() < 1){
 			err_out(&(conn.err), "Improper Input: If joining, must specify desired hostname\n");
 			return -1;
+		} else if(args.size() > 1 && crypt_load_psk(&(conn.crypt), args[1]) == -1){
+			err_out(&(conn.err), "Improper Input: Key file must hold 32 hex characters\n");
+			return -1;
 		} else{
-			std::string hostname = argv[2];
+			if(record && rec_open(&(conn.rec), "log/" + std::to_string(get_timestamp()) + ".rec", REC_JOIN, conn.crypt.enabled) == -1){
+				err_out(&(conn.err), "Recording Not Started\n");
+			}
+			//@lobby[:port] joins the first open game the lobby lists
+			std::string hostname = args[0];
+			if(hostname[0] == '@'){
+				Lobby_Game_Info_t game;
+				if(lobby_find(hostname.substr(1), &game, 1) < 1){
+					err_out(&(conn.err), "No Open Game Found On Lobby " + hostname.substr(1) + "\n");
+					return -1;
+				}
+				struct in_addr addr;
+				addr.S_un.S_addr = game.addr;
+				hostname = std::string(inet_ntoa(addr)) + ":" + std::to_string(ntohs(game.port));
+				if(game.session_id != 0){
+					hostname += "/" + std::to_string(game.session_id);
+				}
+				log_out(&(conn.log), "Lobby found game " + std::string(game.name) + " at " + hostname + "\n");
+			}
 			jc.init_join(&conn, hostname);
 		}
+	} else if(strcmp(argv[1], "watch") == 0){
+		//draws the stream of a spectator node (no player of its own, so only the world and exit are set up)
+		struct sockaddr_in node;
+		if(args.size() < 1 || parse_addr(args[0], SPEC_PORT, &node) == -1){
+			err_out(&(conn.err), "Improper Input: If watching, must specify a spectator node as address or address:port\n");
+			return -1;
+		}
+		pthread_mutex_init(&(conn.exit_lock), NULL);
+		conn.exit = 0;
+		ecs_init(&(conn.world));
+		pthread_mutex_init(&(conn.world_lock), NULL);
+		memset((char*)conn.player_ents, 0, sizeof(conn.player_ents));
+		ecs_query_init(&(conn.player_query), ECS_BIT(ECS_POS) | ECS_BIT(ECS_PLAYER), 0);
+		if(spec_watch_start(&watch, &node, &(conn.store)) != 0){
+			err_out(&(conn.err), "Watch Not Started\n");
+			return -1;
+		}
+		watching = 1;
 	} else{
-		err_out(&(conn.err), "Improper Input: Must specify host or join\n");
+		err_out(&(conn.err), "Improper Input: Must specify host, join or watch\n");
 		return -1;
 	}
 	
+	//the gl loop runs on this thread
+	if(tc_apply(&(conn.threads), THREAD_RENDER) == -1){
+		err_out(&(conn.err), "Render Thread Placement Not Set\n");
+	}
+	log_out(&(conn.log), tc_describe(&(conn.threads), THREAD_RENDER) + "\n");
+	trace_thread("render");
+	
 	//gl window setup
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
@@ -158,12 +409,37 @@ int main(int argc, char** argv){
 	glutInitWindowPosition(0, 0);
 	glutCreateWindow("Marvel Heros");
 	
+	//frame pacing: vsync where the driver has the swap interval extension, otherwise the timer paced rate
+	fp_init(&pacer, fps > 0 ? fps : MAX_FPS);
+	typedef BOOL (APIENTRY *Swap_Interval_t)(int);
+	Swap_Interval_t swap_interval = (Swap_Interval_t)wglGetProcAddress("wglSwapIntervalEXT");
+	if(swap_interval != NULL){
+		if(fps > 0){
+			swap_interval(0);
+		} else if(swap_interval(1)){
+			fp_set_vsync(&pacer, GetDeviceCaps(wglGetCurrentDC(), VREFRESH));
+		}
+	}
+	log_out(&(conn.log), "Frame pacing at " + std::to_string((int)(1e9 / pacer.period_ns)) + " fps" + (pacer.vsync ? " (vsync)\n" : "\n"));
+	
 	//gl display and interaction functions
 	glutDisplayFunc(display);
-	glutIdleFunc(display);
+	glutIdleFunc(idle);
 	glutKeyboardFunc(processNormKey);
+	glutKeyboardUpFunc(processKeyUp);
+	glutSpecialFunc(processSpecialKey);
+	glutIgnoreKeyRepeat(1);
+	
+	//self player input (a join sends key changes right away instead of waiting for its send tick)
+	if(!watching){
+		in_init(&input, &conn, jc.get_prev_init() ? join_send_now : NULL);
+		in_start(&input);
+	}
 	
 	//start gl loop
 	init();
+	if(asset_path.size() > 0){
+		load_assets(asset_path);
+	}
 	glutMainLoop();
 }
@@ -0,0 +1,124 @@
+#include <string.h>
+
+#include "inc/ConnectStruct.h"
+#include "inc/PacketBatch.h"
+
+//a lone message takes this many bytes more in the batch buffer than it does sent (the message count and its
+//Msg_Head_t), so the batches the host keeps must still hold one of the largest it sends
+static const int lone_extra = (int)(multi_head_len + sizeof(Msg_Head_t) - sizeof(Header_t));
+static_assert(batch_cap + lone_extra <= PB_BUF_LEN, "a batch must hold a lone message of batch_cap bytes");
+
+//a message's body is everything past its header (quit and ack messages have none)
+static int body_len(int len){
+	return (len > (int)sizeof(Header_t)) ? len - (int)sizeof(Header_t) : 0;
+}
+
+/*	pb_init:
+ * 		Sets up an empty batch whose taken packets hold at most cap bytes (no more than PB_BUF_LEN less
+ * 		lone_extra, so a lone message of cap bytes fits the buffer).
+ */
+void pb_init(Packet_Batch_t* pb, int cap){
+	pb->len = 0;
+	pb->cap = (cap > PB_BUF_LEN - lone_extra) ? PB_BUF_LEN - lone_extra : cap;
+	pb->count = 0;
+	pb->msgs = 0;
+	pb->packets = 0;
+}
+
+/*	pb_add:
+ * 		Queues a whole message (header and all, as it would be sent alone). Its player id, session id and
+ * 		timestamp are replaced by the first queued message's when it goes out in a multi packet.
+ *	returns: 0 for success, -1 if it does not fit (take the batch and add it again)
+ */
+int pb_add(Packet_Batch_t* pb, const char* message, int len){
+	if(pb == NULL || message == NULL || len < PACKET_HEAD_LEN || len > pb->cap){
+		return -1;
+	}
+	//a multi packet has to fit cap, the first message (taken alone unless another joins it) only the buffer
+	int body = body_len(len);
+	int used = (pb->count == 0) ? (int)multi_head_len : pb->len;
+	if(used + (int)sizeof(Msg_Head_t) + body > ((pb->count == 0) ? PB_BUF_LEN : pb->cap)){
+		return -1;
+	}
+	if(pb->count == 0){
+		memcpy(pb->buf, message, sizeof(Header_t));
+		pb->len = multi_head_len;
+	}
+	
+	Msg_Head_t head;
+	head.len = (unsigned short)len;
+	head.flags = ((const Header_t*)message)->flags;
+	head.pad = 0;
+	head.packet_num = ((const Header_t*)message)->packet_num;
+	memcpy(pb->buf + pb->len, &head, sizeof(head));
+	memcpy(pb->buf + pb->len + sizeof(head), message + sizeof(Header_t), body);
+	pb->len += sizeof(head) + body;
+	(pb->count)++;
+	return 0;
+}
+
+/*	pb_take:
+ * 		Empties the batch into out (a MAX_PACKET_LEN send buffer): the lone message as it was queued, or
+ * 		the multi packet (flags PF_MULTI, the message count after the header, then the messages).
+ *	returns: length of the packet in out, 0 if nothing was queued
+ */
+int pb_take(Packet_Batch_t* pb, char* out){
+	if(pb == NULL || out == NULL || pb->count == 0){
+		return 0;
+	}
+	int len;
+	if(pb->count == 1){
+		Msg_Head_t head;
+		memcpy(&head, pb->buf + multi_head_len, sizeof(head));
+		memcpy(out, pb->buf, sizeof(Header_t));
+		memcpy(out + sizeof(Header_t), pb->buf + multi_head_len + sizeof(head), body_len(head.len));
+		len = head.len;
+	} else{
+		unsigned short count = (unsigned short)pb->count;
+		memcpy(out, pb->buf, pb->len);
+		((Header_t*)out)->flags = PF_MULTI;
+		memcpy(out + sizeof(Header_t), &count, sizeof(count));
+		len = pb->len;
+	}
+	pb->msgs += pb->count;
+	(pb->packets)++;
+	pb->len = 0;
+	pb->count = 0;
+	return len;
+}
+
+/*	pb_next:
+ * 		Unpacks the message at *offset of a received multi packet into out (a MAX_PACKET_LEN buffer) as it
+ * 		was queued, with the shared header's player id, session id and timestamp, and moves *offset past
+ * 		it. Start with *offset 0.
+ *	returns: length of the message in out, 0 past the last message, -1 if the packet is malformed
+ */
+int pb_next(const char* buf, int bytes, int* offset, char* out){
+	if(buf == NULL || offset == NULL || out == NULL || bytes < (int)multi_head_len || bytes > PB_BUF_LEN){
+		return -1;
+	}
+	if(*offset == 0){
+		*offset = multi_head_len;
+	}
+	if(*offset == bytes){
+		return 0;
+	}
+	
+	//the message has to lie inside the packet and cannot be another multi packet
+	Msg_Head_t head;
+	if(*offset + (int)sizeof(head) > bytes){
+		return -1;
+	}
+	memcpy(&head, buf + *offset, sizeof(head));
+	int body = body_len(head.len);
+	if(head.len < PACKET_HEAD_LEN || *offset + (int)sizeof(head) + body > bytes || (head.flags & PF_MULTI) == PF_MULTI){
+		return -1;
+	}
+	
+	memcpy(out, buf, sizeof(Header_t));
+	((Header_t*)out)->flags = head.flags;
+	((Header_t*)out)->packet_num = head.packet_num;
+	memcpy(out + sizeof(Header_t), buf + *offset + sizeof(head), body);
+	*offset += sizeof(head) + body;
+	return head.len;
+}
@@ -0,0 +1,706 @@
+#include "inc/PacketCrypt.h"
+
+#include <string.h>
+#include <fstream>
+#include <windows.h>
+#include <bcrypt.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRYPT_X86 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#else
+#define CRYPT_X86 0
+#endif
+
+//tables shared by every key (filled once by crypt_init)
+static unsigned char sbox[256];
+static unsigned int te0[256], te1[256], te2[256], te3[256];
+static int tables_ready = 0;
+static int hw_available = 0;
+static int use_hw = 0;
+
+//reduction constants for the 4-bit GHASH tables
+static const unsigned long long last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static unsigned int get_be32(const unsigned char* p){
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+static void put_be32(unsigned char* p, unsigned int v){
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static unsigned long long get_be64(const unsigned char* p){
+	return ((unsigned long long)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+static void put_be64(unsigned char* p, unsigned long long v){
+	put_be32(p, (unsigned int)(v >> 32));
+	put_be32(p + 4, (unsigned int)v);
+}
+
+static unsigned char xtime(unsigned char x){
+	return (unsigned char)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+// ##################################################################### Portable AES and GHASH
+
+/*	build_tables:
+ * 		Generates the AES S-box and the combined SubBytes/MixColumns round tables.
+ */
+static void build_tables(){
+	//walk the multiplicative group with generator 3 to get each inverse
+	unsigned char p = 1, q = 1;
+	do{
+		p = p ^ xtime(p);
+		q ^= q << 1;
+		q ^= q << 2;
+		q ^= q << 4;
+		if(q & 0x80){
+			q ^= 0x09;
+		}
+		unsigned char x = q ^ (unsigned char)((q << 1) | (q >> 7)) ^ (unsigned char)((q << 2) | (q >> 6))
+				^ (unsigned char)((q << 3) | (q >> 5)) ^ (unsigned char)((q << 4) | (q >> 4));
+		sbox[p] = x ^ 0x63;
+	} while(p != 1);
+	sbox[0] = 0x63;
+	
+	for(int i=0; i<256; i++){
+		unsigned char s = sbox[i];
+		unsigned char s2 = xtime(s);
+		unsigned char s3 = s2 ^ s;
+		te0[i] = ((unsigned int)s2 << 24) | ((unsigned int)s << 16) | ((unsigned int)s << 8) | s3;
+		te1[i] = (te0[i] >> 8) | (te0[i] << 24);
+		te2[i] = (te0[i] >> 16) | (te0[i] << 16);
+		te3[i] = (te0[i] >> 24) | (te0[i] << 8);
+	}
+}
+
+/*	aes_encrypt_block:
+ * 		Table driven AES-128 encryption of a single block.
+ */
+static void aes_encrypt_block(const Crypt_Key_t* key, const unsigned char* in, unsigned char* out){
+	const unsigned int* rk = key->rk;
+	unsigned int s0 = get_be32(in) ^ rk[0];
+	unsigned int s1 = get_be32(in + 4) ^ rk[1];
+	unsigned int s2 = get_be32(in + 8) ^ rk[2];
+	unsigned int s3 = get_be32(in + 12) ^ rk[3];
+	unsigned int t0, t1, t2, t3;
+	
+	for(int r=1; r<10; r++){
+		rk += 4;
+		t0 = te0[s0 >> 24] ^ te1[(s1 >> 16) & 0xff] ^ te2[(s2 >> 8) & 0xff] ^ te3[s3 & 0xff] ^ rk[0];
+		t1 = te0[s1 >> 24] ^ te1[(s2 >> 16) & 0xff] ^ te2[(s3 >> 8) & 0xff] ^ te3[s0 & 0xff] ^ rk[1];
+		t2 = te0[s2 >> 24] ^ te1[(s3 >> 16) & 0xff] ^ te2[(s0 >> 8) & 0xff] ^ te3[s1 & 0xff] ^ rk[2];
+		t3 = te0[s3 >> 24] ^ te1[(s0 >> 16) & 0xff] ^ te2[(s1 >> 8) & 0xff] ^ te3[s2 & 0xff] ^ rk[3];
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+	
+	//last round has no MixColumns
+	rk += 4;
+	t0 = ((unsigned int)sbox[s0 >> 24] << 24) ^ ((unsigned int)sbox[(s1 >> 16) & 0xff] << 16) ^ ((unsigned int)sbox[(s2 >> 8) & 0xff] << 8) ^ sbox[s3 & 0xff] ^ rk[0];
+	t1 = ((unsigned int)sbox[s1 >> 24] << 24) ^ ((unsigned int)sbox[(s2 >> 16) & 0xff] << 16) ^ ((unsigned int)sbox[(s3 >> 8) & 0xff] << 8) ^ sbox[s0 & 0xff] ^ rk[1];
+	t2 = ((unsigned int)sbox[s2 >> 24] << 24) ^ ((unsigned int)sbox[(s3 >> 16) & 0xff] << 16) ^ ((unsigned int)sbox[(s0 >> 8) & 0xff] << 8) ^ sbox[s1 & 0xff] ^ rk[2];
+	t3 = ((unsigned int)sbox[s3 >> 24] << 24) ^ ((unsigned int)sbox[(s0 >> 16) & 0xff] << 16) ^ ((unsigned int)sbox[(s1 >> 8) & 0xff] << 8) ^ sbox[s2 & 0xff] ^ rk[3];
+	put_be32(out, t0);
+	put_be32(out + 4, t1);
+	put_be32(out + 8, t2);
+	put_be32(out + 12, t3);
+}
+
+/*	ghash_mult:
+ * 		Multiplies x by the hash key in GF(2^128) using the 4-bit tables (result written back to x).
+ */
+static void ghash_mult(const Crypt_Key_t* key, unsigned char* x){
+	int lo = x[15] & 0xf;
+	unsigned long long zh = key->hh[lo];
+	unsigned long long zl = key->hl[lo];
+	
+	for(int i=15; i>=0; i--){
+		lo = x[i] & 0xf;
+		int hi = (x[i] >> 4) & 0xf;
+		int rem;
+		if(i != 15){
+			rem = (int)(zl & 0xf);
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (last4[rem] << 48);
+			zh ^= key->hh[lo];
+			zl ^= key->hl[lo];
+		}
+		rem = (int)(zl & 0xf);
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (last4[rem] << 48);
+		zh ^= key->hh[hi];
+		zl ^= key->hl[hi];
+	}
+	put_be64(x, zh);
+	put_be64(x + 8, zl);
+}
+
+/*	ghash_update:
+ * 		Absorbs data (zero padded to whole blocks) into the running hash.
+ */
+static void ghash_update(const Crypt_Key_t* key, unsigned char* x, const unsigned char* data, int len){
+	while(len > 0){
+		int n = (len < CRYPT_BLOCK_LEN) ? len : CRYPT_BLOCK_LEN;
+		for(int i=0; i<n; i++){
+			x[i] ^= data[i];
+		}
+		ghash_mult(key, x);
+		data += n;
+		len -= n;
+	}
+}
+
+/*	ghash_portable:
+ * 		GHASH of the aad and ciphertext followed by their bit lengths.
+ */
+static void ghash_portable(const Crypt_Key_t* key, const unsigned char* aad, int aad_len, const unsigned char* ct, int len, unsigned char* out){
+	unsigned char lens[CRYPT_BLOCK_LEN];
+	memset(out, 0, CRYPT_BLOCK_LEN);
+	ghash_update(key, out, aad, aad_len);
+	ghash_update(key, out, ct, len);
+	put_be64(lens, (unsigned long long)aad_len * 8);
+	put_be64(lens + 8, (unsigned long long)len * 8);
+	ghash_update(key, out, lens, CRYPT_BLOCK_LEN);
+}
+
+/*	ctr_portable:
+ * 		Counter mode keystream xor starting from the block after j0.
+ */
+static void ctr_portable(const Crypt_Key_t* key, const unsigned char* j0, unsigned char* data, int len){
+	unsigned char ctr[CRYPT_BLOCK_LEN], ks[CRYPT_BLOCK_LEN];
+	memcpy(ctr, j0, CRYPT_BLOCK_LEN);
+	unsigned int count = get_be32(j0 + 12);
+	while(len > 0){
+		put_be32(ctr + 12, ++count);
+		aes_encrypt_block(key, ctr, ks);
+		int n = (len < CRYPT_BLOCK_LEN) ? len : CRYPT_BLOCK_LEN;
+		for(int i=0; i<n; i++){
+			data[i] ^= ks[i];
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+// ##################################################################### AES-NI and PCLMULQDQ
+
+#if CRYPT_X86
+#define CRYPT_HW_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+CRYPT_HW_TARGET static inline __m128i hw_encrypt(const __m128i* rk, __m128i b){
+	b = _mm_xor_si128(b, rk[0]);
+	for(int r=1; r<10; r++){
+		b = _mm_aesenc_si128(b, rk[r]);
+	}
+	return _mm_aesenclast_si128(b, rk[10]);
+}
+
+/*	hw_gfmul:
+ * 		Carry-less multiply and reduce of two byte reflected GHASH values (Intel GCM white paper method).
+ */
+CRYPT_HW_TARGET static inline __m128i hw_gfmul(__m128i a, __m128i b){
+	__m128i t3 = _mm_clmulepi64_si128(a, b, 0x00);
+	__m128i t4 = _mm_clmulepi64_si128(a, b, 0x10);
+	__m128i t5 = _mm_clmulepi64_si128(a, b, 0x01);
+	__m128i t6 = _mm_clmulepi64_si128(a, b, 0x11);
+	
+	t4 = _mm_xor_si128(t4, t5);
+	t5 = _mm_slli_si128(t4, 8);
+	t4 = _mm_srli_si128(t4, 8);
+	t3 = _mm_xor_si128(t3, t5);
+	t6 = _mm_xor_si128(t6, t4);
+	
+	//shift the 256 bit product left by one for the bit reflected representation
+	__m128i t7 = _mm_srli_epi32(t3, 31);
+	__m128i t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+	__m128i t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+	
+	//reduce modulo x^128 + x^7 + x^2 + x + 1
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+	
+	__m128i t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+	return _mm_xor_si128(t6, t3);
+}
+
+CRYPT_HW_TARGET static inline __m128i hw_load_partial(const unsigned char* p, int n){
+	unsigned char block[CRYPT_BLOCK_LEN] = {0};
+	memcpy(block, p, n);
+	return _mm_loadu_si128((const __m128i*)block);
+}
+
+CRYPT_HW_TARGET static void ghash_hw(const Crypt_Key_t* key, const unsigned char* aad, int aad_len, const unsigned char* ct, int len, unsigned char* out){
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)key->h), bswap);
+	__m128i x = _mm_setzero_si128();
+	const unsigned char* parts[2] = {aad, ct};
+	int lens[2] = {aad_len, len};
+	
+	for(int p=0; p<2; p++){
+		const unsigned char* data = parts[p];
+		int n = lens[p];
+		while(n >= CRYPT_BLOCK_LEN){
+			__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap);
+			x = hw_gfmul(_mm_xor_si128(x, b), h);
+			data += CRYPT_BLOCK_LEN;
+			n -= CRYPT_BLOCK_LEN;
+		}
+		if(n > 0){
+			__m128i b = _mm_shuffle_epi8(hw_load_partial(data, n), bswap);
+			x = hw_gfmul(_mm_xor_si128(x, b), h);
+		}
+	}
+	
+	__m128i bits = _mm_set_epi64x((long long)aad_len * 8, (long long)len * 8);
+	x = hw_gfmul(_mm_xor_si128(x, bits), h);
+	_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(x, bswap));
+}
+
+CRYPT_HW_TARGET static void ctr_hw(const Crypt_Key_t* key, const unsigned char* j0, unsigned char* data, int len){
+	__m128i rk[11];
+	for(int r=0; r<11; r++){
+		rk[r] = _mm_loadu_si128((const __m128i*)(key->rk_bytes + (16 * r)));
+	}
+	unsigned char ctr[4 * CRYPT_BLOCK_LEN];
+	unsigned int count = get_be32(j0 + 12);
+	for(int i=0; i<4; i++){
+		memcpy(ctr + (16 * i), j0, 12);
+	}
+	
+	//four blocks in flight to hide the aesenc latency
+	while(len >= 4 * CRYPT_BLOCK_LEN){
+		for(int i=0; i<4; i++){
+			put_be32(ctr + (16 * i) + 12, ++count);
+		}
+		__m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)ctr), rk[0]);
+		__m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ctr + 16)), rk[0]);
+		__m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ctr + 32)), rk[0]);
+		__m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ctr + 48)), rk[0]);
+		for(int r=1; r<10; r++){
+			b0 = _mm_aesenc_si128(b0, rk[r]);
+			b1 = _mm_aesenc_si128(b1, rk[r]);
+			b2 = _mm_aesenc_si128(b2, rk[r]);
+			b3 = _mm_aesenc_si128(b3, rk[r]);
+		}
+		b0 = _mm_aesenclast_si128(b0, rk[10]);
+		b1 = _mm_aesenclast_si128(b1, rk[10]);
+		b2 = _mm_aesenclast_si128(b2, rk[10]);
+		b3 = _mm_aesenclast_si128(b3, rk[10]);
+		_mm_storeu_si128((__m128i*)data, _mm_xor_si128(b0, _mm_loadu_si128((const __m128i*)data)));
+		_mm_storeu_si128((__m128i*)(data + 16), _mm_xor_si128(b1, _mm_loadu_si128((const __m128i*)(data + 16))));
+		_mm_storeu_si128((__m128i*)(data + 32), _mm_xor_si128(b2, _mm_loadu_si128((const __m128i*)(data + 32))));
+		_mm_storeu_si128((__m128i*)(data + 48), _mm_xor_si128(b3, _mm_loadu_si128((const __m128i*)(data + 48))));
+		data += 4 * CRYPT_BLOCK_LEN;
+		len -= 4 * CRYPT_BLOCK_LEN;
+	}
+	
+	while(len > 0){
+		put_be32(ctr + 12, ++count);
+		__m128i ks = hw_encrypt(rk, _mm_loadu_si128((const __m128i*)ctr));
+		int n = (len < CRYPT_BLOCK_LEN) ? len : CRYPT_BLOCK_LEN;
+		unsigned char ks_bytes[CRYPT_BLOCK_LEN];
+		_mm_storeu_si128((__m128i*)ks_bytes, ks);
+		for(int i=0; i<n; i++){
+			data[i] ^= ks_bytes[i];
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+CRYPT_HW_TARGET static void encrypt_block_hw(const Crypt_Key_t* key, const unsigned char* in, unsigned char* out){
+	__m128i rk[11];
+	for(int r=0; r<11; r++){
+		rk[r] = _mm_loadu_si128((const __m128i*)(key->rk_bytes + (16 * r)));
+	}
+	_mm_storeu_si128((__m128i*)out, hw_encrypt(rk, _mm_loadu_si128((const __m128i*)in)));
+}
+#endif
+
+// ##################################################################### AEAD
+
+/*	crypt_init:
+ * 		Builds the shared tables and picks AES-NI/PCLMULQDQ when the cpu has them.
+ * 		Called by init_host and init_join before any key is set.
+ *	returns: 1 if the hardware path is used, 0 for the portable path
+ */
+int crypt_init(){
+	if(!tables_ready){
+		build_tables();
+		#if CRYPT_X86
+		__builtin_cpu_init();
+		hw_available = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+		#endif
+		use_hw = hw_available;
+		tables_ready = 1;
+	}
+	return use_hw;
+}
+
+/*	crypt_hw_available:
+ *	returns: 1 if the cpu supports the hardware path, 0 if not
+ */
+int crypt_hw_available(){
+	crypt_init();
+	return hw_available;
+}
+
+/*	crypt_use_hw:
+ * 		Switches between the hardware and portable paths (benchmarks compare both).
+ */
+void crypt_use_hw(int use){
+	crypt_init();
+	use_hw = use && hw_available;
+}
+
+static void encrypt_block(const Crypt_Key_t* key, const unsigned char* in, unsigned char* out){
+	#if CRYPT_X86
+	if(use_hw){
+		encrypt_block_hw(key, in, out);
+		return;
+	}
+	#endif
+	aes_encrypt_block(key, in, out);
+}
+
+static void gcm_ghash(const Crypt_Key_t* key, const unsigned char* aad, int aad_len, const unsigned char* ct, int len, unsigned char* out){
+	#if CRYPT_X86
+	if(use_hw){
+		ghash_hw(key, aad, aad_len, ct, len, out);
+		return;
+	}
+	#endif
+	ghash_portable(key, aad, aad_len, ct, len, out);
+}
+
+static void gcm_ctr(const Crypt_Key_t* key, const unsigned char* j0, unsigned char* data, int len){
+	#if CRYPT_X86
+	if(use_hw){
+		ctr_hw(key, j0, data, len);
+		return;
+	}
+	#endif
+	ctr_portable(key, j0, data, len);
+}
+
+/*	crypt_set_key:
+ * 		Expands a 16 byte AES key and precomputes its GHASH key and tables.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_set_key(Crypt_Key_t* key, const unsigned char* k){
+	static const unsigned char rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+	if(key == NULL || k == NULL){
+		return -1;
+	}
+	crypt_init();
+	
+	for(int i=0; i<4; i++){
+		key->rk[i] = get_be32(k + (4 * i));
+	}
+	for(int i=4; i<44; i++){
+		unsigned int t = key->rk[i - 1];
+		if(i % 4 == 0){
+			t = ((unsigned int)sbox[(t >> 16) & 0xff] << 24) ^ ((unsigned int)sbox[(t >> 8) & 0xff] << 16)
+					^ ((unsigned int)sbox[t & 0xff] << 8) ^ sbox[t >> 24] ^ ((unsigned int)rcon[(i / 4) - 1] << 24);
+		}
+		key->rk[i] = key->rk[i - 4] ^ t;
+	}
+	for(int i=0; i<44; i++){
+		put_be32(key->rk_bytes + (4 * i), key->rk[i]);
+	}
+	
+	//hash key is the encryption of the zero block
+	unsigned char zero[CRYPT_BLOCK_LEN] = {0};
+	aes_encrypt_block(key, zero, key->h);
+	
+	//4-bit multiplication tables for the portable GHASH
+	unsigned long long vh = get_be64(key->h);
+	unsigned long long vl = get_be64(key->h + 8);
+	key->hh[0] = 0;
+	key->hl[0] = 0;
+	key->hh[8] = vh;
+	key->hl[8] = vl;
+	for(int i=4; i>0; i>>=1){
+		unsigned long long t = (vl & 1) * 0xe1000000ULL;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ (t << 32);
+		key->hh[i] = vh;
+		key->hl[i] = vl;
+	}
+	for(int i=2; i<=8; i*=2){
+		for(int j=1; j<i; j++){
+			key->hh[i + j] = key->hh[i] ^ key->hh[j];
+			key->hl[i + j] = key->hl[i] ^ key->hl[j];
+		}
+	}
+	return 0;
+}
+
+/*	crypt_seal:
+ * 		AES-GCM encrypts data in place and writes the tag. The aad is authenticated but not encrypted.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_seal(const Crypt_Key_t* key, const unsigned char* nonce, const unsigned char* aad, int aad_len, unsigned char* data, int len, unsigned char* tag){
+	unsigned char j0[CRYPT_BLOCK_LEN], s[CRYPT_BLOCK_LEN];
+	if(key == NULL || nonce == NULL || tag == NULL || len < 0 || aad_len < 0){
+		return -1;
+	}
+	
+	memcpy(j0, nonce, CRYPT_NONCE_LEN);
+	put_be32(j0 + 12, 1);
+	gcm_ctr(key, j0, data, len);
+	gcm_ghash(key, aad, aad_len, data, len, s);
+	encrypt_block(key, j0, j0);
+	for(int i=0; i<CRYPT_TAG_LEN; i++){
+		tag[i] = s[i] ^ j0[i];
+	}
+	return 0;
+}
+
+/*	crypt_open:
+ * 		Checks the AES-GCM tag and only then decrypts the data in place.
+ *	returns: 0 if authentic, -1 if the tag does not match or on error
+ */
+int crypt_open(const Crypt_Key_t* key, const unsigned char* nonce, const unsigned char* aad, int aad_len, unsigned char* data, int len, const unsigned char* tag){
+	unsigned char j0[CRYPT_BLOCK_LEN], s[CRYPT_BLOCK_LEN];
+	if(key == NULL || nonce == NULL || tag == NULL || len < 0 || aad_len < 0){
+		return -1;
+	}
+	
+	memcpy(j0, nonce, CRYPT_NONCE_LEN);
+	put_be32(j0 + 12, 1);
+	gcm_ghash(key, aad, aad_len, data, len, s);
+	unsigned char ek[CRYPT_BLOCK_LEN];
+	encrypt_block(key, j0, ek);
+	
+	//constant time compare
+	unsigned char diff = 0;
+	for(int i=0; i<CRYPT_TAG_LEN; i++){
+		diff |= (unsigned char)(s[i] ^ ek[i] ^ tag[i]);
+	}
+	if(diff != 0){
+		return -1;
+	}
+	gcm_ctr(key, j0, data, len);
+	return 0;
+}
+
+/*	crypt_random:
+ * 		Fills the buffer from the system cryptographic random generator.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_random(unsigned char* buf, int len){
+	if(buf == NULL || len < 0){
+		return -1;
+	}
+	if(BCryptGenRandom(NULL, buf, (unsigned long)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0){
+		return -1;
+	}
+	return 0;
+}
+
+// ##################################################################### Sessions and Packets
+
+/*	crypt_load_psk:
+ * 		Reads the pre-shared key (32 hex characters) from a file and enables encryption.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_load_psk(Crypt_Info_t* ci, std::string path){
+	unsigned char k[CRYPT_KEY_LEN];
+	std::ifstream file(path);
+	std::string hex;
+	if(ci == NULL || !file.is_open() || !(file >> hex) || hex.length() != 2 * CRYPT_KEY_LEN){
+		return -1;
+	}
+	
+	for(int i=0; i<CRYPT_KEY_LEN; i++){
+		char* end;
+		std::string byte = hex.substr(2 * i, 2);
+		k[i] = (unsigned char)strtoul(byte.c_str(), &end, 16);
+		if(*end != '\0'){
+			return -1;
+		}
+	}
+	crypt_set_key(&(ci->base), k);
+	crypt_session_init(&(ci->host_sess));
+	memset(k, 0, sizeof(k));
+	ci->enabled = 1;
+	return 0;
+}
+
+/*	crypt_session_init:
+ * 		Sets up the session lock. The session is not ready until a key is derived.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_session_init(Crypt_Session_t* sess){
+	if(sess == NULL){
+		return -1;
+	}
+	pthread_mutex_init(&(sess->lock), NULL);
+	sess->send_seq.store(0);
+	sess->recv_top = 0;
+	sess->recv_mask = 0;
+	sess->ready = 0;
+	return 0;
+}
+
+/*	crypt_derive_session:
+ * 		Derives the session key from the two handshake randoms (AES of their xor under the pre-shared key)
+ * 		and resets the sequence numbers and replay window.
+ *	returns: 0 on success, -1 on error
+ */
+int crypt_derive_session(const Crypt_Info_t* ci, Crypt_Session_t* sess, const unsigned char* client_rand, const unsigned char* host_rand){
+	unsigned char block[CRYPT_BLOCK_LEN];
+	if(ci == NULL || sess == NULL || client_rand == NULL || host_rand == NULL){
+		return -1;
+	}
+	
+	for(int i=0; i<CRYPT_BLOCK_LEN; i++){
+		block[i] = client_rand[i] ^ host_rand[i];
+	}
+	encrypt_block(&(ci->base), block, block);
+	
+	pthread_mutex_lock(&(sess->lock));
+	crypt_set_key(&(sess->key), block);
+	memcpy(sess->client_rand, client_rand, CRYPT_RAND_LEN);
+	memcpy(sess->host_rand, host_rand, CRYPT_RAND_LEN);
+	sess->send_seq.store(0);
+	sess->recv_top = 0;
+	sess->recv_mask = 0;
+	sess->ready = 1;
+	pthread_mutex_unlock(&(sess->lock));
+	memset(block, 0, sizeof(block));
+	return 0;
+}
+
+/*	replay_check:
+ * 		Checks a sequence number against the replay window and optionally marks it seen.
+ * 		recv_top is one past the newest sequence accepted, bit i of recv_mask is sequence (recv_top - 1 - i).
+ * 		Must be called with the session lock held.
+ *	returns: 0 if the sequence is new, -1 if it is a replay or too old
+ */
+static int replay_check(Crypt_Session_t* sess, unsigned long long seq, int mark){
+	if(seq >= sess->recv_top){
+		if(mark){
+			unsigned long long shift = seq + 1 - sess->recv_top;
+			sess->recv_mask = (shift >= CRYPT_REPLAY_WINDOW) ? 0 : (sess->recv_mask << shift);
+			sess->recv_mask |= 1;
+			sess->recv_top = seq + 1;
+		}
+		return 0;
+	}
+	
+	unsigned long long behind = sess->recv_top - 1 - seq;
+	if(behind >= CRYPT_REPLAY_WINDOW || (sess->recv_mask & (1ULL << behind))){
+		return -1;
+	}
+	if(mark){
+		sess->recv_mask |= (1ULL << behind);
+	}
+	return 0;
+}
+
+/*	pkt_seal:
+ * 		Encrypts a packet in place. The header (head_len bytes) stays readable and is authenticated,
+ * 		the nonce and tag are appended. With a session the nonce is the direction and the next send
+ * 		sequence, without one (join handshake under the pre-shared key) the nonce is random.
+ *	returns: sealed packet length, -1 on error
+ */
+int pkt_seal(const Crypt_Key_t* key, Crypt_Session_t* sess, char dir, char* buf, int head_len, int len){
+	if(key == NULL || buf == NULL || len < head_len){
+		return -1;
+	}
+	
+	unsigned char* nonce = (unsigned char*)buf + len;
+	nonce[0] = (unsigned char)dir;
+	if(sess != NULL){
+		nonce[1] = 0;
+		nonce[2] = 0;
+		nonce[3] = 0;
+		put_be64(nonce + 4, sess->send_seq.fetch_add(1));
+	} else if(crypt_random(nonce + 1, CRYPT_NONCE_LEN - 1) == -1){
+		return -1;
+	}
+	
+	if(crypt_seal(key, nonce, (unsigned char*)buf, head_len, (unsigned char*)buf + head_len, len - head_len, nonce + CRYPT_NONCE_LEN) == -1){
+		return -1;
+	}
+	return len + CRYPT_OVERHEAD;
+}
+
+/*	pkt_open:
+ * 		Authenticates and decrypts a sealed packet in place. With a session, replayed or
+ * 		too old sequence numbers are rejected (the window is only updated after the tag checks out).
+ *	returns: plain packet length, -1 if the packet is not authentic
+ */
+int pkt_open(const Crypt_Key_t* key, Crypt_Session_t* sess, char dir, char* buf, int head_len, int len){
+	if(key == NULL || buf == NULL || len < head_len + CRYPT_OVERHEAD){
+		return -1;
+	}
+	
+	int plain_len = len - CRYPT_OVERHEAD;
+	unsigned char* nonce = (unsigned char*)buf + plain_len;
+	if(nonce[0] != (unsigned char)dir){
+		return -1;
+	}
+	
+	unsigned long long seq = 0;
+	if(sess != NULL){
+		if(nonce[1] != 0 || nonce[2] != 0 || nonce[3] != 0){
+			return -1;
+		}
+		seq = get_be64(nonce + 4);
+		pthread_mutex_lock(&(sess->lock));
+		int fresh = replay_check(sess, seq, 0);
+		pthread_mutex_unlock(&(sess->lock));
+		if(fresh == -1){
+			return -1;
+		}
+	}
+	
+	if(crypt_open(key, nonce, (unsigned char*)buf, head_len, (unsigned char*)buf + head_len, plain_len - head_len, nonce + CRYPT_NONCE_LEN) == -1){
+		return -1;
+	}
+	
+	if(sess != NULL){
+		pthread_mutex_lock(&(sess->lock));
+		int fresh = replay_check(sess, seq, 1);
+		pthread_mutex_unlock(&(sess->lock));
+		if(fresh == -1){
+			return -1;
+		}
+	}
+	return plain_len;
+}
@@ -0,0 +1,187 @@
+#include "inc/PeerTable.h"
+
+/*	pt_key:
+ * 		Packs the address and port (both kept in network order) into the upper 48 bits of an entry.
+ *	returns: the key bits (0 for the unusable 0.0.0.0:0 address)
+ */
+static unsigned long long pt_key(const struct sockaddr_in* addr){
+	return ((unsigned long long)(unsigned)(addr->sin_addr.S_un.S_addr) << 32) | ((unsigned long long)(addr->sin_port) << 16);
+}
+
+/*	pt_hash:
+ * 		Mixes the key bits so neighbouring addresses and ports spread across the table.
+ *	returns: home index of the key
+ */
+static unsigned pt_hash(const Peer_Table_t* pt, unsigned long long key){
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (unsigned)key & pt->mask;
+}
+
+/*	pt_init:
+ * 		Allocates an empty table sized to keep the load factor at or under one half.
+ *	returns: 0 on success, -1 on error
+ */
+int pt_init(Peer_Table_t* pt, unsigned max_peers){
+	if(pt == NULL || max_peers == 0 || max_peers > PT_MAX_SLOT){
+		return -1;
+	}
+	
+	unsigned cap = 16;
+	while(cap < (max_peers * 2)){
+		cap <<= 1;
+	}
+	pt->entries = new std::atomic<unsigned long long>[cap];
+	for(unsigned i=0; i<cap; i++){
+		pt->entries[i].store(PT_EMPTY, std::memory_order_relaxed);
+	}
+	pt->seq.store(0, std::memory_order_relaxed);
+	pt->mask = cap - 1;
+	pt->count = 0;
+	pthread_mutex_init(&(pt->write_lock), NULL);
+	return 0;
+}
+
+/*	pt_destroy:
+ * 		Frees the table storage.
+ */
+void pt_destroy(Peer_Table_t* pt){
+	if(pt == NULL || pt->entries == NULL){
+		return;
+	}
+	delete[] pt->entries;
+	pt->entries = NULL;
+	pthread_mutex_destroy(&(pt->write_lock));
+}
+
+/*	pt_find:
+ * 		Lock free lookup of the player slot registered for this address and port.
+ * 		The slot may be freed right after the lookup, so callers confirm it under the player lock.
+ *	returns: slot number, -1 if the peer is not in the table
+ */
+int pt_find(Peer_Table_t* pt, const struct sockaddr_in* addr){
+	if(pt == NULL || addr == NULL || pt->entries == NULL){
+		return -1;
+	}
+	
+	unsigned long long key = pt_key(addr);
+	while(1){
+		unsigned start_seq = pt->seq.load(std::memory_order_acquire);
+		if(start_seq & 1){
+			//writer in progress
+			continue;
+		}
+		
+		int slot = -1;
+		unsigned idx = pt_hash(pt, key);
+		for(unsigned probe=0; probe<=pt->mask; probe++){
+			unsigned long long entry = pt->entries[idx].load(std::memory_order_relaxed);
+			if(entry == PT_EMPTY){
+				break;
+			}
+			if((entry & ~0xFFFFULL) == key){
+				slot = (int)(entry & 0xFFFF);
+				break;
+			}
+			idx = (idx + 1) & pt->mask;
+		}
+		
+		//only trust the result if no writer touched the table during the probe
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(pt->seq.load(std::memory_order_relaxed) == start_seq){
+			return slot;
+		}
+	}
+}
+
+/*	pt_insert:
+ * 		Registers the address and port to the given slot.
+ *	returns: the given slot on success, the already registered slot if the peer exists, -1 on error or full
+ */
+int pt_insert(Peer_Table_t* pt, const struct sockaddr_in* addr, int slot){
+	if(pt == NULL || addr == NULL || pt->entries == NULL || slot < 0 || slot > PT_MAX_SLOT){
+		return -1;
+	}
+	unsigned long long key = pt_key(addr);
+	if(key == PT_EMPTY){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(pt->write_lock));
+	unsigned idx = pt_hash(pt, key);
+	while(1){
+		unsigned long long entry = pt->entries[idx].load(std::memory_order_relaxed);
+		if(entry == PT_EMPTY){
+			break;
+		}
+		if((entry & ~0xFFFFULL) == key){
+			pthread_mutex_unlock(&(pt->write_lock));
+			return (int)(entry & 0xFFFF);
+		}
+		idx = (idx + 1) & pt->mask;
+	}
+	
+	//keep the load factor at one half so probe chains stay short
+	if((pt->count + 1) * 2 > pt->mask + 1){
+		pthread_mutex_unlock(&(pt->write_lock));
+		return -1;
+	}
+	
+	//a single entry store needs no seq bump (readers either see it or not)
+	pt->entries[idx].store(key | (unsigned long long)slot, std::memory_order_release);
+	(pt->count)++;
+	pthread_mutex_unlock(&(pt->write_lock));
+	return slot;
+}
+
+/*	pt_remove:
+ * 		Deletes the peer's entry and shifts the rest of its probe chain back to fill the hole.
+ *	returns: slot that was registered, -1 if the peer was not in the table
+ */
+int pt_remove(Peer_Table_t* pt, const struct sockaddr_in* addr){
+	if(pt == NULL || addr == NULL || pt->entries == NULL){
+		return -1;
+	}
+	
+	unsigned long long key = pt_key(addr);
+	pthread_mutex_lock(&(pt->write_lock));
+	unsigned idx = pt_hash(pt, key);
+	unsigned long long entry;
+	while(1){
+		entry = pt->entries[idx].load(std::memory_order_relaxed);
+		if(entry == PT_EMPTY){
+			pthread_mutex_unlock(&(pt->write_lock));
+			return -1;
+		}
+		if((entry & ~0xFFFFULL) == key){
+			break;
+		}
+		idx = (idx + 1) & pt->mask;
+	}
+	
+	//entries move during the shift so readers must retry if they overlap it
+	pt->seq.fetch_add(1, std::memory_order_acq_rel);
+	unsigned hole = idx;
+	unsigned next = (hole + 1) & pt->mask;
+	while(1){
+		unsigned long long moved = pt->entries[next].load(std::memory_order_relaxed);
+		if(moved == PT_EMPTY){
+			break;
+		}
+		//an entry can fill the hole if its home is not cyclically within (hole, next]
+		unsigned home = pt_hash(pt, moved & ~0xFFFFULL);
+		if(((next - home) & pt->mask) >= ((next - hole) & pt->mask)){
+			pt->entries[hole].store(moved, std::memory_order_relaxed);
+			hole = next;
+		}
+		next = (next + 1) & pt->mask;
+	}
+	pt->entries[hole].store(PT_EMPTY, std::memory_order_relaxed);
+	(pt->count)--;
+	pt->seq.fetch_add(1, std::memory_order_release);
+	pthread_mutex_unlock(&(pt->write_lock));
+	return (int)(entry & 0xFFFF);
+}
@@ -0,0 +1,34 @@
+#include <string.h>
+
+#include "inc/PlayerStore.h"
+
+/*	ps_post:
+ * 		Publishes a player's position (x in the low word, y in the high word).
+ */
+void ps_post(Player_Inbox_t* box, float x, float y){
+	unsigned xb, yb;
+	memcpy(&xb, &x, sizeof(xb));
+	memcpy(&yb, &y, sizeof(yb));
+	box->pos.store(((unsigned long long)yb << 32) | xb, std::memory_order_release);
+}
+
+/*	ps_peek:
+ * 		Reads a player's newest position.
+ */
+void ps_peek(const Player_Inbox_t* box, float* x, float* y){
+	unsigned long long v = box->pos.load(std::memory_order_acquire);
+	unsigned xb = (unsigned)v, yb = (unsigned)(v >> 32);
+	memcpy(x, &xb, sizeof(xb));
+	memcpy(y, &yb, sizeof(yb));
+}
+
+/*	ps_gather:
+ * 		Copies the newest position and in use flag of n players into plain arrays (one line read per player,
+ * 		no locks), the per tick view the disp build, snapshots and drawing work from.
+ */
+void ps_gather(const Player_Inbox_t* boxes, const std::atomic<unsigned char>* in_use, unsigned n, float* x, float* y, unsigned char* alive){
+	for(unsigned i=0; i<n; i++){
+		alive[i] = in_use[i].load(std::memory_order_acquire);
+		ps_peek(&boxes[i], &x[i], &y[i]);
+	}
+}
@@ -0,0 +1,182 @@
+#include "inc/RateControl.h"
+
+/*	rc_init:
+ * 		Starts a player's send rate at the ceiling with no rtt or loss history.
+ */
+void rc_init(Rate_Ctrl_t* rc, double min_rate, double max_rate, unsigned long long now_us){
+	if(rc == NULL){
+		return;
+	}
+	rc->min_rate = min_rate;
+	rc->max_rate = max_rate;
+	rc->rate = max_rate;
+	rc->loss = 0.0;
+	rc->srtt_us = 0;
+	rc->rttvar_us = 0;
+	rc->min_rtt_us = 0;
+	rc->min_rtt_at = now_us;
+	rc->last_update = now_us;
+	rc->last_feedback = now_us;
+	rc->next_send_us = now_us;
+	rc->seq = 0;
+	rc->last_echo_seq = 0;
+	rc->last_recv_count = 0;
+	rc->have_echo = 0;
+}
+
+/*	rc_next_seq:
+ * 		Numbers the next disp packet sent to the player (echoed back to measure rtt and loss).
+ *	returns: sequence number for the packet
+ */
+unsigned rc_next_seq(Rate_Ctrl_t* rc){
+	return ++(rc->seq);
+}
+
+/*	rc_clamp:
+ * 		Keeps the rate between the configured floor and ceiling.
+ */
+static void rc_clamp(Rate_Ctrl_t* rc){
+	if(rc->rate < rc->min_rate){
+		rc->rate = rc->min_rate;
+	}
+	if(rc->rate > rc->max_rate){
+		rc->rate = rc->max_rate;
+	}
+}
+
+/*	rc_on_feedback:
+ * 		Takes one echo from the player (newest disp seq and send time it saw, how long it held that
+ * 		echo before sending, and its running count of disp packets received).
+ * 		Updates rtt, min rtt and loss, then at most once per RC_UPDATE_US (or srtt if longer) moves the rate:
+ * 		multiplicative decrease on high loss or queueing delay, additive increase on a clear link.
+ */
+void rc_on_feedback(Rate_Ctrl_t* rc, unsigned echo_seq, unsigned echo_us, unsigned hold_us, unsigned recv_count, unsigned long long now_us){
+	if(rc == NULL){
+		return;
+	}
+	rc->last_feedback = now_us;
+	
+	//rtt sample (send times are the low 32 bits of the host clock so the subtraction wraps cleanly)
+	unsigned elapsed = (unsigned)now_us - echo_us;
+	if(elapsed > hold_us && (elapsed - hold_us) < RC_FEEDBACK_TIMEOUT_US * 10){
+		unsigned long long rtt = elapsed - hold_us;
+		if(rc->srtt_us == 0){
+			rc->srtt_us = rtt;
+			rc->rttvar_us = rtt / 2;
+		} else{
+			unsigned long long diff = (rtt > rc->srtt_us) ? (rtt - rc->srtt_us) : (rc->srtt_us - rtt);
+			rc->rttvar_us = ((3 * rc->rttvar_us) + diff) / 4;
+			rc->srtt_us = ((7 * rc->srtt_us) + rtt) / 8;
+		}
+		if(rc->min_rtt_us == 0 || rtt <= rc->min_rtt_us || now_us - rc->min_rtt_at > RC_MIN_RTT_WINDOW_US){
+			rc->min_rtt_us = rtt;
+			rc->min_rtt_at = now_us;
+		}
+	}
+	
+	//loss over the packets sent since the previous echo
+	if(!rc->have_echo){
+		rc->have_echo = 1;
+		rc->last_echo_seq = echo_seq;
+		rc->last_recv_count = recv_count;
+	} else if((int)(echo_seq - rc->last_echo_seq) > 0){
+		unsigned sent = echo_seq - rc->last_echo_seq;
+		unsigned got = recv_count - rc->last_recv_count;
+		double sample = (got >= sent) ? 0.0 : 1.0 - ((double)got / sent);
+		rc->loss += (sample - rc->loss) * 0.25;
+		rc->last_echo_seq = echo_seq;
+		rc->last_recv_count = recv_count;
+	}
+	
+	//rate decision
+	unsigned long long period = (rc->srtt_us > RC_UPDATE_US) ? rc->srtt_us : RC_UPDATE_US;
+	if(now_us - rc->last_update < period){
+		return;
+	}
+	rc->last_update = now_us;
+	unsigned long long queue_us = (rc->srtt_us > rc->min_rtt_us) ? (rc->srtt_us - rc->min_rtt_us) : 0;
+	if(rc->loss > RC_LOSS_HIGH || queue_us > RC_QUEUE_HIGH_US){
+		rc->rate *= RC_DECREASE;
+		//the decrease drains the queue so forget the old loss and let srtt settle before judging again
+		rc->loss = 0.0;
+		rc->srtt_us -= queue_us / 2;
+	} else if(rc->loss < RC_LOSS_LOW && queue_us < RC_QUEUE_LOW_US){
+		rc->rate += RC_INCREASE_PPS;
+	}
+	rc_clamp(rc);
+}
+
+/*	rc_next_send:
+ * 		Advances the send schedule by one interval at the current rate.
+ * 		A player that has gone quiet (no feedback for RC_FEEDBACK_TIMEOUT_US) has its rate halved.
+ *	returns: time (us) the next disp packet is due
+ */
+unsigned long long rc_next_send(Rate_Ctrl_t* rc, unsigned long long now_us){
+	if(now_us - rc->last_feedback > RC_FEEDBACK_TIMEOUT_US){
+		rc->rate /= 2;
+		rc->last_feedback = now_us;
+		rc_clamp(rc);
+	}
+	
+	unsigned long long interval = (unsigned long long)(1000000.0 / rc->rate);
+	rc->next_send_us += interval;
+	//do not burst to catch up after a stall
+	if(rc->next_send_us + interval < now_us){
+		rc->next_send_us = now_us + interval;
+	}
+	return rc->next_send_us;
+}
+
+/*	rc_echo_init:
+ * 		Clears the echo record of a joining player.
+ */
+void rc_echo_init(Rate_Echo_t* re){
+	if(re == NULL){
+		return;
+	}
+	pthread_mutex_init(&(re->lock), NULL);
+	re->seq = 0;
+	re->send_us = 0;
+	re->recv_count = 0;
+	re->recv_at = 0;
+	re->valid = 0;
+}
+
+/*	rc_echo_record:
+ * 		Counts a received disp packet and remembers it for the echo if it is the newest seen.
+ */
+void rc_echo_record(Rate_Echo_t* re, unsigned seq, unsigned send_us, unsigned long long now_us){
+	if(re == NULL){
+		return;
+	}
+	pthread_mutex_lock(&(re->lock));
+	(re->recv_count)++;
+	if(!re->valid || (int)(seq - re->seq) > 0){
+		re->seq = seq;
+		re->send_us = send_us;
+		re->recv_at = now_us;
+		re->valid = 1;
+	}
+	pthread_mutex_unlock(&(re->lock));
+}
+
+/*	rc_echo_get:
+ * 		Reads the values to echo back to the host in the next keys packet.
+ *	returns: 0 if an echo is available, -1 if no disp packet has arrived yet
+ */
+int rc_echo_get(Rate_Echo_t* re, unsigned long long now_us, unsigned* seq, unsigned* send_us, unsigned* hold_us, unsigned* recv_count){
+	if(re == NULL || seq == NULL || send_us == NULL || hold_us == NULL || recv_count == NULL){
+		return -1;
+	}
+	pthread_mutex_lock(&(re->lock));
+	if(!re->valid){
+		pthread_mutex_unlock(&(re->lock));
+		return -1;
+	}
+	*seq = re->seq;
+	*send_us = re->send_us;
+	*hold_us = (unsigned)(now_us - re->recv_at);
+	*recv_count = re->recv_count;
+	pthread_mutex_unlock(&(re->lock));
+	return 0;
+}
@@ -0,0 +1,203 @@
+#include "inc/Recorder.h"
+#include "inc/ConnectStruct.h"
+
+/*	rec_map:
+ * 		Maps the recording file at the given size, growing the file to match.
+ *	returns: 0 on success, -1 on error
+ */
+static int rec_map(Recorder_t* rec, unsigned long long size){
+	rec->map = CreateFileMappingA(rec->file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+	if(rec->map == NULL){
+		return -1;
+	}
+	rec->base = (char*)MapViewOfFile(rec->map, FILE_MAP_WRITE, 0, 0, (size_t)size);
+	if(rec->base == NULL){
+		CloseHandle(rec->map);
+		return -1;
+	}
+	rec->size = size;
+	return 0;
+}
+
+/*	rec_open:
+ * 		Creates the recording file, maps all REC_SIZE bytes of it (so appends never remap) and writes the
+ * 		header.
+ *	returns: 0 on success, -1 on error
+ */
+int rec_open(Recorder_t* rec, std::string path, char role, int crypt){
+	if(rec == NULL || rec->active || rec->base != NULL){
+		return -1;
+	}
+	
+	rec->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(rec->file == INVALID_HANDLE_VALUE){
+		return -1;
+	}
+	if(!rec->lock_ready){
+		pthread_mutex_init(&(rec->lock), NULL);
+		rec->lock_ready = 1;
+	}
+	rec->base = NULL;
+	if(rec_map(rec, REC_SIZE) == -1){
+		CloseHandle(rec->file);
+		return -1;
+	}
+	
+	Rec_File_Head_t* head = (Rec_File_Head_t*)rec->base;
+	memset(head, 0, sizeof(Rec_File_Head_t));
+	memcpy(head->magic, REC_MAGIC, sizeof(head->magic));
+	head->version = 1;
+	head->role = role;
+	head->crypt = (crypt != 0);
+	rec->start_ns = get_mono_ns();
+	head->start_ns = rec->start_ns;
+	rec->used = sizeof(Rec_File_Head_t);
+	head->used = rec->used;
+	rec->active = 1;
+	return 0;
+}
+
+/*	rec_write:
+ * 		Appends one datagram with its time, direction and peer. Does nothing if not recording. A datagram
+ * 		that does not fit in what is left of the file ends the recording.
+ *	returns: 0 on success (or not recording), -1 on error
+ */
+int rec_write(Recorder_t* rec, char dir, const struct sockaddr_in* addr, const char* buf, int len){
+	if(rec == NULL || !rec->active){
+		return 0;
+	}
+	if(buf == NULL || len < 0 || len > 0xFFFF){
+		return -1;
+	}
+	
+	unsigned long long need = (sizeof(Rec_Entry_t) + len + (REC_ALIGN - 1)) & ~(unsigned long long)(REC_ALIGN - 1);
+	pthread_mutex_lock(&(rec->lock));
+	if(!rec->active){
+		pthread_mutex_unlock(&(rec->lock));
+		return 0;
+	}
+	if(rec->used + need > rec->size){
+		rec->active = 0;
+		pthread_mutex_unlock(&(rec->lock));
+		return -1;
+	}
+	
+	Rec_Entry_t* entry = (Rec_Entry_t*)(rec->base + rec->used);
+	entry->time_ns = get_mono_ns() - rec->start_ns;
+	entry->addr = (addr != NULL) ? addr->sin_addr.S_un.S_addr : 0;
+	entry->port = (addr != NULL) ? addr->sin_port : 0;
+	entry->len = (unsigned short)len;
+	entry->dir = dir;
+	memset(entry->pad, 0, sizeof(entry->pad));
+	memcpy((char*)(entry + 1), buf, len);
+	rec->used += need;
+	((Rec_File_Head_t*)rec->base)->used = rec->used;
+	pthread_mutex_unlock(&(rec->lock));
+	return 0;
+}
+
+/*	rec_close:
+ * 		Stops recording, unmaps the file and trims it to the bytes actually written. The lock is kept for
+ * 		the next open.
+ *	returns: 0 on success (or not recording), -1 on error
+ */
+int rec_close(Recorder_t* rec){
+	if(rec == NULL || !rec->lock_ready){
+		return 0;
+	}
+	
+	pthread_mutex_lock(&(rec->lock));
+	if(rec->base == NULL){
+		pthread_mutex_unlock(&(rec->lock));
+		return 0;
+	}
+	rec->active = 0;
+	FlushViewOfFile(rec->base, (size_t)rec->used);
+	UnmapViewOfFile(rec->base);
+	CloseHandle(rec->map);
+	rec->base = NULL;
+	
+	LARGE_INTEGER end;
+	end.QuadPart = (LONGLONG)rec->used;
+	int ret = 0;
+	if(!SetFilePointerEx(rec->file, end, NULL, FILE_BEGIN) || !SetEndOfFile(rec->file)){
+		ret = -1;
+	}
+	CloseHandle(rec->file);
+	pthread_mutex_unlock(&(rec->lock));
+	return ret;
+}
+
+/*	rec_load:
+ * 		Maps a recording read only and checks its header.
+ *	returns: 0 on success, -1 on error
+ */
+int rec_load(Rec_Reader_t* rd, std::string path){
+	LARGE_INTEGER size;
+	if(rd == NULL){
+		return -1;
+	}
+	
+	rd->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(rd->file == INVALID_HANDLE_VALUE){
+		return -1;
+	}
+	if(!GetFileSizeEx(rd->file, &size) || (unsigned long long)size.QuadPart < sizeof(Rec_File_Head_t)){
+		CloseHandle(rd->file);
+		return -1;
+	}
+	rd->map = CreateFileMappingA(rd->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(rd->map == NULL){
+		CloseHandle(rd->file);
+		return -1;
+	}
+	rd->base = (const char*)MapViewOfFile(rd->map, FILE_MAP_READ, 0, 0, 0);
+	if(rd->base == NULL){
+		CloseHandle(rd->map);
+		CloseHandle(rd->file);
+		return -1;
+	}
+	
+	//an unclosed recording is longer than its used count, a cut short one is shorter
+	const Rec_File_Head_t* head = (const Rec_File_Head_t*)rd->base;
+	if(memcmp(head->magic, REC_MAGIC, sizeof(REC_MAGIC)) != 0 || head->version != 1){
+		rec_unload(rd);
+		return -1;
+	}
+	rd->used = (head->used < (unsigned long long)size.QuadPart) ? head->used : (unsigned long long)size.QuadPart;
+	rd->pos = sizeof(Rec_File_Head_t);
+	rd->role = head->role;
+	rd->crypt = head->crypt;
+	return 0;
+}
+
+/*	rec_next:
+ * 		Steps to the next entry of a loaded recording (the datagram follows the entry header).
+ *	returns: the entry, NULL at the end of the recording
+ */
+const Rec_Entry_t* rec_next(Rec_Reader_t* rd){
+	if(rd == NULL || rd->base == NULL || rd->pos + sizeof(Rec_Entry_t) > rd->used){
+		return NULL;
+	}
+	
+	const Rec_Entry_t* entry = (const Rec_Entry_t*)(rd->base + rd->pos);
+	unsigned long long next = rd->pos + ((sizeof(Rec_Entry_t) + entry->len + (REC_ALIGN - 1)) & ~(unsigned long long)(REC_ALIGN - 1));
+	if(next > rd->used){
+		return NULL;
+	}
+	rd->pos = next;
+	return entry;
+}
+
+/*	rec_unload:
+ * 		Unmaps a loaded recording.
+ */
+void rec_unload(Rec_Reader_t* rd){
+	if(rd == NULL || rd->base == NULL){
+		return;
+	}
+	UnmapViewOfFile(rd->base);
+	CloseHandle(rd->map);
+	CloseHandle(rd->file);
+	rd->base = NULL;
+}
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "inc/ConnectStruct.h"
+#include "inc/RecvStamp.h"
+
+/*	rs_init:
+ * 		Asks the network stack to timestamp the datagrams arriving on s, falling back to stamping them in
+ * 		the recv thread where the stack cannot (older Windows or no WSARecvMsg).
+ *	returns: the timestamp source (RS_KERNEL or RS_USER)
+ */
+int rs_init(Recv_Stamp_t* rs, SOCKET s){
+	rs->recv_msg = NULL;
+	rs->source = RS_USER;
+	rs->missing = 0;
+	
+	GUID guid = WSAID_WSARECVMSG;
+	LPFN_WSARECVMSG recv_msg = NULL;
+	DWORD bytes = 0;
+	if(WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &recv_msg, sizeof(recv_msg), &bytes, NULL, NULL) == SOCKET_ERROR
+			|| recv_msg == NULL){
+		return rs->source;
+	}
+	TIMESTAMPING_CONFIG config;
+	memset((char*)&config, 0, sizeof(config));
+	config.Flags = TIMESTAMPING_FLAG_RX;
+	if(WSAIoctl(s, SIO_TIMESTAMPING, &config, sizeof(config), NULL, 0, &bytes, NULL, NULL) == SOCKET_ERROR){
+		return rs->source;
+	}
+	rs->recv_msg = recv_msg;
+	rs->source = RS_KERNEL;
+	return rs->source;
+}
+
+/*	rs_recvfrom:
+ * 		recvfrom that also gives the datagram's arrival time on the get_mono_ns clock, from the network stack
+ * 		when kernel stamps are on, otherwise (or when the stack left a datagram unstamped) when the call returned.
+ *	returns: bytes received, or SOCKET_ERROR like recvfrom (WSAEWOULDBLOCK when nothing is waiting)
+ */
+int rs_recvfrom(Recv_Stamp_t* rs, SOCKET s, char* buf, int len, struct sockaddr_in* from, int* fromlen, unsigned long long* arrive_ns){
+	if(rs->recv_msg == NULL){
+		int numbytes = recvfrom(s, buf, len, 0, (struct sockaddr*)from, fromlen);
+		*arrive_ns = get_mono_ns();
+		return numbytes;
+	}
+	
+	//one datagram buffer and room for the timestamp control message
+	unsigned long long control[(WSA_CMSG_SPACE(sizeof(UINT64)) + 7) / 8];
+	WSABUF data;
+	data.buf = buf;
+	data.len = len;
+	WSAMSG msg;
+	msg.name = (LPSOCKADDR)from;
+	msg.namelen = *fromlen;
+	msg.lpBuffers = &data;
+	msg.dwBufferCount = 1;
+	msg.Control.buf = (CHAR*)control;
+	msg.Control.len = sizeof(control);
+	msg.dwFlags = 0;
+	DWORD numbytes = 0;
+	if(rs->recv_msg(s, &msg, &numbytes, NULL, NULL) == SOCKET_ERROR){
+		return SOCKET_ERROR;
+	}
+	*fromlen = msg.namelen;
+	
+	*arrive_ns = 0;
+	for(WSACMSGHDR* c = WSA_CMSG_FIRSTHDR(&msg); c != NULL; c = WSA_CMSG_NXTHDR(&msg, c)){
+		if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMP){
+			UINT64 count;
+			memcpy(&count, WSA_CMSG_DATA(c), sizeof(count));
+			*arrive_ns = qpc_to_ns(count);
+		}
+	}
+	if(*arrive_ns == 0){
+		rs->missing++;
+		*arrive_ns = get_mono_ns();
+	}
+	return (int)numbytes;
+}
+
+/*	rs_source_name:
+ *	returns: the timestamp source for the log
+ */
+const char* rs_source_name(int source){
+	return (source == RS_KERNEL) ? "network stack" : "recv thread";
+}
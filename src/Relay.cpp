@@ -0,0 +1,294 @@
+#include "inc/Relay.h"
+
+/*	relay_find_room:
+ * 		Looks up the room a token names.
+ *	returns: the room, NULL for a free room or a stale token
+ */
+static Relay_Room_t* relay_find_room(Relay_Server_t* rs, unsigned int token){
+	unsigned id = (token & 0xFFFF) - 1;
+	if(token == 0 || id >= RELAY_MAX_ROOMS || rs->rooms[id].token != token){
+		return NULL;
+	}
+	return &(rs->rooms[id]);
+}
+
+/*	relay_room_timeout:
+ * 		Ttl timer callback (one per room) run by the relay thread.
+ * 		Host traffic only refreshes last_seen, so when this fires it either pushes the deadline out to
+ * 		match the latest datagram or frees the room of a host that has gone silent.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+static void relay_room_timeout(void* input){
+	Relay_Room_t* room = (Relay_Room_t*) input;
+	Relay_Server_t* rs = room->rs;
+	
+	if(room->last_seen + RELAY_TTL > rs->now){
+		tw_add(&(rs->wheel), &(room->ttl_timer), room->last_seen + RELAY_TTL);
+		return;
+	}
+	log_out(&(rs->log), "Room " + std::to_string(room->token) + " timed out\n");
+	room->token = 0;
+	rs->free_rooms[(rs->free_room_count)++] = room->id;
+}
+
+/*	relay_peer_timeout:
+ * 		Ttl timer callback (one per join), as relay_room_timeout for the joins.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+static void relay_peer_timeout(void* input){
+	Relay_Peer_t* peer = (Relay_Peer_t*) input;
+	Relay_Server_t* rs = peer->rs;
+	
+	if(peer->last_seen + RELAY_TTL > rs->now){
+		tw_add(&(rs->wheel), &(peer->ttl_timer), peer->last_seen + RELAY_TTL);
+		return;
+	}
+	pt_remove(&(rs->peer_index), &(peer->addr));
+	peer->token = 0;
+	rs->free_peers[(rs->free_peer_count)++] = peer->id;
+}
+
+/*	relay_bind:
+ * 		Hands a host a new room (token 0) or refreshes the room its token names, then writes the answer
+ * 		(a bare trailer with the token, 0 if the relay is full) over the datagram.
+ *	returns: length of the answer
+ */
+static int relay_bind(Relay_Server_t* rs, char* buf, unsigned int token, const struct sockaddr_in* from){
+	Relay_Room_t* room = relay_find_room(rs, token);
+	if(room != NULL && !same_addr(&(room->host), from)){
+		//only the host a room was handed to may refresh it
+		room = NULL;
+	}
+	//a new host (or one whose room expired) gets a new room
+	token = 0;
+	if(room == NULL && rs->free_room_count > 0){
+		room = &(rs->rooms[rs->free_rooms[--(rs->free_room_count)]]);
+		(rs->gen)++;
+		room->token = ((unsigned int)rs->gen << 16) | (unsigned int)(room->id + 1);
+		room->host = *from;
+		room->last_seen = rs->now;
+		tw_add(&(rs->wheel), &(room->ttl_timer), rs->now + RELAY_TTL);
+		log_out(&(rs->log), "Room " + std::to_string(room->token) + " bound to " + inet_ntoa(from->sin_addr) + ":"
+				+ std::to_string(ntohs(from->sin_port)) + "\n");
+	}
+	if(room != NULL){
+		room->last_seen = rs->now;
+		token = room->token;
+	}
+	(rs->binds)++;
+	return relay_wrap(buf, 0, token, NULL, RELAY_BIND);
+}
+
+/*	relay_init:
+ * 		Opens and binds the relay's UDP socket, sets up the free rooms and joins and starts the relay thread.
+ *	returns: 0 on success, other on error
+ */
+int relay_init(Relay_Server_t* rs, unsigned short port){
+	//null check
+	if(rs == NULL){
+		return -1;
+	}
+	
+	//open the non-blocking UDP socket on the port
+	int ret = udp_bind(&(rs->wsa), &(rs->s), &(rs->server), port, &(rs->err));
+	if(ret != 0){
+		return ret;
+	}
+	
+	//free rooms and joins (handed out from the low ids)
+	if(pt_init(&(rs->peer_index), RELAY_MAX_PEERS) == -1){
+		err_out(&(rs->err), "Peer Table Not Created\n");
+		return -1;
+	}
+	rs->now = get_mono_ms();
+	tw_init(&(rs->wheel), rs->now);
+	rs->rooms = new Relay_Room_t[RELAY_MAX_ROOMS];
+	rs->free_rooms = new int[RELAY_MAX_ROOMS];
+	for(int i=0; i<RELAY_MAX_ROOMS; i++){
+		rs->rooms[i].rs = rs;
+		rs->rooms[i].id = i;
+		rs->rooms[i].token = 0;
+		timer_init(&(rs->rooms[i].ttl_timer), relay_room_timeout, (void*)&(rs->rooms[i]));
+		rs->free_rooms[i] = RELAY_MAX_ROOMS - 1 - i;
+	}
+	rs->free_room_count = RELAY_MAX_ROOMS;
+	rs->peers = new Relay_Peer_t[RELAY_MAX_PEERS];
+	rs->free_peers = new int[RELAY_MAX_PEERS];
+	for(int i=0; i<RELAY_MAX_PEERS; i++){
+		rs->peers[i].rs = rs;
+		rs->peers[i].id = i;
+		rs->peers[i].token = 0;
+		timer_init(&(rs->peers[i].ttl_timer), relay_peer_timeout, (void*)&(rs->peers[i]));
+		rs->free_peers[i] = RELAY_MAX_PEERS - 1 - i;
+	}
+	rs->free_peer_count = RELAY_MAX_PEERS;
+	rs->gen = (unsigned short)(get_mono_ns() & 0xFFFF);
+	
+	rs->bufs = new char[RELAY_BATCH][MAX_PACKET_LEN];
+	rs->lens = new int[RELAY_BATCH];
+	rs->from = new struct sockaddr_in[RELAY_BATCH];
+	rs->forwarded = 0;
+	rs->dropped = 0;
+	rs->binds = 0;
+	rs->batches = 0;
+	rs->busy_ns = 0;
+	rs->exit = 0;
+	pthread_create(&(rs->thread), NULL, relay_run, (void*)rs);
+	
+	log_out(&(rs->log), "Relay listening on port " + std::to_string(port) + "\n");
+	return 0;
+}
+
+/*	relay_quit:
+ * 		Stops the relay thread, closes the socket and frees the tables.
+ *	returns: 0 for success, -1 for error
+ */
+int relay_quit(Relay_Server_t* rs){
+	if(rs == NULL){
+		return -1;
+	}
+	
+	rs->exit = 1;
+	if(pthread_join(rs->thread, NULL) != 0){
+		err_out(&(rs->err), "Error ending relay thread\n");
+	}
+	closesocket(rs->s);
+	WSACleanup();
+	
+	tw_destroy(&(rs->wheel));
+	pt_destroy(&(rs->peer_index));
+	delete[] rs->rooms;
+	delete[] rs->free_rooms;
+	delete[] rs->peers;
+	delete[] rs->free_peers;
+	delete[] rs->bufs;
+	delete[] rs->lens;
+	delete[] rs->from;
+	log_out(&(rs->log), "Relay closed\n");
+	return 0;
+}
+
+/*	relay_run:
+ * 		Relay thread function.
+ * 		Reads up to RELAY_BATCH datagrams, turns the ttl wheel once for the batch, then forwards each from
+ * 		the buffer it was read into. Only waits on the socket after a short batch (the socket is drained).
+ * 		Winsock has no multi datagram recv or send, so the batch saves the wait, clock read and wheel turn
+ * 		per datagram rather than system calls.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* relay_run(void* input){
+	Relay_Server_t* rs = (Relay_Server_t*) input;
+	int slen = sizeof(struct sockaddr_in);
+	int full = 0;
+	
+	while(!rs->exit){
+		if(!full){
+			//wait up to a ms so the exit flag and the ttl timers are still seen on a quiet socket
+			fd_set ready;
+			FD_ZERO(&ready);
+			FD_SET(rs->s, &ready);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 1000;
+			if(select((int)rs->s + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+				err_out(&(rs->err), "Select Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+				continue;
+			}
+		}
+		unsigned long long start = get_mono_ns();
+		
+		int n = 0;
+		while(n < RELAY_BATCH){
+			slen = sizeof(struct sockaddr_in);
+			if((rs->lens[n] = recvfrom(rs->s, rs->bufs[n], MAX_PACKET_LEN, 0, (struct sockaddr*)&(rs->from[n]), &slen)) == SOCKET_ERROR){
+				//a send to a peer that has gone away resets the next recv on windows, which is not fatal here
+				if(WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAECONNRESET){
+					err_out(&(rs->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+				}
+				break;
+			}
+			n++;
+		}
+		full = (n == RELAY_BATCH);
+		
+		rs->now = start / 1000000ULL;
+		tw_advance(&(rs->wheel), rs->now);
+		for(int i=0; i<n; i++){
+			relay_forward(rs, rs->bufs[i], rs->lens[i], &(rs->from[i]));
+		}
+		if(n > 0){
+			(rs->batches)++;
+			rs->busy_ns += get_mono_ns() - start;
+		}
+	}
+	pthread_exit(NULL);
+}
+
+/*	relay_forward:
+ * 		Forwards one datagram by its trailer, rewriting the trailer in place (the payload is never read).
+ * 		From a room's host it goes to the join named in the trailer, if that join is in the same room.
+ * 		From anyone else it goes to the host of the room the token names, with the sender's address in the
+ * 		trailer, and the sender is kept as a join of that room. Binds are answered to the sender.
+ *	returns: 0 if the datagram was sent on, -1 if it was dropped
+ */
+int relay_forward(Relay_Server_t* rs, char* buf, int len, const struct sockaddr_in* from){
+	Relay_Trailer_t t;
+	int plain = relay_unwrap(buf, len, &t);
+	if(plain == -1){
+		(rs->dropped)++;
+		return -1;
+	}
+	
+	const struct sockaddr_in* dest;
+	struct sockaddr_in join;
+	if(t.flags == RELAY_BIND){
+		len = relay_bind(rs, buf, t.token, from);
+		dest = from;
+	} else{
+		Relay_Room_t* room = relay_find_room(rs, t.token);
+		if(room == NULL){
+			(rs->dropped)++;
+			return -1;
+		}
+		
+		if(same_addr(&(room->host), from)){
+			//host to join
+			memset((char*)&join, 0, sizeof(join));
+			join.sin_family = AF_INET;
+			join.sin_addr.S_un.S_addr = t.addr;
+			join.sin_port = t.port;
+			int p = pt_find(&(rs->peer_index), &join);
+			if(p == -1 || rs->peers[p].token != t.token){
+				(rs->dropped)++;
+				return -1;
+			}
+			room->last_seen = rs->now;
+			relay_wrap(buf, plain, t.token, NULL, RELAY_DATA);
+			dest = &join;
+		} else{
+			//join to host
+			int p = pt_find(&(rs->peer_index), from);
+			if(p == -1){
+				if(rs->free_peer_count == 0){
+					(rs->dropped)++;
+					return -1;
+				}
+				p = rs->free_peers[--(rs->free_peer_count)];
+				rs->peers[p].addr = *from;
+				pt_insert(&(rs->peer_index), from, p);
+				tw_add(&(rs->wheel), &(rs->peers[p].ttl_timer), rs->now + RELAY_TTL);
+			}
+			rs->peers[p].token = t.token;
+			rs->peers[p].last_seen = rs->now;
+			relay_wrap(buf, plain, t.token, from, RELAY_DATA);
+			dest = &(room->host);
+		}
+	}
+	
+	if(sendto(rs->s, buf, len, 0, (struct sockaddr*)dest, sizeof(*dest)) == SOCKET_ERROR){
+		(rs->dropped)++;
+		return -1;
+	}
+	(rs->forwarded)++;
+	return 0;
+}
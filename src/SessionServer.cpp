@@ -0,0 +1,520 @@
+#include <malloc.h>
+#include <time.h>
+#include <new>
+
+#include "inc/SessionServer.h"
+#include "inc/HostConnect.h"
+
+/*	ss_init:
+ * 		Opens and binds the shared UDP socket, sets up an empty session table and starts the demux thread
+ * 		and the fixed set of worker threads that run the sessions.
+ *	returns: 0 on success, other on error
+ */
+int ss_init(Session_Server_t* ss, unsigned short port, unsigned max_sessions, int n_workers){
+	//null check
+	if(ss == NULL || max_sessions == 0 || max_sessions > MAX_SESSIONS || n_workers < 1){
+		return -1;
+	}
+	
+	//open the non-blocking UDP socket on the port
+	int ret = udp_bind(&(ss->wsa), &(ss->s), &(ss->server), port, &(ss->err));
+	if(ret != 0){
+		return ret;
+	}
+	
+	//empty session table
+	ss->max_sessions = max_sessions;
+	ss->next_id = 1;
+	ss->sessions = new Conn_Info_t*[max_sessions + 1];
+	ss->owner = new std::atomic<int>[max_sessions + 1];
+	ss->closing = new char[max_sessions + 1];
+	for(unsigned i=0; i<=max_sessions; i++){
+		ss->sessions[i] = NULL;
+		ss->owner[i] = -1;
+		ss->closing[i] = 0;
+	}
+	pthread_mutex_init(&(ss->open_lock), NULL);
+	if(ad_init(&(ss->admit), max_sessions * MAX_PLAYER, ADMIT_IDLE) == -1){
+		err_out(&(ss->err), "Admission Table Not Created\n");
+		return -1;
+	}
+	ad_rate(&(ss->admit), AD_PLAYER, ADMIT_PPS, ADMIT_BURST);
+	ss->received = 0;
+	ss->no_session = 0;
+	ss->queue_full = 0;
+	ss->exit = 0;
+	if(ss->crypt.enabled){
+		log_out(&(ss->log), std::string("Packet encryption enabled (") + (crypt_init() ? "AES-NI" : "portable AES") + ")\n");
+	}
+	
+	//start the workers then the demux thread that feeds them
+	ss->n_workers = n_workers;
+	ss->workers = new Session_Worker_t[n_workers];
+	for(int i=0; i<n_workers; i++){
+		Session_Worker_t* w = &(ss->workers[i]);
+		w->ss = ss;
+		w->id = i;
+		w->queue = new Session_Packet_t[SESSION_QUEUE];
+		w->head = 0;
+		w->tail = 0;
+		pthread_mutex_init(&(w->lock), NULL);
+		pthread_mutex_init(&(w->wake_lock), NULL);
+		pthread_cond_init(&(w->wake), NULL);
+		w->handled = 0;
+		w->rejected = 0;
+		w->timers = 0;
+		w->busy_ns = 0;
+		pthread_create(&(w->thread), NULL, ss_worker, (void*)w);
+	}
+	pthread_create(&(ss->recv_thread), NULL, ss_recv, (void*)ss);
+	
+	log_out(&(ss->log), "Session server listening on port " + std::to_string(port) + " with " + std::to_string(n_workers) + " workers\n");
+	return 0;
+}
+
+/*	ss_quit:
+ * 		Closes every open session (quitting its players), stops the threads and closes the socket.
+ *	returns: 0 for success, -1 for error
+ */
+int ss_quit(Session_Server_t* ss){
+	if(ss == NULL){
+		return -1;
+	}
+	
+	//send every game's quit requests at once, then close them (most have their acks by then)
+	pthread_mutex_lock(&(ss->open_lock));
+	for(unsigned i=1; i<=ss->max_sessions; i++){
+		if(ss->owner[i] != -1){
+			ss_quit_players(ss->sessions[i]);
+		}
+	}
+	pthread_mutex_unlock(&(ss->open_lock));
+	for(unsigned i=1; i<=ss->max_sessions; i++){
+		if(ss->owner[i] != -1){
+			ss_close_session(ss, i);
+		}
+	}
+	
+	//stop the demux thread first so nothing is queued for a stopped worker
+	ss->exit = 1;
+	if(pthread_join(ss->recv_thread, NULL) != 0){
+		err_out(&(ss->err), "Error ending recv thread\n");
+	}
+	for(int i=0; i<ss->n_workers; i++){
+		ss_wake(&(ss->workers[i]));
+		if(pthread_join(ss->workers[i].thread, NULL) != 0){
+			err_out(&(ss->err), "Error ending worker thread\n");
+		}
+		pthread_mutex_destroy(&(ss->workers[i].lock));
+		pthread_mutex_destroy(&(ss->workers[i].wake_lock));
+		pthread_cond_destroy(&(ss->workers[i].wake));
+		delete[] ss->workers[i].queue;
+	}
+	delete[] ss->workers;
+	delete[] ss->sessions;
+	delete[] ss->owner;
+	delete[] ss->closing;
+	pthread_mutex_destroy(&(ss->open_lock));
+	if(ss->admit.dropped > 0){
+		log_out(&(ss->log), "Dropped " + std::to_string(ss->admit.dropped) + " datagrams over their source rate\n");
+	}
+	ad_destroy(&(ss->admit));
+	
+	closesocket(ss->s);
+	WSACleanup();
+	log_out(&(ss->log), "Session server closed\n");
+	return 0;
+}
+
+/*	ss_open_session:
+ * 		Creates a new game on the server: a host state with its own players, peer index, timers and logs
+ * 		but no self player, handed to the worker running the fewest sessions.
+ *	returns: session id (joins name it as address:port/id), -1 on error or when the server is full
+ */
+int ss_open_session(Session_Server_t* ss){
+	if(ss == NULL){
+		return -1;
+	}
+	
+	//find a free id (round robin so a closed id is not handed straight back out)
+	pthread_mutex_lock(&(ss->open_lock));
+	int id = -1;
+	for(unsigned n=0; n<ss->max_sessions; n++){
+		unsigned i = ((ss->next_id - 1 + n) % ss->max_sessions) + 1;
+		if(ss->owner[i] == -1){
+			id = i;
+			break;
+		}
+	}
+	if(id == -1){
+		pthread_mutex_unlock(&(ss->open_lock));
+		err_out(&(ss->err), "Session Not Opened. Server full\n");
+		return -1;
+	}
+	ss->next_id = (id % ss->max_sessions) + 1;
+	
+	//the player store lines are cache aligned and new is not before c++17
+	void* mem = _aligned_malloc(sizeof(Conn_Info_t), CACHE_LINE);
+	if(mem == NULL){
+		pthread_mutex_unlock(&(ss->open_lock));
+		err_out(&(ss->err), "Session Not Opened. Out of memory\n");
+		return -1;
+	}
+	Conn_Info_t* conn = new(mem) Conn_Info_t();
+	conn->s = ss->s;
+	conn->server = ss->server;
+	conn->session_id = (unsigned short)id;
+	conn->replay = 0;
+	conn->crypt.enabled = ss->crypt.enabled;
+	conn->crypt.base = ss->crypt.base;
+	conn->lobby = ss->lobby;
+	conn->use_lobby = ss->use_lobby;
+	snprintf(conn->game_name, LOBBY_NAME_LEN, "game %d", id);
+	#if LOG
+	conn->log.open("log/" + std::to_string(get_timestamp()) + "_s" + std::to_string(id) + ".log");
+	#endif
+	#if ERR
+	conn->err.open("log/" + std::to_string(get_timestamp()) + "_s" + std::to_string(id) + ".err");
+	#endif
+	if(host_init_state(conn) == -1){
+		conn->~Conn_Info_t();
+		_aligned_free(mem);
+		pthread_mutex_unlock(&(ss->open_lock));
+		return -1;
+	}
+	
+	//dedicated game: slot 0 is the host's own player on a single game host, here it stays empty
+	conn->store.in_use[0] = 0;
+	memset((char*)&(conn->players[0].p_addr), 0, sizeof(conn->players[0].p_addr));
+	
+	//hand it to the least loaded worker
+	int best = 0;
+	for(int i=1; i<ss->n_workers; i++){
+		pthread_mutex_lock(&(ss->workers[i].lock));
+		size_t load = ss->workers[i].sessions.size();
+		pthread_mutex_unlock(&(ss->workers[i].lock));
+		pthread_mutex_lock(&(ss->workers[best].lock));
+		size_t best_load = ss->workers[best].sessions.size();
+		pthread_mutex_unlock(&(ss->workers[best].lock));
+		if(load < best_load){
+			best = i;
+		}
+	}
+	Session_Worker_t* w = &(ss->workers[best]);
+	pthread_mutex_lock(&(w->lock));
+	w->sessions.push_back(conn);
+	ss->sessions[id] = conn;
+	ss->owner[id] = best;
+	pthread_mutex_unlock(&(w->lock));
+	pthread_mutex_unlock(&(ss->open_lock));
+	
+	log_out(&(ss->log), "Session " + std::to_string(id) + " opened on worker " + std::to_string(best) + "\n");
+	return id;
+}
+
+/*	ss_close_session:
+ * 		Ends a game: sends quit requests to its players (retransmitted by its worker until acked or the
+ * 		players time out), then takes it off its worker and frees it. The id is marked closing so the wait
+ * 		for the acks runs without open_lock (opens, closes and counts of other games go on meanwhile) and
+ * 		a second close of the same game is turned away.
+ *	returns: 0 for success, -1 for error
+ */
+int ss_close_session(Session_Server_t* ss, int session_id){
+	if(ss == NULL || session_id < 1 || session_id > (int)ss->max_sessions){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(ss->open_lock));
+	int owner = ss->owner[session_id];
+	if(owner == -1 || ss->closing[session_id]){
+		pthread_mutex_unlock(&(ss->open_lock));
+		return -1;
+	}
+	ss->closing[session_id] = 1;
+	Session_Worker_t* w = &(ss->workers[owner]);
+	Conn_Info_t* conn = ss->sessions[session_id];
+	pthread_mutex_unlock(&(ss->open_lock));
+	
+	ss_quit_players(conn);
+	
+	//wait for every player to ack (the liveness timeouts clear the silent ones)
+	unsigned long long now = get_mono_ms();
+	int all_quit = 0;
+	while(!all_quit && get_mono_ms() < now + PLAYER_LOST){
+		all_quit = 1;
+		for(int i=1; i<MAX_PLAYER; i++){
+			if(conn->store.in_use[i]){
+				all_quit = 0;
+			}
+		}
+		pthread_mutex_lock(&(conn->exit_lock));
+		if(conn->exit){
+			all_quit = 1;
+		}
+		pthread_mutex_unlock(&(conn->exit_lock));
+		if(!all_quit){
+			Sleep(1);
+		}
+	}
+	
+	//take it off the worker (queued packets for the id are dropped once the owner is cleared)
+	pthread_mutex_lock(&(ss->open_lock));
+	pthread_mutex_lock(&(w->lock));
+	for(size_t i=0; i<w->sessions.size(); i++){
+		if(w->sessions[i] == conn){
+			w->sessions[i] = w->sessions.back();
+			w->sessions.pop_back();
+			break;
+		}
+	}
+	ss->sessions[session_id] = NULL;
+	ss->owner[session_id] = -1;
+	ss->closing[session_id] = 0;
+	pthread_mutex_unlock(&(w->lock));
+	pthread_mutex_unlock(&(ss->open_lock));
+	
+	host_lobby_remove(conn);
+	tw_destroy(&(conn->wheel));
+	pt_destroy(&(conn->peers));
+	sh_destroy(&(conn->snaps));
+	ecs_query_destroy(&(conn->player_query));
+	ecs_query_destroy(&(conn->hitbox_query));
+	ecs_destroy(&(conn->world));
+	col_destroy(&(conn->col));
+	pthread_mutex_destroy(&(conn->world_lock));
+	#if ERR
+	conn->err.close();
+	#endif
+	#if LOG
+	conn->log.close();
+	#endif
+	conn->~Conn_Info_t();
+	_aligned_free((void*)conn);
+	
+	log_out(&(ss->log), "Session " + std::to_string(session_id) + " closed\n");
+	return 0;
+}
+
+/*	ss_session_players:
+ * 		Counts the players connected to a game.
+ *	returns: number of players, -1 for error or a free id
+ */
+int ss_session_players(Session_Server_t* ss, int session_id){
+	if(ss == NULL || session_id < 1 || session_id > (int)ss->max_sessions){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(ss->open_lock));
+	int owner = ss->owner[session_id];
+	if(owner == -1){
+		pthread_mutex_unlock(&(ss->open_lock));
+		return -1;
+	}
+	int count = 0;
+	for(int i=1; i<MAX_PLAYER; i++){
+		if(ss->sessions[session_id]->store.in_use[i]){
+			count++;
+		}
+	}
+	pthread_mutex_unlock(&(ss->open_lock));
+	return count;
+}
+
+// ##################################################################### Thread Functions and Helpers
+
+/*	ss_quit_players:
+ * 		Pauses a game's disp sends and starts the quit request retransmits for each of its connected players
+ * 		(run by its worker until acked or the player times out), as quit_host does for a single game.
+ *	returns: 0 for success, -1 for error
+ */
+int ss_quit_players(Conn_Info_t* conn){
+	if(conn == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(conn->send_p_lock));
+	conn->send_p = 1;
+	pthread_mutex_unlock(&(conn->send_p_lock));
+	unsigned long long now = get_mono_ms();
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(conn->players[i].lock));
+		if(conn->store.in_use[i] && !tw_pending(&(conn->wheel), &(conn->players[i].retx_timer))){
+			tw_add(&(conn->wheel), &(conn->players[i].retx_timer), now);
+		}
+		pthread_mutex_unlock(&(conn->players[i].lock));
+	}
+	return 0;
+}
+
+/*	ss_recv:
+ * 		Demux thread function for the session server.
+ * 		Waits for the shared socket to be readable, drains every waiting datagram into the queue of the worker
+ * 		that owns its session, then wakes each worker that was given packets once.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* ss_recv(void* input){
+	Session_Server_t* ss = (Session_Server_t*) input;
+	char buf[MAX_PACKET_LEN];
+	struct sockaddr_in si_other;
+	int slen = sizeof(si_other);
+	int numbytes;
+	
+	//null check
+	if(ss == NULL){
+		pthread_exit(NULL);
+	}
+	std::vector<char> touched(ss->n_workers, 0);
+	
+	while(!ss->exit){
+		//wait up to a ms so the exit flag is still seen on a quiet socket
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(ss->s, &ready);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 1000;
+		if(select((int)ss->s + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+			err_out(&(ss->err), "Select Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+			continue;
+		}
+		
+		while((numbytes = recvfrom(ss->s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+			int w = ss_route(ss, buf, numbytes, &si_other);
+			if(w != -1){
+				touched[w] = 1;
+			}
+		}
+		//a send to a player that has gone away resets the next recv on windows, which is not fatal here
+		if(WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAECONNRESET){
+			err_out(&(ss->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+		}
+		
+		for(int i=0; i<ss->n_workers; i++){
+			if(touched[i]){
+				touched[i] = 0;
+				ss_wake(&(ss->workers[i]));
+			}
+		}
+	}
+	pthread_exit(NULL);
+}
+
+/*	ss_route:
+ * 		Queues one datagram for the worker owning the session named in its header. Only the demux thread
+ * 		(or a test standing in for it) may call this. The worker is not woken, see ss_wake. Sources over
+ * 		their datagram rate are dropped first.
+ *	returns: index of the worker given the packet, -1 if it was dropped
+ */
+int ss_route(Session_Server_t* ss, const char* buf, int numbytes, const struct sockaddr_in* si_other){
+	if(ss == NULL || buf == NULL || si_other == NULL){
+		return -1;
+	}
+	(ss->received)++;
+	
+	//a source over its rate is dropped before its datagram is looked at or copied (the demux does not know
+	//which sources hold player slots, so every source gets the player rate)
+	if(!ad_admit(&(ss->admit), si_other, AD_PLAYER, get_mono_ms())){
+		return -1;
+	}
+	
+	//the session id is in the clear even on encrypted packets
+	if(numbytes < PACKET_HEAD_LEN || numbytes > MAX_PACKET_LEN){
+		(ss->no_session)++;
+		return -1;
+	}
+	unsigned short id = ((const Header_t*)buf)->session_id;
+	if(id == 0 || id > ss->max_sessions || ss->owner[id] == -1){
+		(ss->no_session)++;
+		return -1;
+	}
+	int owner = ss->owner[id];
+	Session_Worker_t* w = &(ss->workers[owner]);
+	
+	unsigned head = w->head.load(std::memory_order_relaxed);
+	if(head - w->tail.load(std::memory_order_acquire) >= SESSION_QUEUE){
+		(ss->queue_full)++;
+		return -1;
+	}
+	Session_Packet_t* pkt = &(w->queue[head & (SESSION_QUEUE - 1)]);
+	pkt->session_id = id;
+	pkt->numbytes = numbytes;
+	pkt->si_other = *si_other;
+	memcpy(pkt->buf, buf, numbytes);
+	w->head.store(head + 1, std::memory_order_release);
+	return owner;
+}
+
+/*	ss_wake:
+ * 		Wakes a worker waiting for packets or its next tick.
+ */
+void ss_wake(Session_Worker_t* w){
+	pthread_mutex_lock(&(w->wake_lock));
+	pthread_cond_signal(&(w->wake));
+	pthread_mutex_unlock(&(w->wake_lock));
+}
+
+/*	ss_worker:
+ * 		Worker thread function for the session server.
+ * 		Each pass runs the packet handler for every queued datagram and turns the timer wheel of every owned
+ * 		session (disp sends, snapshots, retransmits and timeouts), then sleeps until the next ms tick or
+ * 		until the demux thread queues more packets. Only passes that did work count as busy time.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* ss_worker(void* input){
+	Session_Worker_t* w = (Session_Worker_t*) input;
+	Session_Server_t* ss = w->ss;
+	
+	while(!ss->exit){
+		unsigned long long start = get_mono_ns();
+		int work = 0;
+		
+		pthread_mutex_lock(&(w->lock));
+		unsigned tail = w->tail.load(std::memory_order_relaxed);
+		unsigned head = w->head.load(std::memory_order_acquire);
+		while(tail != head){
+			Session_Packet_t* pkt = &(w->queue[tail & (SESSION_QUEUE - 1)]);
+			//the session may have closed (or moved to a new game on another worker) since it was queued
+			if(ss->owner[pkt->session_id] == w->id){
+				if(host_pkt_handle(ss->sessions[pkt->session_id], pkt->numbytes, pkt->buf, &(pkt->si_other)) == -1){
+					(w->rejected)++;
+				}
+			} else{
+				(w->rejected)++;
+			}
+			(w->handled)++;
+			tail++;
+			work++;
+		}
+		w->tail.store(tail, std::memory_order_release);
+		
+		unsigned long long now = get_mono_ms();
+		for(size_t i=0; i<w->sessions.size(); i++){
+			int fired = tw_advance(&(w->sessions[i]->wheel), now);
+			if(fired > 0){
+				host_flush(w->sessions[i]);
+				w->timers += fired;
+				work++;
+			}
+		}
+		pthread_mutex_unlock(&(w->lock));
+		
+		if(work){
+			w->busy_ns += get_mono_ns() - start;
+		} else{
+			//nothing due this tick so wait for the next one (or for packets)
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 1000000;
+			if(ts.tv_nsec >= 1000000000){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_mutex_lock(&(w->wake_lock));
+			if(w->head.load(std::memory_order_acquire) == tail && !ss->exit){
+				pthread_cond_timedwait(&(w->wake), &(w->wake_lock), &ts);
+			}
+			pthread_mutex_unlock(&(w->wake_lock));
+		}
+	}
+	pthread_exit(NULL);
+}
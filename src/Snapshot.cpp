@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "inc/Snapshot.h"
+
+/*	sh_init:
+ * 		Allocates an empty history of the given number of ticks (rounded up to a power of two) and players.
+ *	returns: 0 on success, -1 on error
+ */
+int sh_init(Snap_History_t* sh, unsigned frames, unsigned players){
+	if(sh == NULL || frames < 2 || players == 0){
+		return -1;
+	}
+	
+	unsigned cap = 2;
+	while(cap < frames){
+		cap <<= 1;
+	}
+	sh->time_us = new unsigned long long[cap];
+	sh->x = new float[cap * players];
+	sh->y = new float[cap * players];
+	sh->alive = new unsigned char[cap * players];
+	memset(sh->alive, 0, cap * players);
+	sh->frames = cap;
+	sh->mask = cap - 1;
+	sh->players = players;
+	sh->head = 0;
+	pthread_mutex_init(&(sh->lock), NULL);
+	return 0;
+}
+
+/*	sh_destroy:
+ * 		Frees the history storage.
+ */
+void sh_destroy(Snap_History_t* sh){
+	if(sh == NULL || sh->time_us == NULL){
+		return;
+	}
+	delete[] sh->time_us;
+	delete[] sh->x;
+	delete[] sh->y;
+	delete[] sh->alive;
+	sh->time_us = NULL;
+	pthread_mutex_destroy(&(sh->lock));
+}
+
+/*	sh_record:
+ * 		Stores one tick of every player's position, overwriting the oldest tick once the ring is full.
+ * 		Tick times must not go backwards.
+ *	returns: 0 on success, -1 on error
+ */
+int sh_record(Snap_History_t* sh, unsigned long long time_us, const float* x, const float* y, const unsigned char* alive){
+	if(sh == NULL || x == NULL || y == NULL || alive == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(sh->lock));
+	if(sh->head > 0 && time_us < sh->time_us[(sh->head - 1) & sh->mask]){
+		pthread_mutex_unlock(&(sh->lock));
+		return -1;
+	}
+	unsigned f = (unsigned)(sh->head & sh->mask);
+	sh->time_us[f] = time_us;
+	memcpy(sh->x + ((size_t)f * sh->players), x, sh->players * sizeof(float));
+	memcpy(sh->y + ((size_t)f * sh->players), y, sh->players * sizeof(float));
+	memcpy(sh->alive + ((size_t)f * sh->players), alive, sh->players);
+	(sh->head)++;
+	pthread_mutex_unlock(&(sh->lock));
+	return 0;
+}
+
+/*	sh_view_time:
+ * 		Time of the world a player was looking at when it acted: its disp packets reach it half an rtt late
+ * 		and are drawn interp_us behind that, and its action reaches the host half an rtt later again.
+ * 		Rewinds past max_rewind_us are cut off so a bad link cannot reach arbitrarily far back.
+ *	returns: view time in us on the host clock
+ */
+unsigned long long sh_view_time(unsigned long long now_us, unsigned long long rtt_us, unsigned long long interp_us, unsigned long long max_rewind_us){
+	unsigned long long back = rtt_us + interp_us;
+	if(back > max_rewind_us){
+		back = max_rewind_us;
+	}
+	return (back > now_us) ? 0 : now_us - back;
+}
+
+/*	sh_bracket:
+ * 		Finds the ticks either side of the view time (binary search over the ring, oldest to newest) and
+ * 		the blend between them. Views outside the history clamp to its oldest or newest tick.
+ * 		The caller must hold the history lock and the history must not be empty.
+ */
+static void sh_bracket(Snap_History_t* sh, unsigned long long view_us, unsigned* fa, unsigned* fb, float* t){
+	unsigned long long n = (sh->head < sh->frames) ? sh->head : sh->frames;
+	unsigned long long oldest = sh->head - n;
+	
+	//first tick newer than the view
+	unsigned long long lo = 0, hi = n;
+	while(lo < hi){
+		unsigned long long mid = (lo + hi) / 2;
+		if(sh->time_us[(oldest + mid) & sh->mask] <= view_us){
+			lo = mid + 1;
+		} else{
+			hi = mid;
+		}
+	}
+	if(lo == 0){
+		*fa = *fb = (unsigned)(oldest & sh->mask);
+		*t = 0.0f;
+	} else if(lo == n){
+		*fa = *fb = (unsigned)((sh->head - 1) & sh->mask);
+		*t = 0.0f;
+	} else{
+		*fa = (unsigned)((oldest + lo - 1) & sh->mask);
+		*fb = (unsigned)((oldest + lo) & sh->mask);
+		unsigned long long ta = sh->time_us[*fa], tb = sh->time_us[*fb];
+		*t = (tb > ta) ? (float)(view_us - ta) / (float)(tb - ta) : 0.0f;
+	}
+}
+
+/*	sh_rewind:
+ * 		Rebuilds every player's position at the view time by blending the two surrounding ticks.
+ * 		A player only counts as alive if it was in both ticks.
+ *	returns: 0 on success, -1 on error or empty history
+ */
+int sh_rewind(Snap_History_t* sh, unsigned long long view_us, float* x, float* y, unsigned char* alive){
+	unsigned fa, fb;
+	float t;
+	if(sh == NULL || x == NULL || y == NULL || alive == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(sh->lock));
+	if(sh->head == 0){
+		pthread_mutex_unlock(&(sh->lock));
+		return -1;
+	}
+	sh_bracket(sh, view_us, &fa, &fb, &t);
+	const float* xa = sh->x + ((size_t)fa * sh->players);
+	const float* xb = sh->x + ((size_t)fb * sh->players);
+	const float* ya = sh->y + ((size_t)fa * sh->players);
+	const float* yb = sh->y + ((size_t)fb * sh->players);
+	const unsigned char* la = sh->alive + ((size_t)fa * sh->players);
+	const unsigned char* lb = sh->alive + ((size_t)fb * sh->players);
+	for(unsigned i=0; i<sh->players; i++){
+		x[i] = xa[i] + ((xb[i] - xa[i]) * t);
+		y[i] = ya[i] + ((yb[i] - ya[i]) * t);
+		alive[i] = la[i] & lb[i];
+	}
+	pthread_mutex_unlock(&(sh->lock));
+	return 0;
+}
+
+/*	sh_hit_test:
+ * 		Resolves an attack as the attacker saw it: a circle of the given reach around (cx, cy) against every
+ * 		other player's square (half_size from its centre) at the view time. Rewinds in place without a copy.
+ *	returns: number of players hit (their numbers in hits, at most max_hits), -1 on error or empty history
+ */
+int sh_hit_test(Snap_History_t* sh, unsigned long long view_us, int attacker, float cx, float cy, float reach, float half_size, int* hits, int max_hits){
+	unsigned fa, fb;
+	float t;
+	int count = 0;
+	if(sh == NULL || hits == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(sh->lock));
+	if(sh->head == 0){
+		pthread_mutex_unlock(&(sh->lock));
+		return -1;
+	}
+	sh_bracket(sh, view_us, &fa, &fb, &t);
+	const float* xa = sh->x + ((size_t)fa * sh->players);
+	const float* xb = sh->x + ((size_t)fb * sh->players);
+	const float* ya = sh->y + ((size_t)fa * sh->players);
+	const float* yb = sh->y + ((size_t)fb * sh->players);
+	const unsigned char* la = sh->alive + ((size_t)fa * sh->players);
+	const unsigned char* lb = sh->alive + ((size_t)fb * sh->players);
+	float r2 = reach * reach;
+	for(unsigned i=0; i<sh->players && count < max_hits; i++){
+		if(!(la[i] & lb[i]) || (int)i == attacker){
+			continue;
+		}
+		//distance from the attack centre to the nearest point of the square
+		float dx = (xa[i] + ((xb[i] - xa[i]) * t)) - cx;
+		float dy = (ya[i] + ((yb[i] - ya[i]) * t)) - cy;
+		dx = (dx > half_size) ? dx - half_size : ((dx < -half_size) ? dx + half_size : 0.0f);
+		dy = (dy > half_size) ? dy - half_size : ((dy < -half_size) ? dy + half_size : 0.0f);
+		if((dx * dx) + (dy * dy) <= r2){
+			hits[count++] = (int)i;
+		}
+	}
+	pthread_mutex_unlock(&(sh->lock));
+	return count;
+}
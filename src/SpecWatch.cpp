@@ -0,0 +1,98 @@
+#include "inc/SpecWatch.h"
+
+/*	spec_watch_start:
+ * 		Opens a UDP socket for watching the stream of the node at node and starts the watch thread, which
+ * 		posts what it shows into store.
+ *	returns: 0 on success, other on error
+ */
+int spec_watch_start(Spec_Watch_t* sw, const struct sockaddr_in* node, Player_Store_t* store){
+	if(sw == NULL || node == NULL || store == NULL){
+		return -1;
+	}
+	int ret = udp_bind(&(sw->wsa), &(sw->s), NULL, 0, NULL);
+	if(ret != 0){
+		return ret;
+	}
+	sw->node = *node;
+	sw->store = store;
+	spec_view_init(&(sw->view));
+	memset((char*)&(sw->cookie), 0, sizeof(sw->cookie));
+	sw->start_ms = get_mono_ms();
+	sw->first_ms = 0;
+	sw->exit = 0;
+	pthread_create(&(sw->thread), NULL, spec_watch_run, (void*)sw);
+	return 0;
+}
+
+/*	spec_watch_stop:
+ * 		Stops the watch thread, unsubscribes and closes the socket.
+ *	returns: 0 for success, -1 for error
+ */
+int spec_watch_stop(Spec_Watch_t* sw){
+	if(sw == NULL){
+		return -1;
+	}
+	sw->exit = 1;
+	pthread_join(sw->thread, NULL);
+	char message[MAX_PACKET_LEN];
+	int len = spec_sub_message(message, SPEC_BYE, 0, NULL);
+	sendto(sw->s, message, len, 0, (struct sockaddr*)&(sw->node), sizeof(sw->node));
+	closesocket(sw->s);
+	WSACleanup();
+	return 0;
+}
+
+/*	spec_watch_run:
+ * 		Watch thread function. Subscribes every REQ_TIMEOUT ms until a frame is shown, then refreshes every
+ * 		SPEC_BEAT ms, and posts each frame shown into the store. A cookie from the node is kept and sent
+ * 		back in a subscribe at once.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* spec_watch_run(void* input){
+	Spec_Watch_t* sw = (Spec_Watch_t*) input;
+	char buf[MAX_PACKET_LEN];
+	unsigned long long next_sub = 0;
+	
+	while(!sw->exit){
+		unsigned long long now = get_mono_ms();
+		if(now >= next_sub){
+			int len = spec_sub_message(buf, SPEC_SUB, sw->view.key, &(sw->cookie));
+			sendto(sw->s, buf, len, 0, (struct sockaddr*)&(sw->node), sizeof(sw->node));
+			next_sub = now + (sw->view.frames ? SPEC_BEAT : REQ_TIMEOUT);
+		}
+		
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(sw->s, &ready);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 10000;
+		if(select((int)sw->s + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+			continue;
+		}
+		struct sockaddr_in from;
+		int slen = sizeof(from);
+		int len;
+		while((len = recvfrom(sw->s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&from, &slen)) != SOCKET_ERROR){
+			int from_node = same_addr(&from, &(sw->node));
+			if(from_node && len == (int)spec_sub_len && ((Spec_Frame_t*)buf)->flags == SPEC_COOKIE){
+				memcpy(&(sw->cookie), buf + spec_head_len, COOKIE_LEN);
+				next_sub = 0;
+			} else if(from_node && spec_apply(&(sw->view), buf, len) == 1){
+				if(sw->view.frames == 1){
+					sw->first_ms = get_mono_ms() - sw->start_ms;
+				}
+				for(int i=0; i<MAX_PLAYER; i++){
+					if((sw->view.in_use >> i) & 0x01){
+						ps_post(&(sw->store->pos[i]), sw->view.x[i], sw->view.y[i]);
+						sw->store->in_use[i] = 1;
+					} else{
+						sw->store->in_use[i] = 0;
+					}
+				}
+			}
+			slen = sizeof(from);
+		}
+	}
+	pthread_exit(NULL);
+}
@@ -0,0 +1,402 @@
+#include "inc/Spectate.h"
+
+/*	spec_frame_ok:
+ * 		Checks a stream frame is a keyframe or delta whose length matches the players it says it holds.
+ *	returns: 1 if it is, 0 if not
+ */
+static int spec_frame_ok(const char* buf, int len){
+	if(len < (int)spec_head_len){
+		return 0;
+	}
+	const Spec_Frame_t* f = (const Spec_Frame_t*)buf;
+	if(f->flags != SPEC_KEY && f->flags != SPEC_DELTA){
+		return 0;
+	}
+	int n = 0;
+	for(int i=0; i<MAX_PLAYER; i++){
+		n += (f->changed >> i) & 0x01;
+	}
+	return len == (int)(spec_head_len + 2*n*sizeof(float)) && (f->changed & ~(f->in_use)) == 0;
+}
+
+/*	spec_view_init:
+ * 		Sets up an empty view (nothing shown until the first keyframe).
+ */
+void spec_view_init(Spec_View_t* view){
+	memset((char*)view, 0, sizeof(*view));
+}
+
+/*	spec_apply:
+ * 		Takes a stream frame into the view. A keyframe replaces it, a delta is laid over its keyframe
+ * 		(dropped if the view does not hold that keyframe, counted in waits). Frames older than the one
+ * 		shown are dropped.
+ *	returns: 1 if the view changed, 0 if the frame was dropped, -1 if it is malformed
+ */
+int spec_apply(Spec_View_t* view, const char* buf, int len){
+	if(view == NULL || buf == NULL || !spec_frame_ok(buf, len)){
+		return -1;
+	}
+	const Spec_Frame_t* f = (const Spec_Frame_t*)buf;
+	if(view->key != 0 && f->frame <= view->frame){
+		return 0;
+	}
+	if(f->flags == SPEC_DELTA && f->key != view->key){
+		(view->waits)++;
+		return 0;
+	}
+	
+	//start from the keyframe (the new one, or the one the delta builds on), then lay the changed players over it
+	if(f->flags == SPEC_KEY){
+		view->key = f->frame;
+		view->key_in_use = f->in_use;
+	}
+	memcpy(view->x, view->kx, sizeof(view->x));
+	memcpy(view->y, view->ky, sizeof(view->y));
+	int n = 0;
+	for(int i=0; i<MAX_PLAYER; i++){
+		if((f->changed >> i) & 0x01){
+			view->x[i] = f->loc[2*n];
+			view->y[i] = f->loc[2*n + 1];
+			n++;
+		}
+	}
+	if(f->flags == SPEC_KEY){
+		memcpy(view->kx, view->x, sizeof(view->kx));
+		memcpy(view->ky, view->y, sizeof(view->ky));
+	}
+	view->in_use = f->in_use;
+	view->frame = f->frame;
+	view->game_ms = f->game_ms;
+	(view->frames)++;
+	return 1;
+}
+
+/*	spec_sub_message:
+ * 		Writes a subscribe (or refresh) or unsubscribe into buf, naming the keyframe the sender holds and
+ * 		ending in the cookie the node last answered with (zeroed for NULL).
+ *	returns: length of the message
+ */
+int spec_sub_message(char* buf, char flags, unsigned int key, const Cookie_t* cookie){
+	memset(buf, 0, spec_sub_len);
+	((Spec_Frame_t*)buf)->flags = flags;
+	((Spec_Frame_t*)buf)->key = key;
+	if(cookie != NULL){
+		memcpy(buf + spec_head_len, cookie, COOKIE_LEN);
+	}
+	return spec_sub_len;
+}
+
+/*	spec_send_cookie:
+ * 		Answers a subscribe that had no good cookie with a fresh one for its source, as long as the subscribe
+ * 		(so the node never sends an address that did not ask more than it was sent).
+ */
+static void spec_send_cookie(Spec_Node_t* sn, const struct sockaddr_in* to){
+	char message[MAX_PACKET_LEN];
+	Cookie_t c;
+	ck_mint(&(sn->cookie), to, (unsigned int)sn->now, &c);
+	int len = spec_sub_message(message, SPEC_COOKIE, 0, &c);
+	sendto(sn->s, message, len, 0, (struct sockaddr*)to, sizeof(*to));
+	(sn->cookies)++;
+}
+
+/*	spec_send_cache:
+ * 		Sends a subscriber the node's newest keyframe and the newest delta on it.
+ */
+static void spec_send_cache(Spec_Node_t* sn, const struct sockaddr_in* to){
+	if(sn->key_len == 0){
+		return;
+	}
+	sendto(sn->s, sn->key, sn->key_len, 0, (struct sockaddr*)to, sizeof(*to));
+	if(sn->delta_len > 0){
+		sendto(sn->s, sn->delta, sn->delta_len, 0, (struct sockaddr*)to, sizeof(*to));
+	}
+	(sn->cached)++;
+}
+
+/*	spec_drop_sub:
+ * 		Frees a subscriber, moving the last live subscriber into its place in the live list.
+ */
+static void spec_drop_sub(Spec_Node_t* sn, Spec_Sub_t* sub){
+	pt_remove(&(sn->index), &(sub->addr));
+	tw_cancel(&(sn->wheel), &(sub->ttl_timer));
+	int last = sn->live[--(sn->live_count)];
+	sn->live[sub->live] = last;
+	sn->subs[last].live = sub->live;
+	sub->live = -1;
+	sn->free_subs[(sn->free_count)++] = sub->id;
+}
+
+/*	spec_sub_timeout:
+ * 		Ttl timer callback (one per subscriber) run by the node thread.
+ * 		Refreshes only update last_seen, so when this fires it either pushes the deadline out to match the
+ * 		latest refresh or drops a subscriber that has gone silent.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+static void spec_sub_timeout(void* input){
+	Spec_Sub_t* sub = (Spec_Sub_t*) input;
+	Spec_Node_t* sn = sub->sn;
+	
+	if(sub->last_seen + SPEC_TTL > sn->now){
+		tw_add(&(sn->wheel), &(sub->ttl_timer), sub->last_seen + SPEC_TTL);
+		return;
+	}
+	spec_drop_sub(sn, sub);
+}
+
+/*	spec_node_beat:
+ * 		Periodic timer callback of a node under a parent node: subscribes every REQ_TIMEOUT ms until the
+ * 		stream arrives, then refreshes every SPEC_BEAT ms.
+ *	returns: N/A (timer callbacks have no return value)
+ */
+static void spec_node_beat(void* input){
+	Spec_Node_t* sn = (Spec_Node_t*) input;
+	char message[MAX_PACKET_LEN];
+	
+	int len = spec_sub_message(message, SPEC_SUB, (sn->key_len > 0) ? ((Spec_Frame_t*)sn->key)->frame : 0, &(sn->up_cookie));
+	if(sendto(sn->s, message, len, 0, (struct sockaddr*)&(sn->upstream), sizeof(sn->upstream)) == SOCKET_ERROR){
+		err_out(&(sn->err), "Subscribe Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+	}
+	tw_add(&(sn->wheel), &(sn->beat_timer), sn->now + (sn->newest ? SPEC_BEAT : REQ_TIMEOUT));
+}
+
+/*	spec_node_init:
+ * 		Opens and binds the node's UDP socket, sets up the free subscribers and starts the node thread.
+ * 		The stream comes from upstream: the host sends it there itself, or with parent set upstream is
+ * 		another node, which this one subscribes to.
+ *	returns: 0 on success, other on error
+ */
+int spec_node_init(Spec_Node_t* sn, unsigned short port, const struct sockaddr_in* upstream, int parent){
+	//null check
+	if(sn == NULL || upstream == NULL){
+		return -1;
+	}
+	
+	//open the non-blocking UDP socket on the port
+	int ret = udp_bind(&(sn->wsa), &(sn->s), &(sn->server), port, &(sn->err));
+	if(ret != 0){
+		return ret;
+	}
+	sn->upstream = *upstream;
+	sn->parent = parent;
+	
+	//secret for the subscribe cookies
+	unsigned char secret[CK_KEY_LEN];
+	if(crypt_random(secret, CK_KEY_LEN) == -1){
+		err_out(&(sn->err), "Cookie Secret Not Created\n");
+		return -1;
+	}
+	ck_set_key(&(sn->cookie), secret, CK_KEY_LEN);
+	memset((char*)&(sn->up_cookie), 0, sizeof(sn->up_cookie));
+	
+	//free subscribers (handed out from the low ids)
+	if(pt_init(&(sn->index), SPEC_MAX_SUBS) == -1){
+		err_out(&(sn->err), "Peer Table Not Created\n");
+		return -1;
+	}
+	sn->now = get_mono_ms();
+	tw_init(&(sn->wheel), sn->now);
+	sn->subs = new Spec_Sub_t[SPEC_MAX_SUBS];
+	sn->free_subs = new int[SPEC_MAX_SUBS];
+	sn->live = new int[SPEC_MAX_SUBS];
+	for(int i=0; i<SPEC_MAX_SUBS; i++){
+		sn->subs[i].sn = sn;
+		sn->subs[i].id = i;
+		sn->subs[i].live = -1;
+		timer_init(&(sn->subs[i].ttl_timer), spec_sub_timeout, (void*)&(sn->subs[i]));
+		sn->free_subs[i] = SPEC_MAX_SUBS - 1 - i;
+	}
+	sn->free_count = SPEC_MAX_SUBS;
+	sn->live_count = 0;
+	timer_init(&(sn->beat_timer), spec_node_beat, (void*)sn);
+	if(parent){
+		tw_add(&(sn->wheel), &(sn->beat_timer), sn->now);
+	}
+	
+	sn->key_len = 0;
+	sn->delta_len = 0;
+	sn->newest = 0;
+	sn->bufs = new char[RELAY_BATCH][MAX_PACKET_LEN];
+	sn->lens = new int[RELAY_BATCH];
+	sn->from = new struct sockaddr_in[RELAY_BATCH];
+	sn->frames = 0;
+	sn->sent = 0;
+	sn->joins = 0;
+	sn->cached = 0;
+	sn->cookies = 0;
+	sn->dropped = 0;
+	sn->busy_ns = 0;
+	sn->exit = 0;
+	pthread_create(&(sn->thread), NULL, spec_node_run, (void*)sn);
+	
+	log_out(&(sn->log), "Spectator node listening on port " + std::to_string(port) + " for the stream from "
+			+ inet_ntoa(upstream->sin_addr) + ":" + std::to_string(ntohs(upstream->sin_port)) + (parent ? " (parent node)\n" : " (host)\n"));
+	return 0;
+}
+
+/*	spec_node_quit:
+ * 		Stops the node thread, tells a parent node it is leaving, closes the socket and frees the tables.
+ *	returns: 0 for success, -1 for error
+ */
+int spec_node_quit(Spec_Node_t* sn){
+	if(sn == NULL){
+		return -1;
+	}
+	
+	sn->exit = 1;
+	if(pthread_join(sn->thread, NULL) != 0){
+		err_out(&(sn->err), "Error ending node thread\n");
+	}
+	if(sn->parent){
+		char message[MAX_PACKET_LEN];
+		int len = spec_sub_message(message, SPEC_BYE, 0, NULL);
+		sendto(sn->s, message, len, 0, (struct sockaddr*)&(sn->upstream), sizeof(sn->upstream));
+	}
+	closesocket(sn->s);
+	WSACleanup();
+	
+	tw_destroy(&(sn->wheel));
+	pt_destroy(&(sn->index));
+	delete[] sn->subs;
+	delete[] sn->free_subs;
+	delete[] sn->live;
+	delete[] sn->bufs;
+	delete[] sn->lens;
+	delete[] sn->from;
+	log_out(&(sn->log), "Spectator node closed\n");
+	return 0;
+}
+
+/*	spec_node_run:
+ * 		Node thread function, read loop as relay_run: reads up to RELAY_BATCH datagrams, turns the ttl wheel
+ * 		once for the batch, then handles each from the buffer it was read into.
+ *	returns: N/A (thread functions have no return value)
+ */
+void* spec_node_run(void* input){
+	Spec_Node_t* sn = (Spec_Node_t*) input;
+	int slen = sizeof(struct sockaddr_in);
+	int full = 0;
+	
+	while(!sn->exit){
+		if(!full){
+			//wait up to a ms so the exit flag and the timers are still seen on a quiet socket
+			fd_set ready;
+			FD_ZERO(&ready);
+			FD_SET(sn->s, &ready);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 1000;
+			if(select((int)sn->s + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+				err_out(&(sn->err), "Select Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+				continue;
+			}
+		}
+		unsigned long long start = get_mono_ns();
+		
+		int n = 0;
+		while(n < RELAY_BATCH){
+			slen = sizeof(struct sockaddr_in);
+			if((sn->lens[n] = recvfrom(sn->s, sn->bufs[n], MAX_PACKET_LEN, 0, (struct sockaddr*)&(sn->from[n]), &slen)) == SOCKET_ERROR){
+				//a send to a subscriber that has gone away resets the next recv on windows, which is not fatal here
+				if(WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAECONNRESET){
+					err_out(&(sn->err), "Receive Failed. Error Code: " + std::to_string(WSAGetLastError()) + "\n");
+				}
+				break;
+			}
+			n++;
+		}
+		full = (n == RELAY_BATCH);
+		
+		sn->now = start / 1000000ULL;
+		tw_advance(&(sn->wheel), sn->now);
+		for(int i=0; i<n; i++){
+			spec_node_handle(sn, sn->bufs[i], sn->lens[i], &(sn->from[i]));
+		}
+		if(n > 0){
+			sn->busy_ns += get_mono_ns() - start;
+		}
+	}
+	pthread_exit(NULL);
+}
+
+/*	spec_node_handle:
+ * 		Handles one datagram. Frames from upstream are kept in the cache (keyframes, and deltas on the cached
+ * 		keyframe) and sent on to every subscriber. A subscribe with a good cookie adds (or refreshes) the
+ * 		sender and sends it the cache unless it already holds the cached keyframe, one without is only
+ * 		answered with a cookie. An unsubscribe drops the sender. A cookie from a parent node is kept for
+ * 		the next subscribe, which is sent at once.
+ *	returns: 0 if the datagram was taken, -1 if it was dropped
+ */
+int spec_node_handle(Spec_Node_t* sn, char* buf, int len, const struct sockaddr_in* from){
+	if(len < (int)spec_head_len){
+		(sn->dropped)++;
+		return -1;
+	}
+	Spec_Frame_t* f = (Spec_Frame_t*)buf;
+	
+	if(f->flags == SPEC_KEY || f->flags == SPEC_DELTA){
+		//only the stream from upstream, in order
+		if(!same_addr(from, &(sn->upstream)) || !spec_frame_ok(buf, len) || (sn->newest != 0 && f->frame <= sn->newest)){
+			(sn->dropped)++;
+			return -1;
+		}
+		sn->newest = f->frame;
+		(sn->frames)++;
+		if(f->flags == SPEC_KEY){
+			memcpy(sn->key, buf, len);
+			sn->key_len = len;
+			sn->delta_len = 0;
+		} else if(sn->key_len > 0 && f->key == ((Spec_Frame_t*)sn->key)->frame){
+			memcpy(sn->delta, buf, len);
+			sn->delta_len = len;
+		}
+		
+		//fan out
+		for(int i=0; i<sn->live_count; i++){
+			const struct sockaddr_in* to = &(sn->subs[sn->live[i]].addr);
+			if(sendto(sn->s, buf, len, 0, (struct sockaddr*)to, sizeof(*to)) == SOCKET_ERROR){
+				(sn->dropped)++;
+			} else{
+				(sn->sent)++;
+			}
+		}
+		return 0;
+	}
+	
+	int s = pt_find(&(sn->index), from);
+	if(f->flags == SPEC_SUB && len == (int)spec_sub_len){
+		Cookie_t c;
+		memcpy(&c, buf + spec_head_len, COOKIE_LEN);
+		if(!ck_check(&(sn->cookie), from, (unsigned int)sn->now, COOKIE_LIFE, &c)){
+			spec_send_cookie(sn, from);
+			return 0;
+		}
+		if(s == -1){
+			if(sn->free_count == 0){
+				(sn->dropped)++;
+				return -1;
+			}
+			s = sn->free_subs[--(sn->free_count)];
+			sn->subs[s].addr = *from;
+			sn->subs[s].live = sn->live_count;
+			sn->live[(sn->live_count)++] = s;
+			pt_insert(&(sn->index), from, s);
+			tw_add(&(sn->wheel), &(sn->subs[s].ttl_timer), sn->now + SPEC_TTL);
+			(sn->joins)++;
+		}
+		sn->subs[s].last_seen = sn->now;
+		if(sn->key_len > 0 && f->key != ((Spec_Frame_t*)sn->key)->frame){
+			spec_send_cache(sn, from);
+		}
+		return 0;
+	} else if(f->flags == SPEC_BYE && s != -1){
+		spec_drop_sub(sn, &(sn->subs[s]));
+		return 0;
+	} else if(f->flags == SPEC_COOKIE && sn->parent && len == (int)spec_sub_len && same_addr(from, &(sn->upstream))){
+		memcpy(&(sn->up_cookie), buf + spec_head_len, COOKIE_LEN);
+		tw_cancel(&(sn->wheel), &(sn->beat_timer));
+		tw_add(&(sn->wheel), &(sn->beat_timer), sn->now);
+		return 0;
+	}
+	(sn->dropped)++;
+	return -1;
+}
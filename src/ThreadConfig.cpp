@@ -0,0 +1,205 @@
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#include "inc/ThreadConfig.h"
+
+static const char* role_names[THREAD_ROLES] = {"recv", "send", "render"};
+
+//priority names of the config file
+static const struct {
+	const char* name;
+	int level;
+} priorities[] = {
+	{"idle", THREAD_PRIORITY_IDLE}, {"lowest", THREAD_PRIORITY_LOWEST}, {"below_normal", THREAD_PRIORITY_BELOW_NORMAL},
+	{"normal", THREAD_PRIORITY_NORMAL}, {"above_normal", THREAD_PRIORITY_ABOVE_NORMAL}, {"highest", THREAD_PRIORITY_HIGHEST},
+	{"time_critical", THREAD_PRIORITY_TIME_CRITICAL}
+};
+static const struct {
+	const char* name;
+	DWORD value;
+} classes[] = {
+	{"normal", NORMAL_PRIORITY_CLASS}, {"above_normal", ABOVE_NORMAL_PRIORITY_CLASS}, {"high", HIGH_PRIORITY_CLASS},
+	{"realtime", REALTIME_PRIORITY_CLASS}
+};
+
+//cpu list (2, 2,3, 0-3 or -) to an affinity mask
+static int parse_cpus(std::string list, unsigned long long* mask){
+	*mask = 0;
+	if(list == "-"){
+		return 0;
+	}
+	std::istringstream parts(list);
+	std::string part;
+	while(std::getline(parts, part, ',')){
+		char* end;
+		long first = strtol(part.c_str(), &end, 10), last = first;
+		if(*end == '-'){
+			last = strtol(end + 1, &end, 10);
+		}
+		if(end == part.c_str() || *end != '\0' || first < 0 || last < first || last > 63){
+			return -1;
+		}
+		for(long c=first; c<=last; c++){
+			*mask |= 1ULL << c;
+		}
+	}
+	return (*mask == 0) ? -1 : 0;
+}
+
+/*	tc_init:
+ * 		Leaves every thread to the scheduler at normal priority with the default stack.
+ */
+void tc_init(Thread_Config_t* tc){
+	for(int r=0; r<THREAD_ROLES; r++){
+		tc->roles[r].cpus = 0;
+		tc->roles[r].priority = THREAD_PRIORITY_NORMAL;
+		tc->roles[r].stack = 0;
+	}
+	tc->process_class = 0;
+	tc->isolate = 0;
+}
+
+/*	tc_load:
+ * 		Reads a thread config file (format in ThreadConfig.h) over the current settings.
+ *	returns: 0 for success, -1 with the reason in error
+ */
+int tc_load(Thread_Config_t* tc, std::string path, std::string* error){
+	std::ifstream file(path.c_str());
+	if(!file.is_open()){
+		*error = "cannot read " + path;
+		return -1;
+	}
+	std::string line;
+	int line_num = 0;
+	while(std::getline(file, line)){
+		line_num++;
+		std::istringstream words(line);
+		std::string word;
+		if(!(words >> word) || word[0] == '#'){
+			continue;
+		}
+		std::string where = path + " line " + std::to_string(line_num) + ": ";
+		if(word == "isolate"){
+			tc->isolate = 1;
+			continue;
+		}
+		if(word == "process"){
+			std::string name;
+			words >> name;
+			unsigned c = 0;
+			for(; c<sizeof(classes)/sizeof(classes[0]) && name != classes[c].name; c++);
+			if(c == sizeof(classes)/sizeof(classes[0])){
+				*error = where + "unknown priority class " + name;
+				return -1;
+			}
+			tc->process_class = classes[c].value;
+			continue;
+		}
+		
+		//role cpus priority [stack kb]
+		int role = 0;
+		for(; role<THREAD_ROLES && word != role_names[role]; role++);
+		if(role == THREAD_ROLES){
+			*error = where + "unknown role " + word + " (recv, send, render, process or isolate)";
+			return -1;
+		}
+		Thread_Setting_t set;
+		std::string cpus, priority;
+		unsigned int stack_kb = 0;
+		if(!(words >> cpus >> priority) || parse_cpus(cpus, &(set.cpus)) == -1){
+			*error = where + "expected " + word + " cpus priority [stack kb]";
+			return -1;
+		}
+		unsigned p = 0;
+		for(; p<sizeof(priorities)/sizeof(priorities[0]) && priority != priorities[p].name; p++);
+		if(p == sizeof(priorities)/sizeof(priorities[0])){
+			*error = where + "unknown priority " + priority;
+			return -1;
+		}
+		set.priority = priorities[p].level;
+		if((words >> stack_kb) && stack_kb * 1024 < THREAD_MIN_STACK){
+			*error = where + "stack must be at least " + std::to_string(THREAD_MIN_STACK / 1024) + " kb";
+			return -1;
+		}
+		set.stack = stack_kb * 1024;
+		tc->roles[role] = set;
+	}
+	return 0;
+}
+
+/*	tc_describe:
+ *	returns: one role's settings for the log
+ */
+std::string tc_describe(const Thread_Config_t* tc, int role){
+	const Thread_Setting_t* set = &(tc->roles[role]);
+	std::string cpus;
+	for(int c=0; c<64; c++){
+		if(set->cpus & (1ULL << c)){
+			cpus += (cpus.empty() ? "" : ",") + std::to_string(c);
+		}
+	}
+	std::string priority = std::to_string(set->priority);
+	for(unsigned p=0; p<sizeof(priorities)/sizeof(priorities[0]); p++){
+		if(priorities[p].level == set->priority){
+			priority = priorities[p].name;
+		}
+	}
+	return std::string(role_names[role]) + " threads on cpus " + (cpus.empty() ? (tc->isolate && role == THREAD_RENDER ?
+			"not used by recv or send" : "any") : cpus) + ", " + priority + " priority, " + (set->stack ? std::to_string(set->stack / 1024) +
+			" kb" : "default") + " stack";
+}
+
+/*	tc_attr:
+ * 		Sets up the attributes to create one of a role's threads with (destroy them after pthread_create).
+ *	returns: 0 for success, -1 for error
+ */
+int tc_attr(const Thread_Config_t* tc, int role, pthread_attr_t* attr){
+	if(tc == NULL || attr == NULL || role < 0 || role >= THREAD_ROLES){
+		return -1;
+	}
+	pthread_attr_init(attr);
+	if(tc->roles[role].stack != 0 && pthread_attr_setstacksize(attr, tc->roles[role].stack) != 0){
+		return -1;
+	}
+	return 0;
+}
+
+/*	tc_apply:
+ * 		Pins the calling thread to its role's cpus and sets its priority. With isolate a role without cpus
+ * 		is kept off the cores the recv and send threads are pinned to.
+ *	returns: 0 for success, -1 if a setting was refused
+ */
+int tc_apply(const Thread_Config_t* tc, int role){
+	if(tc == NULL || role < 0 || role >= THREAD_ROLES){
+		return -1;
+	}
+	const Thread_Setting_t* set = &(tc->roles[role]);
+	int ret = 0;
+	unsigned long long mask = set->cpus;
+	if(mask == 0 && tc->isolate){
+		DWORD_PTR proc, sys;
+		if(GetProcessAffinityMask(GetCurrentProcess(), &proc, &sys)){
+			mask = (unsigned long long)proc & ~(tc->roles[THREAD_RECV].cpus | tc->roles[THREAD_SEND].cpus);
+		}
+	}
+	if(mask != 0 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) == 0){
+		ret = -1;
+	}
+	if(set->priority != THREAD_PRIORITY_NORMAL && !SetThreadPriority(GetCurrentThread(), set->priority)){
+		ret = -1;
+	}
+	return ret;
+}
+
+/*	tc_apply_process:
+ * 		Sets the process priority class (thread priorities are relative to it).
+ *	returns: 0 for success, -1 if refused
+ */
+int tc_apply_process(const Thread_Config_t* tc){
+	if(tc == NULL || tc->process_class == 0){
+		return 0;
+	}
+	return SetPriorityClass(GetCurrentProcess(), tc->process_class) ? 0 : -1;
+}
@@ -0,0 +1,238 @@
+#include "inc/TimerWheel.h"
+
+/*	list helpers:
+ * 		Each wheel slot is a circular doubly linked list with the slot entry as its sentinel
+ * 		so that unlinking a timer from whatever slot it is in is O(1).
+ */
+static void list_init(Timer_t* head){
+	head->next = head;
+	head->prev = head;
+}
+
+static void list_append(Timer_t* head, Timer_t* t){
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+static void list_unlink(Timer_t* t){
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = t;
+	t->prev = t;
+}
+
+/*	tw_place:
+ * 		Links an active timer into the slot matching its distance from the current tick.
+ * 		Near timers go in level 0 (one slot per tick), further timers go in coarser levels
+ * 		and are cascaded down as the wheel turns. Timers already due go on the expired list.
+ * 		Must be called with the wheel lock held.
+ */
+static void tw_place(Timer_Wheel_t* tw, Timer_t* t){
+	unsigned long long expire = t->expire;
+	if(expire <= tw->now){
+		list_append(&(tw->expired), t);
+		return;
+	}
+	
+	//timers past the top level are parked in the furthest slot and re-placed on cascade
+	unsigned long long max_delta = (1ULL << (TW_SLOT_BITS * TW_LEVELS)) - 1;
+	if(expire - tw->now > max_delta){
+		expire = tw->now + max_delta;
+	}
+	
+	unsigned long long delta = expire - tw->now;
+	int level;
+	for(level=0; level<TW_LEVELS-1; level++){
+		if(delta < (1ULL << (TW_SLOT_BITS * (level + 1)))){
+			break;
+		}
+	}
+	int idx = (int)((expire >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK);
+	list_append(&(tw->slots[level][idx]), t);
+}
+
+/*	tw_cascade:
+ * 		Empties one slot of a coarse level and re-places its timers into the finer levels.
+ * 		Must be called with the wheel lock held.
+ */
+static void tw_cascade(Timer_Wheel_t* tw, int level, int idx){
+	Timer_t* head = &(tw->slots[level][idx]);
+	while(head->next != head){
+		Timer_t* t = head->next;
+		list_unlink(t);
+		tw_place(tw, t);
+	}
+}
+
+/*	tw_tick:
+ * 		Turns the wheel by a single tick, cascading the coarse levels on their boundaries and
+ * 		moving every timer in the new level 0 slot to the expired list.
+ * 		Must be called with the wheel lock held.
+ */
+static void tw_tick(Timer_Wheel_t* tw){
+	(tw->now)++;
+	for(int level=1; level<TW_LEVELS; level++){
+		if((tw->now & ((1ULL << (TW_SLOT_BITS * level)) - 1)) != 0){
+			break;
+		}
+		tw_cascade(tw, level, (int)((tw->now >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK));
+	}
+	
+	Timer_t* head = &(tw->slots[0][tw->now & TW_SLOT_MASK]);
+	while(head->next != head){
+		Timer_t* t = head->next;
+		list_unlink(t);
+		list_append(&(tw->expired), t);
+	}
+}
+
+/*	tw_init:
+ * 		Sets up an empty wheel whose current tick is the given time.
+ *	returns: 0 on success, -1 on error
+ */
+int tw_init(Timer_Wheel_t* tw, unsigned long long now){
+	if(tw == NULL){
+		return -1;
+	}
+	
+	for(int level=0; level<TW_LEVELS; level++){
+		for(int i=0; i<TW_SLOTS; i++){
+			list_init(&(tw->slots[level][i]));
+		}
+	}
+	list_init(&(tw->expired));
+	tw->now = now;
+	tw->count = 0;
+	pthread_mutex_init(&(tw->lock), NULL);
+	return 0;
+}
+
+/*	tw_destroy:
+ * 		Releases the wheel lock. Timers still linked are simply forgotten (they are owned elsewhere).
+ */
+void tw_destroy(Timer_Wheel_t* tw){
+	if(tw == NULL){
+		return;
+	}
+	pthread_mutex_destroy(&(tw->lock));
+}
+
+/*	timer_init:
+ * 		Prepares a timer with its callback. Must be called once before the timer is first added.
+ */
+void timer_init(Timer_t* t, Timer_Func_t func, void* arg){
+	if(t == NULL){
+		return;
+	}
+	list_init(t);
+	t->expire = 0;
+	t->func = func;
+	t->arg = arg;
+	t->active = 0;
+}
+
+/*	tw_add:
+ * 		Schedules the timer to fire at the given absolute tick.
+ * 		A timer that is already pending is moved to the new time instead.
+ *	returns: 0 on success, -1 on error
+ */
+int tw_add(Timer_Wheel_t* tw, Timer_t* t, unsigned long long expire){
+	if(tw == NULL || t == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(tw->lock));
+	if(t->active){
+		list_unlink(t);
+	} else{
+		t->active = 1;
+		(tw->count)++;
+	}
+	t->expire = expire;
+	tw_place(tw, t);
+	pthread_mutex_unlock(&(tw->lock));
+	return 0;
+}
+
+/*	tw_cancel:
+ * 		Removes a pending timer from the wheel.
+ *	returns: 1 if the timer was pending, 0 if it was not, -1 on error
+ */
+int tw_cancel(Timer_Wheel_t* tw, Timer_t* t){
+	if(tw == NULL || t == NULL){
+		return -1;
+	}
+	
+	int was_active = 0;
+	pthread_mutex_lock(&(tw->lock));
+	if(t->active){
+		list_unlink(t);
+		t->active = 0;
+		(tw->count)--;
+		was_active = 1;
+	}
+	pthread_mutex_unlock(&(tw->lock));
+	return was_active;
+}
+
+/*	tw_pending:
+ * 		Checks if the timer is currently scheduled.
+ *	returns: 1 if pending, 0 if not, -1 on error
+ */
+int tw_pending(Timer_Wheel_t* tw, Timer_t* t){
+	if(tw == NULL || t == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(tw->lock));
+	int active = t->active;
+	pthread_mutex_unlock(&(tw->lock));
+	return active;
+}
+
+/*	tw_advance:
+ * 		Turns the wheel up to the given tick and runs the callback of every expired timer.
+ * 		Callbacks are called with the wheel lock released, so they may add or cancel timers
+ * 		(including re-adding their own timer for periodic work).
+ *	returns: number of timers fired, -1 on error
+ */
+int tw_advance(Timer_Wheel_t* tw, unsigned long long now){
+	if(tw == NULL){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&(tw->lock));
+	if(tw->count == 0){
+		//nothing scheduled so skip straight to the new tick
+		if(now > tw->now){
+			tw->now = now;
+		}
+	} else{
+		while(tw->now < now){
+			tw_tick(tw);
+		}
+	}
+	
+	//fire the expired timers one at a time so cancels from other threads stay safe
+	int fired = 0;
+	while(tw->expired.next != &(tw->expired)){
+		Timer_t* t = tw->expired.next;
+		list_unlink(t);
+		t->active = 0;
+		(tw->count)--;
+		Timer_Func_t func = t->func;
+		void* arg = t->arg;
+		pthread_mutex_unlock(&(tw->lock));
+		
+		if(func != NULL){
+			func(arg);
+		}
+		fired++;
+		
+		pthread_mutex_lock(&(tw->lock));
+	}
+	pthread_mutex_unlock(&(tw->lock));
+	return fired;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <vector>
+#include <fstream>
+
+#include "inc/ConnectStruct.h"
+#include "inc/Trace.h"
+
+std::atomic<int> trace_on(0);
+
+//buffer pool (buffers are made as threads first trace and kept for the life of the process)
+static Trace_Buffer_t* buffers[TRACE_THREADS];
+static int buffer_count = 0;
+static int free_ids[TRACE_THREADS];
+static int free_count = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t exit_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+//the calling thread's buffer and track name
+static thread_local Trace_Buffer_t* mine = NULL;
+static thread_local const char* mine_name = "thread";
+static thread_local int no_buffer = 0;
+
+//gives a thread's buffer back to the pool as it exits
+static void trace_release(void* input){
+	Trace_Buffer_t* b = (Trace_Buffer_t*) input;
+	pthread_mutex_lock(&pool_lock);
+	free_ids[free_count++] = b->id;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static void trace_make_key(){
+	pthread_key_create(&exit_key, trace_release);
+}
+
+//takes a pooled buffer (or makes one) for the calling thread
+static Trace_Buffer_t* trace_acquire(){
+	pthread_once(&key_once, trace_make_key);
+	Trace_Buffer_t* b = NULL;
+	pthread_mutex_lock(&pool_lock);
+	if(free_count > 0){
+		b = buffers[free_ids[--free_count]];
+	} else if(buffer_count < TRACE_THREADS){
+		b = new Trace_Buffer_t;
+		b->head.store(0);
+		b->id = buffer_count;
+		buffers[buffer_count++] = b;
+	}
+	if(b != NULL){
+		b->name = mine_name;
+	}
+	pthread_mutex_unlock(&pool_lock);
+	if(b != NULL){
+		pthread_setspecific(exit_key, b);
+	}
+	return b;
+}
+
+/*	trace_enable:
+ * 		Turns span recording on or off (spans already recorded are kept for the next dump).
+ */
+void trace_enable(int on){
+	trace_on.store(on ? 1 : 0);
+}
+
+/*	trace_thread:
+ * 		Names the calling thread's track in the trace (name must outlive the thread, e.g. a literal).
+ */
+void trace_thread(const char* name){
+	mine_name = name;
+	if(mine != NULL){
+		pthread_mutex_lock(&pool_lock);
+		mine->name = name;
+		pthread_mutex_unlock(&pool_lock);
+	}
+}
+
+/*	trace_span:
+ * 		Records a span from start_ns (a TRACE_NOW reading) to now on the calling thread's buffer.
+ */
+void trace_span(const char* name, unsigned long long start_ns, unsigned int pkt, unsigned int tick){
+	unsigned long long end_ns = get_mono_ns();
+	if(mine == NULL){
+		if(no_buffer || (mine = trace_acquire()) == NULL){
+			no_buffer = 1;
+			return;
+		}
+	}
+	unsigned long long h = mine->head.load(std::memory_order_relaxed);
+	Trace_Event_t* e = &(mine->events[h % TRACE_EVENTS]);
+	e->name = name;
+	e->start_ns = start_ns;
+	e->dur_ns = (end_ns > start_ns) ? end_ns - start_ns : 0;
+	e->pkt = pkt;
+	e->tick = tick;
+	mine->head.store(h + 1, std::memory_order_release);
+}
+
+/*	trace_dump:
+ * 		Writes every thread's recorded spans to path as Chrome trace event JSON (opens in Perfetto or
+ * 		chrome://tracing), one track per thread buffer. Threads keep tracing while it copies.
+ *	returns: spans written, -1 if the file could not be written
+ */
+int trace_dump(std::string path){
+	std::ofstream out(path.c_str());
+	if(!out.is_open()){
+		return -1;
+	}
+	pthread_mutex_lock(&pool_lock);
+	int count = buffer_count;
+	std::vector<const char*> names(count);
+	for(int b=0; b<count; b++){
+		names[b] = buffers[b]->name;
+	}
+	pthread_mutex_unlock(&pool_lock);
+	
+	char line[256];
+	int written = 0;
+	out << "{\"traceEvents\":[\n";
+	for(int b=0; b<count; b++){
+		snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}},\n",
+				b, names[b], b);
+		out << line;
+	}
+	std::vector<Trace_Event_t> copy;
+	for(int b=0; b<count; b++){
+		//copy the ring, then keep only the spans its thread cannot have overwritten since
+		Trace_Buffer_t* buf = buffers[b];
+		unsigned long long head = buf->head.load(std::memory_order_acquire);
+		unsigned long long first = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+		copy.resize(head - first);
+		for(unsigned long long i=first; i<head; i++){
+			copy[i - first] = buf->events[i % TRACE_EVENTS];
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		unsigned long long now = buf->head.load(std::memory_order_relaxed);
+		unsigned long long valid = (now >= TRACE_EVENTS) ? now - TRACE_EVENTS + 1 : 0;
+		for(unsigned long long i=(valid > first ? valid : first); i<head; i++){
+			const Trace_Event_t* e = &(copy[i - first]);
+			snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+					"\"args\":{\"pkt\":%u,\"tick\":%u}},\n", e->name, b, e->start_ns / 1000.0, e->dur_ns / 1000.0, e->pkt, e->tick);
+			out << line;
+			written++;
+		}
+	}
+	//closing metadata event so the list has no trailing comma
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"MarvelHeros\"}}\n]}\n";
+	out.close();
+	return written;
+}
@@ -0,0 +1,43 @@
+#ifndef ADMISSION_H_
+#define ADMISSION_H_
+
+#include <winsock2.h>
+
+#define AD_WAYS 4					// buckets a source may sit in (one cache line of entries)
+
+//source classes, each with its own rate
+#define AD_STRANGER 0				// not (yet) a player
+#define AD_PLAYER 1					// holds a player slot
+#define AD_CLASSES 2
+
+//token bucket of one source (ip and port), 16 bytes so a set of AD_WAYS fits a cache line
+typedef struct Admit_Entry {
+	unsigned long long key;			// (ip << 32 | port << 16 | 1), 0 for a never used entry
+	unsigned int stamp;				// low bits of the ms time the bucket was last filled
+	float tokens;
+} Admit_Entry_t;
+
+//per source token buckets checked on every datagram before it is copied or handed to a handler, so a
+//flooding source is dropped for the cost of one hash and one cache line. Sources hash to a set of AD_WAYS
+//buckets, a new source takes a bucket idle for idle_ms (aged out, it would be full again anyway) or else
+//the set's stalest one, so the table never grows or needs a sweep. A bucket refills at the rate of the class
+//the caller gives each datagram, so a source that becomes a player gets the player rate. Only one thread
+//(the recv thread) may use a table
+typedef struct Admit_Table {
+	Admit_Entry_t* entries;			// sets * AD_WAYS, cache line aligned inside base
+	Admit_Entry_t* base;
+	unsigned mask;					// set index mask (sets - 1)
+	float per_ms[AD_CLASSES], burst[AD_CLASSES];	// tokens a bucket gains per ms and holds at most
+	unsigned idle_ms;
+	
+	//counts
+	unsigned long long admitted, dropped, evicted;
+} Admit_Table_t;
+
+//table functions
+int ad_init(Admit_Table_t* at, unsigned max_sources, unsigned idle_ms);
+int ad_rate(Admit_Table_t* at, int cls, double pps, double burst);
+void ad_destroy(Admit_Table_t* at);
+int ad_admit(Admit_Table_t* at, const struct sockaddr_in* addr, int cls, unsigned long long now_ms);
+
+#endif
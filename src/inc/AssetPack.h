@@ -0,0 +1,65 @@
+#ifndef ASSET_PACK_H_
+#define ASSET_PACK_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+//pack file layout: header, sprite table, animation table, then the atlas pages as raw rgba rows (top row
+//first), each page starting on a PACK_ALIGN boundary so the mapping can go to the gpu as it is
+#define PACK_MAGIC "GSPACK1"
+#define PACK_VERSION 1
+#define PACK_PAGE_SIZE 1024		// atlas page width and height (pixels)
+#define PACK_PAD 1				// empty pixels around every sprite so filtering does not bleed
+#define PACK_ALIGN 4096
+#define PACK_NAME_LEN 16		// animation name length (with the terminating null)
+
+typedef struct Pack_Head {
+	char magic[8];
+	unsigned int version;
+	unsigned int page_size;
+	unsigned int page_count, sprite_count, anim_count, reserved;
+	unsigned long long sprite_off, anim_off, pixel_off, file_size;
+} Pack_Head_t;
+
+//one frame in an atlas page (v0 is the top row, as the rows are stored top first)
+typedef struct Pack_Sprite {
+	unsigned short page, x, y, w, h, reserved;
+	float u0, v0, u1, v1;
+} Pack_Sprite_t;
+
+//an animation is a run of sprites in the sprite table
+typedef struct Pack_Anim {
+	char name[PACK_NAME_LEN];
+	unsigned int first, count, frame_ms, reserved;
+} Pack_Anim_t;
+
+//a loaded pack, every table points into the read only mapping
+typedef struct Asset_Pack {
+	HANDLE file, map;
+	const char* base;
+	unsigned long long size;
+	const Pack_Head_t* head;
+	const Pack_Sprite_t* sprites;
+	const Pack_Anim_t* anims;
+} Asset_Pack_t;
+
+//animation input of the pack builder (the asset_pack tool reads these from a manifest)
+typedef struct Pack_Input {
+	std::string name;
+	unsigned int frame_ms;
+	std::vector<std::string> files;
+} Pack_Input_t;
+
+//loading
+int ap_load(Asset_Pack_t* pack, std::string path);
+void ap_unload(Asset_Pack_t* pack);
+const unsigned char* ap_page(const Asset_Pack_t* pack, unsigned int page);
+const Pack_Anim_t* ap_find_anim(const Asset_Pack_t* pack, const char* name);
+const Pack_Sprite_t* ap_frame(const Asset_Pack_t* pack, const Pack_Anim_t* anim, unsigned long long t_ms);
+
+//building
+unsigned char* ap_load_bmp(std::string path, int* w, int* h);
+int ap_build(const std::vector<Pack_Input_t>& anims, std::string path, std::string* error);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef COLLISION_H_
+#define COLLISION_H_
+
+//narrowphase paths (picked by col_init from what the cpu has, col_use_simd forces one)
+#define COL_SCALAR 0
+#define COL_AVX2 1				// 8 boxes per compare
+#define COL_AVX512 2			// 16 boxes per compare
+
+#define COL_PAD 16				// sentinel boxes after the sorted arrays so the widest loads never read past them
+#define COL_RESORT 8			// insertion sort shifts per box before the sweep order is sorted from scratch
+
+//box layers: a pair is a contact when either box's hits mask has a layer of the other
+#define COL_BODY 0x01			// player bodies (push each other)
+#define COL_HURT 0x02			// where a player can be hit
+#define COL_HIT 0x04			// attacks and projectiles
+
+//contact events, between the contacts of one step and the last
+#define COL_BEGIN 1
+#define COL_END 2
+
+//axis aligned box added for one step (id is the game's handle, e.g. the entity)
+typedef struct Col_Box {
+	float min_x, min_y, max_x, max_y;
+	unsigned int id;
+	unsigned int layers, hits;
+} Col_Box_t;
+
+//a contact starting or ending (a is the smaller id)
+typedef struct Col_Event {
+	unsigned int a, b;
+	int type;
+} Col_Event_t;
+
+//sweep and prune on x: boxes are kept sorted by min_x, so each box only tests the run of boxes after it
+//that start before it ends, 8 or 16 at a time from a structure of arrays copy in sweep order
+typedef struct Collision_World {
+	//boxes of the current step
+	Col_Box_t* boxes;
+	int count, capacity;
+	
+	//sweep order (indexes of boxes), kept between steps while the box count holds so it is nearly sorted
+	int* order;
+	int order_count;
+	
+	//boxes in sweep order [capacity + COL_PAD]
+	float *min_x, *min_y, *max_x, *max_y;
+	unsigned int *layers, *hits;
+	
+	//contacts of this step and the last (sorted pair keys, smaller id high) and the events between them
+	unsigned long long *pairs, *prev;
+	int pair_count, pair_capacity, prev_count, prev_capacity;
+	Col_Event_t* events;
+	int event_count, event_capacity;
+	
+	int simd;
+	unsigned long long tested;				// box pairs the narrowphase compared (running count)
+} Collision_World_t;
+
+//world functions
+int col_init(Collision_World_t* col);
+void col_destroy(Collision_World_t* col);
+int col_simd_available();
+int col_use_simd(Collision_World_t* col, int simd);
+const char* col_simd_name(int simd);
+
+//step functions
+void col_clear(Collision_World_t* col);
+int col_add(Collision_World_t* col, unsigned int id, float cx, float cy, float half_w, float half_h, unsigned int layers, unsigned int hits);
+int col_step(Collision_World_t* col);
+
+#endif
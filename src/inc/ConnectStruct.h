@@ -8,6 +8,27 @@
 #include <string>
 #include <fstream>
 
+//the max size of a single packet (ahead of the module headers, PacketBatch sizes its buffer by it)
+#define MAX_PACKET_LEN 1414
+
+#include "TimerWheel.h"
+#include "PeerTable.h"
+#include "PacketCrypt.h"
+#include "RateControl.h"
+#include "Recorder.h"
+#include "Snapshot.h"
+#include "PlayerStore.h"
+#include "LatencyHist.h"
+#include "Ecs.h"
+#include "JobSystem.h"
+#include "Collision.h"
+#include "ThreadConfig.h"
+#include "RecvStamp.h"
+#include "Trace.h"
+#include "PacketBatch.h"
+#include "Admission.h"
+#include "Cookie.h"
+
 //test variables
 #define LOG 1
 #define ERR 1
@@ -19,6 +40,7 @@
 #define MAX_FPS 240.0
 #define MAX_CLIENT_PPS 240.0
 #define MAX_SERVER_PPS 240.0
+#define MIN_SERVER_PPS 20.0		// floor the per player disp rate can be cut to on a bad link
 
 //socket connections
 #define SERVER_PORT 3940 		// the port the host will use
@@ -27,7 +49,43 @@
 #define MAX_BACKLOG 10			// the max threads open handling messages
 #define REQ_TIMEOUT 80 			// the time (ms) before resending request
 #define CONN_LOST 30000			// the time (ms) without disp packet before quitting
-#define MAX_PACKET_LEN 1414		// the max size of a single packet
+#define PLAYER_LOST 10000		// the time (ms) without a player packet before the host drops them
+#define RATE_LOG_TIME 5000		// the time (ms) between host logs of each player send rate
+#define SNAP_TIME 4				// the time (ms) between host world snapshots
+#define SNAP_HISTORY 256		// the number of host world snapshots kept (about one second)
+#define MAX_REWIND 500			// the max time (ms) a hit check may rewind the world
+#define INTERP_TIME 0			// the time (ms) joins draw behind the newest disp (raise when joins interpolate)
+#define MAX_SESSIONS 1024		// the max games one session server holds
+#define SESSION_QUEUE 1024		// the datagrams waiting per session server worker (power of two)
+#define LOBBY_PORT 3950			// the port the lobby server uses
+#define LOBBY_BEAT 5000			// the time (ms) between host heartbeats to the lobby
+#define LOBBY_TTL 15000			// the time (ms) without a heartbeat before the lobby drops a game
+#define LOBBY_MAX_GAMES 65536	// the max games one lobby holds
+#define LOBBY_NAME_LEN 16		// game name length (with the terminating null)
+#define LOBBY_LIST_MAX 32		// the max games in one lobby answer
+#define LOBBY_EXPIRE_TIME 10	// the time (ms) between lobby ttl passes
+#define LOBBY_TRIES 10			// the lobby queries a join sends (REQ_TIMEOUT apart) before giving up
+#define RELAY_PORT 3945			// the port the relay server uses
+#define RELAY_BEAT 5000			// the time (ms) between host binds to the relay
+#define RELAY_TTL 15000			// the time (ms) without traffic before the relay drops a host or join
+#define RELAY_MAX_ROOMS 4096	// the max hosts one relay serves
+#define RELAY_MAX_PEERS 16384	// the max joins one relay serves
+#define RELAY_BATCH 64			// the max datagrams the relay reads before forwarding them
+#define SPEC_PORT 3955			// the port a spectator node uses
+#define SPEC_TIME 50			// the time (ms) between spectator stream frames
+#define SPEC_DELAY 500			// how far (ms) the spectator stream runs behind the game (inside the snapshot history)
+#define SPEC_KEY_EVERY 20		// spectator frames from one keyframe to the next
+#define SPEC_BEAT 2000			// the time (ms) between spectator (and child node) subscribe refreshes
+#define SPEC_TTL 6000			// the time (ms) without a refresh before a node drops a subscriber
+#define SPEC_MAX_SUBS 16384		// the max subscribers one spectator node serves
+#define ADMIT_PPS (2*MAX_CLIENT_PPS)	// the datagrams per second the host takes from a player (twice a join's keys rate)
+#define ADMIT_BURST 48			// the datagrams a player may send at once above its rate
+#define ADMIT_NEW_PPS 25		// the datagrams per second the host takes from a source without a player slot (join retries)
+#define ADMIT_NEW_BURST 8		// the datagrams such a source may send at once above its rate
+#define ADMIT_IDLE 1000			// the time (ms) without a datagram before a source's bucket may be reused
+#define ADMIT_SOURCES 256		// the sources a host tracks at once (a session server tracks MAX_PLAYER per game)
+#define HOST_RECV_BUF (1 << 20)	// the host socket receive buffer (bytes)
+#define COOKIE_LIFE 5000		// the time (ms) a join cookie from the host stays good
 #define PACKET_HEAD_LEN 14		// packet header length
 
 //packet flags
@@ -37,6 +95,19 @@
 #define PF_DISP 0x08
 #define PF_ACK  0x10
 #define PF_DENY 0x20
+#define PF_MULTI 0x40		// several messages for one peer in one packet (see PacketBatch)
+#define PF_COOKIE 0x80		// join answer carrying a cookie to send back in the next join request (see Cookie)
+
+//spectator stream flags
+#define SPEC_KEY 0x01		// frame with every player
+#define SPEC_DELTA 0x02		// frame with the players that moved since its keyframe
+#define SPEC_SUB 0x04		// subscribe (or refresh) to a node's stream
+#define SPEC_BYE 0x08		// unsubscribe
+#define SPEC_COOKIE 0x10	// node answer to a subscribe without a good cookie (see Cookie)
+
+//relay trailer flags
+#define RELAY_DATA 0x00		// datagram between a host and a join
+#define RELAY_BIND 0x01		// host asking for (or refreshing) a token, and the relay answer
 
 //ascii key info
 #define W_ASCII 119
@@ -55,21 +126,53 @@ WSANOTINITIALISED (10093) = attempting to send or recv with wsa not setup or clo
 */
 
 //useful constants that depend on precompiler definitions
-const unsigned int disp_packet_len = PACKET_HEAD_LEN + 1 + (8*MAX_PLAYER);
-const unsigned int keys_packet_len = PACKET_HEAD_LEN + 8;
+const unsigned int join_crypt_len = PACKET_HEAD_LEN + CRYPT_RAND_LEN;		// encrypted join request (client random)
+const unsigned int ack_crypt_len = PACKET_HEAD_LEN + (2*CRYPT_RAND_LEN);	// encrypted join ack (host random, echoed client random)
+const unsigned int cookie_answer_len = PACKET_HEAD_LEN + COOKIE_LEN;		// join cookie answer (join requests end in a cookie field as long, zeroed until answered)
 const unsigned long max_client_time = (unsigned long)(1000.0/MAX_CLIENT_PPS);
 const unsigned long max_server_time = (unsigned long)(1000.0/MAX_SERVER_PPS);
-const unsigned long max_fps_time = (unsigned long)(1000.0/MAX_FPS);
 
-//all info needed for single player
+//connection info for a single player (positions and in use flags are kept in the player store)
 typedef struct Player_Info {
 	pthread_mutex_t lock;
-	float px_loc;
-	float py_loc;
 	struct sockaddr_in p_addr;
-	int in_use;
+	
+	//host side timers (liveness, scheduled disp sends, quit retransmits)
+	struct Conn_Info* conn;
+	int id;
+	unsigned long long last_recv;
+	Timer_t live_timer, send_timer, retx_timer;
+	unsigned long long send_due_us;			// when the send timer was due (0 before the first send)
+	
+	//host side disp send rate controller for this player
+	Rate_Ctrl_t rate;
+	
+	//host side encryption session with this player (kept after the slot clears so late quits still open)
+	Crypt_Session_t sess;
+	
+	//host side messages for this player not yet sent, they go out together at the end of the send tick
+	Packet_Batch_t out;
+	
+	//host side keys messages taken from this player since it joined
+	unsigned long long keys_in;
 } Player_Info_t;
 
+//hot player state read every tick, kept apart from the locked per player connection info:
+//each position on its own cache line (written by that player's handler threads or, for the self player,
+//the input thread) and the in use flags together (written under the player lock, read without it)
+typedef struct Player_Store {
+	Player_Inbox_t pos[MAX_PLAYER];
+	std::atomic<unsigned char> in_use[MAX_PLAYER];
+} Player_Store_t;
+
+//host side of the spectator stream: the keyframe the deltas are taken against and what has been sent
+typedef struct Spec_Feed {
+	unsigned int frame, key;
+	float kx[MAX_PLAYER], ky[MAX_PLAYER];
+	unsigned char kalive[MAX_PLAYER];
+	unsigned long long frames, bytes;
+} Spec_Feed_t;
+
 //structure holding important connection and player info
 typedef struct Conn_Info {
 	//socket connection info
@@ -77,8 +180,10 @@ typedef struct Conn_Info {
 	unsigned long ul;
 	int nRet;
 	struct sockaddr_in server, client;
+	unsigned short client_port;		// port a join binds (0 for CLIENT_PORT, set before init_join to run several on one machine)
 	WSADATA wsa;
-	unsigned pkt_num;
+	std::atomic<unsigned> pkt_num;
+	unsigned short session_id;		// game on a session server (0 for a single game host)
 	
 	//logging info
 	std::ofstream log, err;
@@ -87,30 +192,119 @@ typedef struct Conn_Info {
 	char self_player_num;
 	float self_x_loc;
 	float self_y_loc;
+	Player_Store_t store;
 	Player_Info_t players[MAX_PLAYER];
 	pthread_mutex_t exit_lock, send_p_lock;
 	int exit, send_p;
+	
+	//recv, send and handler thread placement (loaded with tc_load before init_host or init_join) and the
+	//latencies it is for, recorded under lat_lock: a datagram's arrival (stamped by the network stack where
+	//it can) to the recv thread reading it, the read to its handler thread running, the handler itself, and
+	//a host send coming due to the send thread getting to it
+	Thread_Config_t threads;
+	Recv_Stamp_t stamp;
+	pthread_mutex_t lat_lock;
+	Latency_Hist_t kernel_lat, wake_lat, handle_lat, send_lat;
+	
+	//join keys sends (tick and urgent input path), the oldest input change not yet sent (0 for none)
+	//and the time from an input change to its keys packet going out
+	pthread_mutex_t keys_lock;
+	std::atomic<unsigned long long> input_ns;
+	Latency_Hist_t input_lat;
+	
+	//timers driven by the send thread (times in ms from get_mono_ms)
+	Timer_Wheel_t wheel;
+	
+	//host disp sends: with a job system the send timers only queue their players, then the send thread builds
+	//the disp once and seals and sends it to each queued player as parallel jobs (NULL sends from the timers)
+	Job_System_t* jobs;
+	Player_Info_t* send_batch[MAX_PLAYER];
+	int send_count;
+	std::atomic<int> out_pending;	// some player has messages queued that its disp send did not take
+	
+	//host index of player slots by source address and port
+	Peer_Table_t peers;
+	
+	//host secret the join cookies are minted with (a slot is only given to a join request carrying a good
+	//cookie, so an unanswered request costs the host nothing)
+	Cookie_Key_t cookie;
+	std::atomic<unsigned long long> cookies;	// cookie answers sent
+	
+	//host per source rate limit, checked by the recv thread before a datagram is copied or handled
+	//(admit_off lets every datagram through, for comparisons)
+	Admit_Table_t admit;
+	std::atomic<int> admit_off;
+	
+	//packet encryption (off unless a key file is loaded before init)
+	Crypt_Info_t crypt;
+	
+	//host periodic send rate log, join echo of the newest disp packet for the host rate control
+	Timer_t rate_log_timer;
+	Rate_Echo_t echo;
+	
+	//optional datagram recording, replay runs the packet handlers without a socket
+	Recorder_t rec;
+	int replay;
+	
+	//game world: the player slots are mirrored in as entities next to everything else in the game, and the
+	//disp and snapshot builders and the draw read it through the player query (all under the world lock)
+	Ecs_World_t world;
+	pthread_mutex_t world_lock;
+	Ecs_Entity_t player_ents[MAX_PLAYER];
+	Ecs_Query_t player_query;
+	
+	//host collision step (run with the snapshots) over the player bodies and the world's hitbox entities,
+	//contact begin and end events go to on_contact (the game logic, NULL to only count them)
+	Collision_World_t col;
+	Ecs_Query_t hitbox_query;
+	void (*on_contact)(struct Conn_Info* conn, const Col_Event_t* ev);
+	unsigned long long contacts;
+	
+	//host world snapshots for lag compensated hit checks
+	Snap_History_t snaps;
+	Timer_t snap_timer;
+	
+	//optional lobby listing (host heartbeats to the lobby address while use_lobby is set)
+	struct sockaddr_in lobby;
+	int use_lobby;
+	char game_name[LOBBY_NAME_LEN];
+	Timer_t lobby_timer;
+	
+	//optional relay (every datagram goes to the relay address with a trailer naming the game by token)
+	struct sockaddr_in relay;
+	int use_relay;
+	unsigned int relay_token;
+	Timer_t relay_timer;
+	
+	//optional spectator stream (one delayed stream to the spectator node at spec while use_spec is set,
+	//the nodes fan it out so spectators cost the host nothing)
+	struct sockaddr_in spec;
+	int use_spec;
+	Spec_Feed_t feed;
+	Timer_t spec_timer;
 } Conn_Info_t;
 
 //struct to hold the items necessary for a single recv thread
 typedef struct Recv_Thread {
 	//thread info
 	pthread_t handler_thread;
-	int t_handler;
+	int t_handler;						// 0 while handler_thread is a started thread not yet joined
 	int use_handler;
 	pthread_mutex_t use_lock;
 	
-	//packet info
+	//packet info (arrive_ns is when it reached the socket, recv_ns when the recv thread got it)
 	Conn_Info_t* conn;
+	unsigned long long arrive_ns, recv_ns;
 	int numbytes;
 	char buf[MAX_PACKET_LEN];
 	sockaddr_in si_other;
 } Recv_Thread_t;
 
-//packet header format
+//packet header format (the session id fills what was padding after player_id, so the layout is unchanged)
 typedef struct Header {
 	char flags;
 	char player_id;
+	unsigned short session_id;
 	int packet_num;
 	unsigned long timestamp;
 } Header_t;
@@ -121,6 +315,8 @@ typedef struct Disp_Packet {
 	char in_use;
 	float px_loc[MAX_PLAYER];
 	float py_loc[MAX_PLAYER];
+	unsigned int seq;			// per player disp sequence
+	unsigned int send_us;		// host send time (low 32 bits of the mono clock in us)
 } Disp_Packet_t;
 
 //key info packet format
@@ -128,11 +324,59 @@ typedef struct Keys_Packet {
 	Header_t head;
 	float px_loc;
 	float py_loc;
+	unsigned int echo_seq;		// newest disp seq received (0 before the first disp)
+	unsigned int echo_us;		// send time carried by that disp
+	unsigned int echo_hold;		// us between receiving that disp and sending this packet
+	unsigned int recv_count;	// disp packets received so far
 } Keys_Packet_t;
 
+//relay trailer, added after the (sealed) packet so neither end nor the relay moves the payload
+//host bound datagrams carry the join's address and port (network order), join bound ones carry zeros
+typedef struct Relay_Trailer {
+	unsigned int token;
+	unsigned int addr;
+	unsigned short port;
+	unsigned short flags;
+} Relay_Trailer_t;
+
+//spectator stream frame (host to spectator nodes to spectators, never sealed: it runs SPEC_DELAY behind the game
+//and holds only what a spectator draws). A keyframe holds every player in the game, a delta only the ones that
+//moved since its keyframe, so a delta applies on top of its keyframe alone and a lost frame costs nothing after
+//it. Subscribes and unsubscribes are the head (key is the keyframe the subscriber holds, 0 for none) and a cookie
+//field, zeroed until the node answers with one
+typedef struct Spec_Frame {
+	char flags;
+	char in_use;				// players in the game (bit per slot)
+	char changed;				// players whose position follows (bit per slot)
+	char pad;
+	unsigned int frame;			// frame number (counts keyframes and deltas)
+	unsigned int key;			// keyframe this frame builds on (its own number for a keyframe)
+	unsigned int game_ms;		// game time the frame shows (host mono clock)
+	float loc[2*MAX_PLAYER];	// x and y of each changed player in slot order
+} Spec_Frame_t;
+
+//packet lengths (whole structs are sent so both ends agree on the padding)
+const unsigned int disp_packet_len = sizeof(Disp_Packet_t);
+const unsigned int keys_packet_len = sizeof(Keys_Packet_t);
+const unsigned int relay_trailer_len = sizeof(Relay_Trailer_t);
+const unsigned int multi_head_len = sizeof(Header_t) + sizeof(unsigned short);	// shared header and message count
+const int batch_cap = MAX_PACKET_LEN - CRYPT_OVERHEAD - relay_trailer_len;			// largest packet a batch takes
+const unsigned int spec_head_len = sizeof(Spec_Frame_t) - 2*MAX_PLAYER*sizeof(float);		// spectator frame without positions
+const unsigned int spec_sub_len = spec_head_len + COOKIE_LEN;								// subscribe, unsubscribe and cookie answer
+
 //broad helper functions
 unsigned long get_timestamp();
+unsigned long long get_mono_ns();
+unsigned long long qpc_to_ns(unsigned long long count);
+unsigned long long get_mono_ms();
 void err_out(std::ofstream* err, std::string text);
 void log_out(std::ofstream* log, std::string text);
+int parse_addr(std::string text, unsigned short port, struct sockaddr_in* addr);
+int same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b);
+int udp_bind(WSADATA* wsa, SOCKET* s, struct sockaddr_in* server, unsigned short port, std::ofstream* err);
+int relay_wrap(char* message, int len, unsigned int token, const struct sockaddr_in* peer, unsigned short flags);
+int relay_unwrap(char* buf, int len, Relay_Trailer_t* trailer);
+void recv_handler_join(Recv_Thread_t* rt);
+void recv_drain(Recv_Thread_t* rt, int count);
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef COOKIE_H_
+#define COOKIE_H_
+
+#include <winsock2.h>
+
+//HMAC-SHA256 sizes
+#define CK_KEY_LEN 32				// secret a host mints its cookies with
+#define CK_HASH_LEN 32
+#define CK_BLOCK_LEN 64
+#define CK_MAC_LEN 12				// MAC bytes kept in a cookie
+#define COOKIE_LEN (4 + CK_MAC_LEN)	// time stamp and MAC
+
+//HMAC-SHA256 key, kept as the hash states after the inner and outer padded key blocks so each MAC of a
+//short message costs two block compressions
+typedef struct Cookie_Key {
+	unsigned int inner[8], outer[8];
+} Cookie_Key_t;
+
+//join cookie: proof a join request came from the address and port it names, minted by the host without
+//keeping anything and handed back in the next request (the stamp is the host's ms clock, opaque to joins)
+typedef struct Cookie {
+	unsigned int stamp;
+	unsigned char mac[CK_MAC_LEN];
+} Cookie_t;
+
+//MAC functions
+void ck_set_key(Cookie_Key_t* ck, const unsigned char* key, int key_len);
+void ck_hmac(const Cookie_Key_t* ck, const unsigned char* msg, int len, unsigned char* out);
+
+//cookie functions
+void ck_mint(const Cookie_Key_t* ck, const struct sockaddr_in* addr, unsigned int now_ms, Cookie_t* cookie);
+int ck_check(const Cookie_Key_t* ck, const struct sockaddr_in* addr, unsigned int now_ms, unsigned int life_ms, const Cookie_t* cookie);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef ECS_H_
+#define ECS_H_
+
+//entity ids: slot index in the low bits, slot generation above so a stale id never reaches the slot's next
+//entity (0 is never a live entity)
+#define ECS_INDEX_BITS 20
+#define ECS_MAX_ENTITIES (1 << ECS_INDEX_BITS)
+#define ECS_MAX_COMPONENTS 32		// components are bits of an archetype mask
+#define ECS_BIT(c) (1u << (c))
+
+typedef unsigned int Ecs_Entity_t;
+
+//game components (ids are registered in this order by ecs_init)
+#define ECS_POS 0
+#define ECS_VEL 1
+#define ECS_PLAYER 2
+#define ECS_HITBOX 3
+#define ECS_SPRITE 4
+#define ECS_LIFETIME 5
+#define ECS_GAME_COMPONENTS 6
+
+typedef struct Ecs_Pos {
+	float x, y;
+} Ecs_Pos_t;
+
+typedef struct Ecs_Vel {
+	float dx, dy;						// units per second
+} Ecs_Vel_t;
+
+typedef struct Ecs_Player {
+	int slot;							// player number (index of the connection's player slots)
+} Ecs_Player_t;
+
+typedef struct Ecs_Hitbox {
+	float half_w, half_h;
+} Ecs_Hitbox_t;
+
+typedef struct Ecs_Sprite {
+	unsigned int anim;					// animation of the loaded asset pack
+	unsigned long long start_ms;
+} Ecs_Sprite_t;
+
+typedef struct Ecs_Lifetime {
+	unsigned long long expire_ms;
+} Ecs_Lifetime_t;
+
+//every entity with exactly one set of components lives in that set's archetype: one contiguous column per
+//component (row i of every column and of entities[] is the same entity), so a system walks plain arrays
+typedef struct Ecs_Archetype {
+	unsigned int mask;
+	int count, capacity;
+	Ecs_Entity_t* entities;
+	char* columns[ECS_MAX_COMPONENTS];	// NULL for components not in the mask
+} Ecs_Archetype_t;
+
+//where an entity slot's components are (arch -1 while the slot is free)
+typedef struct Ecs_Record {
+	int arch, row;
+	unsigned int gen;
+} Ecs_Record_t;
+
+//world (not thread safe, the owner locks around it)
+typedef struct Ecs_World {
+	unsigned int comp_size[ECS_MAX_COMPONENTS];
+	int comp_count;
+	Ecs_Archetype_t* archs;
+	int arch_count, arch_capacity;
+	Ecs_Record_t* records;
+	int record_count, record_capacity;
+	int* free_slots;
+	int free_count;
+	int alive;
+} Ecs_World_t;
+
+//archetypes holding at least the all components and none of the none components, matched once each
+//(archetypes are never removed, so ecs_query_update only looks at the ones added since its last call)
+typedef struct Ecs_Query {
+	unsigned int all, none;
+	int* matches;
+	int match_count, match_capacity;
+	int seen;
+} Ecs_Query_t;
+
+//world functions
+int ecs_init(Ecs_World_t* w);
+void ecs_destroy(Ecs_World_t* w);
+int ecs_register(Ecs_World_t* w, unsigned int size);
+
+//entity functions
+Ecs_Entity_t ecs_create(Ecs_World_t* w, unsigned int mask);
+int ecs_delete(Ecs_World_t* w, Ecs_Entity_t e);
+int ecs_alive(const Ecs_World_t* w, Ecs_Entity_t e);
+void* ecs_get(Ecs_World_t* w, Ecs_Entity_t e, int comp);
+int ecs_add(Ecs_World_t* w, Ecs_Entity_t e, int comp);
+int ecs_remove(Ecs_World_t* w, Ecs_Entity_t e, int comp);
+
+//query functions
+void ecs_query_init(Ecs_Query_t* q, unsigned int all, unsigned int none);
+void ecs_query_destroy(Ecs_Query_t* q);
+int ecs_query_update(const Ecs_World_t* w, Ecs_Query_t* q);
+void* ecs_column(const Ecs_Archetype_t* a, int comp);
+
+//mirrors a fixed table of player slots (position and in use flag) into player entities
+int ecs_sync_slots(Ecs_World_t* w, Ecs_Entity_t* ents, int n, const float* x, const float* y, const unsigned char* alive);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+#include <windows.h>
+#include <string>
+
+#include "LatencyHist.h"
+
+//pacing (times in ns unless noted)
+#define FRAME_SPIN_NS 200000		// the end of a wait is spent yielding, timer wakeups can be this late
+#define FRAME_SLEEP_SLACK_NS 1200000	// without a high resolution timer Sleep(1) can take this long
+#define FRAME_LOG_TIME 5000			// the time (ms) between frame time logs
+
+//frame pacer of the draw loop: waits out the rest of each frame on a timer instead of polling, or only
+//measures when the buffer swap already waits for the display (vsync)
+typedef struct Frame_Pacer {
+	unsigned long long period_ns;			// target frame time
+	int vsync;								// buffer swaps wait for the display refresh
+	HANDLE timer;							// high resolution waitable timer (NULL where the os has none)
+	int coarse;								// timeBeginPeriod was raised for the Sleep fallback
+	
+	//frame times
+	unsigned long long next_ns;				// start of the next frame
+	unsigned long long begin_ns;			// start of the current frame (0 before the first)
+	
+	//window of measurements since the last report
+	Latency_Hist_t interval;				// frame start to frame start
+	Latency_Hist_t work;					// frame start to the end of its cpu work (swap wait excluded)
+	unsigned long long frames, missed, slept_ns, window_ns;
+} Frame_Pacer_t;
+
+int fp_init(Frame_Pacer_t* fp, double fps);
+void fp_set_vsync(Frame_Pacer_t* fp, double refresh_hz);
+void fp_quit(Frame_Pacer_t* fp);
+unsigned long long fp_wait(Frame_Pacer_t* fp);
+void fp_begin(Frame_Pacer_t* fp, unsigned long long now_ns);
+void fp_end(Frame_Pacer_t* fp, unsigned long long now_ns);
+std::string fp_report(Frame_Pacer_t* fp);
+
+#endif
@@ -22,8 +22,14 @@ class HostConnect {
 		pthread_t send_thread, recv_thread;
 		int t_send, t_recv;
 		
+		//per tick send jobs
+		Job_System_t jobs;
+		
 		//initialized
 		int prev_init;
+		
+		//private helper functions
+		int close_host(Conn_Info_t* conn_ptr);
 	
 	public:
 		HostConnect();
@@ -34,12 +40,45 @@ class HostConnect {
 		pthread_t get_recv_thread();
 };
 
+//one player's disp send, run as a job by host_send_batch
+typedef struct Host_Send_Job {
+	Conn_Info_t* conn;
+	Player_Info_t* player;
+	const char* disp;
+	int paused;
+} Host_Send_Job_t;
+
 //thread functions and helpers
+int host_init_state(Conn_Info_t* conn);
 void* host_recv(void* input);
 void* host_pkt_handle_wrap(void* input);
 int host_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other);
+int host_msg_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other);
 
 void* host_send(void* input);
+void host_send_timer(void* input);
+int host_send_batch(Conn_Info_t* conn);
+void host_send_job(Job_System_t* js, int worker, void* input);
+int host_send_player(Conn_Info_t* conn, Player_Info_t* player, char* message, int paused);
+void host_retx_timer(void* input);
+void host_live_timeout(void* input);
+void host_rate_log(void* input);
+int host_world_players(Conn_Info_t* conn, float* x, float* y, unsigned char* alive);
+int host_collide(Conn_Info_t* conn);
+void host_snap_timer(void* input);
+void host_lobby_beat(void* input);
+int host_lobby_remove(Conn_Info_t* conn);
+void host_relay_beat(void* input);
+int host_relay_recv(Conn_Info_t* conn, char* buf, int bytes, struct sockaddr_in* si_other);
+void host_spec_timer(void* input);
+int host_resolve_action(Conn_Info_t* conn, int player_num, float cx, float cy, float reach, int* hits, int max_hits);
+int host_clear_player(Conn_Info_t* conn, int player_num);
+int host_queue(Conn_Info_t* conn, Player_Info_t* player, const char* message, int len);
+int host_flush_player(Conn_Info_t* conn, Player_Info_t* player);
+int host_flush(Conn_Info_t* conn);
+int host_sendto(Conn_Info_t* conn, int player_num, char* message, int len, struct sockaddr_in* addr);
+int host_open_packet(Conn_Info_t* conn, int bytes, char* buf);
+int host_join_session(Conn_Info_t* conn, int player_num, const unsigned char* client_rand, unsigned char* host_rand);
 int host_build_disp_message(Conn_Info_t* conn, char* message);
 
 #endif
@@ -0,0 +1,47 @@
+#ifndef INPUT_STATE_H_
+#define INPUT_STATE_H_
+
+#include <pthread.h>
+
+#include "ConnectStruct.h"
+
+//sampling (the held keys are turned into movement at a fixed rate, not at the os key repeat rate)
+#define INPUT_HZ 1000			// movement samples per second
+#define MOVE_SPEED 1.5			// units per second while a direction key is held
+
+//held direction keys
+#define IN_UP    0x01
+#define IN_LEFT  0x02
+#define IN_DOWN  0x04
+#define IN_RIGHT 0x08
+
+//self player input: the key callbacks only flip bits here (no player lock), the sample thread integrates
+//the held keys into the self position and hands changes to the urgent send path
+typedef struct Input_State {
+	Conn_Info_t* conn;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	unsigned keys;							// held keys (IN_*)
+	float x, y;								// self position integrated up to last_ns
+	unsigned long long last_ns;
+	unsigned long long change_ns;			// first key change the sample thread has not seen (0 for none)
+	
+	//urgent send path (join_send_now for a join, NULL for a host whose position goes out with its disp packets)
+	int urgent;
+	int (*send_now)(Conn_Info_t* conn);
+	
+	//thread
+	pthread_t thread;
+	int exit;
+	unsigned long long samples, changes;
+} Input_State_t;
+
+int in_init(Input_State_t* in, Conn_Info_t* conn, int (*send_now)(Conn_Info_t* conn));
+int in_start(Input_State_t* in);
+int in_stop(Input_State_t* in);
+int in_key_down(Input_State_t* in, unsigned char key, unsigned long long now_ns);
+int in_key_up(Input_State_t* in, unsigned char key, unsigned long long now_ns);
+int in_sample(Input_State_t* in, unsigned long long now_ns);
+void* in_run(void* input);
+
+#endif
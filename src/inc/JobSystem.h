@@ -0,0 +1,71 @@
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+
+#include <pthread.h>
+#include <atomic>
+
+//scheduler layout
+#define JS_MAX_WORKERS 64
+#define JS_DEQUE_SIZE 1024			// jobs per worker deque (power of two), a spawn into a full deque runs inline
+#define JS_SPIN 64					// failed steal rounds (yielding between them) before an idle worker sleeps
+#define JS_CACHE_LINE 64
+
+struct Job_System;
+
+//a job runs on some worker, worker is the index to spawn and wait with from inside it
+typedef void (*Job_Func_t)(struct Job_System* js, int worker, void* arg);
+
+//fork/join counter: jobs spawned into a group that have not finished
+typedef struct Job_Group {
+	std::atomic<int> pending;
+} Job_Group_t;
+
+typedef struct Job {
+	Job_Func_t func;
+	void* arg;
+	Job_Group_t* group;
+} Job_t;
+
+//Chase-Lev deque: the owning worker pushes and pops at the bottom, thieves take from the top
+//(top and bottom are kept on separate lines so the owner and the thieves do not share one)
+typedef struct Job_Deque {
+	std::atomic<long long> top;
+	char pad0[JS_CACHE_LINE];
+	std::atomic<long long> bottom;
+	char pad1[JS_CACHE_LINE];
+	Job_t* jobs;							// [JS_DEQUE_SIZE]
+} Job_Deque_t;
+
+typedef struct Job_Worker {
+	struct Job_System* js;
+	int id;
+	pthread_t thread;						// not started for worker 0
+	Job_Deque_t deque;
+	unsigned long long ran, stolen;			// counts (written by the worker only)
+} Job_Worker_t;
+
+//work stealing scheduler: worker 0 is whichever single thread calls js_spawn and js_wait with index 0
+//(e.g. the host send thread), workers 1 to count - 1 are threads of the system
+typedef struct Job_System {
+	Job_Worker_t* workers;					// [count]
+	int count;
+	
+	//idle workers sleep on wake once every deque is empty (queued counts jobs spawned but not yet taken)
+	std::atomic<int> queued;
+	std::atomic<int> sleepers;
+	std::atomic<int> exit;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+} Job_System_t;
+
+//system functions
+int js_cores();
+int js_init(Job_System_t* js, int workers);
+void js_quit(Job_System_t* js);
+
+//fork/join functions (worker is the calling thread's index)
+void js_group_init(Job_Group_t* group);
+int js_spawn(Job_System_t* js, int worker, Job_Group_t* group, Job_Func_t func, void* arg);
+void js_wait(Job_System_t* js, int worker, Job_Group_t* group);
+
+#endif
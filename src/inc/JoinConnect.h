@@ -38,11 +38,16 @@ class JoinConnect {
 };
 
 //thread functions and helpers
+int join_init_state(Conn_Info_t* conn);
 void* join_recv(void* input);
 void* join_pkt_handle_wrap(void* input);
 int join_pkt_handle(Conn_Info_t* conn, int bytes, char* buf, struct sockaddr_in* si_other);
+int join_msg_handle(Conn_Info_t* conn, int bytes, char* buf);
 
 void* join_send(void* input);
+int join_send_keys(Conn_Info_t* conn, char* message);
+int join_send_now(Conn_Info_t* conn);
 int join_build_keys_message(Conn_Info_t* conn, char* message);
+int join_sendto(Conn_Info_t* conn, char* message, int len);
 
 #endif
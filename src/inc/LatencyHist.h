@@ -0,0 +1,25 @@
+#ifndef LATENCY_HIST_H_
+#define LATENCY_HIST_H_
+
+#include <string>
+
+//log linear buckets: values under LH_SUB ns get a bucket each, above that every power of two is split into
+//LH_SUB buckets (about 6% wide) so any latency from ns to minutes fits in a fixed array
+#define LH_SUB_BITS 4
+#define LH_SUB (1 << LH_SUB_BITS)
+#define LH_BUCKETS ((64 - LH_SUB_BITS + 1) * LH_SUB)
+
+//latency histogram (one writer at a time, readers may see a count mid update)
+typedef struct Latency_Hist {
+	unsigned long long counts[LH_BUCKETS];
+	unsigned long long total;
+	unsigned long long sum_ns, max_ns;
+} Latency_Hist_t;
+
+void lh_init(Latency_Hist_t* h);
+void lh_record(Latency_Hist_t* h, unsigned long long ns);
+void lh_merge(Latency_Hist_t* dst, const Latency_Hist_t* src);
+unsigned long long lh_percentile(const Latency_Hist_t* h, double pct);
+std::string lh_summary(const Latency_Hist_t* h);
+
+#endif
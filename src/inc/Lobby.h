@@ -0,0 +1,120 @@
+#ifndef LOBBY_H_
+#define LOBBY_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#include "ConnectStruct.h"
+
+//index layout (games are spread over shards by key so registrations and queries on different shards never
+//wait on each other, each shard expires its own games with its own timer wheel)
+#define LOBBY_SHARDS 16
+#define LOBBY_KEY_EMPTY 0ULL
+
+//lobby packet flags (own port, so these do not clash with the game packet flags)
+#define LB_REGISTER 0x01	// host heartbeat (adds or refreshes a game)
+#define LB_REMOVE 0x02		// host closed the game
+#define LB_QUERY 0x04		// join asks for open games
+#define LB_LIST 0x08		// lobby answer to a query
+
+//one open game as listed by the lobby (address and port in network order, as seen by the lobby)
+typedef struct Lobby_Game_Info {
+	unsigned int addr;
+	unsigned short port;
+	unsigned short session_id;
+	unsigned char players;
+	unsigned char max_players;
+	char name[LOBBY_NAME_LEN];
+} Lobby_Game_Info_t;
+
+//host heartbeat and removal format (the game is keyed by the source address and the header session id)
+typedef struct Lobby_Register_Packet {
+	Header_t head;
+	unsigned char players;
+	unsigned char max_players;
+	char name[LOBBY_NAME_LEN];
+} Lobby_Register_Packet_t;
+
+//join query (packet_num is echoed so a join can match the answer, the rest is zero padding up to the size of
+//the largest answer so a spoofed query never gets back more bytes than it sent) and the lobby answer
+typedef struct Lobby_List_Packet {
+	Header_t head;
+	unsigned int count;
+	Lobby_Game_Info_t games[LOBBY_LIST_MAX];
+} Lobby_List_Packet_t;
+
+const unsigned int lobby_register_len = sizeof(Lobby_Register_Packet_t);
+const unsigned int lobby_list_head_len = sizeof(Lobby_List_Packet_t) - (LOBBY_LIST_MAX * sizeof(Lobby_Game_Info_t));
+const unsigned int lobby_query_len = sizeof(Lobby_List_Packet_t);
+
+//one registered game (last_seen only moves forward on a heartbeat, the ttl timer checks it when it fires)
+typedef struct Lobby_Entry {
+	struct Lobby_Shard* shard;
+	unsigned long long key;
+	Lobby_Game_Info_t info;
+	unsigned long long last_seen;
+	Timer_t ttl_timer;
+	int live_pos;						// index in the shard's live list, -1 when free
+} Lobby_Entry_t;
+
+//one shard: open addressing table (key to entry) over a fixed pool of entries, the dense list of live
+//entries walked by queries, and the wheel of ttl timers, all under the shard lock
+typedef struct Lobby_Shard {
+	pthread_mutex_t lock;
+	unsigned long long now;				// time of the expiry pass running the ttl timers
+	unsigned long long* keys;			// [mask + 1]
+	int* slots;							// [mask + 1]
+	unsigned mask;
+	Lobby_Entry_t* entries;				// [cap]
+	int* free_list;						// [cap]
+	int free_count;
+	int* live;							// [cap]
+	int live_count;
+	unsigned cap;
+	unsigned long long ttl;
+	Timer_Wheel_t wheel;
+} Lobby_Shard_t;
+
+typedef struct Lobby_Index {
+	Lobby_Shard_t shards[LOBBY_SHARDS];
+	std::atomic<unsigned> cursor;		// shard a query starts from, moved on by each query
+} Lobby_Index_t;
+
+//lobby server (handler threads share the socket, one more thread expires games)
+typedef struct Lobby_Server {
+	SOCKET s;
+	WSADATA wsa;
+	struct sockaddr_in server;
+	std::ofstream log, err;
+	Lobby_Index_t idx;
+	pthread_t* threads;
+	int n_threads;
+	pthread_t expire_thread;
+	std::atomic<int> exit;
+	std::atomic<unsigned long long> registers, removes, queries, bad;
+} Lobby_Server_t;
+
+//index functions
+int li_init(Lobby_Index_t* li, unsigned max_games, unsigned long long ttl_ms);
+void li_destroy(Lobby_Index_t* li);
+int li_register(Lobby_Index_t* li, const Lobby_Game_Info_t* info, unsigned long long now);
+int li_remove(Lobby_Index_t* li, unsigned int addr, unsigned short port, unsigned short session_id);
+int li_query(Lobby_Index_t* li, Lobby_Game_Info_t* out, int max);
+int li_count(Lobby_Index_t* li);
+void li_expire(Lobby_Index_t* li, unsigned long long now);
+
+//server functions
+int lobby_init(Lobby_Server_t* ls, unsigned short port, int n_threads, unsigned max_games, unsigned long long ttl_ms);
+int lobby_quit(Lobby_Server_t* ls);
+void* lobby_recv(void* input);
+void* lobby_expire(void* input);
+int lobby_handle(Lobby_Server_t* ls, int bytes, char* buf, struct sockaddr_in* si_other);
+
+//host and join side helpers
+int lobby_addr(std::string lobby_host, struct sockaddr_in* addr);
+int lobby_find(std::string lobby_host, Lobby_Game_Info_t* games, int max);
+
+#endif
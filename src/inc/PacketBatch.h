@@ -0,0 +1,33 @@
+#ifndef PACKET_BATCH_H_
+#define PACKET_BATCH_H_
+
+#define PB_BUF_LEN MAX_PACKET_LEN	// batch buffer (a whole packet)
+
+//what each message of a multi packet keeps of its own header (the rest is the shared header): full length of
+//the message as it was queued, its flags and its packet number
+typedef struct Msg_Head {
+	unsigned short len;
+	char flags;
+	char pad;
+	int packet_num;
+} Msg_Head_t;
+
+//messages queued for one peer, kept as a multi packet: the first message's header, then each message as a
+//Msg_Head_t and its body (the message past its header). Taking it gives the multi packet, or the message
+//itself when only one was queued so a lone message goes out exactly as it would unbatched
+typedef struct Packet_Batch {
+	char buf[PB_BUF_LEN];
+	int len;					// bytes used (0 when empty)
+	int cap;					// the most a taken packet can hold (room is left for the seal and relay trailer, and for a
+								// lone message's count and Msg_Head_t in buf)
+	int count;					// messages queued
+	unsigned long long msgs, packets;	// messages and packets taken so far
+} Packet_Batch_t;
+
+//batch functions
+void pb_init(Packet_Batch_t* pb, int cap);
+int pb_add(Packet_Batch_t* pb, const char* message, int len);
+int pb_take(Packet_Batch_t* pb, char* out);
+int pb_next(const char* buf, int bytes, int* offset, char* out);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PACKET_CRYPT_H_
+#define PACKET_CRYPT_H_
+
+#include <pthread.h>
+#include <string>
+#include <atomic>
+
+//AES-128-GCM sizes
+#define CRYPT_KEY_LEN 16
+#define CRYPT_BLOCK_LEN 16
+#define CRYPT_NONCE_LEN 12
+#define CRYPT_TAG_LEN 16
+#define CRYPT_OVERHEAD (CRYPT_NONCE_LEN + CRYPT_TAG_LEN)	// trailer added to each sealed packet
+#define CRYPT_RAND_LEN 16		// handshake random carried by join requests and join acks
+#define CRYPT_REPLAY_WINDOW 64	// how far behind the newest sequence a packet may arrive
+
+//nonce direction bytes (a packet is only opened with the direction it was sealed for)
+#define CRYPT_DIR_HOST 'H'
+#define CRYPT_DIR_JOIN 'J'
+
+//expanded AES-128 key with its GHASH key and 4-bit multiplication tables
+typedef struct Crypt_Key {
+	unsigned int rk[44];
+	unsigned char rk_bytes[176];
+	unsigned char h[CRYPT_BLOCK_LEN];
+	unsigned long long hh[16], hl[16];
+} Crypt_Key_t;
+
+//one side of an encrypted peer link (session key, send sequence and replay window)
+typedef struct Crypt_Session {
+	Crypt_Key_t key;
+	unsigned char client_rand[CRYPT_RAND_LEN];
+	unsigned char host_rand[CRYPT_RAND_LEN];
+	std::atomic<unsigned long long> send_seq;
+	pthread_mutex_t lock;
+	unsigned long long recv_top;
+	unsigned long long recv_mask;
+	int ready;
+} Crypt_Session_t;
+
+//encryption settings of a connection (base key is the pre-shared key used for the join handshake)
+typedef struct Crypt_Info {
+	int enabled;
+	Crypt_Key_t base;
+	Crypt_Session_t host_sess;
+} Crypt_Info_t;
+
+//block cipher and AEAD functions
+int crypt_init();
+int crypt_hw_available();
+void crypt_use_hw(int use);
+int crypt_set_key(Crypt_Key_t* key, const unsigned char* k);
+int crypt_seal(const Crypt_Key_t* key, const unsigned char* nonce, const unsigned char* aad, int aad_len, unsigned char* data, int len, unsigned char* tag);
+int crypt_open(const Crypt_Key_t* key, const unsigned char* nonce, const unsigned char* aad, int aad_len, unsigned char* data, int len, const unsigned char* tag);
+int crypt_random(unsigned char* buf, int len);
+
+//session and packet functions
+int crypt_load_psk(Crypt_Info_t* ci, std::string path);
+int crypt_session_init(Crypt_Session_t* sess);
+int crypt_derive_session(const Crypt_Info_t* ci, Crypt_Session_t* sess, const unsigned char* client_rand, const unsigned char* host_rand);
+int pkt_seal(const Crypt_Key_t* key, Crypt_Session_t* sess, char dir, char* buf, int head_len, int len);
+int pkt_open(const Crypt_Key_t* key, Crypt_Session_t* sess, char dir, char* buf, int head_len, int len);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PEER_TABLE_H_
+#define PEER_TABLE_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <atomic>
+
+//entry encoding: (ip << 32 | port << 16 | slot) with 0 as an empty entry
+#define PT_EMPTY 0ULL
+#define PT_MAX_SLOT 0xFFFF
+
+//open addressing (linear probing) index from peer (ip, port) to player slot
+//lookups are lock free and retry if a writer ran meanwhile (seq is odd while a write is in progress),
+//inserts and removes are serialized by write_lock and removes shift entries back so no tombstones build up
+typedef struct Peer_Table {
+	std::atomic<unsigned long long>* entries;
+	std::atomic<unsigned> seq;
+	unsigned mask;
+	unsigned count;
+	pthread_mutex_t write_lock;
+} Peer_Table_t;
+
+//table functions
+int pt_init(Peer_Table_t* pt, unsigned max_peers);
+void pt_destroy(Peer_Table_t* pt);
+int pt_find(Peer_Table_t* pt, const struct sockaddr_in* addr);
+int pt_insert(Peer_Table_t* pt, const struct sockaddr_in* addr, int slot);
+int pt_remove(Peer_Table_t* pt, const struct sockaddr_in* addr);
+
+#endif
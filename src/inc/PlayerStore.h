@@ -0,0 +1,19 @@
+#ifndef PLAYER_STORE_H_
+#define PLAYER_STORE_H_
+
+#include <atomic>
+
+#define CACHE_LINE 64
+
+//newest position of one player, alone on its cache line so the threads writing neighbouring players never
+//share a line (x and y are packed into one word so a reader never sees half of an update)
+typedef struct alignas(CACHE_LINE) Player_Inbox {
+	std::atomic<unsigned long long> pos;
+} Player_Inbox_t;
+
+//position functions
+void ps_post(Player_Inbox_t* box, float x, float y);
+void ps_peek(const Player_Inbox_t* box, float* x, float* y);
+void ps_gather(const Player_Inbox_t* boxes, const std::atomic<unsigned char>* in_use, unsigned n, float* x, float* y, unsigned char* alive);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef RATE_CONTROL_H_
+#define RATE_CONTROL_H_
+
+#include <pthread.h>
+
+//controller tuning (times in microseconds)
+#define RC_UPDATE_US 50000			// least time between rate decisions
+#define RC_INCREASE_PPS 8.0			// additive increase per decision on a clear link
+#define RC_DECREASE 0.7				// multiplicative decrease on loss or queue build up
+#define RC_LOSS_HIGH 0.10			// smoothed loss fraction that triggers a decrease
+#define RC_LOSS_LOW 0.02			// smoothed loss fraction under which the rate may grow
+#define RC_QUEUE_HIGH_US 40000		// queueing delay (srtt over min rtt) that triggers a decrease
+#define RC_QUEUE_LOW_US 10000		// queueing delay under which the rate may grow
+#define RC_MIN_RTT_WINDOW_US 10000000	// min rtt is re-learned after this long (route changes)
+#define RC_FEEDBACK_TIMEOUT_US 1000000	// halve the rate when no feedback arrives for this long
+
+//host side sender state for one player (disp packets out, echoes back in keys packets)
+typedef struct Rate_Ctrl {
+	double rate;
+	double min_rate, max_rate;
+	double loss;
+	unsigned long long srtt_us, rttvar_us;
+	unsigned long long min_rtt_us, min_rtt_at;
+	unsigned long long last_update, last_feedback;
+	unsigned long long next_send_us;
+	unsigned seq;
+	unsigned last_echo_seq, last_recv_count;
+	int have_echo;
+} Rate_Ctrl_t;
+
+//client side record of the newest disp packet, echoed back to the host in each keys packet
+typedef struct Rate_Echo {
+	pthread_mutex_t lock;
+	unsigned seq;
+	unsigned send_us;
+	unsigned recv_count;
+	unsigned long long recv_at;
+	int valid;
+} Rate_Echo_t;
+
+//sender functions
+void rc_init(Rate_Ctrl_t* rc, double min_rate, double max_rate, unsigned long long now_us);
+unsigned rc_next_seq(Rate_Ctrl_t* rc);
+void rc_on_feedback(Rate_Ctrl_t* rc, unsigned echo_seq, unsigned echo_us, unsigned hold_us, unsigned recv_count, unsigned long long now_us);
+unsigned long long rc_next_send(Rate_Ctrl_t* rc, unsigned long long now_us);
+
+//receiver functions
+void rc_echo_init(Rate_Echo_t* re);
+void rc_echo_record(Rate_Echo_t* re, unsigned seq, unsigned send_us, unsigned long long now_us);
+int rc_echo_get(Rate_Echo_t* re, unsigned long long now_us, unsigned* seq, unsigned* send_us, unsigned* hold_us, unsigned* recv_count);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <windows.h>
+#include <string>
+#include <atomic>
+
+//file layout: Rec_File_Head_t then entries (Rec_Entry_t followed by the datagram, padded to 8 bytes)
+#define REC_MAGIC "GSREC01"
+#define REC_SIZE (256ULL << 20)		// file and mapping size, set at open (recording stops when it is full)
+#define REC_ALIGN 8
+
+//entry directions
+#define REC_IN 'I'			// datagram accepted by the packet handler (after decryption)
+#define REC_OUT 'O'			// datagram sent (before encryption)
+#define REC_DROP 'D'		// datagram that failed authentication (raw bytes)
+
+//recording roles
+#define REC_HOST 'H'
+#define REC_JOIN 'J'
+
+//file header (used is rewritten after every append so a crash still leaves a readable prefix)
+typedef struct Rec_File_Head {
+	char magic[8];
+	unsigned int version;
+	char role;
+	char crypt;			// session was encrypted (packet layouts carry the handshake randoms)
+	char pad[2];
+	unsigned long long start_ns;
+	unsigned long long used;
+} Rec_File_Head_t;
+
+//entry header (addr and port in network order, time in ns from the start of the recording)
+typedef struct Rec_Entry {
+	unsigned long long time_ns;
+	unsigned int addr;
+	unsigned short port;
+	unsigned short len;
+	char dir;
+	char pad[7];
+} Rec_Entry_t;
+
+//append side, shared by the recv, send and handler threads. The lock is made by the first open and kept
+//(never destroyed) so a thread still in rec_write during a close never takes a destroyed lock; active is
+//read once without it to skip the lock when not recording, then again under it
+typedef struct Recorder {
+	pthread_mutex_t lock;
+	int lock_ready;
+	HANDLE file, map;
+	char* base;
+	unsigned long long size;
+	unsigned long long used;
+	unsigned long long start_ns;
+	std::atomic<int> active;
+} Recorder_t;
+
+//read side (the whole file mapped read only)
+typedef struct Rec_Reader {
+	HANDLE file, map;
+	const char* base;
+	unsigned long long used;
+	unsigned long long pos;
+	char role, crypt;
+} Rec_Reader_t;
+
+//recording functions
+int rec_open(Recorder_t* rec, std::string path, char role, int crypt);
+int rec_write(Recorder_t* rec, char dir, const struct sockaddr_in* addr, const char* buf, int len);
+int rec_close(Recorder_t* rec);
+
+//reading functions
+int rec_load(Rec_Reader_t* rd, std::string path);
+const Rec_Entry_t* rec_next(Rec_Reader_t* rd);
+void rec_unload(Rec_Reader_t* rd);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RECV_STAMP_H_
+#define RECV_STAMP_H_
+
+#include <winsock2.h>
+#include <mswsock.h>
+#include <mstcpip.h>
+
+//receive timestamping ioctl and control message (Windows 10 2004 and later, missing from older mingw headers)
+#ifndef SIO_TIMESTAMPING
+#define SIO_TIMESTAMPING 0x980000ebu
+#define TIMESTAMPING_FLAG_RX 0x1
+#define TIMESTAMPING_FLAG_TX 0x2
+typedef struct _TIMESTAMPING_CONFIG {
+	ULONG Flags;
+	USHORT TxTimestampsBuffered;
+} TIMESTAMPING_CONFIG;
+#endif
+#ifndef SO_TIMESTAMP
+#define SO_TIMESTAMP 0x300A
+#endif
+
+//where a packet's arrival time comes from
+#define RS_USER 0				// the recv thread, once recvfrom returned it
+#define RS_KERNEL 1				// the network stack, as the datagram was queued on the socket
+
+//receive path of one socket: with kernel timestamps on, datagrams are read with WSARecvMsg so the
+//arrival time comes with them as a control message (a performance counter reading)
+typedef struct Recv_Stamp {
+	LPFN_WSARECVMSG recv_msg;	// NULL for plain recvfrom
+	int source;
+	unsigned long long missing;	// datagrams read without a timestamp while kernel stamps were on
+} Recv_Stamp_t;
+
+//receive functions
+int rs_init(Recv_Stamp_t* rs, SOCKET s);
+int rs_recvfrom(Recv_Stamp_t* rs, SOCKET s, char* buf, int len, struct sockaddr_in* from, int* fromlen, unsigned long long* arrive_ns);
+const char* rs_source_name(int source);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef RELAY_H_
+#define RELAY_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <atomic>
+#include <fstream>
+
+#include "ConnectStruct.h"
+
+//host behind the relay (a room), found by the low 16 bits of its token (id + 1), the upper bits count the
+//times rooms were handed out so a stale token does not reach the room's next host
+typedef struct Relay_Room {
+	struct Relay_Server* rs;
+	int id;
+	unsigned int token;						// 0 while the room is free
+	struct sockaddr_in host;
+	unsigned long long last_seen;
+	Timer_t ttl_timer;
+} Relay_Room_t;
+
+//join sending through the relay, found by its address in the peer index
+typedef struct Relay_Peer {
+	struct Relay_Server* rs;
+	int id;
+	unsigned int token;						// room the join last sent to, 0 while the peer is free
+	struct sockaddr_in addr;
+	unsigned long long last_seen;
+	Timer_t ttl_timer;
+} Relay_Peer_t;
+
+//relay server: one thread reads a batch of datagrams into fixed buffers, rewrites each trailer in place
+//and sends the same buffer on, so forwarding never copies or allocates
+typedef struct Relay_Server {
+	//socket info
+	SOCKET s;
+	WSADATA wsa;
+	struct sockaddr_in server;
+	
+	//logging info
+	std::ofstream log, err;
+	
+	//rooms, joins and their ttl timers (only touched by the relay thread)
+	Relay_Room_t* rooms;					// [RELAY_MAX_ROOMS]
+	int* free_rooms;
+	int free_room_count;
+	unsigned short gen;
+	Relay_Peer_t* peers;					// [RELAY_MAX_PEERS]
+	int* free_peers;
+	int free_peer_count;
+	Peer_Table_t peer_index;
+	Timer_Wheel_t wheel;
+	unsigned long long now;
+	
+	//batch buffers
+	char (*bufs)[MAX_PACKET_LEN];			// [RELAY_BATCH]
+	int* lens;
+	struct sockaddr_in* from;
+	
+	//thread
+	pthread_t thread;
+	std::atomic<int> exit;
+	
+	//counts (written by the relay thread only)
+	unsigned long long forwarded, dropped, binds, batches, busy_ns;
+} Relay_Server_t;
+
+//server functions
+int relay_init(Relay_Server_t* rs, unsigned short port);
+int relay_quit(Relay_Server_t* rs);
+void* relay_run(void* input);
+int relay_forward(Relay_Server_t* rs, char* buf, int len, const struct sockaddr_in* from);
+
+#endif
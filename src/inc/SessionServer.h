@@ -0,0 +1,96 @@
+#ifndef SESSION_SERVER_H_
+#define SESSION_SERVER_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <atomic>
+#include <vector>
+#include <fstream>
+
+#include "ConnectStruct.h"
+
+//datagram waiting for the worker that owns its session (copied once off the socket, never allocated)
+typedef struct Session_Packet {
+	unsigned short session_id;
+	int numbytes;
+	struct sockaddr_in si_other;
+	char buf[MAX_PACKET_LEN];
+} Session_Packet_t;
+
+//worker thread running the packet handlers and timer wheels of the sessions it owns
+//the inbound ring has one producer (the demux thread) and one consumer (the worker), head and tail are kept
+//on separate lines so the two sides do not share one
+typedef struct Session_Worker {
+	pthread_t thread;
+	struct Session_Server* ss;
+	int id;
+	Session_Packet_t* queue;					// [SESSION_QUEUE]
+	std::atomic<unsigned> head;					// next slot written by the demux thread
+	char pad0[CACHE_LINE];
+	std::atomic<unsigned> tail;					// next slot read by the worker
+	char pad1[CACHE_LINE];
+	
+	//owned sessions (changed and walked under lock) and the wake up for an idle worker
+	pthread_mutex_t lock;
+	std::vector<Conn_Info_t*> sessions;
+	pthread_mutex_t wake_lock;
+	pthread_cond_t wake;
+	
+	//counts (written by the worker only)
+	unsigned long long handled, rejected, timers, busy_ns;
+} Session_Worker_t;
+
+//many independent games behind one socket: each session is a full host state (player table, store, peer
+//index, timer wheel, snapshots) with no self player, reached by the session id in the packet header
+typedef struct Session_Server {
+	//shared socket info
+	SOCKET s;
+	WSADATA wsa;
+	struct sockaddr_in server;
+	
+	//logging info
+	std::ofstream log, err;
+	
+	//session table (a session is only touched under its worker's lock, owner is -1 for a free id)
+	Conn_Info_t** sessions;						// [max_sessions + 1], id 0 is never used
+	std::atomic<int>* owner;					// [max_sessions + 1]
+	char* closing;								// [max_sessions + 1], set (under open_lock) while a close waits for its acks
+	unsigned max_sessions;
+	unsigned next_id;
+	pthread_mutex_t open_lock;
+	
+	//packet encryption for every session (loaded with crypt_load_psk before ss_init)
+	Crypt_Info_t crypt;
+	
+	//lobby every session is listed on (set with lobby_addr before ss_init)
+	struct sockaddr_in lobby;
+	int use_lobby;
+	
+	//threads
+	Session_Worker_t* workers;
+	int n_workers;
+	pthread_t recv_thread;
+	std::atomic<int> exit;
+	
+	//per source rate limit on everything the demux thread reads
+	Admit_Table_t admit;
+	
+	//demux counts (written by the demux thread only)
+	unsigned long long received, no_session, queue_full;
+} Session_Server_t;
+
+//server functions
+int ss_init(Session_Server_t* ss, unsigned short port, unsigned max_sessions, int n_workers);
+int ss_quit(Session_Server_t* ss);
+int ss_open_session(Session_Server_t* ss);
+int ss_close_session(Session_Server_t* ss, int session_id);
+int ss_session_players(Session_Server_t* ss, int session_id);
+
+//thread functions and helpers
+int ss_quit_players(Conn_Info_t* conn);
+void* ss_recv(void* input);
+void* ss_worker(void* input);
+int ss_route(Session_Server_t* ss, const char* buf, int numbytes, const struct sockaddr_in* si_other);
+void ss_wake(Session_Worker_t* w);
+
+#endif
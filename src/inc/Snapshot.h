@@ -0,0 +1,29 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <pthread.h>
+
+//ring of per tick world snapshots kept by the host for lag compensated hit checks
+//stored by field rather than by player: one array of tick times (searched on rewind) and one row of x, y and
+//alive per tick (players side by side), so a rewind reads two neighbouring rows front to back
+typedef struct Snap_History {
+	pthread_mutex_t lock;
+	unsigned long long* time_us;	// [frames]
+	float* x;						// [frames * players]
+	float* y;						// [frames * players]
+	unsigned char* alive;			// [frames * players]
+	unsigned frames, mask, players;
+	unsigned long long head;		// total ticks recorded (newest is head - 1)
+} Snap_History_t;
+
+//history functions
+int sh_init(Snap_History_t* sh, unsigned frames, unsigned players);
+void sh_destroy(Snap_History_t* sh);
+int sh_record(Snap_History_t* sh, unsigned long long time_us, const float* x, const float* y, const unsigned char* alive);
+
+//rewind functions
+unsigned long long sh_view_time(unsigned long long now_us, unsigned long long rtt_us, unsigned long long interp_us, unsigned long long max_rewind_us);
+int sh_rewind(Snap_History_t* sh, unsigned long long view_us, float* x, float* y, unsigned char* alive);
+int sh_hit_test(Snap_History_t* sh, unsigned long long view_us, int attacker, float cx, float cy, float reach, float half_size, int* hits, int max_hits);
+
+#endif
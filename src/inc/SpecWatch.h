@@ -0,0 +1,25 @@
+#ifndef SPECWATCH_H_
+#define SPECWATCH_H_
+
+#include "Spectate.h"
+
+//spectator side of the game: subscribes to a node and posts each frame it shows into a player store, which
+//the game then draws as it would a join's
+typedef struct Spec_Watch {
+	SOCKET s;
+	WSADATA wsa;
+	struct sockaddr_in node;
+	Player_Store_t* store;
+	Spec_View_t view;
+	Cookie_t cookie;						// the node's cookie for this socket (zeroed until it answers)
+	pthread_t thread;
+	std::atomic<int> exit;
+	unsigned long long start_ms, first_ms;	// when it started, and how long it took to show the first frame
+} Spec_Watch_t;
+
+//watch functions
+int spec_watch_start(Spec_Watch_t* sw, const struct sockaddr_in* node, Player_Store_t* store);
+int spec_watch_stop(Spec_Watch_t* sw);
+void* spec_watch_run(void* input);
+
+#endif
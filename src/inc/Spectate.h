@@ -0,0 +1,94 @@
+#ifndef SPECTATE_H_
+#define SPECTATE_H_
+
+#include <pthread.h>
+#include <winsock2.h>
+#include <atomic>
+#include <fstream>
+
+#include "ConnectStruct.h"
+
+//what a spectator shows, built up from the stream: the newest keyframe and the newest frame on top of it
+typedef struct Spec_View {
+	unsigned int key, frame;				// frame numbers held (0 before the first keyframe)
+	char key_in_use;
+	float kx[MAX_PLAYER], ky[MAX_PLAYER];
+	char in_use;
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned int game_ms;
+	unsigned long long frames, waits;		// frames shown, and deltas dropped for want of their keyframe
+} Spec_View_t;
+
+//subscriber of a node (a spectator or a child node), found by its address in the subscriber index
+typedef struct Spec_Sub {
+	struct Spec_Node* sn;
+	int id;
+	int live;								// index in the node's live list, -1 while the subscriber is free
+	struct sockaddr_in addr;
+	unsigned long long last_seen;
+	Timer_t ttl_timer;
+} Spec_Sub_t;
+
+//spectator node: takes one stream from upstream (the host pushing it, or a parent node it subscribes to) and
+//sends every frame on to each of its subscribers, so a tree of nodes serves any number of spectators off the
+//host's one stream. The newest keyframe and the newest delta on it are kept, so a new subscriber is sent them
+//at once instead of waiting for the next keyframe. A subscribe only counts with a cookie the node minted for its
+//source, so a spoofed one never turns the stream on an address that did not ask for it
+typedef struct Spec_Node {
+	//socket info
+	SOCKET s;
+	WSADATA wsa;
+	struct sockaddr_in server;
+	struct sockaddr_in upstream;
+	int parent;								// upstream is a node to subscribe to (not the host)
+	
+	//logging info
+	std::ofstream log, err;
+	
+	//subscribers, the live ones packed for the fan out, and the ttl and subscribe timers (relay thread only)
+	Spec_Sub_t* subs;						// [SPEC_MAX_SUBS]
+	int* free_subs;
+	int free_count;
+	int* live;
+	int live_count;
+	Peer_Table_t index;
+	Timer_Wheel_t wheel;
+	Timer_t beat_timer;
+	unsigned long long now;
+	
+	//cookie secret (new each time the node starts) and the cookie from a parent node (zeroed until it answers)
+	Cookie_Key_t cookie;
+	Cookie_t up_cookie;
+	
+	//newest keyframe and newest delta on it (delta_len 0 for none)
+	char key[MAX_PACKET_LEN];
+	int key_len;
+	char delta[MAX_PACKET_LEN];
+	int delta_len;
+	unsigned int newest;					// newest frame number taken from upstream
+	
+	//batch buffers
+	char (*bufs)[MAX_PACKET_LEN];			// [RELAY_BATCH]
+	int* lens;
+	struct sockaddr_in* from;
+	
+	//thread
+	pthread_t thread;
+	std::atomic<int> exit;
+	
+	//counts (written by the node thread only)
+	unsigned long long frames, sent, joins, cached, cookies, dropped, busy_ns;
+} Spec_Node_t;
+
+//view functions
+void spec_view_init(Spec_View_t* view);
+int spec_apply(Spec_View_t* view, const char* buf, int len);
+int spec_sub_message(char* buf, char flags, unsigned int key, const Cookie_t* cookie);
+
+//node functions
+int spec_node_init(Spec_Node_t* sn, unsigned short port, const struct sockaddr_in* upstream, int parent);
+int spec_node_quit(Spec_Node_t* sn);
+void* spec_node_run(void* input);
+int spec_node_handle(Spec_Node_t* sn, char* buf, int len, const struct sockaddr_in* from);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef THREAD_CONFIG_H_
+#define THREAD_CONFIG_H_
+
+#include <windows.h>
+#include <pthread.h>
+#include <string>
+
+//thread roles
+#define THREAD_RECV 0			// recv thread and the packet handler threads it starts
+#define THREAD_SEND 1			// send thread (timer wheel and send ticks)
+#define THREAD_RENDER 2			// gl loop (the main thread)
+#define THREAD_ROLES 3
+
+#define THREAD_MIN_STACK 65536	// smallest stack size a config may ask for
+
+//placement of one role's threads
+typedef struct Thread_Setting {
+	unsigned long long cpus;	// affinity mask (0 leaves the threads to the scheduler)
+	int priority;				// SetThreadPriority level
+	unsigned int stack;			// stack size in bytes (0 for the default)
+} Thread_Setting_t;
+
+//network and render thread placement, loaded from a file with tc_load before init_host or init_join:
+//	# role cpus priority [stack kb]		(cpus as 2, 2,3, 0-3 or - for any core)
+//	recv 2 time_critical 256
+//	send 3 highest
+//	render - normal
+//	process high						(priority class: normal, above_normal, high or realtime)
+//	isolate								(roles without cpus stay off the cores recv and send are pinned to)
+typedef struct Thread_Config {
+	Thread_Setting_t roles[THREAD_ROLES];
+	DWORD process_class;		// 0 leaves the process priority class alone
+	int isolate;
+} Thread_Config_t;
+
+//config functions
+void tc_init(Thread_Config_t* tc);
+int tc_load(Thread_Config_t* tc, std::string path, std::string* error);
+std::string tc_describe(const Thread_Config_t* tc, int role);
+
+//applying (tc_apply is called by the thread itself, first thing)
+int tc_attr(const Thread_Config_t* tc, int role, pthread_attr_t* attr);
+int tc_apply(const Thread_Config_t* tc, int role);
+int tc_apply_process(const Thread_Config_t* tc);
+
+#endif
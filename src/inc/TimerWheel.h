@@ -0,0 +1,44 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+//wheel layout (4 levels of 64 slots covers 2^24 ticks, about 4.6 hours of 1 ms ticks)
+#define TW_LEVELS 4
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+
+//callback run by tw_advance when a timer expires (called without the wheel lock held)
+typedef void (*Timer_Func_t)(void* arg);
+
+//single timer entry, embedded in its owner so adding and cancelling never allocates
+typedef struct Timer {
+	struct Timer* next;
+	struct Timer* prev;
+	unsigned long long expire;
+	Timer_Func_t func;
+	void* arg;
+	int active;
+} Timer_t;
+
+//hierarchical timing wheel (slot heads are sentinels of circular lists)
+typedef struct Timer_Wheel {
+	pthread_mutex_t lock;
+	unsigned long long now;
+	unsigned count;
+	Timer_t slots[TW_LEVELS][TW_SLOTS];
+	Timer_t expired;
+} Timer_Wheel_t;
+
+//wheel functions
+int tw_init(Timer_Wheel_t* tw, unsigned long long now);
+void tw_destroy(Timer_Wheel_t* tw);
+void timer_init(Timer_t* t, Timer_Func_t func, void* arg);
+int tw_add(Timer_Wheel_t* tw, Timer_t* t, unsigned long long expire);
+int tw_cancel(Timer_Wheel_t* tw, Timer_t* t);
+int tw_pending(Timer_Wheel_t* tw, Timer_t* t);
+int tw_advance(Timer_Wheel_t* tw, unsigned long long now);
+
+#endif
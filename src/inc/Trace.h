@@ -0,0 +1,47 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <string>
+
+#define TRACE 1						// compile the span tracing in (0 leaves nothing behind the macros)
+
+#define TRACE_EVENTS 16384			// spans kept per thread (the newest, older ones are overwritten)
+#define TRACE_THREADS 64			// thread buffers (threads past this many are not traced)
+
+//one finished span (name is a string literal, pkt and tick tag it with the packet number and snapshot tick or frame)
+typedef struct Trace_Event {
+	const char* name;
+	unsigned long long start_ns, dur_ns;
+	unsigned int pkt, tick;
+} Trace_Event_t;
+
+//span ring of one thread: only its thread writes it, publishing each span with the release store of head, so
+//dumps read it without a lock (spans the thread overwrote while being copied are dropped). A thread's buffer
+//goes back to a pool when it exits and is reused by the next thread (e.g. the next packet handler)
+typedef struct Trace_Buffer {
+	Trace_Event_t events[TRACE_EVENTS];
+	std::atomic<unsigned long long> head;	// spans written
+	const char* name;						// track name in the trace
+	int id;
+} Trace_Buffer_t;
+
+//tracing switch: off, each span site costs one predictable branch on it
+extern std::atomic<int> trace_on;
+
+//trace functions
+void trace_enable(int on);
+void trace_thread(const char* name);
+void trace_span(const char* name, unsigned long long start_ns, unsigned int pkt, unsigned int tick);
+int trace_dump(std::string path);
+
+//span sites: start with TRACE_NOW, end with TRACE_SPAN
+#if TRACE
+#define TRACE_NOW() (trace_on.load(std::memory_order_relaxed) ? get_mono_ns() : 0ULL)
+#define TRACE_SPAN(name, start, pkt, tick) do{ if((start) != 0){ trace_span((name), (start), (pkt), (tick)); } }while(0)
+#else
+#define TRACE_NOW() 0ULL
+#define TRACE_SPAN(name, start, pkt, tick) do{ (void)(start); }while(0)
+#endif
+
+#endif
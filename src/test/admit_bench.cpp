@@ -0,0 +1,183 @@
+/*
+** admit_bench.c -- players' keys rate at the host while one source floods the host's port
+** starts a host and several joins over loopback (each join sending keys at its normal rate), then runs three
+** phases: no flood, a flood of keys shaped datagrams from one address at a multiple of a join's rate with the
+** per source rate limit on, and the same flood with the limit off. For each it reports the keys per second
+** each player sent and the host took (and the worst player's share taken), what the rate limit dropped and
+** what the host read in all (less than sent when its socket buffer overflowed). First it times the rate
+** check itself on a source far over its rate
+**
+** usage: ./admit_bench [players] [flood multiple] [seconds per phase] (defaults to 4, 100 and 3)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/HostConnect.h"
+#include "../inc/JoinConnect.h"
+
+#define BENCH_PORT 3970			// joins bind BENCH_PORT + their index
+#define FLOOD_PORT 3969
+#define PHASES 3
+#define CHECKS 10000000			// rate checks timed on a flooding source
+
+static const char* phase_names[PHASES] = {"no flood", "flood, limit on", "flood, limit off"};
+
+static Conn_Info_t host_conn;
+static HostConnect hc;
+static Conn_Info_t join_conn[MAX_PLAYER];
+static JoinConnect jc[MAX_PLAYER];
+static std::atomic<int> flooding(0), stop(0);
+static std::atomic<unsigned long long> flood_sent(0);
+static double flood_pps;
+
+//sends keys shaped datagrams for player 1 from an address the host never registered, paced per ms
+static void* flooder(void*){
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	struct sockaddr_in a, host;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = htons(FLOOD_PORT);
+	bind(s, (struct sockaddr*)&a, sizeof(a));
+	host = a;
+	host.sin_port = htons(SERVER_PORT);
+	
+	char buf[MAX_PACKET_LEN];
+	memset(buf, 0, MAX_PACKET_LEN);
+	((Keys_Packet_t*)buf)->head.flags = PF_KEYS;
+	((Keys_Packet_t*)buf)->head.player_id = 1;
+	
+	unsigned long long start = get_mono_ns(), sent = 0;
+	while(!stop){
+		if(!flooding){
+			Sleep(1);
+			start = get_mono_ns();
+			sent = 0;
+			continue;
+		}
+		//catch up to the flood rate, then wait for the next ms
+		unsigned long long due = (unsigned long long)((get_mono_ns() - start) / 1e9 * flood_pps);
+		while(sent < due){
+			((Keys_Packet_t*)buf)->head.packet_num = (int)sent;
+			sendto(s, buf, keys_packet_len, 0, (struct sockaddr*)&host, sizeof(host));
+			sent++;
+			flood_sent++;
+		}
+		Sleep(1);
+	}
+	closesocket(s);
+	return NULL;
+}
+
+//keys each player sent and the host took from it so far
+static void keys_count(int players, unsigned long long* sent, unsigned long long* taken){
+	for(int q=0; q<players; q++){
+		int id = join_conn[q].self_player_num;
+		sent[q] = join_conn[q].pkt_num;
+		pthread_mutex_lock(&(host_conn.players[id].lock));
+		taken[q] = host_conn.players[id].keys_in;
+		pthread_mutex_unlock(&(host_conn.players[id].lock));
+	}
+}
+
+int main(int argc, char *argv[]){
+	int players = 4, multiple = 100, seconds = 3;
+	if(argc > 4 || (argc > 1 && ((players = atoi(argv[1])) < 1 || players >= MAX_PLAYER)) || (argc > 2 && (multiple = atoi(argv[2])) < 1)
+			|| (argc > 3 && (seconds = atoi(argv[3])) < 1)){
+		fprintf(stderr,"usage: %s [players (1 to %d)] [flood multiple] [seconds per phase]\n", argv[0], MAX_PLAYER - 1);
+		exit(1);
+	}
+	flood_pps = multiple * MAX_CLIENT_PPS;
+	
+	//cost of checking (and dropping) one datagram, with the table holding other sources
+	Admit_Table_t at;
+	ad_init(&at, ADMIT_SOURCES, ADMIT_IDLE);
+	ad_rate(&at, AD_STRANGER, ADMIT_NEW_PPS, ADMIT_NEW_BURST);
+	struct sockaddr_in src;
+	memset((char*)&src, 0, sizeof(src));
+	src.sin_family = AF_INET;
+	src.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for(int i=0; i<ADMIT_SOURCES; i++){
+		src.sin_port = htons(10000 + i);
+		ad_admit(&at, &src, AD_STRANGER, get_mono_ms());
+	}
+	src.sin_port = htons(FLOOD_PORT);
+	unsigned long long t0 = get_mono_ns();
+	for(int i=0; i<CHECKS; i++){
+		ad_admit(&at, &src, AD_STRANGER, t0 / 1000000 + i / 100000);
+	}
+	unsigned long long check_ns = get_mono_ns() - t0;
+	printf("rate check: %.1f ns per datagram (%llu of %d dropped)\n", (double)check_ns / CHECKS, at.dropped, CHECKS);
+	ad_destroy(&at);
+	
+	//host, then the joins on their own ports
+	if(hc.init_host(&host_conn) != 0){
+		fprintf(stderr, "admit_bench: host not started\n");
+		exit(1);
+	}
+	for(int q=0; q<players; q++){
+		join_conn[q].client_port = BENCH_PORT + q;
+		if(jc[q].init_join(&(join_conn[q]), "127.0.0.1") != 0){
+			fprintf(stderr, "admit_bench: join %d did not connect\n", q);
+			exit(1);
+		}
+	}
+	pthread_t flood_thread;
+	pthread_create(&flood_thread, NULL, flooder, NULL);
+	printf("%d players sending keys at %.0f/s, flood of %.0f datagrams/s from one source, %d s per phase\n", players,
+			MAX_CLIENT_PPS, flood_pps, seconds);
+	Sleep(500);
+	
+	for(int p=0; p<PHASES; p++){
+		host_conn.admit_off = (p == 2);
+		flooding = (p > 0);
+		Sleep(100);
+		
+		unsigned long long sent0[MAX_PLAYER], taken0[MAX_PLAYER], sent[MAX_PLAYER], taken[MAX_PLAYER];
+		keys_count(players, sent0, taken0);
+		unsigned long long flood0 = flood_sent, dropped0 = host_conn.admit.dropped, read0 = dropped0 + host_conn.admit.admitted;
+		unsigned long long start = get_mono_ms();
+		Sleep(seconds * 1000);
+		keys_count(players, sent, taken);
+		double secs = (get_mono_ms() - start) / 1000.0;
+		
+		//share of each player's keys the host took (the joins share the machine with the flood, so they may send fewer)
+		double worst = 100.0, sent_all = 0.0, taken_all = 0.0;
+		for(int q=0; q<players; q++){
+			double share = (sent[q] > sent0[q]) ? 100.0 * (taken[q] - taken0[q]) / (sent[q] - sent0[q]) : 0.0;
+			if(share < worst){
+				worst = share;
+			}
+			sent_all += sent[q] - sent0[q];
+			taken_all += taken[q] - taken0[q];
+		}
+		unsigned long long dropped = host_conn.admit.dropped - dropped0, read = host_conn.admit.dropped + host_conn.admit.admitted - read0;
+		printf("%-17s keys/s per player: sent %6.1f, taken %6.1f (worst player %5.1f%%), flood sent %6.0f/s, limit dropped %6.0f/s",
+				phase_names[p], sent_all / players / secs, taken_all / players / secs, worst, (flood_sent - flood0) / secs, dropped / secs);
+		if(p < 2){
+			printf(", host read %6.0f/s", read / secs);
+		}
+		printf("\n");
+	}
+	
+	//shut down: flood off, joins leave first, then the host
+	flooding = 0;
+	host_conn.admit_off = 0;
+	stop = 1;
+	pthread_join(flood_thread, NULL);
+	Sleep(200);
+	for(int q=0; q<players; q++){
+		jc[q].quit_join(&(join_conn[q]));
+	}
+	hc.quit_host(&host_conn);
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*
+** asset_bench.c -- startup time and memory of loose bmp frames against one mapped sprite pack
+** writes a set of bmp frames to log/, packs them, then repeatedly
+**   1) loads every frame file (read, decode to rgba, one allocation per frame) and reads the pixels
+**   2) maps the pack and reads its atlas pages (what the client hands to the gpu)
+** and reports the median time of each with the heap each keeps while the sprites are in use, then checks a bmp
+** whose info header runs past the end of the file is refused
+**
+** usage: ./asset_bench [frames] [runs]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/AssetPack.h"
+
+#define FRAMES_PER_ANIM 8
+
+//writes a 24 bit bottom up bmp with a pattern so every frame differs
+static int write_bmp(std::string path, int w, int h, int seed){
+	int stride = ((w * 3) + 3) & ~3;
+	unsigned int size = 54 + (stride * h);
+	unsigned char head[54];
+	memset(head, 0, sizeof(head));
+	head[0] = 'B';
+	head[1] = 'M';
+	unsigned int fields[] = {size, 0, 54, 40, (unsigned int)w, (unsigned int)h};
+	int at[] = {2, 6, 10, 14, 18, 22};
+	for(int i=0; i<6; i++){
+		for(int b=0; b<4; b++){
+			head[at[i] + b] = (unsigned char)(fields[i] >> (8 * b));
+		}
+	}
+	head[26] = 1;
+	head[28] = 24;
+	FILE* f = fopen(path.c_str(), "wb");
+	if(f == NULL){
+		return -1;
+	}
+	fwrite(head, 1, sizeof(head), f);
+	std::vector<unsigned char> row(stride, 0);
+	for(int y=0; y<h; y++){
+		for(int x=0; x<w; x++){
+			row[(x * 3) + 0] = (unsigned char)(x + seed);
+			row[(x * 3) + 1] = (unsigned char)(y * seed);
+			row[(x * 3) + 2] = (unsigned char)(x ^ y);
+		}
+		fwrite(&(row[0]), 1, stride, f);
+	}
+	fclose(f);
+	return 0;
+}
+
+//stands in for the texture upload reading every pixel
+static unsigned long long touch(const unsigned char* p, size_t n){
+	unsigned long long sum = 0;
+	for(size_t i=0; i<n; i+=64){
+		sum += p[i];
+	}
+	return sum;
+}
+
+static double median(std::vector<double> v){
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+int main(int argc, char *argv[]){
+	int frame_count = 256;
+	int runs = 7;
+	
+	//check arguments
+	if(argc > 3){
+		fprintf(stderr,"usage: %s [frames] [runs]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		frame_count = atoi(argv[1]);
+	}
+	if(argc > 2){
+		runs = atoi(argv[2]);
+	}
+	if(frame_count < 1 || runs < 1){
+		fprintf(stderr,"usage: %s [frames] [runs]\n", argv[0]);
+		exit(1);
+	}
+	
+	//frames of a few sizes, grouped into animations
+	static const int sizes[][2] = {{64, 64}, {96, 128}, {48, 48}, {128, 96}};
+	std::vector<Pack_Input_t> anims;
+	std::vector<std::string> files;
+	unsigned long long file_bytes = 0;
+	for(int i=0; i<frame_count; i++){
+		if(i % FRAMES_PER_ANIM == 0){
+			Pack_Input_t anim;
+			anim.name = "anim" + std::to_string(i / FRAMES_PER_ANIM);
+			anim.frame_ms = 100;
+			anims.push_back(anim);
+		}
+		int w = sizes[(i / FRAMES_PER_ANIM) % 4][0], h = sizes[(i / FRAMES_PER_ANIM) % 4][1];
+		std::string path = "log/asset_bench_" + std::to_string(i) + ".bmp";
+		if(write_bmp(path, w, h, i) == -1){
+			fprintf(stderr, "asset_bench: cannot write %s (run from the repo root)\n", path.c_str());
+			exit(1);
+		}
+		anims.back().files.push_back(path);
+		files.push_back(path);
+		file_bytes += 54 + (((w * 3) + 3) & ~3) * h;
+	}
+	std::string pack_path = "log/asset_bench.pack", error;
+	unsigned long long t0 = get_mono_ns();
+	if(ap_build(anims, pack_path, &error) == -1){
+		fprintf(stderr, "asset_bench: %s\n", error.c_str());
+		exit(1);
+	}
+	printf("%d frames in %u animations (%llu bytes of bmp), packed in %.1f ms\n", frame_count, (unsigned)anims.size(), file_bytes,
+			(get_mono_ns() - t0) / 1e6);
+	
+	std::vector<double> loose_ms, pack_ms;
+	unsigned long long loose_heap = 0, pack_mapped = 0, check = 0;
+	unsigned int pages = 0;
+	for(int r=0; r<runs; r++){
+		//loose files: every frame decoded into its own allocation, kept while the sprites are in use
+		t0 = get_mono_ns();
+		std::vector<unsigned char*> images;
+		loose_heap = 0;
+		for(size_t i=0; i<files.size(); i++){
+			int w, h;
+			unsigned char* rgba = ap_load_bmp(files[i], &w, &h);
+			if(rgba == NULL){
+				fprintf(stderr, "asset_bench: cannot load %s\n", files[i].c_str());
+				exit(1);
+			}
+			check += touch(rgba, (size_t)w * h * 4);
+			loose_heap += (unsigned long long)w * h * 4;
+			images.push_back(rgba);
+		}
+		loose_ms.push_back((get_mono_ns() - t0) / 1e6);
+		for(size_t i=0; i<images.size(); i++){
+			delete[] images[i];
+		}
+		
+		//pack: one mapping, the pages are read straight from it
+		t0 = get_mono_ns();
+		Asset_Pack_t pack;
+		if(ap_load(&pack, pack_path) == -1){
+			fprintf(stderr, "asset_bench: cannot load %s\n", pack_path.c_str());
+			exit(1);
+		}
+		pages = pack.head->page_count;
+		for(unsigned int p=0; p<pages; p++){
+			check += touch(ap_page(&pack, p), (size_t)pack.head->page_size * pack.head->page_size * 4);
+		}
+		pack_mapped = pack.size;
+		pack_ms.push_back((get_mono_ns() - t0) / 1e6);
+		ap_unload(&pack);
+	}
+	
+	printf("loose files: %7.2f ms median of %d, %d allocations holding %llu bytes of heap\n", median(loose_ms), runs, frame_count, loose_heap);
+	printf("mapped pack: %7.2f ms median of %d, no allocations, %llu bytes mapped from the file (%u pages)\n", median(pack_ms), runs,
+			pack_mapped, pages);
+	printf("(checksum %llu)\n", check);
+	
+	//a 32 bit bitfields bmp naming a 124 byte info header, cut off after the first 40 bytes of it and one pixel
+	std::string cut_path = "log/asset_bench_cut.bmp";
+	write_bmp(cut_path, 1, 1, 0);
+	FILE* f = fopen(cut_path.c_str(), "r+b");
+	unsigned char patch[] = {124, 0, 0, 0};
+	fseek(f, 14, SEEK_SET);
+	fwrite(patch, 1, sizeof(patch), f);
+	unsigned char bits[] = {32, 0, 3, 0, 0, 0};
+	fseek(f, 28, SEEK_SET);
+	fwrite(bits, 1, sizeof(bits), f);
+	fclose(f);
+	int w, h;
+	unsigned char* cut = ap_load_bmp(cut_path, &w, &h);
+	printf("bmp with a cut off info header: %s\n", (cut == NULL) ? "refused" : "LOADED");
+	delete[] cut;
+	remove(cut_path.c_str());
+	
+	for(size_t i=0; i<files.size(); i++){
+		remove(files[i].c_str());
+	}
+	remove(pack_path.c_str());
+	return (cut == NULL) ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+** asset_pack.c -- builds a sprite pack (atlas pages and animation frame tables) from bmp frames
+** the manifest has one animation per line: name frame_ms frame.bmp [frame.bmp ...]
+** (blank lines and lines starting with # are skipped, frame paths are relative to the manifest)
+**
+** usage: ./asset_pack manifest out.pack
+** e.g. ./asset_pack assets/sprites.txt assets/sprites.pack then ./MarvelHeros host -a assets/sprites.pack
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+#include "../inc/AssetPack.h"
+
+int main(int argc, char *argv[]){
+	//check arguments
+	if(argc != 3){
+		fprintf(stderr,"usage: %s manifest out.pack\n", argv[0]);
+		exit(1);
+	}
+	std::ifstream manifest(argv[1]);
+	if(!manifest.is_open()){
+		fprintf(stderr, "asset_pack: cannot read %s\n", argv[1]);
+		exit(1);
+	}
+	std::string dir = argv[1];
+	size_t slash = dir.find_last_of("/\\");
+	dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+	
+	//one animation per line
+	std::vector<Pack_Input_t> anims;
+	std::string line;
+	int line_num = 0;
+	while(std::getline(manifest, line)){
+		line_num++;
+		std::istringstream words(line);
+		Pack_Input_t anim;
+		if(!(words >> anim.name) || anim.name[0] == '#'){
+			continue;
+		}
+		if(!(words >> anim.frame_ms)){
+			fprintf(stderr, "asset_pack: %s line %d: expected name frame_ms frames...\n", argv[1], line_num);
+			exit(1);
+		}
+		std::string file;
+		while(words >> file){
+			anim.files.push_back((file[0] == '/' || file[0] == '\\' || file.find(':') != std::string::npos) ? file : dir + file);
+		}
+		if(anim.files.size() == 0){
+			fprintf(stderr, "asset_pack: %s line %d: animation %s has no frames\n", argv[1], line_num, anim.name.c_str());
+			exit(1);
+		}
+		anims.push_back(anim);
+	}
+	
+	std::string error;
+	if(ap_build(anims, argv[2], &error) == -1){
+		fprintf(stderr, "asset_pack: %s\n", error.c_str());
+		exit(1);
+	}
+	
+	//read it back the way the client will
+	Asset_Pack_t pack;
+	if(ap_load(&pack, argv[2]) == -1){
+		fprintf(stderr, "asset_pack: %s does not load back\n", argv[2]);
+		exit(1);
+	}
+	unsigned long long used = 0;
+	for(unsigned int i=0; i<pack.head->sprite_count; i++){
+		used += (unsigned long long)(pack.sprites[i].w + (2 * PACK_PAD)) * (pack.sprites[i].h + (2 * PACK_PAD));
+	}
+	for(unsigned int i=0; i<pack.head->anim_count; i++){
+		printf("%-16s %3u frames, %u ms each\n", pack.anims[i].name, pack.anims[i].count, pack.anims[i].frame_ms);
+	}
+	printf("%s: %u sprites on %u %ux%u pages (%.1f%% filled), %llu bytes\n", argv[2], pack.head->sprite_count,
+			pack.head->page_count, pack.head->page_size, pack.head->page_size, pack.head->page_count ?
+			(100.0 * used) / ((double)pack.head->page_count * pack.head->page_size * pack.head->page_size) : 0.0, pack.size);
+	ap_unload(&pack);
+	return 0;
+}
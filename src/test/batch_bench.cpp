@@ -0,0 +1,138 @@
+/*
+** batch_bench.c -- packets and bytes on the wire for a player's messages sent one per packet against
+** coalesced per tick (see PacketBatch), and the cost of packing and unpacking them
+** each tick a player gets its disp and some small event messages (headers only, like quit requests and
+** acks, or with a short body like future game events); every packet is charged the udp/ip headers and
+** the seal overhead. Every unpacked message is checked against the one queued, and a batch asked for a whole
+** packet's cap is checked to hold a lone message of its (clamped) cap and refuse a longer one
+**
+** usage: ./batch_bench [events per tick] [event body bytes] (defaults to 3 and 16)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/PacketBatch.h"
+
+#define TICKS 200000
+#define UDP_IP_LEN 28			// ipv4 and udp headers per packet
+#define MAX_EVENTS 64
+
+//one tick's messages for a player: the disp then the events
+static int build_tick(char msgs[][MAX_PACKET_LEN], int* lens, int events, int event_len, int* pkt_num){
+	memset(msgs[0], 0, MAX_PACKET_LEN);
+	((Disp_Packet_t*)msgs[0])->head.flags = PF_DISP;
+	((Disp_Packet_t*)msgs[0])->head.player_id = 1;
+	((Disp_Packet_t*)msgs[0])->head.packet_num = (*pkt_num)++;
+	((Disp_Packet_t*)msgs[0])->in_use = 0x03;
+	((Disp_Packet_t*)msgs[0])->px_loc[1] = 0.25f;
+	((Disp_Packet_t*)msgs[0])->seq = *pkt_num;
+	lens[0] = disp_packet_len;
+	for(int e=1; e<=events; e++){
+		memset(msgs[e], 0, MAX_PACKET_LEN);
+		((Header_t*)msgs[e])->flags = PF_QUIT;
+		((Header_t*)msgs[e])->player_id = 1;
+		((Header_t*)msgs[e])->packet_num = (*pkt_num)++;
+		lens[e] = (event_len > 0) ? (int)sizeof(Header_t) + event_len : PACKET_HEAD_LEN;
+		for(int b=sizeof(Header_t); b<lens[e]; b++){
+			msgs[e][b] = (char)(b + e);
+		}
+	}
+	return events + 1;
+}
+
+//the body of an unpacked message matches the queued one (the shared header fields are not compared)
+static int same_msg(const char* a, const char* b, int len){
+	return ((const Header_t*)a)->flags == ((const Header_t*)b)->flags && ((const Header_t*)a)->packet_num == ((const Header_t*)b)->packet_num
+			&& (len <= (int)sizeof(Header_t) || memcmp(a + sizeof(Header_t), b + sizeof(Header_t), len - sizeof(Header_t)) == 0);
+}
+
+int main(int argc, char *argv[]){
+	int events = 3, event_len = 16;
+	if(argc > 3 || (argc > 1 && ((events = atoi(argv[1])) < 0 || events >= MAX_EVENTS)) || (argc > 2 && (event_len = atoi(argv[2])) < 0)){
+		fprintf(stderr,"usage: %s [events per tick (0 to %d)] [event body bytes]\n", argv[0], MAX_EVENTS - 1);
+		exit(1);
+	}
+	
+	static char msgs[MAX_EVENTS][MAX_PACKET_LEN];
+	int lens[MAX_EVENTS];
+	char packet[MAX_PACKET_LEN], out[MAX_PACKET_LEN];
+	Packet_Batch_t pb;
+	pb_init(&pb, batch_cap);
+	int pkt_num = 0;
+	unsigned long long single_pkts = 0, single_bytes = 0, batch_pkts = 0, batch_bytes = 0, bad = 0;
+	unsigned long long pack_ns = 0, unpack_ns = 0, unpacked = 0;
+	
+	for(int t=0; t<TICKS; t++){
+		int n = build_tick(msgs, lens, events, event_len, &pkt_num);
+		for(int m=0; m<n; m++){
+			single_pkts++;
+			single_bytes += lens[m] + CRYPT_OVERHEAD + UDP_IP_LEN;
+		}
+		
+		//pack the tick (a full batch goes out early, like host_queue)
+		unsigned long long t0 = get_mono_ns();
+		int sent[MAX_EVENTS + 1], lens_out[MAX_EVENTS + 1], taken = 0;
+		for(int m=0; m<n; m++){
+			if(pb_add(&pb, msgs[m], lens[m]) == -1){
+				lens_out[taken] = pb_take(&pb, packet);
+				sent[taken++] = m;
+				pb_add(&pb, msgs[m], lens[m]);
+			}
+		}
+		lens_out[taken] = pb_take(&pb, packet);
+		sent[taken++] = n;
+		pack_ns += get_mono_ns() - t0;
+		for(int p=0; p<taken; p++){
+			batch_pkts++;
+			batch_bytes += lens_out[p] + CRYPT_OVERHEAD + UDP_IP_LEN;
+		}
+		
+		//unpack and check the last packet of the tick (the whole tick when it fit in one)
+		int first = (taken > 1) ? sent[taken - 2] : 0;
+		t0 = get_mono_ns();
+		if((((Header_t*)packet)->flags & PF_MULTI) == PF_MULTI){
+			int offset = 0, len, m = first;
+			while((len = pb_next(packet, lens_out[taken - 1], &offset, out)) > 0){
+				if(m >= n || len != lens[m] || !same_msg(out, msgs[m], len)){
+					bad++;
+				}
+				m++;
+				unpacked++;
+			}
+			if(len == -1 || m != n){
+				bad++;
+			}
+		} else{
+			if(n - first != 1 || lens_out[taken - 1] != lens[first] || !same_msg(packet, msgs[first], lens[first])){
+				bad++;
+			}
+			unpacked++;
+		}
+		unpack_ns += get_mono_ns() - t0;
+	}
+	
+	unsigned long long msg_count = (unsigned long long)TICKS * (events + 1);
+	printf("%d ticks of 1 disp (%u bytes) and %d events (%d bytes): %llu messages\n", TICKS, disp_packet_len, events,
+			(event_len > 0) ? (int)sizeof(Header_t) + event_len : PACKET_HEAD_LEN, msg_count);
+	printf("one per packet: %llu packets, %llu bytes on the wire\n", single_pkts, single_bytes);
+	printf("coalesced:      %llu packets, %llu bytes on the wire (%.1f%% fewer packets, %.1f%% fewer bytes)\n", batch_pkts,
+			batch_bytes, 100.0 * (1.0 - (double)batch_pkts / single_pkts), 100.0 * (1.0 - (double)batch_bytes / single_bytes));
+	printf("pack %.1f ns, unpack %.1f ns per message, %llu mismatched\n", (double)pack_ns / msg_count, (double)unpack_ns / unpacked, bad);
+	
+	//the largest lone message a batch takes comes back whole, one byte more is refused
+	Packet_Batch_t big;
+	pb_init(&big, MAX_PACKET_LEN);
+	memset(msgs[0], 0x5A, MAX_PACKET_LEN);
+	((Header_t*)msgs[0])->flags = PF_DISP;
+	int lone_ok = (big.cap < MAX_PACKET_LEN && pb_add(&big, msgs[0], big.cap + 1) == -1 && pb_add(&big, msgs[0], big.cap) == 0
+			&& pb_take(&big, packet) == big.cap && same_msg(packet, msgs[0], big.cap));
+	printf("lone message of the cap (%d bytes): %s\n", big.cap, lone_ok ? "ok" : "FAILED");
+	return (bad || !lone_ok) ? 1 : 0;
+}
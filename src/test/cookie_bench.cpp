@@ -0,0 +1,250 @@
+/*
+** cookie_bench.c -- join cookie MAC checks, mint and check cost, and a host answering join requests it keeps nothing for
+** checks the HMAC-SHA256 against the RFC 4231 test vectors, times minting and checking a cookie, makes sure
+** forged, moved (another port) and expired cookies are turned down, then starts a host and sends it bare join
+** requests from many sources (resent until answered, like a join): each should get a cookie back while the
+** host holds no player slot or peer entry for any of them, and no answer is bigger than its request. A
+** request too short to carry a cookie must get no answer at all. Last a normal join (which echoes its
+** cookie) should still get a slot.
+** Exits 1 on any failed check
+**
+** usage: ./cookie_bench [sources] (defaults to 200)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/HostConnect.h"
+#include "../inc/JoinConnect.h"
+
+#define JOIN_PORT 4090
+#define SOURCE_PORT 4100		// sources bind SOURCE_PORT + their index
+#define MAX_SOURCES 1000
+#define COOKIES 1000000			// cookies minted and checked when timing
+#define ANSWER_WAIT 5000		// ms to wait for the host's answers
+#define RESEND 100				// ms before a source not answered asks again
+
+//RFC 4231 test cases 1, 2 and 6 (the last with a key longer than a block)
+typedef struct Vector {
+	int key_byte, key_len;
+	const char* key;
+	const char* msg;
+	const char* mac;
+} Vector_t;
+
+static const Vector_t vectors[3] = {
+	{0x0b, 20, NULL, "Hi There", "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+	{0, 4, "Jefe", "what do ya want for nothing?", "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+	{0xaa, 131, NULL, "Test Using Larger Than Block-Size Key - Hash Key First", "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"}
+};
+
+static Conn_Info_t host_conn;
+static HostConnect hc;
+static Conn_Info_t join_conn;
+static JoinConnect jc;
+
+//checks each vector, printing the ones that do not match
+static int check_vectors(){
+	int bad = 0;
+	for(int v=0; v<3; v++){
+		unsigned char key[256], out[CK_HASH_LEN];
+		char hex[2*CK_HASH_LEN + 1];
+		if(vectors[v].key != NULL){
+			memcpy(key, vectors[v].key, vectors[v].key_len);
+		} else{
+			memset(key, vectors[v].key_byte, vectors[v].key_len);
+		}
+		
+		Cookie_Key_t ck;
+		ck_set_key(&ck, key, vectors[v].key_len);
+		ck_hmac(&ck, (const unsigned char*)vectors[v].msg, (int)strlen(vectors[v].msg), out);
+		for(int i=0; i<CK_HASH_LEN; i++){
+			sprintf(hex + 2*i, "%02x", out[i]);
+		}
+		if(strcmp(hex, vectors[v].mac) != 0){
+			printf("HMAC-SHA256 vector %d: got %s, want %s\n", v + 1, hex, vectors[v].mac);
+			bad++;
+		}
+	}
+	return bad;
+}
+
+//bare join request: header and a zeroed cookie field
+static void join_request(char* buf, int num){
+	memset(buf, 0, cookie_answer_len);
+	((Header_t*)buf)->flags = PF_JOIN;
+	((Header_t*)buf)->player_id = (char)0xFF;
+	((Header_t*)buf)->packet_num = num;
+}
+
+//slots and peer entries the host holds (the peer count is only read, the recv thread keeps it)
+static int host_held(){
+	int held = (int)host_conn.peers.count;
+	for(int i=1; i<MAX_PLAYER; i++){
+		pthread_mutex_lock(&(host_conn.players[i].lock));
+		held += host_conn.store.in_use[i] ? 1 : 0;
+		pthread_mutex_unlock(&(host_conn.players[i].lock));
+	}
+	return held;
+}
+
+int main(int argc, char *argv[]){
+	int sources = 200, bad = 0;
+	if(argc > 2 || (argc > 1 && ((sources = atoi(argv[1])) < 1 || sources > MAX_SOURCES))){
+		fprintf(stderr,"usage: %s [sources (1 to %d)]\n", argv[0], MAX_SOURCES);
+		exit(1);
+	}
+	
+	//MAC against the known answers
+	int wrong = check_vectors();
+	printf("HMAC-SHA256 test vectors: %d of 3 match\n", 3 - wrong);
+	bad += wrong;
+	
+	//mint and check cost, over many ports so no two cookies are alike
+	unsigned char secret[CK_KEY_LEN];
+	crypt_random(secret, CK_KEY_LEN);
+	Cookie_Key_t ck;
+	ck_set_key(&ck, secret, CK_KEY_LEN);
+	struct sockaddr_in src;
+	memset((char*)&src, 0, sizeof(src));
+	src.sin_family = AF_INET;
+	src.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	Cookie_t* cookies = new Cookie_t[COOKIES];
+	unsigned int now = (unsigned int)get_mono_ms();
+	
+	unsigned long long t0 = get_mono_ns();
+	for(int i=0; i<COOKIES; i++){
+		src.sin_port = htons((unsigned short)i);
+		ck_mint(&ck, &src, now + i / 1000, &(cookies[i]));
+	}
+	unsigned long long mint_ns = get_mono_ns() - t0;
+	int good = 0;
+	t0 = get_mono_ns();
+	for(int i=0; i<COOKIES; i++){
+		src.sin_port = htons((unsigned short)i);
+		good += ck_check(&ck, &src, now + COOKIES / 1000, COOKIE_LIFE, &(cookies[i]));
+	}
+	unsigned long long check_ns = get_mono_ns() - t0;
+	printf("mint %.1f ns, check %.1f ns per cookie (%d of %d good)\n", (double)mint_ns / COOKIES, (double)check_ns / COOKIES, good, COOKIES);
+	bad += (good != COOKIES);
+	
+	//a flipped MAC bit, another port, and one check past the cookie's life, each must fail
+	int forged = 0, moved = 0, expired = 0;
+	for(int i=0; i<COOKIES; i += 1000){
+		Cookie_t c = cookies[i];
+		c.mac[i % CK_MAC_LEN] ^= (unsigned char)(1 << (i % 8));
+		src.sin_port = htons((unsigned short)i);
+		forged += ck_check(&ck, &src, now + COOKIES / 1000, COOKIE_LIFE, &c);
+		expired += ck_check(&ck, &src, cookies[i].stamp + COOKIE_LIFE + 1, COOKIE_LIFE, &(cookies[i]));
+		src.sin_port = htons((unsigned short)(i + 1));
+		moved += ck_check(&ck, &src, now + COOKIES / 1000, COOKIE_LIFE, &(cookies[i]));
+	}
+	printf("accepted of %d: forged %d, other port %d, expired %d\n", COOKIES / 1000, forged, moved, expired);
+	bad += forged + moved + expired;
+	delete[] cookies;
+	
+	//host, then bare join requests from each source
+	if(hc.init_host(&host_conn) != 0){
+		fprintf(stderr, "cookie_bench: host not started\n");
+		exit(1);
+	}
+	struct sockaddr_in host;
+	memset((char*)&host, 0, sizeof(host));
+	host.sin_family = AF_INET;
+	host.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	host.sin_port = htons(SERVER_PORT);
+	SOCKET* s = new SOCKET[sources];
+	int* got = new int[sources];
+	for(int i=0; i<sources; i++){
+		s[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		src.sin_port = htons(SOURCE_PORT + i);
+		bind(s[i], (struct sockaddr*)&src, sizeof(src));
+		ioctlsocket(s[i], FIONBIO, (unsigned long*)&(host_conn.ul));
+		got[i] = 0;
+	}
+	
+	//every source should get a cookie back (and nothing else); like a join, a source not answered yet asks
+	//again each RESEND ms (a burst overflows the host's handler threads)
+	char buf[MAX_PACKET_LEN];
+	int answered = 0, others = 0, requests = 0;
+	unsigned long long answer_bytes = 0;
+	unsigned long long start = get_mono_ms(), last_sent = 0;
+	while(answered < sources && get_mono_ms() - start < ANSWER_WAIT){
+		if(get_mono_ms() - last_sent >= RESEND){
+			for(int i=0; i<sources; i++){
+				if(!got[i]){
+					join_request(buf, i);
+					sendto(s[i], buf, cookie_answer_len, 0, (struct sockaddr*)&host, sizeof(host));
+					requests++;
+				}
+			}
+			last_sent = get_mono_ms();
+		}
+		for(int i=0; i<sources; i++){
+			struct sockaddr_in from;
+			int from_len = sizeof(from);
+			int n = recvfrom(s[i], buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&from, &from_len);
+			if(n <= 0){
+				continue;
+			}
+			answer_bytes += n;
+			if(n == (int)cookie_answer_len && (((Header_t*)buf)->flags & (PF_JOIN | PF_COOKIE)) == (PF_JOIN | PF_COOKIE)){
+				answered += !got[i];
+				got[i] = 1;
+			} else{
+				others++;
+			}
+		}
+		Sleep(1);
+	}
+	int held = host_held();
+	printf("%d sources (%d join requests): %d answered with a cookie, %d other answers, host holds %d slots and peers for them\n",
+			sources, requests, answered, others, held);
+	printf("answer bytes per request byte: %.2f\n", (double)answer_bytes / ((double)requests * cookie_answer_len));
+	bad += (answered != sources) + others + held + (answer_bytes > (unsigned long long)requests * cookie_answer_len);
+	
+	//a request without the cookie field (shorter than the answer) must get nothing back
+	int unpadded = 0;
+	for(int i=0; i<sources; i++){
+		join_request(buf, i);
+		sendto(s[i], buf, PACKET_HEAD_LEN, 0, (struct sockaddr*)&host, sizeof(host));
+	}
+	Sleep(RESEND);
+	for(int i=0; i<sources; i++){
+		struct sockaddr_in from;
+		int from_len = sizeof(from);
+		while(recvfrom(s[i], buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&from, &from_len) > 0){
+			unpadded++;
+		}
+	}
+	printf("%d unpadded join requests: %d answers\n", sources, unpadded);
+	bad += unpadded;
+	for(int i=0; i<sources; i++){
+		closesocket(s[i]);
+	}
+	delete[] s;
+	delete[] got;
+	
+	//a real join echoes its cookie and gets a slot
+	join_conn.client_port = JOIN_PORT;
+	if(jc.init_join(&join_conn, "127.0.0.1") != 0){
+		printf("join with a cookie: no slot\n");
+		bad++;
+	} else{
+		printf("join with a cookie: slot %d, host holds %d slots and peers\n", (int)join_conn.self_player_num, host_held());
+		jc.quit_join(&join_conn);
+	}
+	hc.quit_host(&host_conn);
+	
+	if(bad != 0){
+		printf("cookie_bench: %d checks failed\n", bad);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+** crypt_bench.c -- packet seal/open cost against packet size for the AES-NI and portable AES-GCM paths
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/PacketCrypt.h"
+
+#define ROUNDS 200000
+
+//NIST GCM test case 4 (128 bit key, 96 bit iv, aad and a partial last block)
+static const unsigned char kat_key[16] = {0xfe,0xff,0xe9,0x92,0x86,0x65,0x73,0x1c,0x6d,0x6a,0x8f,0x94,0x67,0x30,0x83,0x08};
+static const unsigned char kat_iv[12] = {0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,0xde,0xca,0xf8,0x88};
+static const unsigned char kat_aad[20] = {0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,0xab,0xad,0xda,0xd2};
+static const unsigned char kat_pt[60] = {
+	0xd9,0x31,0x32,0x25,0xf8,0x84,0x06,0xe5,0xa5,0x59,0x09,0xc5,0xaf,0xf5,0x26,0x9a,
+	0x86,0xa7,0xa9,0x53,0x15,0x34,0xf7,0xda,0x2e,0x4c,0x30,0x3d,0x8a,0x31,0x8a,0x72,
+	0x1c,0x3c,0x0c,0x95,0x95,0x68,0x09,0x53,0x2f,0xcf,0x0e,0x24,0x49,0xa6,0xb5,0x25,
+	0xb1,0x6a,0xed,0xf5,0xaa,0x0d,0xe6,0x57,0xba,0x63,0x7b,0x39};
+static const unsigned char kat_ct[60] = {
+	0x42,0x83,0x1e,0xc2,0x21,0x77,0x74,0x24,0x4b,0x72,0x21,0xb7,0x84,0xd0,0xd4,0x9c,
+	0xe3,0xaa,0x21,0x2f,0x2c,0x02,0xa4,0xe0,0x35,0xc1,0x7e,0x23,0x29,0xac,0xa1,0x2e,
+	0x21,0xd5,0x14,0xb2,0x54,0x66,0x93,0x1c,0x7d,0x8f,0x6a,0x5a,0xac,0x84,0xaa,0x05,
+	0x1b,0xa3,0x0b,0x39,0x6a,0x0a,0xac,0x97,0x3d,0x58,0xe0,0x91};
+static const unsigned char kat_tag[16] = {0x5b,0xc9,0x4f,0xbc,0x32,0x21,0xa5,0xdb,0x94,0xfa,0xe9,0x5a,0xe7,0x12,0x1a,0x47};
+
+//checks the current path against the test vector (and that a flipped tag bit is rejected)
+static int known_answer(){
+	Crypt_Key_t key;
+	unsigned char data[60], tag[16];
+	crypt_set_key(&key, kat_key);
+	memcpy(data, kat_pt, sizeof(data));
+	crypt_seal(&key, kat_iv, kat_aad, sizeof(kat_aad), data, sizeof(data), tag);
+	if(memcmp(data, kat_ct, sizeof(data)) != 0 || memcmp(tag, kat_tag, sizeof(tag)) != 0){
+		return -1;
+	}
+	if(crypt_open(&key, kat_iv, kat_aad, sizeof(kat_aad), data, sizeof(data), tag) != 0 || memcmp(data, kat_pt, sizeof(data)) != 0){
+		return -1;
+	}
+	tag[0] ^= 0x01;
+	if(crypt_open(&key, kat_iv, kat_aad, sizeof(kat_aad), data, sizeof(data), tag) != -1){
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]){
+	int sizes[] = {PACKET_HEAD_LEN, (int)keys_packet_len, (int)disp_packet_len, 256, 512, MAX_PACKET_LEN - CRYPT_OVERHEAD};
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	
+	crypt_init();
+	printf("AES-NI/PCLMULQDQ available: %s\n", crypt_hw_available() ? "yes" : "no");
+	
+	for(int hw=1; hw>=0; hw--){
+		if(hw && !crypt_hw_available()){
+			continue;
+		}
+		crypt_use_hw(hw);
+		printf("\n%s path, known answer test: %s\n", hw ? "hardware" : "portable", known_answer() == 0 ? "pass" : "FAIL");
+		printf("%10s %12s %12s %12s %12s\n", "bytes", "seal ns", "open ns", "seal MB/s", "open MB/s");
+		
+		//a session pair like the host and a joining player would hold
+		Crypt_Info_t ci;
+		ci.enabled = 1;
+		crypt_set_key(&(ci.base), kat_key);
+		Crypt_Session_t tx, rx;
+		crypt_session_init(&tx);
+		crypt_session_init(&rx);
+		unsigned char client_rand[CRYPT_RAND_LEN], host_rand[CRYPT_RAND_LEN];
+		crypt_random(client_rand, CRYPT_RAND_LEN);
+		crypt_random(host_rand, CRYPT_RAND_LEN);
+		crypt_derive_session(&ci, &tx, client_rand, host_rand);
+		crypt_derive_session(&ci, &rx, client_rand, host_rand);
+		
+		for(unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+			int len = sizes[s];
+			char* pkts = new char[(size_t)ROUNDS * MAX_PACKET_LEN / 16];
+			char buf[MAX_PACKET_LEN];
+			int bad = 0;
+			
+			//seal into a scratch buffer each round
+			memset(buf, 0x5A, sizeof(buf));
+			unsigned long long start = get_mono_ns();
+			for(int i=0; i<ROUNDS; i++){
+				pkt_seal(&(tx.key), &tx, CRYPT_DIR_HOST, buf, PACKET_HEAD_LEN, len);
+			}
+			double seal_ns = (double)(get_mono_ns() - start) / ROUNDS;
+			
+			//open a batch of distinct sealed packets (each sequence number is only accepted once)
+			int batch = ROUNDS / 16;
+			int sealed = 0;
+			for(int i=0; i<batch; i++){
+				memset(pkts + ((size_t)i * MAX_PACKET_LEN), 0x5A, len);
+				sealed = pkt_seal(&(tx.key), &tx, CRYPT_DIR_HOST, pkts + ((size_t)i * MAX_PACKET_LEN), PACKET_HEAD_LEN, len);
+			}
+			rx.recv_top = 0;
+			rx.recv_mask = 0;
+			start = get_mono_ns();
+			for(int i=0; i<batch; i++){
+				if(pkt_open(&(rx.key), &rx, CRYPT_DIR_HOST, pkts + ((size_t)i * MAX_PACKET_LEN), PACKET_HEAD_LEN, sealed) != len){
+					bad++;
+				}
+			}
+			double open_ns = (double)(get_mono_ns() - start) / batch;
+			
+			printf("%10d %12.1f %12.1f %12.1f %12.1f%s\n", len, seal_ns, open_ns, len * 1000.0 / seal_ns, len * 1000.0 / open_ns, bad ? "  (open failures)" : "");
+			delete[] pkts;
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+** ecs_bench.c -- iteration and churn of the entity component system against a fixed array of structs
+** fills a world with a mix of archetypes (players, moving projectiles with lifetimes, static props with
+** hitboxes, sprites without velocity) and
+**   1) integrates every entity with a position and velocity, through the query against an array of
+**      structs that has every component in every entry and checks a mask
+**   2) churns projectiles: a share of them expire and are replaced every frame, and some gain and lose a
+**      hitbox (moving them between archetypes)
+** at each entity count and reports ns per entity and operations per second
+**
+** usage: ./ecs_bench [entities ...] (defaults to 10000 100000)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Ecs.h"
+
+#define ITER_FRAMES 200
+#define CHURN_FRAMES 200
+#define CHURN_SHARE 20				// one in this many projectiles is replaced every frame
+#define DT (1.0f / 60.0f)
+
+//the array of structs the ecs replaces: every entity carries every component
+typedef struct Fat_Entity {
+	unsigned int mask;
+	Ecs_Pos_t pos;
+	Ecs_Vel_t vel;
+	Ecs_Player_t player;
+	Ecs_Hitbox_t hitbox;
+	Ecs_Sprite_t sprite;
+	Ecs_Lifetime_t lifetime;
+} Fat_Entity_t;
+
+static const unsigned int kinds[] = {
+	ECS_BIT(ECS_POS) | ECS_BIT(ECS_VEL) | ECS_BIT(ECS_LIFETIME) | ECS_BIT(ECS_SPRITE),		// projectiles
+	ECS_BIT(ECS_POS) | ECS_BIT(ECS_HITBOX),													// props
+	ECS_BIT(ECS_POS) | ECS_BIT(ECS_SPRITE),													// decoration
+	ECS_BIT(ECS_POS) | ECS_BIT(ECS_VEL) | ECS_BIT(ECS_HITBOX),								// movers
+};
+#define KINDS (int)(sizeof(kinds) / sizeof(kinds[0]))
+
+static double median(std::vector<double> v){
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+static void run(int n){
+	srand(n);
+	Ecs_World_t w;
+	ecs_init(&w);
+	std::vector<Fat_Entity_t> fat(n);
+	std::vector<Ecs_Entity_t> projectiles;
+	for(int i=0; i<n; i++){
+		unsigned int mask = kinds[rand() % KINDS];
+		float x = (rand() % 2000) / 1000.0f - 1.0f, y = (rand() % 2000) / 1000.0f - 1.0f;
+		float dx = (rand() % 200) / 1000.0f - 0.1f, dy = (rand() % 200) / 1000.0f - 0.1f;
+		Ecs_Entity_t e = ecs_create(&w, mask);
+		((Ecs_Pos_t*)ecs_get(&w, e, ECS_POS))->x = x;
+		((Ecs_Pos_t*)ecs_get(&w, e, ECS_POS))->y = y;
+		if(mask & ECS_BIT(ECS_VEL)){
+			((Ecs_Vel_t*)ecs_get(&w, e, ECS_VEL))->dx = dx;
+			((Ecs_Vel_t*)ecs_get(&w, e, ECS_VEL))->dy = dy;
+		}
+		if(mask & ECS_BIT(ECS_LIFETIME)){
+			projectiles.push_back(e);
+		}
+		memset((char*)&(fat[i]), 0, sizeof(Fat_Entity_t));
+		fat[i].mask = mask;
+		fat[i].pos.x = x;
+		fat[i].pos.y = y;
+		fat[i].vel.dx = dx;
+		fat[i].vel.dy = dy;
+	}
+	
+	//1) integration
+	Ecs_Query_t moving;
+	ecs_query_init(&moving, ECS_BIT(ECS_POS) | ECS_BIT(ECS_VEL), 0);
+	std::vector<double> ecs_ns, fat_ns;
+	int moved = 0;
+	for(int f=0; f<ITER_FRAMES; f++){
+		unsigned long long t0 = get_mono_ns();
+		moved = 0;
+		ecs_query_update(&w, &moving);
+		for(int m=0; m<moving.match_count; m++){
+			const Ecs_Archetype_t* a = &(w.archs[moving.matches[m]]);
+			Ecs_Pos_t* pos = (Ecs_Pos_t*)ecs_column(a, ECS_POS);
+			const Ecs_Vel_t* vel = (const Ecs_Vel_t*)ecs_column(a, ECS_VEL);
+			for(int i=0; i<a->count; i++){
+				pos[i].x += vel[i].dx * DT;
+				pos[i].y += vel[i].dy * DT;
+			}
+			moved += a->count;
+		}
+		ecs_ns.push_back((double)(get_mono_ns() - t0) / n);
+		
+		t0 = get_mono_ns();
+		unsigned int need = ECS_BIT(ECS_POS) | ECS_BIT(ECS_VEL);
+		for(int i=0; i<n; i++){
+			if((fat[i].mask & need) == need){
+				fat[i].pos.x += fat[i].vel.dx * DT;
+				fat[i].pos.y += fat[i].vel.dy * DT;
+			}
+		}
+		fat_ns.push_back((double)(get_mono_ns() - t0) / n);
+	}
+	printf("%7d entities (%d moving, %d archetypes)\n", n, moved, w.arch_count);
+	printf("  integrate  ecs %6.2f ns/entity   array of structs %6.2f ns/entity   (%zu vs %zu bytes per entity)\n",
+			median(ecs_ns), median(fat_ns), sizeof(Ecs_Pos_t) + sizeof(Ecs_Vel_t), sizeof(Fat_Entity_t));
+	
+	//2) churn: expire and respawn projectiles, give and take hitboxes
+	unsigned long long ops = 0, t0 = get_mono_ns();
+	int replace = (int)projectiles.size() / CHURN_SHARE;
+	for(int f=0; f<CHURN_FRAMES; f++){
+		for(int r=0; r<replace; r++){
+			int at = rand() % (int)projectiles.size();
+			ecs_delete(&w, projectiles[at]);
+			projectiles[at] = ecs_create(&w, kinds[0]);
+			((Ecs_Lifetime_t*)ecs_get(&w, projectiles[at], ECS_LIFETIME))->expire_ms = f + 60;
+			ops += 2;
+		}
+		for(int r=0; r<replace; r++){
+			Ecs_Entity_t e = projectiles[rand() % (int)projectiles.size()];
+			if(ecs_get(&w, e, ECS_HITBOX) == NULL){
+				ecs_add(&w, e, ECS_HITBOX);
+			} else{
+				ecs_remove(&w, e, ECS_HITBOX);
+			}
+			ops++;
+		}
+	}
+	double churn_s = (get_mono_ns() - t0) / 1e9;
+	printf("  churn      %llu creates, deletes and moves in %.1f ms (%.1f M ops/s, %d alive, %d archetypes)\n", ops,
+			churn_s * 1000, (ops / churn_s) / 1e6, w.alive, w.arch_count);
+	
+	//iteration still only walks the matching archetypes after the churn added new ones
+	t0 = get_mono_ns();
+	ecs_query_update(&w, &moving);
+	int after = 0;
+	for(int m=0; m<moving.match_count; m++){
+		after += w.archs[moving.matches[m]].count;
+	}
+	printf("  query      %d archetypes matched, %d moving entities (%.1f us to update and count)\n", moving.match_count, after,
+			(get_mono_ns() - t0) / 1e3);
+	
+	ecs_query_destroy(&moving);
+	ecs_destroy(&w);
+}
+
+int main(int argc, char *argv[]){
+	std::vector<int> counts;
+	for(int i=1; i<argc; i++){
+		int n = atoi(argv[i]);
+		if(n < 1 || n >= ECS_MAX_ENTITIES){
+			fprintf(stderr,"usage: %s [entities ...]\n", argv[0]);
+			exit(1);
+		}
+		counts.push_back(n);
+	}
+	if(counts.size() == 0){
+		counts.push_back(10000);
+		counts.push_back(100000);
+	}
+	for(size_t i=0; i<counts.size(); i++){
+		run(counts[i]);
+	}
+	return 0;
+}
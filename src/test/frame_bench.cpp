@@ -0,0 +1,93 @@
+/*
+** frame_bench.c -- frame pacing of the old idle loop gate against the frame pacer
+** runs a draw loop with a fixed amount of busy work per frame (no window), first gated the old way (polling
+** get_timestamp against a whole number of ms) and then paced by the frame pacer, and reports the frame
+** rate, interval and work percentiles, missed frames and the cpu the loop used
+**
+** usage: ./frame_bench [fps] [work us] [seconds]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/FramePacer.h"
+
+//process cpu time (user and kernel) in ns
+static unsigned long long cpu_ns(){
+	FILETIME create, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+	unsigned long long k = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	unsigned long long u = ((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (k + u) * 100;
+}
+
+//stand in for drawing a frame
+static void work(unsigned long long us){
+	unsigned long long end = get_mono_ns() + (us * 1000);
+	while(get_mono_ns() < end);
+}
+
+int main(int argc, char *argv[]){
+	double fps = MAX_FPS;
+	int work_us = 500;
+	double run_s = 3.0;
+	
+	//check arguments
+	if(argc > 4){
+		fprintf(stderr,"usage: %s [fps] [work us] [seconds]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		fps = atof(argv[1]);
+	}
+	if(argc > 2){
+		work_us = atoi(argv[2]);
+	}
+	if(argc > 3){
+		run_s = atof(argv[3]);
+	}
+	if(fps <= 0 || work_us < 0 || run_s <= 0){
+		fprintf(stderr,"usage: %s [fps] [work us] [seconds]\n", argv[0]);
+		exit(1);
+	}
+	printf("target %.1f fps, %d us of work per frame, %.1f s per run\n", fps, work_us, run_s);
+	
+	//old gate: the idle callback polls and draws once a whole number of ms passed
+	Frame_Pacer_t fp;
+	fp_init(&fp, fps);
+	unsigned long gate_ms = (unsigned long)(1000.0 / fps);
+	unsigned long last_frame = 0;
+	unsigned long long cpu0 = cpu_ns(), t0 = get_mono_ns();
+	while(get_mono_ns() < t0 + (unsigned long long)(run_s * 1e9)){
+		if(last_frame + gate_ms < get_timestamp()){
+			last_frame = get_timestamp();
+			fp_begin(&fp, get_mono_ns());
+			work(work_us);
+			fp_end(&fp, get_mono_ns());
+		}
+	}
+	double cpu = (double)(cpu_ns() - cpu0) / (double)(get_mono_ns() - t0);
+	printf("idle gate (%lu ms):\n%s\tcpu %.1f%% of a core\n", gate_ms, fp_report(&fp).c_str(), cpu * 100.0);
+	fp_quit(&fp);
+	
+	//frame pacer
+	fp_init(&fp, fps);
+	cpu0 = cpu_ns();
+	t0 = get_mono_ns();
+	while(get_mono_ns() < t0 + (unsigned long long)(run_s * 1e9)){
+		fp_wait(&fp);
+		fp_begin(&fp, get_mono_ns());
+		work(work_us);
+		fp_end(&fp, get_mono_ns());
+	}
+	cpu = (double)(cpu_ns() - cpu0) / (double)(get_mono_ns() - t0);
+	printf("frame pacer:\n%s\tcpu %.1f%% of a core\n", fp_report(&fp).c_str(), cpu * 100.0);
+	fp_quit(&fp);
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+** input_bench.c -- input to wire latency of the join keys path over loopback
+** runs a join send thread and the input sample thread against a sink socket, presses and releases a
+** direction key at random gaps and reports the time from each key change to the keys packet carrying it
+** leaving through sendto, first with changes left for the send tick and then with the urgent send path
+**
+** usage: ./input_bench [changes]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/JoinConnect.h"
+#include "../inc/InputState.h"
+
+#define MIN_GAP 2		// least time (ms) between key changes
+#define MAX_GAP 8		// most time (ms) between key changes
+
+Conn_Info_t conn;
+
+//presses and releases the up key with random gaps, returns the histogram of the run
+static void run(int changes, int urgent, Latency_Hist_t* out){
+	Input_State_t in;
+	pthread_t send_thread;
+	
+	join_init_state(&conn);
+	conn.self_player_num = 1;
+	pthread_create(&send_thread, NULL, join_send, (void*)&conn);
+	in_init(&in, &conn, join_send_now);
+	in.urgent = urgent;
+	in_start(&in);
+	
+	for(int i=0; i<changes; i++){
+		Sleep(MIN_GAP + (rand() % (MAX_GAP - MIN_GAP + 1)));
+		if(i % 2 == 0){
+			in_key_down(&in, W_ASCII, get_mono_ns());
+		} else{
+			in_key_up(&in, W_ASCII, get_mono_ns());
+		}
+	}
+	Sleep(2 * MAX_GAP);
+	
+	in_stop(&in);
+	pthread_mutex_lock(&(conn.exit_lock));
+	conn.exit = 1;
+	pthread_mutex_unlock(&(conn.exit_lock));
+	pthread_join(send_thread, NULL);
+	*out = conn.input_lat;
+	
+	float x, y;
+	ps_peek(&(conn.store.pos[1]), &x, &y);
+	printf("%-10s %s (moved to %.3f, %llu samples)\n", urgent ? "urgent" : "tick only", lh_summary(out).c_str(), y,
+			in.samples);
+}
+
+int main(int argc, char *argv[]){
+	int changes = 1000;
+	
+	//check arguments
+	if(argc > 2 || (argc == 2 && (changes = atoi(argv[1])) < 2)){
+		fprintf(stderr,"usage: %s [changes]\n", argv[0]);
+		exit(1);
+	}
+	
+	//join socket and a sink standing in for the host (nothing reads it, the bench times the sends)
+	WSAStartup(MAKEWORD(2,2), &(conn.wsa));
+	conn.s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	SOCKET sink = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	memset((char*)&(conn.server), 0, sizeof(conn.server));
+	conn.server.sin_family = AF_INET;
+	conn.server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	conn.server.sin_port = 0;
+	bind(sink, (struct sockaddr*)&(conn.server), sizeof(conn.server));
+	int slen = sizeof(conn.server);
+	getsockname(sink, (struct sockaddr*)&(conn.server), &slen);
+	conn.server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	
+	printf("%d key changes %d to %d ms apart, send tick %lu ms, input sampled at %d Hz\n", changes, MIN_GAP, MAX_GAP,
+			max_client_time, INPUT_HZ);
+	Latency_Hist_t tick, urgent;
+	srand(1);
+	run(changes, 0, &tick);
+	srand(1);
+	run(changes, 1, &urgent);
+	if(urgent.total > 0 && tick.total > 0){
+		printf("urgent path cuts input to wire p50 by %.1f us and p99 by %.1f us\n",
+				(lh_percentile(&tick, 50.0) - (double)lh_percentile(&urgent, 50.0)) / 1000.0,
+				(lh_percentile(&tick, 99.0) - (double)lh_percentile(&urgent, 99.0)) / 1000.0);
+	}
+	
+	closesocket(sink);
+	closesocket(conn.s);
+	WSACleanup();
+	return 0;
+}
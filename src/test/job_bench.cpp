@@ -0,0 +1,189 @@
+/*
+** job_bench.c -- per tick latency of the host's per client send work spread over the job system
+** fills a world with entities, then every tick builds each client's snapshot (the entities in its view,
+** quantized into a packet), seals it with the client's session key and hands it to the "socket" (a copy),
+** one job per client, from 1 worker up to the given count, and reports tick latency percentiles and the
+** speedup over 1 worker (the send thread on its own); workers above the core count only add contention
+**
+** usage: ./job_bench [clients] [entities] [max workers] [ticks]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/JobSystem.h"
+#include "../inc/Ecs.h"
+#include "../inc/PacketCrypt.h"
+#include "../inc/LatencyHist.h"
+
+#define VIEW 0.25f					// half width of a client's view
+#define ENTRY_LEN 8					// entity index then x and y quantized to 16 bits
+#define QUANT 16384.0f
+
+typedef struct Bench_Client {
+	float x, y;
+	Crypt_Session_t sess;
+	char out[MAX_PACKET_LEN];		// the last packet "sent"
+	int out_len;
+} Bench_Client_t;
+
+typedef struct Bench_Tick {
+	Ecs_World_t* world;
+	Ecs_Query_t* query;
+	Bench_Client_t* client;
+} Bench_Tick_t;
+
+static unsigned rng_state = 2463534242u;
+static float rng_f(){
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return (float)(rng_state & 0xFFFFFF) / (float)0x1000000;
+}
+
+//one client's send: interest filter over every positioned entity, encode, seal
+static void client_job(Job_System_t*, int, void* input){
+	Bench_Tick_t* t = (Bench_Tick_t*) input;
+	Bench_Client_t* c = t->client;
+	char message[MAX_PACKET_LEN];
+	int len = PACKET_HEAD_LEN + 2;
+	int max_len = MAX_PACKET_LEN - CRYPT_OVERHEAD - ENTRY_LEN;
+	unsigned short count = 0;
+	
+	memset(message, 0, PACKET_HEAD_LEN);
+	((Header_t*)message)->flags = PF_DISP;
+	for(int m=0; m<t->query->match_count && len <= max_len; m++){
+		const Ecs_Archetype_t* a = &(t->world->archs[t->query->matches[m]]);
+		const Ecs_Pos_t* pos = (const Ecs_Pos_t*)ecs_column(a, ECS_POS);
+		for(int i=0; i<a->count && len <= max_len; i++){
+			float dx = pos[i].x - c->x, dy = pos[i].y - c->y;
+			if(dx < -VIEW || dx > VIEW || dy < -VIEW || dy > VIEW){
+				continue;
+			}
+			unsigned int id = a->entities[i];
+			short qx = (short)(dx * QUANT), qy = (short)(dy * QUANT);
+			memcpy(message + len, &id, 4);
+			memcpy(message + len + 4, &qx, 2);
+			memcpy(message + len + 6, &qy, 2);
+			len += ENTRY_LEN;
+			count++;
+		}
+	}
+	memcpy(message + PACKET_HEAD_LEN, &count, 2);
+	len = pkt_seal(&(c->sess.key), &(c->sess), CRYPT_DIR_HOST, message, PACKET_HEAD_LEN, len);
+	memcpy(c->out, message, len);
+	c->out_len = len;
+}
+
+int main(int argc, char *argv[]){
+	int clients = 512, entities = 20000, max_workers = js_cores(), ticks = 200;
+	
+	//check arguments
+	if(argc > 5){
+		fprintf(stderr,"usage: %s [clients] [entities] [max workers] [ticks]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		clients = atoi(argv[1]);
+	}
+	if(argc > 2){
+		entities = atoi(argv[2]);
+	}
+	if(argc > 3){
+		max_workers = atoi(argv[3]);
+	}
+	if(argc > 4){
+		ticks = atoi(argv[4]);
+	}
+	if(clients < 1 || entities < 1 || entities >= ECS_MAX_ENTITIES || max_workers < 1 || max_workers > JS_MAX_WORKERS || ticks < 1){
+		fprintf(stderr,"usage: %s [clients] [entities] [max workers] [ticks]\n", argv[0]);
+		exit(1);
+	}
+	
+	//the world and a session per client
+	crypt_init();
+	Ecs_World_t world;
+	ecs_init(&world);
+	for(int i=0; i<entities; i++){
+		Ecs_Entity_t e = ecs_create(&world, (i % 4 == 0) ? (ECS_BIT(ECS_POS) | ECS_BIT(ECS_PLAYER)) : (ECS_BIT(ECS_POS) | ECS_BIT(ECS_VEL)));
+		Ecs_Pos_t* pos = (Ecs_Pos_t*)ecs_get(&world, e, ECS_POS);
+		pos->x = (rng_f() * 2.0f) - 1.0f;
+		pos->y = (rng_f() * 2.0f) - 1.0f;
+	}
+	Ecs_Query_t query;
+	ecs_query_init(&query, ECS_BIT(ECS_POS), 0);
+	ecs_query_update(&world, &query);
+	
+	Crypt_Info_t ci;
+	unsigned char psk[CRYPT_KEY_LEN], client_rand[CRYPT_RAND_LEN], host_rand[CRYPT_RAND_LEN];
+	crypt_random(psk, CRYPT_KEY_LEN);
+	crypt_set_key(&(ci.base), psk);
+	ci.enabled = 1;
+	Bench_Client_t* client = new Bench_Client_t[clients];
+	std::vector<Bench_Tick_t> work(clients);
+	for(int i=0; i<clients; i++){
+		client[i].x = (rng_f() * 2.0f) - 1.0f;
+		client[i].y = (rng_f() * 2.0f) - 1.0f;
+		crypt_session_init(&(client[i].sess));
+		crypt_random(client_rand, CRYPT_RAND_LEN);
+		crypt_random(host_rand, CRYPT_RAND_LEN);
+		crypt_derive_session(&ci, &(client[i].sess), client_rand, host_rand);
+		work[i].world = &world;
+		work[i].query = &query;
+		work[i].client = &(client[i]);
+	}
+	printf("%d clients, %d entities, %d ticks per run, %d cores\n", clients, entities, ticks, js_cores());
+	
+	double base_p50 = 0;
+	//1, 2, 4 ... workers, then the max
+	for(int workers=1; ; workers*=2){
+		if(workers > max_workers){
+			workers = max_workers;
+		}
+		Job_System_t js;
+		js_init(&js, workers);
+		Latency_Hist_t tick;
+		lh_init(&tick);
+		unsigned long long bytes = 0;
+		for(int t=0; t<ticks; t++){
+			unsigned long long t0 = get_mono_ns();
+			Job_Group_t group;
+			js_group_init(&group);
+			for(int i=0; i<clients; i++){
+				js_spawn(&js, 0, &group, client_job, (void*)&(work[i]));
+			}
+			js_wait(&js, 0, &group);
+			lh_record(&tick, get_mono_ns() - t0);
+		}
+		unsigned long long stolen = 0;
+		for(int i=0; i<js.count; i++){
+			stolen += js.workers[i].stolen;
+		}
+		for(int i=0; i<clients; i++){
+			bytes += client[i].out_len;
+		}
+		js_quit(&js);
+		
+		double p50 = lh_percentile(&tick, 50) / 1e3;
+		if(workers == 1){
+			base_p50 = p50;
+		}
+		printf("%2d workers: tick p50 %8.1f us  p99 %8.1f us  speedup %5.2fx  (%llu jobs stolen, %llu bytes per tick)\n", workers,
+				p50, lh_percentile(&tick, 99) / 1e3, base_p50 / p50, stolen, bytes);
+		if(workers == max_workers){
+			break;
+		}
+	}
+	
+	delete[] client;
+	ecs_query_destroy(&query);
+	ecs_destroy(&world);
+	return 0;
+}
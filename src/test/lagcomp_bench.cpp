@@ -0,0 +1,191 @@
+/*
+** lagcomp_bench.c -- cost of a lag compensated hit check (rewind the world to the attacker's view time and test
+** the attack) as players grow, against testing the current tick only and against keeping a separate history ring
+** per player (one (time, x, y) record per tick, searched per player); also checks both rewinds agree
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Snapshot.h"
+
+#define ACTIONS 50000
+#define TICK_US (SNAP_TIME * 1000ULL)
+#define REACH 0.15f
+
+//per player history record (how a history bolted onto each player slot would look)
+typedef struct Past_Pos {
+	unsigned long long time_us;
+	float x, y;
+	unsigned char alive;
+} Past_Pos_t;
+
+static unsigned rng_state = 2463534242u;
+static unsigned rng_u(){
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+static float rng_f(){
+	return (float)(rng_u() & 0xFFFFFF) / (float)0x1000000;
+}
+
+//per player rewind: binary search of that player's own ring then blend
+static int ring_hit_test(Past_Pos_t* rings, unsigned players, unsigned frames, unsigned long long head, unsigned long long view_us,
+		int attacker, float cx, float cy, float reach, float half, int* hits, int max_hits){
+	int count = 0;
+	unsigned long long n = (head < frames) ? head : frames;
+	unsigned long long oldest = head - n;
+	for(unsigned p=0; p<players && count < max_hits; p++){
+		if((int)p == attacker){
+			continue;
+		}
+		Past_Pos_t* ring = rings + ((size_t)p * frames);
+		unsigned long long lo = 0, hi = n;
+		while(lo < hi){
+			unsigned long long mid = (lo + hi) / 2;
+			if(ring[(oldest + mid) % frames].time_us <= view_us){
+				lo = mid + 1;
+			} else{
+				hi = mid;
+			}
+		}
+		Past_Pos_t *a, *b;
+		float t = 0.0f;
+		if(lo == 0){
+			a = b = &ring[oldest % frames];
+		} else if(lo == n){
+			a = b = &ring[(head - 1) % frames];
+		} else{
+			a = &ring[(oldest + lo - 1) % frames];
+			b = &ring[(oldest + lo) % frames];
+			t = (float)(view_us - a->time_us) / (float)(b->time_us - a->time_us);
+		}
+		if(!(a->alive & b->alive)){
+			continue;
+		}
+		float dx = (a->x + ((b->x - a->x) * t)) - cx;
+		float dy = (a->y + ((b->y - a->y) * t)) - cy;
+		dx = (dx > half) ? dx - half : ((dx < -half) ? dx + half : 0.0f);
+		dy = (dy > half) ? dy - half : ((dy < -half) ? dy + half : 0.0f);
+		if((dx * dx) + (dy * dy) <= reach * reach){
+			hits[count++] = (int)p;
+		}
+	}
+	return count;
+}
+
+int main(int argc, char *argv[]){
+	unsigned sizes[] = {8, 64, 512, 4096};
+	int failed = 0;
+	volatile long long sink = 0;
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	
+	printf("%d ticks of %d ms kept, %d actions per size\n", SNAP_HISTORY, SNAP_TIME, ACTIONS);
+	printf("%8s %16s %16s %16s %10s\n", "players", "rewind+test ns", "current only ns", "per player ns", "avg hits");
+	for(unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		unsigned players = sizes[s];
+		Snap_History_t sh;
+		if(sh_init(&sh, SNAP_HISTORY, players) == -1){
+			fprintf(stderr, "history init failed\n");
+			exit(1);
+		}
+		
+		//random walk over an arena grown with the player count (same crowding as 8 players on screen),
+		//a few players dropping in and out, enough ticks to wrap the ring
+		float extent = sqrtf(players / 8.0f);
+		float* x = new float[players];
+		float* y = new float[players];
+		unsigned char* alive = new unsigned char[players];
+		Past_Pos_t* rings = new Past_Pos_t[(size_t)players * sh.frames];
+		for(unsigned p=0; p<players; p++){
+			x[p] = extent * ((2.0f * rng_f()) - 1.0f);
+			y[p] = extent * ((2.0f * rng_f()) - 1.0f);
+			alive[p] = 1;
+		}
+		unsigned long long ticks = sh.frames * 3;
+		for(unsigned long long k=0; k<ticks; k++){
+			for(unsigned p=0; p<players; p++){
+				x[p] += (rng_f() - 0.5f) * 0.02f;
+				y[p] += (rng_f() - 0.5f) * 0.02f;
+				if((rng_u() % 1000) == 0){
+					alive[p] = !alive[p];
+				}
+				Past_Pos_t* r = &rings[((size_t)p * sh.frames) + (k % sh.frames)];
+				r->time_us = k * TICK_US;
+				r->x = x[p];
+				r->y = y[p];
+				r->alive = alive[p];
+			}
+			sh_record(&sh, k * TICK_US, x, y, alive);
+		}
+		unsigned long long now_us = ticks * TICK_US;
+		
+		//same actions for every method: random attacker, position and rtt up to the rewind cap
+		int* attacker = new int[ACTIONS];
+		float* cx = new float[ACTIONS];
+		float* cy = new float[ACTIONS];
+		unsigned long long* view = new unsigned long long[ACTIONS];
+		for(int a=0; a<ACTIONS; a++){
+			attacker[a] = (int)(rng_u() % players);
+			cx[a] = extent * ((2.0f * rng_f()) - 1.0f);
+			cy[a] = extent * ((2.0f * rng_f()) - 1.0f);
+			view[a] = sh_view_time(now_us, rng_u() % (MAX_REWIND * 1000ULL), INTERP_TIME * 1000ULL, MAX_REWIND * 1000ULL);
+		}
+		int hits[64], check[64];
+		
+		unsigned long long t0 = get_mono_ns();
+		for(int a=0; a<ACTIONS; a++){
+			sink += sh_hit_test(&sh, view[a], attacker[a], cx[a], cy[a], REACH, PLAYER_SIZE, hits, 64);
+		}
+		unsigned long long t1 = get_mono_ns();
+		for(int a=0; a<ACTIONS; a++){
+			sink += sh_hit_test(&sh, now_us, attacker[a], cx[a], cy[a], REACH, PLAYER_SIZE, hits, 64);
+		}
+		unsigned long long t2 = get_mono_ns();
+		for(int a=0; a<ACTIONS; a++){
+			sink += ring_hit_test(rings, players, sh.frames, ticks, view[a], attacker[a], cx[a], cy[a], REACH, PLAYER_SIZE, hits, 64);
+		}
+		unsigned long long t3 = get_mono_ns();
+		
+		//both rewinds must find the same players
+		long long total = 0;
+		for(int a=0; a<ACTIONS; a++){
+			int n1 = sh_hit_test(&sh, view[a], attacker[a], cx[a], cy[a], REACH, PLAYER_SIZE, hits, 64);
+			int n2 = ring_hit_test(rings, players, sh.frames, ticks, view[a], attacker[a], cx[a], cy[a], REACH, PLAYER_SIZE, check, 64);
+			if(n1 != n2 || memcmp(hits, check, n1 * sizeof(int)) != 0){
+				failed = 1;
+			}
+			total += n1;
+		}
+		
+		printf("%8u %16.1f %16.1f %16.1f %10.2f\n", players, (double)(t1 - t0) / ACTIONS, (double)(t2 - t1) / ACTIONS,
+				(double)(t3 - t2) / ACTIONS, (double)total / ACTIONS);
+		
+		sh_destroy(&sh);
+		delete[] x;
+		delete[] y;
+		delete[] alive;
+		delete[] rings;
+		delete[] attacker;
+		delete[] cx;
+		delete[] cy;
+		delete[] view;
+	}
+	
+	printf("\n%s\n", failed ? "FAIL (rewinds disagree)" : "PASS");
+	return failed || sink == 0x7FFFFFFF;
+}
@@ -0,0 +1,327 @@
+/*
+** latency_harness.c -- input to photon latency of a host and scripted joins on one machine
+** starts a host and several joins over loopback (each join on its own port with its own input thread and a
+** render loop paced like the game's), then presses a direction key on one join at a time and times the move
+** showing up: in the host's state, in the other joins' state, in the other joins' next rendered frame, and
+** in the pressing join's own state (its input thread predicts the move locally, so this one stays short)
+**
+** reports p50/p99/p999 of each, and with -b compares them to a baseline saved by -s, exiting 1 when any
+** percentile is over the baseline by more than the tolerance (so a latency regression fails the build)
+**
+** usage: ./latency_harness [-j joins] [-n inputs] [-t tolerance %] [-s save.baseline] [-b baseline]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/HostConnect.h"
+#include "../inc/JoinConnect.h"
+#include "../inc/InputState.h"
+#include "../inc/FramePacer.h"
+
+#define HARNESS_PORT 3991		// joins bind HARNESS_PORT + their index
+#define SETTLE_MS 1000		// longest wait after a release for the move to finish reaching everyone
+#define INPUT_TIMEOUT_MS 1000	// an observer that has not seen an input by then counts it as lost
+#define MOVE_EPS 0.0001f		// least position change that counts as the input arriving
+#define SLACK_US 250			// allowance on top of the tolerance (percentiles are bucketed about 6% wide)
+
+//where an input is seen
+#define STAGE_HOST 0			// host state
+#define STAGE_REMOTE 1			// another join's state
+#define STAGE_FRAME 2			// another join's rendered frame
+#define STAGE_OWN 3				// the pressing join's own (predicted) state
+#define STAGES 4
+static const char* stage_names[STAGES] = {"host_state", "remote_state", "remote_frame", "own_state"};
+static const double percentiles[3] = {50.0, 99.0, 99.9};
+
+static Conn_Info_t host_conn;
+static HostConnect hc;
+static Conn_Info_t join_conn[MAX_PLAYER];
+static JoinConnect jc[MAX_PLAYER];
+static Input_State_t in[MAX_PLAYER];
+static int joins = 3;
+
+//the input in flight (one at a time): base is each observer's position of the moving player before the press
+static pthread_mutex_t pending_lock;
+static int pending = 0, pending_from, pending_id;
+static float base_y[MAX_PLAYER];
+static unsigned long long press_ns;
+static unsigned long long frame_seen[MAX_PLAYER];
+
+static std::atomic<int> stop(0);
+static Latency_Hist_t hist[STAGES];
+static unsigned long long lost[STAGES];
+
+//stand in for display(): the same gather and world update, checking the frame for the pending input
+static void* render_loop(void* input){
+	int q = (int)(size_t)input;
+	Conn_Info_t* conn = &(join_conn[q]);
+	Frame_Pacer_t fp;
+	fp_init(&fp, MAX_FPS);
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	while(!stop){
+		fp_begin(&fp, fp_wait(&fp));
+		ps_gather(conn->store.pos, conn->store.in_use, MAX_PLAYER, x, y, alive);
+		pthread_mutex_lock(&(conn->world_lock));
+		ecs_sync_slots(&(conn->world), conn->player_ents, MAX_PLAYER, x, y, alive);
+		ecs_query_update(&(conn->world), &(conn->player_query));
+		pthread_mutex_unlock(&(conn->world_lock));
+		unsigned long long now = get_mono_ns();
+		pthread_mutex_lock(&pending_lock);
+		if(pending && pending_from != q && frame_seen[q] == 0 && fabsf(y[pending_id] - base_y[q]) > MOVE_EPS){
+			frame_seen[q] = now;
+		}
+		pthread_mutex_unlock(&pending_lock);
+		fp_end(&fp, get_mono_ns());
+	}
+	fp_quit(&fp);
+	return NULL;
+}
+
+static float peek_y(Conn_Info_t* conn, int id){
+	float x, y;
+	ps_peek(&(conn->store.pos[id]), &x, &y);
+	return y;
+}
+
+//waits until the host and every join hold join j's real position (so no earlier move is still arriving)
+static void settle(int j){
+	int id = join_conn[j].self_player_num;
+	unsigned long long deadline = get_mono_ns() + SETTLE_MS * 1000000ULL;
+	while(get_mono_ns() < deadline){
+		pthread_mutex_lock(&(join_conn[j].players[id].lock));
+		float y = join_conn[j].self_y_loc;
+		pthread_mutex_unlock(&(join_conn[j].players[id].lock));
+		int settled = fabsf(peek_y(&host_conn, id) - y) <= MOVE_EPS;
+		for(int q=0; q<joins; q++){
+			settled = settled && fabsf(peek_y(&(join_conn[q]), id) - y) <= MOVE_EPS;
+		}
+		if(settled){
+			Sleep(1000 / (int)MAX_FPS + 1);
+			return;
+		}
+		Sleep(1);
+	}
+}
+
+//presses a key on join j, waits for every observer to see the move (or time out), then releases it
+static void one_input(int j, unsigned char key){
+	int id = join_conn[j].self_player_num;
+	settle(j);
+	float host_base = peek_y(&host_conn, id);
+	unsigned long long state_seen[MAX_PLAYER];
+	unsigned long long host_seen = 0;
+	pthread_mutex_lock(&pending_lock);
+	for(int q=0; q<joins; q++){
+		base_y[q] = peek_y(&(join_conn[q]), id);
+		frame_seen[q] = 0;
+		state_seen[q] = 0;
+	}
+	pending_from = j;
+	pending_id = id;
+	press_ns = get_mono_ns();
+	pending = 1;
+	pthread_mutex_unlock(&pending_lock);
+	in_key_down(&(in[j]), key, press_ns);
+	
+	//poll the states until everyone has seen it
+	unsigned long long deadline = press_ns + INPUT_TIMEOUT_MS * 1000000ULL;
+	int done = 0;
+	while(!done && get_mono_ns() < deadline){
+		unsigned long long now = get_mono_ns();
+		if(host_seen == 0 && fabsf(peek_y(&host_conn, id) - host_base) > MOVE_EPS){
+			host_seen = now;
+		}
+		done = (host_seen != 0);
+		pthread_mutex_lock(&pending_lock);
+		for(int q=0; q<joins; q++){
+			if(state_seen[q] == 0 && fabsf(peek_y(&(join_conn[q]), id) - base_y[q]) > MOVE_EPS){
+				state_seen[q] = now;
+			}
+			done = done && state_seen[q] != 0 && (q == j || frame_seen[q] != 0);
+		}
+		pthread_mutex_unlock(&pending_lock);
+		Sleep(0);
+	}
+	in_key_up(&(in[j]), key, get_mono_ns());
+	
+	pthread_mutex_lock(&pending_lock);
+	pending = 0;
+	if(host_seen != 0){
+		lh_record(&hist[STAGE_HOST], host_seen - press_ns);
+	} else{
+		lost[STAGE_HOST]++;
+	}
+	for(int q=0; q<joins; q++){
+		int stage = (q == j) ? STAGE_OWN : STAGE_REMOTE;
+		if(state_seen[q] != 0){
+			lh_record(&hist[stage], state_seen[q] - press_ns);
+		} else{
+			lost[stage]++;
+		}
+		if(q != j){
+			if(frame_seen[q] != 0){
+				lh_record(&hist[STAGE_FRAME], frame_seen[q] - press_ns);
+			} else{
+				lost[STAGE_FRAME]++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&pending_lock);
+}
+
+static int save_baseline(const char* path){
+	std::ofstream out(path);
+	if(!out.is_open()){
+		return -1;
+	}
+	out << "# latency_harness baseline (us): stage p50 p99 p999\n";
+	for(int s=0; s<STAGES; s++){
+		out << stage_names[s];
+		for(int p=0; p<3; p++){
+			out << " " << lh_percentile(&hist[s], percentiles[p]) / 1000.0;
+		}
+		out << "\n";
+	}
+	return 0;
+}
+
+//returns 1 if every percentile is within tolerance of the baseline, 0 for a regression, -1 if unreadable
+static int check_baseline(const char* path, double tolerance){
+	std::ifstream base(path);
+	if(!base.is_open()){
+		return -1;
+	}
+	int pass = 1, found = 0;
+	std::string line;
+	while(std::getline(base, line)){
+		std::istringstream words(line);
+		std::string name;
+		double limit_us[3];
+		if(!(words >> name) || name[0] == '#' || !(words >> limit_us[0] >> limit_us[1] >> limit_us[2])){
+			continue;
+		}
+		for(int s=0; s<STAGES; s++){
+			if(name != stage_names[s]){
+				continue;
+			}
+			found++;
+			for(int p=0; p<3; p++){
+				double now_us = lh_percentile(&hist[s], percentiles[p]) / 1000.0;
+				double max_us = limit_us[p] * (1.0 + tolerance / 100.0) + SLACK_US;
+				if(now_us > max_us){
+					printf("REGRESSION %s p%g: %.1f us over %.1f us (baseline %.1f us)\n", name.c_str(), percentiles[p], now_us,
+							max_us, limit_us[p]);
+					pass = 0;
+				}
+			}
+		}
+	}
+	return (found == STAGES) ? pass : -1;
+}
+
+int main(int argc, char *argv[]){
+	int inputs = 300;
+	double tolerance = 20.0;
+	const char* save_path = NULL;
+	const char* base_path = NULL;
+	for(int i=1; i<argc; i++){
+		if(strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+			joins = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+			inputs = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc){
+			tolerance = atof(argv[++i]);
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+			save_path = argv[++i];
+		} else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc){
+			base_path = argv[++i];
+		} else{
+			joins = 0;
+		}
+	}
+	if(joins < 2 || joins >= MAX_PLAYER || inputs < 1 || tolerance < 0){
+		fprintf(stderr,"usage: %s [-j joins (2 to %d)] [-n inputs] [-t tolerance %%] [-s save.baseline] [-b baseline]\n", argv[0],
+				MAX_PLAYER - 1);
+		exit(1);
+	}
+	
+	//host, then the joins on their own ports
+	tc_init(&(host_conn.threads));
+	if(hc.init_host(&host_conn) != 0){
+		fprintf(stderr, "host did not start\n");
+		exit(1);
+	}
+	pthread_mutex_init(&pending_lock, NULL);
+	pthread_t render[MAX_PLAYER];
+	for(int q=0; q<joins; q++){
+		tc_init(&(join_conn[q].threads));
+		join_conn[q].client_port = HARNESS_PORT + q;
+		if(jc[q].init_join(&(join_conn[q]), "127.0.0.1") != 0){
+			fprintf(stderr, "join %d did not connect\n", q);
+			exit(1);
+		}
+		in_init(&(in[q]), &(join_conn[q]), join_send_now);
+		in_start(&(in[q]));
+		pthread_create(&(render[q]), NULL, render_loop, (void*)(size_t)q);
+	}
+	printf("host and %d joins up, %d inputs\n", joins, inputs);
+	Sleep(100);
+	
+	//each join in turn moves up then back down
+	for(int s=0; s<STAGES; s++){
+		lh_init(&hist[s]);
+	}
+	for(int i=0; i<inputs; i++){
+		int j = i % joins;
+		one_input(j, ((i / joins) % 2 == 0) ? W_ASCII : S_ASCII);
+	}
+	
+	for(int s=0; s<STAGES; s++){
+		printf("%-13s p50 %8.1f us  p99 %8.1f us  p999 %8.1f us  (%llu samples, %llu lost)\n", stage_names[s],
+				lh_percentile(&hist[s], 50.0) / 1000.0, lh_percentile(&hist[s], 99.0) / 1000.0, lh_percentile(&hist[s], 99.9) / 1000.0,
+				hist[s].total, lost[s]);
+	}
+	
+	//shut down: joins leave first, then the host
+	stop = 1;
+	for(int q=0; q<joins; q++){
+		pthread_join(render[q], NULL);
+		in_stop(&(in[q]));
+		jc[q].quit_join(&(join_conn[q]));
+	}
+	hc.quit_host(&host_conn);
+	
+	int result = 0;
+	if(save_path != NULL){
+		if(save_baseline(save_path) == -1){
+			fprintf(stderr, "cannot write %s\n", save_path);
+			result = 1;
+		} else{
+			printf("baseline saved to %s\n", save_path);
+		}
+	}
+	if(base_path != NULL){
+		int pass = check_baseline(base_path, tolerance);
+		if(pass == -1){
+			fprintf(stderr, "cannot read every stage from %s (save one with -s)\n", base_path);
+			result = 1;
+		} else{
+			printf("%s against %s (tolerance %.0f%% + %d us)\n", pass ? "PASS" : "FAIL", base_path, tolerance, SLACK_US);
+			result = pass ? result : 1;
+		}
+	}
+	return result;
+}
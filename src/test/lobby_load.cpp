@@ -0,0 +1,226 @@
+/*
+** lobby_load.c -- load test of the lobby server over loopback
+** starts a lobby in process, then client threads (each with its own socket standing in for many hosts and
+** joins) register every game and keep sending heartbeats and queries as fast as the answers come back;
+** reports the rates the lobby handled, the query round trip times, and then checks that silent games expire
+**
+** usage: ./lobby_load [server threads] [client threads] [games] [seconds]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Lobby.h"
+
+#define LOAD_PORT 3951
+#define LOAD_TTL 1000		// short ttl (ms) so the expiry check does not wait long
+#define BATCH 64			// heartbeats sent per round
+#define QUERIES 8			// queries sent per round (each waited on before the next round)
+#define WAIT_MS 20			// the time (ms) a round waits for its answers
+
+Lobby_Server_t ls;
+static std::atomic<int> phase(0);		// 0 warm up, 1 measure, 2 stop
+
+typedef struct Load_Client {
+	pthread_t thread;
+	int id;
+	int first_game, games;
+	unsigned long long sent_reg, sent_query, answered, games_seen;
+	std::vector<unsigned long long> rtt_us;
+} Load_Client_t;
+
+//sends heartbeats for this client's games in turn plus a few queries, then waits for the answers
+static void* client_thread(void* input){
+	Load_Client_t* c = (Load_Client_t*) input;
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	struct sockaddr_in lobby;
+	lobby_addr("127.0.0.1:" + std::to_string(LOAD_PORT), &lobby);
+	unsigned long long send_us[QUERIES];
+	int next_game = 0;
+	int round = 0;
+	
+	while(phase != 2){
+		//heartbeats (the session id keys the game, every game of a client shares its socket's port)
+		Lobby_Register_Packet_t reg;
+		memset((char*)&reg, 0, sizeof(reg));
+		reg.head.flags = LB_REGISTER;
+		reg.max_players = MAX_PLAYER;
+		for(int i=0; i<BATCH; i++){
+			int g = c->first_game + next_game;
+			reg.head.session_id = (unsigned short)(next_game + 1);
+			reg.players = (unsigned char)(g % MAX_PLAYER);
+			snprintf(reg.name, LOBBY_NAME_LEN, "load %d", g);
+			sendto(s, (char*)&reg, lobby_register_len, 0, (struct sockaddr*)&lobby, sizeof(lobby));
+			next_game = (next_game + 1) % c->games;
+			if(phase == 1){
+				(c->sent_reg)++;
+			}
+		}
+		
+		//queries (padded to a full answer as lobby_find sends them), numbered so the answers can be matched
+		//to their send times
+		Lobby_List_Packet_t query;
+		memset((char*)&query, 0, sizeof(query));
+		query.head.flags = LB_QUERY;
+		for(int i=0; i<QUERIES; i++){
+			query.head.packet_num = (round * QUERIES) + i;
+			send_us[i] = get_mono_ns() / 1000;
+			sendto(s, (char*)&query, lobby_query_len, 0, (struct sockaddr*)&lobby, sizeof(lobby));
+			if(phase == 1){
+				(c->sent_query)++;
+			}
+		}
+		
+		//wait for this round's answers (late ones from an earlier round are skipped)
+		int got = 0;
+		unsigned long long deadline = get_mono_ms() + WAIT_MS;
+		while(got < QUERIES && get_mono_ms() < deadline){
+			fd_set ready;
+			FD_ZERO(&ready);
+			FD_SET(s, &ready);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 1000;
+			if(select((int)s + 1, &ready, NULL, NULL, &tv) <= 0){
+				continue;
+			}
+			Lobby_List_Packet_t list;
+			int bytes = recvfrom(s, (char*)&list, sizeof(list), 0, NULL, NULL);
+			unsigned long long now_us = get_mono_ns() / 1000;
+			if(bytes < (int)lobby_list_head_len || list.head.flags != LB_LIST || list.head.packet_num / QUERIES != round){
+				continue;
+			}
+			got++;
+			if(phase == 1){
+				(c->answered)++;
+				c->games_seen += list.count;
+				c->rtt_us.push_back(now_us - send_us[list.head.packet_num % QUERIES]);
+			}
+		}
+		round++;
+	}
+	closesocket(s);
+	return NULL;
+}
+
+int main(int argc, char *argv[]){
+	int server_threads = 2;
+	int client_threads = 4;
+	int games = 20000;
+	double run_s = 5.0;
+	
+	//check arguments
+	if(argc > 5){
+		fprintf(stderr,"usage: %s [server threads] [client threads] [games] [seconds]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		server_threads = atoi(argv[1]);
+	}
+	if(argc > 2){
+		client_threads = atoi(argv[2]);
+	}
+	if(argc > 3){
+		games = atoi(argv[3]);
+	}
+	if(argc > 4){
+		run_s = atof(argv[4]);
+	}
+	if(server_threads < 1 || client_threads < 1 || games < client_threads || games > LOBBY_MAX_GAMES
+			|| games / client_threads > 0xFFFF || run_s <= 0){
+		fprintf(stderr,"usage: %s [server threads] [client threads] [games (up to %d)] [seconds]\n", argv[0], LOBBY_MAX_GAMES);
+		exit(1);
+	}
+	
+	if(lobby_init(&ls, LOAD_PORT, server_threads, LOBBY_MAX_GAMES, LOAD_TTL) != 0){
+		fprintf(stderr, "lobby init failed\n");
+		exit(1);
+	}
+	printf("%d server threads, %d client threads, %d games, %.1f s\n", server_threads, client_threads, games, run_s);
+	
+	std::vector<Load_Client_t> clients(client_threads);
+	for(int i=0; i<client_threads; i++){
+		Load_Client_t* c = &(clients[i]);
+		c->id = i;
+		c->first_game = (games / client_threads) * i;
+		c->games = (i == client_threads - 1) ? games - c->first_game : games / client_threads;
+		c->sent_reg = 0;
+		c->sent_query = 0;
+		c->answered = 0;
+		c->games_seen = 0;
+		pthread_create(&(c->thread), NULL, client_thread, (void*)c);
+	}
+	
+	//warm up until every game is listed, then measure
+	unsigned long long start = get_mono_ms();
+	while(li_count(&(ls.idx)) < games && get_mono_ms() < start + 5000){
+		Sleep(10);
+	}
+	int listed = li_count(&(ls.idx));
+	unsigned long long reg0 = ls.registers, query0 = ls.queries;
+	unsigned long long t0 = get_mono_ns();
+	phase = 1;
+	Sleep((DWORD)(run_s * 1000.0));
+	unsigned long long reg1 = ls.registers, query1 = ls.queries;
+	double wall_s = (double)(get_mono_ns() - t0) / 1e9;
+	phase = 2;
+	for(int i=0; i<client_threads; i++){
+		pthread_join(clients[i].thread, NULL);
+	}
+	
+	unsigned long long sent_reg = 0, sent_query = 0, answered = 0, seen = 0;
+	std::vector<unsigned long long> rtt;
+	for(int i=0; i<client_threads; i++){
+		sent_reg += clients[i].sent_reg;
+		sent_query += clients[i].sent_query;
+		answered += clients[i].answered;
+		seen += clients[i].games_seen;
+		rtt.insert(rtt.end(), clients[i].rtt_us.begin(), clients[i].rtt_us.end());
+	}
+	std::sort(rtt.begin(), rtt.end());
+	printf("games listed after warm up: %d of %d\n", listed, games);
+	printf("heartbeats: %10.0f /s handled (%llu sent)\n", (double)(reg1 - reg0) / wall_s, sent_reg);
+	printf("queries:    %10.0f /s handled (%llu sent, %llu answered in time, %.1f games per answer)\n",
+			(double)(query1 - query0) / wall_s, sent_query, answered, answered ? (double)seen / answered : 0.0);
+	if(rtt.size() > 0){
+		printf("query round trip: p50 %llu us, p99 %llu us, max %llu us\n", rtt[rtt.size() / 2], rtt[(rtt.size() * 99) / 100], rtt.back());
+	}
+	printf("bad packets: %llu\n", (unsigned long long)ls.bad);
+	
+	//a bare header query (what a spoofed source would send to amplify) must be dropped, not answered
+	unsigned long long bad0 = ls.bad, queries0 = ls.queries;
+	SOCKET bare = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	struct sockaddr_in lobby;
+	lobby_addr("127.0.0.1:" + std::to_string(LOAD_PORT), &lobby);
+	Header_t short_query;
+	memset((char*)&short_query, 0, sizeof(short_query));
+	short_query.flags = LB_QUERY;
+	sendto(bare, (char*)&short_query, PACKET_HEAD_LEN, 0, (struct sockaddr*)&lobby, sizeof(lobby));
+	Sleep(WAIT_MS * 5);
+	closesocket(bare);
+	int dropped = (ls.bad == bad0 + 1 && ls.queries == queries0);
+	printf("short query: %s\n", dropped ? "dropped" : "ANSWERED");
+	
+	//with every host silent the games should all be gone a ttl (plus an expiry pass) later
+	unsigned long long quiet = get_mono_ms();
+	int left = li_count(&(ls.idx));
+	while(left > 0 && get_mono_ms() < quiet + (3 * LOAD_TTL)){
+		Sleep(LOBBY_EXPIRE_TIME);
+		left = li_count(&(ls.idx));
+	}
+	printf("ttl expiry: %s (%d games left %llu ms after the last heartbeat, ttl %d ms)\n", left == 0 ? "ok" : "FAILED", left,
+			get_mono_ms() - quiet, LOAD_TTL);
+	
+	lobby_quit(&ls);
+	return (left == 0 && listed == games && dropped) ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*
+** lobby_server.c -- local rendezvous server listing the open games hosts register with it
+** prints the number of listed games and the request rates every few seconds
+**
+** usage: ./lobby_server [threads] [-p port] [-g max_games] [-t ttl_ms]
+** e.g. ./lobby_server then ./MarvelHeros host -l 127.0.0.1 and ./MarvelHeros join @127.0.0.1
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <string>
+#include <vector>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Lobby.h"
+
+#define STATS_TIME 5000	// the time (ms) between prints
+
+Lobby_Server_t ls;
+static volatile int stop = 0;
+
+//ctrl-c closes the lobby before exiting
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char *argv[]){
+	int threads = 2;
+	unsigned short port = LOBBY_PORT;
+	unsigned max_games = LOBBY_MAX_GAMES;
+	unsigned long long ttl = LOBBY_TTL;
+	std::vector<std::string> args;
+	
+	//check arguments
+	for(int i=1; i<argc; i++){
+		std::string arg = argv[i];
+		if((arg == "-p" || arg == "-g" || arg == "-t") && i + 1 >= argc){
+			fprintf(stderr, "lobby_server: %s needs a value\n", argv[i]);
+			exit(1);
+		}
+		if(arg == "-p"){
+			port = (unsigned short)atoi(argv[++i]);
+		} else if(arg == "-g"){
+			max_games = (unsigned)atoi(argv[++i]);
+		} else if(arg == "-t"){
+			ttl = (unsigned long long)atoll(argv[++i]);
+		} else{
+			args.push_back(arg);
+		}
+	}
+	if(args.size() > 1 || port == 0 || max_games == 0 || ttl == 0){
+		fprintf(stderr,"usage: %s [threads] [-p port] [-g max_games] [-t ttl_ms]\n", argv[0]);
+		exit(1);
+	}
+	if(args.size() > 0){
+		threads = atoi(args[0].c_str());
+	}
+	if(threads < 1){
+		threads = 1;
+	}
+	
+	if(lobby_init(&ls, port, threads, max_games, ttl) != 0){
+		fprintf(stderr, "lobby_server: cannot listen on port %u\n", port);
+		exit(1);
+	}
+	signal(SIGINT, on_signal);
+	printf("lobby on port %u, %d threads, up to %u games, ttl %llu ms\n", port, threads, max_games, ttl);
+	
+	unsigned long long last = get_mono_ms();
+	unsigned long long last_reg = 0, last_query = 0;
+	while(!stop){
+		Sleep(100);
+		unsigned long long now = get_mono_ms();
+		if(now < last + STATS_TIME){
+			continue;
+		}
+		unsigned long long reg = ls.registers, query = ls.queries;
+		printf("%d games listed, %.0f heartbeats/s, %.0f queries/s (%llu removes, %llu bad)\n", li_count(&(ls.idx)),
+				(double)(reg - last_reg) * 1000.0 / (now - last), (double)(query - last_query) * 1000.0 / (now - last),
+				(unsigned long long)ls.removes, (unsigned long long)ls.bad);
+		last_reg = reg;
+		last_query = query;
+		last = now;
+	}
+	
+	lobby_quit(&ls);
+	return 0;
+}
@@ -0,0 +1,551 @@
+/*
+** netem.c -- udp impairment proxy to sit between joining players and the host (on loopback or a lan)
+** adds delay, jitter, random and bursty loss, duplication, reordering and a bandwidth cap per direction,
+** optionally changing them on a script, and reports (and can export) what it did to every datagram
+**
+** usage: ./netem listen_port host_addr[:port] [options]
+**   up:key=value / down:key=value / key=value (both directions) with keys
+**     delay (ms), jitter (ms), loss (0-1), burst (p_enter/p_leave of the lossy state), burst_loss (0-1),
+**     dup (0-1), reorder (0-1), reorder_gap (ms), rate (kbit/s, 0 for no cap), queue (packets)
+**   -p profile	script of "seconds direction key=value ..." lines applied when their time comes
+**   -o file	csv export of every datagram (time, direction, size, type, action, added delay)
+**   -t seconds	run time (0 runs until interrupted)
+**   -s seed	random seed (same seed, script and traffic give the same impairments)
+** e.g. ./netem 3941 127.0.0.1:3940 delay=40 jitter=8 down:loss=0.02 then ./MarvelHeros join 127.0.0.1:3941
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <winsock2.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../inc/ConnectStruct.h"
+
+#define DIR_UP 0		// player to host
+#define DIR_DOWN 1		// host to player
+#define STATS_TIME 5000	// the time (ms) between stats prints
+#define IDLE_TIME 60000	// the time (ms) without traffic before a player's relay socket is closed
+
+//impairments of one direction
+typedef struct Impair {
+	double delay_ms, jitter_ms;
+	double loss;
+	double burst_enter, burst_leave, burst_loss;
+	double dup, reorder, reorder_gap_ms;
+	double rate_kbps;
+	unsigned queue;
+} Impair_t;
+
+//per direction link state and counts
+typedef struct Link {
+	Impair_t imp;
+	int bad;						// in the lossy state of the burst model
+	unsigned long long busy_until;	// bandwidth cap: time the link finishes its backlog
+	unsigned long long last_release;	// release time of the newest in order packet
+	unsigned long long in, out, lost, burst_lost, queue_lost, dups, reordered;
+	double delay_sum, delay_max;
+} Link_t;
+
+//one proxied player (its own socket towards the host so the host sees one source per player)
+typedef struct Relay {
+	struct sockaddr_in player;
+	SOCKET up;
+	unsigned long long last_seen;
+	int in_use;
+} Relay_t;
+
+//datagram waiting for its release time
+typedef struct Pending {
+	int dir, relay;
+	std::vector<char> data;
+} Pending_t;
+
+//scripted impairment change
+typedef struct Step {
+	double at_s;
+	std::string dir;
+	std::string setting;
+} Step_t;
+
+static volatile int stop = 0;
+static unsigned long long rng_state = 88172645463325252ULL;
+
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+//xorshift, uniform in [0, 1)
+static double rng(){
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (double)(rng_state >> 11) / 9007199254740992.0;
+}
+
+static void impair_clear(Impair_t* imp){
+	memset(imp, 0, sizeof(Impair_t));
+	imp->burst_loss = 1.0;
+	imp->reorder_gap_ms = 10.0;
+	imp->queue = 100;
+}
+
+/*	impair_set:
+ * 		Applies one key=value setting to a direction ("reset" clears every impairment).
+ *	returns: 0 on success, -1 for an unknown key or bad value
+ */
+static int impair_set(Impair_t* imp, std::string setting){
+	if(setting == "reset"){
+		impair_clear(imp);
+		return 0;
+	}
+	size_t eq = setting.find('=');
+	if(eq == std::string::npos){
+		return -1;
+	}
+	std::string key = setting.substr(0, eq);
+	const char* val = setting.c_str() + eq + 1;
+	char* end;
+	double v = strtod(val, &end);
+	if(end == val || v < 0){
+		return -1;
+	}
+	
+	if(key == "delay"){
+		imp->delay_ms = v;
+	} else if(key == "jitter"){
+		imp->jitter_ms = v;
+	} else if(key == "loss" && v <= 1){
+		imp->loss = v;
+	} else if(key == "burst" && *end == '/'){
+		imp->burst_enter = v;
+		imp->burst_leave = strtod(end + 1, NULL);
+	} else if(key == "burst_loss" && v <= 1){
+		imp->burst_loss = v;
+	} else if(key == "dup" && v <= 1){
+		imp->dup = v;
+	} else if(key == "reorder" && v <= 1){
+		imp->reorder = v;
+	} else if(key == "reorder_gap"){
+		imp->reorder_gap_ms = v;
+	} else if(key == "rate"){
+		imp->rate_kbps = v;
+	} else if(key == "queue"){
+		imp->queue = (unsigned)v;
+	} else{
+		return -1;
+	}
+	return 0;
+}
+
+/*	apply_setting:
+ * 		Applies a setting to the named direction ("up", "down" or "both").
+ *	returns: 0 on success, -1 on error
+ */
+static int apply_setting(Link_t* links, std::string dir, std::string setting){
+	if(dir == "up" || dir == "both"){
+		if(impair_set(&(links[DIR_UP].imp), setting) == -1){
+			return -1;
+		}
+	}
+	if(dir == "down" || dir == "both"){
+		if(impair_set(&(links[DIR_DOWN].imp), setting) == -1){
+			return -1;
+		}
+	}
+	return (dir == "up" || dir == "down" || dir == "both") ? 0 : -1;
+}
+
+/*	load_profile:
+ * 		Reads a script of "seconds direction key=value ..." lines ('#' starts a comment).
+ *	returns: 0 on success, -1 on error
+ */
+static int load_profile(const char* path, std::vector<Step_t>* steps){
+	FILE* f = fopen(path, "r");
+	char line[512];
+	if(f == NULL){
+		return -1;
+	}
+	while(fgets(line, sizeof(line), f) != NULL){
+		char* hash = strchr(line, '#');
+		if(hash != NULL){
+			*hash = '\0';
+		}
+		char* tok = strtok(line, " \t\r\n");
+		if(tok == NULL){
+			continue;
+		}
+		Step_t step;
+		step.at_s = atof(tok);
+		if((tok = strtok(NULL, " \t\r\n")) == NULL){
+			fclose(f);
+			return -1;
+		}
+		step.dir = tok;
+		while((tok = strtok(NULL, " \t\r\n")) != NULL){
+			step.setting = tok;
+			steps->push_back(step);
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/*	impair:
+ * 		Runs a datagram through a direction's impairments.
+ *	returns: number of copies to send (0 if lost), release times in rel (at most 2)
+ */
+static int impair(Link_t* l, int len, unsigned long long now, unsigned long long* rel){
+	Impair_t* imp = &(l->imp);
+	(l->in)++;
+	
+	//two state (gilbert) burst loss then independent loss
+	if(imp->burst_enter > 0){
+		if(!l->bad && rng() < imp->burst_enter){
+			l->bad = 1;
+		} else if(l->bad && rng() < imp->burst_leave){
+			l->bad = 0;
+		}
+		if(l->bad && rng() < imp->burst_loss){
+			(l->burst_lost)++;
+			return 0;
+		}
+	}
+	if(rng() < imp->loss){
+		(l->lost)++;
+		return 0;
+	}
+	
+	//bandwidth cap: drop tail queue ahead of a link of the given rate (backlog counted in packets of this size)
+	unsigned long long t = now;
+	if(imp->rate_kbps > 0){
+		unsigned long long tx = (unsigned long long)((len * 8.0 * 1000000.0) / imp->rate_kbps);
+		unsigned long long backlog = (l->busy_until > now) ? l->busy_until - now : 0;
+		if(backlog >= tx * imp->queue){
+			(l->queue_lost)++;
+			return 0;
+		}
+		l->busy_until = now + backlog + tx;
+		t = l->busy_until;
+	}
+	
+	int copies = (rng() < imp->dup) ? 2 : 1;
+	if(copies == 2){
+		(l->dups)++;
+	}
+	for(int c=0; c<copies; c++){
+		double d = imp->delay_ms + (imp->jitter_ms * ((2.0 * rng()) - 1.0));
+		unsigned long long r = t + (unsigned long long)(((d > 0) ? d : 0) * 1000000.0);
+		if(rng() < imp->reorder){
+			//held back so packets behind it overtake
+			r += (unsigned long long)(imp->reorder_gap_ms * 1000000.0);
+			(l->reordered)++;
+		} else{
+			//jitter alone keeps the order (like a real queue)
+			if(r < l->last_release){
+				r = l->last_release;
+			}
+			l->last_release = r;
+		}
+		rel[c] = r;
+		double added = (double)(r - now) / 1000000.0;
+		l->delay_sum += added;
+		l->delay_max = (added > l->delay_max) ? added : l->delay_max;
+	}
+	l->out += copies;
+	return copies;
+}
+
+static const char* pkt_type(const char* buf, int len){
+	if(len < PACKET_HEAD_LEN){
+		return "short";
+	}
+	unsigned char flags = ((const Header_t*)buf)->flags;
+	if(flags & PF_JOIN){
+		if(flags & PF_COOKIE){
+			return "cookie";
+		}
+		return (flags & PF_ACK) ? "join_ack" : "join";
+	} else if(flags & PF_QUIT){
+		return (flags & PF_ACK) ? "quit_ack" : "quit";
+	} else if(flags & PF_KEYS){
+		return "keys";
+	} else if(flags & PF_DISP){
+		return "disp";
+	}
+	return "other";
+}
+
+static void print_stats(Link_t* links, double elapsed_s){
+	const char* names[2] = {"up", "down"};
+	printf("%8.1fs %5s %8s %8s %7s %7s %7s %6s %6s %9s %9s\n", elapsed_s, "dir", "in", "out", "lost", "burst", "queue", "dup", "reord", "avg ms", "max ms");
+	for(int d=0; d<2; d++){
+		Link_t* l = &links[d];
+		printf("%9s %5s %8llu %8llu %7llu %7llu %7llu %6llu %6llu %9.2f %9.2f\n", "", names[d], l->in, l->out, l->lost, l->burst_lost,
+				l->queue_lost, l->dups, l->reordered, l->out ? l->delay_sum / l->out : 0.0, l->delay_max);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]){
+	SOCKET s;
+	unsigned long ul = 1;
+	struct sockaddr_in self, host, si_other;
+	int slen, numbytes;
+	WSADATA wsa;
+	char buf[MAX_PACKET_LEN];
+	Link_t links[2];
+	Relay_t relays[MAX_PLAYER];
+	std::vector<Step_t> steps;
+	std::multimap<std::pair<unsigned long long, unsigned long long>, Pending_t> pending;
+	unsigned long long pending_seq = 0;
+	FILE* out = NULL;
+	double run_s = 0;
+	
+	//check arguments
+	if (argc < 3) {
+		fprintf(stderr,"usage: %s listen_port host_addr[:port] [up:|down:]key=value ... [-p profile] [-o events.csv] [-t seconds] [-s seed]\n", argv[0]);
+		exit(1);
+	}
+	memset(links, 0, sizeof(links));
+	impair_clear(&(links[DIR_UP].imp));
+	impair_clear(&(links[DIR_DOWN].imp));
+	
+	std::string hostname = argv[2];
+	unsigned short host_port = SERVER_PORT;
+	size_t colon = hostname.find(':');
+	if(colon != std::string::npos){
+		host_port = (unsigned short)atoi(hostname.c_str() + colon + 1);
+		hostname = hostname.substr(0, colon);
+	}
+	for(int i=3; i<argc; i++){
+		std::string arg = argv[i];
+		if((arg == "-p" || arg == "-o" || arg == "-t" || arg == "-s") && i + 1 >= argc){
+			fprintf(stderr, "netem: %s needs a value\n", argv[i]);
+			exit(1);
+		}
+		if(arg == "-p"){
+			if(load_profile(argv[++i], &steps) == -1){
+				fprintf(stderr, "netem: bad profile %s\n", argv[i]);
+				exit(1);
+			}
+		} else if(arg == "-o"){
+			if((out = fopen(argv[++i], "w")) == NULL){
+				fprintf(stderr, "netem: cannot write %s\n", argv[i]);
+				exit(1);
+			}
+			fprintf(out, "time_ms,dir,bytes,type,action,added_ms\n");
+		} else if(arg == "-t"){
+			run_s = atof(argv[++i]);
+		} else if(arg == "-s"){
+			rng_state = strtoull(argv[++i], NULL, 10) | 1;
+		} else{
+			size_t c = arg.find(':');
+			std::string dir = (c == std::string::npos) ? "both" : arg.substr(0, c);
+			std::string setting = (c == std::string::npos) ? arg : arg.substr(c + 1);
+			if(apply_setting(links, dir, setting) == -1){
+				fprintf(stderr, "netem: bad setting %s\n", argv[i]);
+				exit(1);
+			}
+		}
+	}
+	
+	//initializing winsock
+	if(WSAStartup(MAKEWORD(2,2),&wsa)!=0){
+		printf("Initialization Failed. Error Code: %d", WSAGetLastError());
+		exit(EXIT_FAILURE);
+	}
+	
+	//creating the non-blocking player side socket
+	if((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == SOCKET_ERROR){
+		printf("Socket Not Created. Error Code: %d", WSAGetLastError());
+		exit(EXIT_FAILURE);
+	}
+	if(ioctlsocket(s, FIONBIO, (unsigned long*)&ul) == SOCKET_ERROR){
+		printf("Non-Blocking Mode Failed. Error Code: %d", WSAGetLastError());
+		exit(EXIT_FAILURE);
+	}
+	memset((char*)&self, 0, sizeof(self));
+	self.sin_family = AF_INET;
+	self.sin_addr.s_addr = INADDR_ANY;
+	self.sin_port = htons((unsigned short)atoi(argv[1]));
+	if(bind(s, (struct sockaddr*)&self, sizeof(self)) == SOCKET_ERROR){
+		printf("Socket Bind Failed. Error Code: %d", WSAGetLastError());
+		exit(EXIT_FAILURE);
+	}
+	memset((char*)&host, 0, sizeof(host));
+	host.sin_family = AF_INET;
+	host.sin_addr.S_un.S_addr = inet_addr(hostname.c_str());
+	host.sin_port = htons(host_port);
+	for(int i=0; i<MAX_PLAYER; i++){
+		relays[i].in_use = 0;
+	}
+	
+	signal(SIGINT, on_signal);
+	printf("relaying port %s to %s:%u\n", argv[1], hostname.c_str(), host_port);
+	unsigned long long start = get_mono_ns();
+	unsigned long long last_stats = start;
+	size_t next_step = 0;
+	
+	while(!stop){
+		unsigned long long now = get_mono_ns();
+		double elapsed_s = (double)(now - start) / 1000000000.0;
+		if(run_s > 0 && elapsed_s >= run_s){
+			break;
+		}
+		
+		//scripted impairment changes
+		while(next_step < steps.size() && steps[next_step].at_s <= elapsed_s){
+			if(apply_setting(links, steps[next_step].dir, steps[next_step].setting) == -1){
+				printf("%8.1fs bad profile setting %s %s\n", elapsed_s, steps[next_step].dir.c_str(), steps[next_step].setting.c_str());
+			} else{
+				printf("%8.1fs %s %s\n", elapsed_s, steps[next_step].dir.c_str(), steps[next_step].setting.c_str());
+			}
+			next_step++;
+		}
+		
+		//wait for traffic until the next release is due (at most 1 ms so the script and stats keep time)
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(s, &ready);
+		SOCKET top = s;
+		for(int i=0; i<MAX_PLAYER; i++){
+			if(relays[i].in_use){
+				FD_SET(relays[i].up, &ready);
+				top = (relays[i].up > top) ? relays[i].up : top;
+			}
+		}
+		struct timeval tv;
+		unsigned long long wait_ns = 1000000;
+		if(!pending.empty()){
+			unsigned long long due = pending.begin()->first.first;
+			wait_ns = (due <= now) ? 0 : ((due - now < wait_ns) ? due - now : wait_ns);
+		}
+		tv.tv_sec = 0;
+		tv.tv_usec = (long)(wait_ns / 1000);
+		if(select((int)top + 1, &ready, NULL, NULL, &tv) == SOCKET_ERROR){
+			printf("Select Failed. Error Code: %d", WSAGetLastError());
+			break;
+		}
+		now = get_mono_ns();
+		
+		//player to host
+		slen = sizeof(si_other);
+		while(FD_ISSET(s, &ready) && (numbytes = recvfrom(s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+			int r = -1, free_slot = -1;
+			for(int i=0; i<MAX_PLAYER; i++){
+				if(relays[i].in_use && same_addr(&(relays[i].player), &si_other)){
+					r = i;
+					break;
+				} else if(!relays[i].in_use && free_slot == -1){
+					free_slot = i;
+				}
+			}
+			if(r == -1 && free_slot != -1){
+				//new player gets its own relay socket
+				SOCKET up = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+				if(up != (SOCKET)SOCKET_ERROR && ioctlsocket(up, FIONBIO, (unsigned long*)&ul) != SOCKET_ERROR){
+					relays[free_slot].player = si_other;
+					relays[free_slot].up = up;
+					relays[free_slot].in_use = 1;
+					r = free_slot;
+					printf("%8.1fs player %s:%u on relay %d\n", elapsed_s, inet_ntoa(si_other.sin_addr), ntohs(si_other.sin_port), r);
+				}
+			}
+			if(r != -1){
+				relays[r].last_seen = now;
+				unsigned long long rel[2];
+				int copies = impair(&links[DIR_UP], numbytes, now, rel);
+				for(int c=0; c<copies; c++){
+					Pending_t p;
+					p.dir = DIR_UP;
+					p.relay = r;
+					p.data.assign(buf, buf + numbytes);
+					pending.insert(std::make_pair(std::make_pair(rel[c], pending_seq++), p));
+				}
+				if(out != NULL){
+					fprintf(out, "%.3f,up,%d,%s,%s,%.3f\n", (double)(now - start) / 1000000.0, numbytes, pkt_type(buf, numbytes),
+							(copies == 0) ? "drop" : ((copies == 2) ? "dup" : "pass"), copies ? (double)(rel[0] - now) / 1000000.0 : 0.0);
+				}
+			}
+			slen = sizeof(si_other);
+		}
+		
+		//host to player
+		for(int i=0; i<MAX_PLAYER; i++){
+			if(!relays[i].in_use || !FD_ISSET(relays[i].up, &ready)){
+				continue;
+			}
+			slen = sizeof(si_other);
+			while((numbytes = recvfrom(relays[i].up, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+				unsigned long long rel[2];
+				int copies = impair(&links[DIR_DOWN], numbytes, now, rel);
+				for(int c=0; c<copies; c++){
+					Pending_t p;
+					p.dir = DIR_DOWN;
+					p.relay = i;
+					p.data.assign(buf, buf + numbytes);
+					pending.insert(std::make_pair(std::make_pair(rel[c], pending_seq++), p));
+				}
+				if(out != NULL){
+					fprintf(out, "%.3f,down,%d,%s,%s,%.3f\n", (double)(now - start) / 1000000.0, numbytes, pkt_type(buf, numbytes),
+							(copies == 0) ? "drop" : ((copies == 2) ? "dup" : "pass"), copies ? (double)(rel[0] - now) / 1000000.0 : 0.0);
+				}
+				slen = sizeof(si_other);
+			}
+		}
+		
+		//release everything that is due
+		now = get_mono_ns();
+		while(!pending.empty() && pending.begin()->first.first <= now){
+			Pending_t* p = &(pending.begin()->second);
+			Relay_t* relay = &relays[p->relay];
+			if(relay->in_use){
+				if(p->dir == DIR_UP){
+					sendto(relay->up, &(p->data[0]), (int)p->data.size(), 0, (struct sockaddr*)&host, sizeof(host));
+				} else{
+					sendto(s, &(p->data[0]), (int)p->data.size(), 0, (struct sockaddr*)&(relay->player), sizeof(relay->player));
+				}
+			}
+			pending.erase(pending.begin());
+		}
+		
+		//close relays of players gone quiet
+		for(int i=0; i<MAX_PLAYER; i++){
+			if(relays[i].in_use && (now - relays[i].last_seen) / 1000000ULL > IDLE_TIME){
+				closesocket(relays[i].up);
+				relays[i].in_use = 0;
+				printf("%8.1fs relay %d closed (idle)\n", elapsed_s, i);
+			}
+		}
+		
+		if((now - last_stats) / 1000000ULL >= STATS_TIME){
+			last_stats = now;
+			print_stats(links, elapsed_s);
+		}
+	}
+	
+	print_stats(links, (double)(get_mono_ns() - start) / 1000000000.0);
+	if(out != NULL){
+		fclose(out);
+	}
+	for(int i=0; i<MAX_PLAYER; i++){
+		if(relays[i].in_use){
+			closesocket(relays[i].up);
+		}
+	}
+	closesocket(s);
+	WSACleanup();
+	return 0;
+}
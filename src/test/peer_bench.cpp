@@ -0,0 +1,91 @@
+/*
+** peer_bench.c -- peer lookup cost of the hashed peer table against a linear slot scan as players grow
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/PeerTable.h"
+
+#define LOOKUPS 2000000
+
+//linear scan over the slot addresses (how the host found peers before the table)
+static int scan_find(struct sockaddr_in* addrs, int n, struct sockaddr_in* addr){
+	for(int i=0; i<n; i++){
+		if(addrs[i].sin_addr.S_un.S_addr == addr->sin_addr.S_un.S_addr && addrs[i].sin_port == addr->sin_port){
+			return i;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char *argv[]){
+	int sizes[] = {8, 64, 512, 4096, 32768};
+	volatile int sink = 0;
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	
+	printf("%10s %14s %14s %14s\n", "players", "table hit ns", "table miss ns", "scan hit ns");
+	for(unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		int n = sizes[s];
+		struct sockaddr_in* addrs = new struct sockaddr_in[n];
+		int* order = new int[LOOKUPS];
+		Peer_Table_t pt;
+		pt_init(&pt, n);
+		
+		//peers spread over a few NAT addresses so many share an ip and differ only by port
+		srand(n);
+		for(int i=0; i<n; i++){
+			memset((char*)&addrs[i], 0, sizeof(addrs[i]));
+			addrs[i].sin_family = AF_INET;
+			addrs[i].sin_addr.S_un.S_addr = htonl(0x0A000000 | (rand() % 16));
+			addrs[i].sin_port = htons(1024 + i);
+			pt_insert(&pt, &addrs[i], i);
+		}
+		for(int i=0; i<LOOKUPS; i++){
+			order[i] = rand() % n;
+		}
+		
+		//hits in random order
+		unsigned long long start = get_mono_ns();
+		for(int i=0; i<LOOKUPS; i++){
+			sink += pt_find(&pt, &addrs[order[i]]);
+		}
+		double hit_ns = (double)(get_mono_ns() - start) / LOOKUPS;
+		
+		//misses (same addresses on ports no peer uses)
+		struct sockaddr_in miss;
+		start = get_mono_ns();
+		for(int i=0; i<LOOKUPS; i++){
+			miss = addrs[order[i]];
+			miss.sin_port = htons(60000 - (order[i] & 0xFFF));
+			sink += pt_find(&pt, &miss);
+		}
+		double miss_ns = (double)(get_mono_ns() - start) / LOOKUPS;
+		
+		//linear scan hits (fewer lookups at large sizes to keep the run short)
+		int scan_lookups = LOOKUPS / (n > 512 ? 64 : 1);
+		start = get_mono_ns();
+		for(int i=0; i<scan_lookups; i++){
+			sink += scan_find(addrs, n, &addrs[order[i]]);
+		}
+		double scan_ns = (double)(get_mono_ns() - start) / scan_lookups;
+		
+		printf("%10d %14.1f %14.1f %14.1f\n", n, hit_ns, miss_ns, scan_ns);
+		pt_destroy(&pt);
+		delete[] addrs;
+		delete[] order;
+	}
+	
+	return sink == 0x7FFFFFFF;
+}
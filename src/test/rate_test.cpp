@@ -0,0 +1,192 @@
+/*
+** rate_test.c -- runs the per player send rate controller against emulated links (delay, random loss and a
+** bottleneck queue) and reports the rate each one settles at along with the delay and loss the player sees
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/RateControl.h"
+
+#define SIM_US 30000000ULL		// simulated run length
+#define SETTLE_US 10000000ULL	// stats only cover the time after this
+#define STEP_US 100ULL			// simulation tick
+
+//one way link: fixed propagation delay, random loss and a drop tail bottleneck queue
+typedef struct Link {
+	unsigned long long delay_us;
+	double loss;
+	double capacity_pps;		// 0 for no bottleneck
+	unsigned queue_max;
+	std::deque<unsigned> queue;		// seqs of packets waiting on the bottleneck
+	std::deque<std::pair<unsigned long long, unsigned> > flight;	// (delivery time, seq)
+	unsigned long long next_service;
+} Link_t;
+
+typedef struct Scenario {
+	const char* name;
+	unsigned long long delay_us;
+	double loss;
+	double capacity_pps;
+	unsigned queue_max;
+} Scenario_t;
+
+static unsigned rng_state = 12345;
+static double rng(){
+	rng_state = (rng_state * 1103515245u) + 12345u;
+	return (double)((rng_state >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+//puts a packet on the link (dropped at random or when the bottleneck queue is full)
+static void link_send(Link_t* l, unsigned seq, unsigned long long now){
+	if(rng() < l->loss){
+		return;
+	}
+	if(l->capacity_pps <= 0){
+		l->flight.push_back(std::make_pair(now + l->delay_us, seq));
+		return;
+	}
+	if(l->queue.size() >= l->queue_max){
+		return;
+	}
+	l->queue.push_back(seq);
+}
+
+//serves the bottleneck queue at the link capacity
+static void link_step(Link_t* l, unsigned long long now){
+	unsigned long long service_us = (unsigned long long)(1000000.0 / l->capacity_pps);
+	while(l->capacity_pps > 0 && !l->queue.empty() && l->next_service <= now){
+		unsigned seq = l->queue.front();
+		l->queue.pop_front();
+		l->flight.push_back(std::make_pair(now + l->delay_us, seq));
+		l->next_service = now + service_us;
+	}
+	if(l->queue.empty() && l->next_service < now){
+		l->next_service = now;
+	}
+}
+
+int main(int argc, char *argv[]){
+	Scenario_t scenarios[] = {
+		{"clean lan",            1000,  0.00,   0,   0},
+		{"50 ms rtt",           25000,  0.00,   0,   0},
+		{"2% loss 50 ms",       25000,  0.02,   0,   0},
+		{"15% loss 50 ms",      25000,  0.15,   0,   0},
+		{"120 pps bottleneck",  20000,  0.00, 120, 100},
+		{"60 pps bottleneck",   20000,  0.00,  60, 100},
+		{"40 pps 1% loss 150ms",75000,  0.01,  40,  50},
+	};
+	int failed = 0;
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	
+	printf("%-22s %9s %9s %9s %9s %9s %9s\n", "link", "min pps", "max pps", "avg pps", "got pps", "rtt ms", "loss %");
+	for(unsigned s=0; s<sizeof(scenarios)/sizeof(scenarios[0]); s++){
+		Scenario_t* sc = &scenarios[s];
+		Link_t down, up;
+		down.delay_us = sc->delay_us;
+		down.loss = sc->loss;
+		down.capacity_pps = sc->capacity_pps;
+		down.queue_max = sc->queue_max;
+		down.next_service = 0;
+		up.delay_us = sc->delay_us;
+		up.loss = sc->loss;
+		up.capacity_pps = 0;
+		up.queue_max = 0;
+		up.next_service = 0;
+		
+		Rate_Ctrl_t rc;
+		Rate_Echo_t re;
+		rc_init(&rc, MIN_SERVER_PPS, MAX_SERVER_PPS, 0);
+		rc_echo_init(&re);
+		
+		//keys packets carry the echo back (queued here with their send time)
+		std::deque<std::pair<unsigned long long, unsigned long long> > keys;	// (delivery time, index into echoes)
+		std::deque<unsigned> echoes;
+		unsigned long long next_disp = 0, next_keys = 0;
+		double rate_min = 1e9, rate_max = 0, rate_sum = 0, rtt_sum = 0;
+		unsigned long long samples = 0, sent = 0, got = 0, rtt_samples = 0;
+		std::deque<unsigned long long> sent_at;
+		unsigned sent_base = 1;
+		
+		for(unsigned long long now=0; now<SIM_US; now+=STEP_US){
+			//host sends disp packets on the controller schedule
+			if(now >= next_disp){
+				unsigned seq = rc_next_seq(&rc);
+				sent_at.push_back(now);
+				link_send(&down, seq, now);
+				next_disp = rc_next_send(&rc, now);
+				if(now >= SETTLE_US){
+					sent++;
+				}
+			}
+			link_step(&down, now);
+			
+			//player receives disp packets
+			while(!down.flight.empty() && down.flight.front().first <= now){
+				unsigned seq = down.flight.front().second;
+				down.flight.pop_front();
+				rc_echo_record(&re, seq, (unsigned)sent_at[seq - sent_base], now);
+				if(now >= SETTLE_US){
+					got++;
+					rtt_sum += (double)(now - sent_at[seq - sent_base] + up.delay_us);
+					rtt_samples++;
+				}
+			}
+			
+			//player sends keys packets with the echo at the client rate
+			if(now >= next_keys){
+				next_keys = now + (unsigned long long)(1000000.0 / MAX_CLIENT_PPS);
+				unsigned e_seq, e_us, hold, count;
+				if(rc_echo_get(&re, now, &e_seq, &e_us, &hold, &count) == 0 && rng() >= up.loss){
+					echoes.push_back(e_seq);
+					echoes.push_back(e_us);
+					echoes.push_back(hold);
+					echoes.push_back(count);
+					keys.push_back(std::make_pair(now + up.delay_us, echoes.size() - 4));
+				}
+			}
+			
+			//host takes the echoes
+			while(!keys.empty() && keys.front().first <= now){
+				unsigned long long i = keys.front().second;
+				keys.pop_front();
+				rc_on_feedback(&rc, echoes[i], echoes[i + 1], echoes[i + 2], echoes[i + 3], now);
+			}
+			
+			if(now >= SETTLE_US && (now % 10000) == 0){
+				rate_min = (rc.rate < rate_min) ? rc.rate : rate_min;
+				rate_max = (rc.rate > rate_max) ? rc.rate : rate_max;
+				rate_sum += rc.rate;
+				samples++;
+			}
+		}
+		
+		double avg = rate_sum / samples;
+		double got_pps = (double)got * 1000000.0 / (SIM_US - SETTLE_US);
+		double rtt_ms = rtt_samples ? (rtt_sum / rtt_samples) / 1000.0 : 0;
+		double loss = sent ? 100.0 * (1.0 - ((double)got / sent)) : 0;
+		printf("%-22s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", sc->name, rate_min, rate_max, avg, got_pps, rtt_ms, loss);
+		
+		//good links keep the full rate, bottlenecks settle near capacity without a standing queue
+		if(sc->capacity_pps <= 0 && sc->loss < RC_LOSS_LOW && avg < MAX_SERVER_PPS * 0.95){
+			failed = 1;
+		}
+		if(sc->capacity_pps > 0 && (got_pps < sc->capacity_pps * 0.6 || rtt_ms > ((2.0 * sc->delay_us) + RC_QUEUE_HIGH_US * 2.0) / 1000.0)){
+			failed = 1;
+		}
+		if(sc->loss > RC_LOSS_HIGH && avg > MAX_SERVER_PPS * 0.5){
+			failed = 1;
+		}
+	}
+	
+	printf("\n%s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
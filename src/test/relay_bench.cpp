@@ -0,0 +1,281 @@
+/*
+** relay_bench.c -- forwarding rate and added latency of the relay server over loopback
+** starts a relay in process and an echo host bound to it, then
+**   1) ping pongs a keys sized packet from a join through the relay and directly to the echo host and
+**      reports the round trip percentiles of both (each relayed round trip passes the relay twice)
+**   2) keeps a window of packets in flight from several joins through the relay and reports the rate the
+**      relay forwarded, the relay thread's busy time and the rate one core of forwarding would sustain
+**
+** usage: ./relay_bench [pings] [joins] [window] [seconds]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Relay.h"
+
+#define BENCH_PORT 3946
+#define SOCK_BUF (4 << 20)
+
+Relay_Server_t rs;
+static struct sockaddr_in relay_addr;
+static unsigned int token = 0;
+static std::atomic<int> stop(0);
+
+//non-blocking loopback socket on an ephemeral port
+static SOCKET open_socket(){
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	unsigned long ul = 1;
+	int buf = SOCK_BUF;
+	ioctlsocket(s, FIONBIO, &ul);
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&buf, sizeof(buf));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&buf, sizeof(buf));
+	struct sockaddr_in a;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = 0;
+	bind(s, (struct sockaddr*)&a, sizeof(a));
+	return s;
+}
+
+//waits up to ms for the socket to be readable
+static int wait_readable(SOCKET s, int ms){
+	fd_set ready;
+	FD_ZERO(&ready);
+	FD_SET(s, &ready);
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = ms * 1000;
+	return select((int)s + 1, &ready, NULL, NULL, &tv) > 0;
+}
+
+//echo host: relayed packets go back to the join named in the trailer, direct ones straight back
+static void* echo_thread(void* input){
+	SOCKET s = *(SOCKET*)input;
+	char buf[MAX_PACKET_LEN];
+	struct sockaddr_in si_other;
+	int slen = sizeof(si_other);
+	int numbytes;
+	while(!stop){
+		if(!wait_readable(s, 10)){
+			continue;
+		}
+		while((numbytes = recvfrom(s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+			if(si_other.sin_port == relay_addr.sin_port){
+				Relay_Trailer_t t;
+				int plain = relay_unwrap(buf, numbytes, &t);
+				if(plain == -1 || t.flags != RELAY_DATA){
+					continue;
+				}
+				struct sockaddr_in join;
+				memset((char*)&join, 0, sizeof(join));
+				join.sin_addr.S_un.S_addr = t.addr;
+				join.sin_port = t.port;
+				numbytes = relay_wrap(buf, plain, token, &join, RELAY_DATA);
+				sendto(s, buf, numbytes, 0, (struct sockaddr*)&relay_addr, sizeof(relay_addr));
+			} else{
+				sendto(s, buf, numbytes, 0, (struct sockaddr*)&si_other, sizeof(si_other));
+			}
+		}
+	}
+	return NULL;
+}
+
+//one ping pong (returns the round trip in ns, 0 if the answer did not come back in time)
+static unsigned long long ping(SOCKET s, const struct sockaddr_in* to, int relayed){
+	char buf[MAX_PACKET_LEN];
+	memset(buf, 0, keys_packet_len);
+	int len = keys_packet_len;
+	if(relayed){
+		len = relay_wrap(buf, len, token, NULL, RELAY_DATA);
+	}
+	unsigned long long start = get_mono_ns();
+	sendto(s, buf, len, 0, (struct sockaddr*)to, sizeof(*to));
+	while(get_mono_ns() < start + 100000000ULL){
+		if(recvfrom(s, buf, MAX_PACKET_LEN, 0, NULL, NULL) != SOCKET_ERROR){
+			return get_mono_ns() - start;
+		}
+		wait_readable(s, 1);
+	}
+	return 0;
+}
+
+//join keeping a window of packets in flight through the relay
+typedef struct Blast {
+	pthread_t thread;
+	int window;
+	unsigned long long echoed;
+} Blast_t;
+
+static void* blast_thread(void* input){
+	Blast_t* b = (Blast_t*) input;
+	SOCKET s = open_socket();
+	char buf[MAX_PACKET_LEN];
+	memset(buf, 0, keys_packet_len);
+	int len = relay_wrap(buf, keys_packet_len, token, NULL, RELAY_DATA);
+	for(int i=0; i<b->window; i++){
+		sendto(s, buf, len, 0, (struct sockaddr*)&relay_addr, sizeof(relay_addr));
+	}
+	unsigned long long last_recv = get_mono_ms();
+	while(!stop){
+		int got = 0;
+		while(recvfrom(s, buf + MAX_PACKET_LEN / 2, MAX_PACKET_LEN / 2, 0, NULL, NULL) != SOCKET_ERROR){
+			sendto(s, buf, len, 0, (struct sockaddr*)&relay_addr, sizeof(relay_addr));
+			(b->echoed)++;
+			got++;
+		}
+		if(got){
+			last_recv = get_mono_ms();
+		} else if(get_mono_ms() > last_recv + 50){
+			//refill the window if packets were lost
+			for(int i=0; i<b->window; i++){
+				sendto(s, buf, len, 0, (struct sockaddr*)&relay_addr, sizeof(relay_addr));
+			}
+			last_recv = get_mono_ms();
+		} else{
+			wait_readable(s, 1);
+		}
+	}
+	closesocket(s);
+	return NULL;
+}
+
+//prints the percentiles of a set of round trips (in us)
+static void print_rtt(const char* name, std::vector<unsigned long long>& rtt){
+	std::sort(rtt.begin(), rtt.end());
+	if(rtt.size() == 0){
+		printf("%-8s no answers\n", name);
+		return;
+	}
+	printf("%-8s p50 %7.1f us  p90 %7.1f us  p99 %7.1f us  (%u answered)\n", name, rtt[rtt.size() / 2] / 1000.0,
+			rtt[(rtt.size() * 9) / 10] / 1000.0, rtt[(rtt.size() * 99) / 100] / 1000.0, (unsigned)rtt.size());
+}
+
+int main(int argc, char *argv[]){
+	int pings = 20000;
+	int joins = 4;
+	int window = 32;
+	double run_s = 3.0;
+	
+	//check arguments
+	if(argc > 5){
+		fprintf(stderr,"usage: %s [pings] [joins] [window] [seconds]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		pings = atoi(argv[1]);
+	}
+	if(argc > 2){
+		joins = atoi(argv[2]);
+	}
+	if(argc > 3){
+		window = atoi(argv[3]);
+	}
+	if(argc > 4){
+		run_s = atof(argv[4]);
+	}
+	if(pings < 1 || joins < 1 || window < 1 || run_s <= 0){
+		fprintf(stderr,"usage: %s [pings] [joins] [window] [seconds]\n", argv[0]);
+		exit(1);
+	}
+	
+	if(relay_init(&rs, BENCH_PORT) != 0){
+		fprintf(stderr, "relay init failed\n");
+		exit(1);
+	}
+	memset((char*)&relay_addr, 0, sizeof(relay_addr));
+	relay_addr.sin_family = AF_INET;
+	relay_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	relay_addr.sin_port = htons(BENCH_PORT);
+	
+	//echo host binds to the relay for its token
+	SOCKET host = open_socket();
+	char buf[MAX_PACKET_LEN];
+	for(int tries=0; tries<LOBBY_TRIES && token == 0; tries++){
+		int len = relay_wrap(buf, 0, 0, NULL, RELAY_BIND);
+		sendto(host, buf, len, 0, (struct sockaddr*)&relay_addr, sizeof(relay_addr));
+		if(wait_readable(host, REQ_TIMEOUT)){
+			Relay_Trailer_t t;
+			int bytes = recvfrom(host, buf, MAX_PACKET_LEN, 0, NULL, NULL);
+			if(relay_unwrap(buf, bytes, &t) == 0 && t.flags == RELAY_BIND){
+				token = t.token;
+			}
+		}
+	}
+	if(token == 0){
+		fprintf(stderr, "no token from the relay\n");
+		exit(1);
+	}
+	struct sockaddr_in host_addr;
+	int hlen = sizeof(host_addr);
+	getsockname(host, (struct sockaddr*)&host_addr, &hlen);
+	host_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	pthread_t echo_tid;
+	pthread_create(&echo_tid, NULL, echo_thread, (void*)&host);
+	
+	//latency: alternate relayed and direct pings so both see the same machine load
+	printf("token %u, %d pings of %u bytes\n", token, pings, keys_packet_len);
+	SOCKET join = open_socket();
+	std::vector<unsigned long long> relayed, direct;
+	for(int i=0; i<pings; i++){
+		unsigned long long r = ping(join, &relay_addr, 1);
+		unsigned long long d = ping(join, &host_addr, 0);
+		if(r){
+			relayed.push_back(r);
+		}
+		if(d){
+			direct.push_back(d);
+		}
+	}
+	closesocket(join);
+	double relayed_p50 = 0, direct_p50 = 0, relayed_p99 = 0, direct_p99 = 0;
+	print_rtt("relayed", relayed);
+	print_rtt("direct", direct);
+	if(relayed.size() > 0 && direct.size() > 0){
+		relayed_p50 = relayed[relayed.size() / 2] / 1000.0;
+		direct_p50 = direct[direct.size() / 2] / 1000.0;
+		relayed_p99 = relayed[(relayed.size() * 99) / 100] / 1000.0;
+		direct_p99 = direct[(direct.size() * 99) / 100] / 1000.0;
+		printf("added by the relay: %.1f us per pass at p50, %.1f us at p99 (round trip difference / 2)\n",
+				(relayed_p50 - direct_p50) / 2.0, (relayed_p99 - direct_p99) / 2.0);
+	}
+	
+	//throughput
+	unsigned long long fwd0 = rs.forwarded, busy0 = rs.busy_ns, batch0 = rs.batches, drop0 = rs.dropped;
+	unsigned long long t0 = get_mono_ns();
+	std::vector<Blast_t> blasts(joins);
+	for(int i=0; i<joins; i++){
+		blasts[i].window = window;
+		blasts[i].echoed = 0;
+		pthread_create(&(blasts[i].thread), NULL, blast_thread, (void*)&(blasts[i]));
+	}
+	Sleep((DWORD)(run_s * 1000.0));
+	unsigned long long fwd = rs.forwarded - fwd0, busy = rs.busy_ns - busy0, batches = rs.batches - batch0;
+	double wall_s = (double)(get_mono_ns() - t0) / 1e9;
+	stop = 1;
+	for(int i=0; i<joins; i++){
+		pthread_join(blasts[i].thread, NULL);
+	}
+	pthread_join(echo_tid, NULL);
+	
+	printf("%d joins, window %d: %.0f pkt/s forwarded, relay busy %.1f%%, %.1f datagrams per batch, %llu dropped\n", joins, window,
+			(double)fwd / wall_s, (double)busy / (wall_s * 1e7), batches ? (double)fwd / batches : 0.0, rs.dropped - drop0);
+	if(busy > 0){
+		printf("one core of forwarding: about %.0f pkt/s (%.2f us per datagram)\n", (double)fwd * 1e9 / busy, (double)busy / 1000.0 / fwd);
+	}
+	
+	closesocket(host);
+	relay_quit(&rs);
+	return 0;
+}
@@ -0,0 +1,74 @@
+/*
+** relay_server.c -- forwards datagrams between hosts and joins that cannot reach each other directly
+** prints the forwarded and dropped counts every few seconds
+**
+** usage: ./relay_server [-p port]
+** e.g. ./relay_server then ./MarvelHeros host -R 127.0.0.1, read the token from the host log and
+** ./MarvelHeros join 127.0.0.1:3945#token
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <string>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Relay.h"
+
+#define STATS_TIME 5000	// the time (ms) between prints
+
+Relay_Server_t rs;
+static volatile int stop = 0;
+
+//ctrl-c closes the relay before exiting
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char *argv[]){
+	unsigned short port = RELAY_PORT;
+	
+	//check arguments
+	if(argc == 3 && strcmp(argv[1], "-p") == 0){
+		port = (unsigned short)atoi(argv[2]);
+	} else if(argc != 1){
+		port = 0;
+	}
+	if(port == 0){
+		fprintf(stderr,"usage: %s [-p port]\n", argv[0]);
+		exit(1);
+	}
+	
+	if(relay_init(&rs, port) != 0){
+		fprintf(stderr, "relay_server: cannot listen on port %u\n", port);
+		exit(1);
+	}
+	signal(SIGINT, on_signal);
+	printf("relay on port %u, up to %d hosts and %d joins\n", port, RELAY_MAX_ROOMS, RELAY_MAX_PEERS);
+	
+	unsigned long long last = get_mono_ms();
+	unsigned long long last_fwd = 0, last_busy = 0;
+	while(!stop){
+		Sleep(100);
+		unsigned long long now = get_mono_ms();
+		if(now < last + STATS_TIME){
+			continue;
+		}
+		unsigned long long fwd = rs.forwarded, busy = rs.busy_ns;
+		printf("%d hosts, %d joins, %.0f pkt/s forwarded, busy %.1f%% (%llu dropped, %llu binds)\n",
+				RELAY_MAX_ROOMS - rs.free_room_count, RELAY_MAX_PEERS - rs.free_peer_count,
+				(double)(fwd - last_fwd) * 1000.0 / (now - last), (double)(busy - last_busy) / ((now - last) * 10000.0), rs.dropped, rs.binds);
+		last_fwd = fwd;
+		last_busy = busy;
+		last = now;
+	}
+	
+	relay_quit(&rs);
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+** replay.c -- feeds a recorded session (host or join, see the -r option of the game) back through the packet
+** handlers with no socket, either at the recorded pace or as fast as possible, and reports what the handlers did
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/HostConnect.h"
+#include "../inc/JoinConnect.h"
+
+Conn_Info_t conn;
+
+int main(int argc, char *argv[]){
+	Rec_Reader_t rd;
+	const Rec_Entry_t* entry;
+	char buf[MAX_PACKET_LEN];
+	unsigned long long in = 0, out = 0, drop = 0, ok = 0, failed = 0;
+	unsigned long long handle_ns = 0;
+	
+	//check arguments
+	if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "fast") != 0)) {
+		fprintf(stderr,"usage: %s recording [fast]\n", argv[0]);
+		exit(1);
+	}
+	int fast = (argc == 3);
+	
+	if(rec_load(&rd, argv[1]) == -1){
+		fprintf(stderr, "replay: cannot load %s\n", argv[1]);
+		exit(1);
+	}
+	if(rd.role != REC_HOST && rd.role != REC_JOIN){
+		fprintf(stderr, "replay: unknown role '%c'\n", rd.role);
+		rec_unload(&rd);
+		exit(1);
+	}
+	
+	//the recording holds plain datagrams, replay mode skips the open and seal steps (and the sends)
+	//while the encryption flag keeps the handlers checking the encrypted packet layouts
+	conn.crypt.enabled = rd.crypt;
+	conn.replay = 1;
+	memset((char*)&(conn.server), 0, sizeof(conn.server));
+	if((rd.role == REC_HOST ? host_init_state(&conn) : join_init_state(&conn)) == -1){
+		fprintf(stderr, "replay: state setup failed\n");
+		rec_unload(&rd);
+		exit(1);
+	}
+	
+	//a joining player learns its number and the host address from the join ack
+	int joined = (rd.role == REC_HOST);
+	unsigned long long start = get_mono_ns();
+	while((entry = rec_next(&rd)) != NULL){
+		if(!fast){
+			//hold each datagram until its recorded time, turning the host timers meanwhile
+			while(get_mono_ns() - start < entry->time_ns){
+				if(rd.role == REC_HOST){
+					tw_advance(&(conn.wheel), get_mono_ms());
+				}
+				usleep(100);
+			}
+		}
+		
+		if(entry->dir == REC_OUT){
+			out++;
+			continue;
+		} else if(entry->dir == REC_DROP){
+			drop++;
+			continue;
+		} else if(entry->dir != REC_IN || entry->len > MAX_PACKET_LEN){
+			failed++;
+			continue;
+		}
+		in++;
+		
+		struct sockaddr_in si_other;
+		memset((char*)&si_other, 0, sizeof(si_other));
+		si_other.sin_family = AF_INET;
+		si_other.sin_addr.S_un.S_addr = entry->addr;
+		si_other.sin_port = entry->port;
+		memcpy(buf, (const char*)(entry + 1), entry->len);
+		
+		if(!joined){
+			//the cookie answer to the first join request is not a handler call either
+			if(entry->len >= PACKET_HEAD_LEN && (((Header_t*)buf)->flags & PF_COOKIE) == PF_COOKIE){
+				continue;
+			}
+			if(entry->len >= PACKET_HEAD_LEN && (((Header_t*)buf)->flags & (PF_JOIN | PF_ACK)) == (PF_JOIN | PF_ACK)
+					&& (((Header_t*)buf)->flags & PF_DENY) != PF_DENY){
+				conn.self_player_num = ((Header_t*)buf)->player_id;
+				conn.session_id = ((Header_t*)buf)->session_id;
+				conn.server = si_other;
+				joined = 1;
+				ok++;
+			} else{
+				failed++;
+			}
+			continue;
+		}
+		
+		//time only the handler (the copy above stands in for the recv)
+		unsigned long long t0 = get_mono_ns();
+		int ret = (rd.role == REC_HOST) ? host_pkt_handle(&conn, entry->len, buf, &si_other) : join_pkt_handle(&conn, entry->len, buf, &si_other);
+		handle_ns += get_mono_ns() - t0;
+		if(ret == -1){
+			failed++;
+		} else{
+			ok++;
+		}
+	}
+	rec_unload(&rd);
+	
+	printf("%s recording, %s\n", (rd.role == REC_HOST) ? "host" : "join", fast ? "fast" : "recorded pace");
+	printf("in %llu, out %llu, dropped %llu\n", in, out, drop);
+	printf("handled %llu, rejected %llu, %.0f ns per handler call\n", ok, failed, (ok + failed) ? (double)handle_ns / (ok + failed) : 0.0);
+	if(rd.role == REC_JOIN){
+		printf("self player %d\n", (int)conn.self_player_num);
+	}
+	float x[MAX_PLAYER], y[MAX_PLAYER];
+	unsigned char alive[MAX_PLAYER];
+	ps_gather(conn.store.pos, conn.store.in_use, MAX_PLAYER, x, y, alive);
+	for(int i=0; i<MAX_PLAYER; i++){
+		if(alive[i]){
+			printf("player %d at (%.3f, %.3f)\n", i, x[i], y[i]);
+		}
+	}
+	return 0;
+}
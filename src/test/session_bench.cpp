@@ -0,0 +1,294 @@
+/*
+** session_bench.c -- sessions per core of the session server at a fixed tick rate
+** fills games of 7 players, each player sending keys at KEYS_HZ (echoing its newest disp so the host rate
+** control runs as it would on a real link) while the host sends disp at up to MAX_SERVER_PPS per player;
+** reports worker busy time per game, the games one core could hold and the disp rate players actually got,
+** then checks a game can be opened while another one's close is still waiting on a player's quit ack
+**
+** the keys are handed to the demux (ss_route) directly from fake player addresses 127.p.x.y, the server's
+** disp packets go out through its socket to a sink on SINK_PORT that records them for the echoes
+**
+** usage: ./session_bench [workers] [seconds per step]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/SessionServer.h"
+
+#define BENCH_PORT 3960
+#define SINK_PORT 3961
+#define KEYS_HZ 60
+#define WARM_MS 1000
+#define SINK_BUF (8 << 20)
+
+Session_Server_t ss;
+static Rate_Echo_t echoes[MAX_SESSIONS + 1][MAX_PLAYER];
+static std::atomic<int> sink_stop(0);
+static std::atomic<unsigned long long> disp_count(0);
+
+//fake address of player p of game s (every player lands on the sink port)
+static struct sockaddr_in player_addr(int s, int p){
+	struct sockaddr_in a;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.S_un.S_addr = htonl((127u << 24) | ((unsigned)p << 16) | ((unsigned)s & 0xFFFF));
+	a.sin_port = htons(SINK_PORT);
+	return a;
+}
+
+//records every disp packet for the echo of the player it was sent to
+static void* sink_thread(void* input){
+	SOCKET s = *(SOCKET*)input;
+	char buf[MAX_PACKET_LEN];
+	struct sockaddr_in si_other;
+	int slen = sizeof(si_other);
+	int numbytes;
+	while(!sink_stop){
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(s, &ready);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 10000;
+		select((int)s + 1, &ready, NULL, NULL, &tv);
+		while((numbytes = recvfrom(s, buf, MAX_PACKET_LEN, 0, (struct sockaddr*)&si_other, &slen)) != SOCKET_ERROR){
+			Disp_Packet_t* d = (Disp_Packet_t*)buf;
+			if(numbytes == (int)disp_packet_len && (d->head.flags & PF_DISP) == PF_DISP && d->head.session_id <= MAX_SESSIONS
+					&& d->head.player_id > 0 && d->head.player_id < MAX_PLAYER){
+				rc_echo_record(&(echoes[d->head.session_id][(int)d->head.player_id]), d->seq, d->send_us, get_mono_ns() / 1000);
+				disp_count++;
+			}
+		}
+	}
+	return NULL;
+}
+
+//hands one header only packet (join or quit) from a player to the demux (a join carries the cookie the
+//session would have answered the player's first request with)
+static void send_head(int s, int p, char flags){
+	char buf[MAX_PACKET_LEN];
+	int len = PACKET_HEAD_LEN;
+	memset(buf, 0, MAX_PACKET_LEN);
+	((Header_t*)buf)->flags = flags;
+	((Header_t*)buf)->player_id = (flags == PF_JOIN) ? (char)0xFF : (char)p;
+	((Header_t*)buf)->session_id = (unsigned short)s;
+	struct sockaddr_in a = player_addr(s, p);
+	if(flags == PF_JOIN){
+		Cookie_t c;
+		ck_mint(&(ss.sessions[s]->cookie), &a, (unsigned int)get_mono_ms(), &c);
+		memcpy(buf + len, &c, COOKIE_LEN);
+		len += COOKIE_LEN;
+	}
+	int w = ss_route(&ss, buf, len, &a);
+	if(w != -1){
+		ss_wake(&(ss.workers[w]));
+	}
+}
+
+//closes a game from its own thread (the close waits on the quit acks)
+static void* closer_thread(void* input){
+	int id = *(int*)input;
+	*(int*)input = ss_close_session(&ss, id);
+	return NULL;
+}
+
+int main(int argc, char *argv[]){
+	//ids are handed out round robin so the steps together stay under MAX_SESSIONS and no echo is reused
+	int steps[] = {10, 25, 50, 100, 200, 400};
+	int workers = 1;
+	double step_s = 3.0;
+	double held = 0;
+	
+	//check arguments
+	if(argc > 3){
+		fprintf(stderr,"usage: %s [workers] [seconds per step]\n", argv[0]);
+		exit(1);
+	}
+	if(argc > 1){
+		workers = atoi(argv[1]);
+	}
+	if(argc > 2){
+		step_s = atof(argv[2]);
+	}
+	if(workers < 1 || step_s <= 0){
+		fprintf(stderr,"usage: %s [workers] [seconds per step]\n", argv[0]);
+		exit(1);
+	}
+	
+	//sink socket for everything the server sends
+	SOCKET sink = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	unsigned long ul = 1;
+	int rcvbuf = SINK_BUF;
+	ioctlsocket(sink, FIONBIO, &ul);
+	setsockopt(sink, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf));
+	struct sockaddr_in sink_addr;
+	memset((char*)&sink_addr, 0, sizeof(sink_addr));
+	sink_addr.sin_family = AF_INET;
+	sink_addr.sin_addr.s_addr = INADDR_ANY;
+	sink_addr.sin_port = htons(SINK_PORT);
+	if(bind(sink, (struct sockaddr*)&sink_addr, sizeof(sink_addr)) == SOCKET_ERROR){
+		fprintf(stderr, "sink bind failed\n");
+		exit(1);
+	}
+	for(int s=0; s<=MAX_SESSIONS; s++){
+		for(int p=0; p<MAX_PLAYER; p++){
+			rc_echo_init(&(echoes[s][p]));
+		}
+	}
+	pthread_t sink_tid;
+	pthread_create(&sink_tid, NULL, sink_thread, (void*)&sink);
+	
+	if(ss_init(&ss, BENCH_PORT, MAX_SESSIONS, workers) != 0){
+		fprintf(stderr, "server init failed\n");
+		exit(1);
+	}
+	
+	printf("%d workers, %d players per game, keys at %d Hz, disp up to %d pps per player, %.1f s per step\n",
+			workers, MAX_PLAYER - 1, KEYS_HZ, (int)MAX_SERVER_PPS, step_s);
+	printf("%8s %10s %10s %14s %14s %14s\n", "games", "keys/s", "busy %", "us per game/s", "games / core", "disp pps/plr");
+	for(unsigned k=0; k<sizeof(steps)/sizeof(steps[0]); k++){
+		int games = steps[k];
+		if(games > MAX_SESSIONS){
+			break;
+		}
+		
+		//open the games and join every player (slots fill from 1 in order)
+		std::vector<int> ids;
+		for(int g=0; g<games; g++){
+			int id = ss_open_session(&ss);
+			if(id == -1){
+				fprintf(stderr, "session not opened\n");
+				exit(1);
+			}
+			ids.push_back(id);
+			for(int p=1; p<MAX_PLAYER; p++){
+				send_head(id, p, PF_JOIN);
+				Sleep(0);
+			}
+		}
+		Sleep(200);
+		int joined = 0;
+		for(int g=0; g<games; g++){
+			joined += ss_session_players(&ss, ids[g]);
+		}
+		if(joined != games * (MAX_PLAYER - 1)){
+			fprintf(stderr, "only %d of %d players joined\n", joined, games * (MAX_PLAYER - 1));
+		}
+		
+		//keys from every player at a fixed rate, spread evenly over each period
+		int players = games * (MAX_PLAYER - 1);
+		unsigned long long period_us = 1000000ULL / KEYS_HZ;
+		unsigned long long start_us = get_mono_ns() / 1000;
+		unsigned long long measure_us = start_us + (WARM_MS * 1000ULL);
+		unsigned long long end_us = measure_us + (unsigned long long)(step_s * 1000000.0);
+		unsigned long long sent = 0;
+		unsigned long long busy0 = 0, disp0 = 0, keys0 = 0, t0 = 0;
+		int measuring = 0;
+		while(1){
+			unsigned long long now_us = get_mono_ns() / 1000;
+			if(!measuring && now_us >= measure_us){
+				measuring = 1;
+				for(int i=0; i<workers; i++){
+					busy0 += ss.workers[i].busy_ns;
+				}
+				disp0 = disp_count;
+				keys0 = sent;
+				t0 = now_us;
+			}
+			if(now_us >= end_us){
+				break;
+			}
+			
+			//every player due by now (player i is due at start + i * period / players + n * period)
+			unsigned long long due = ((now_us - start_us) * players) / period_us;
+			int touched = 0;
+			while(sent < due){
+				int i = (int)(sent % players);
+				int g = ids[i / (MAX_PLAYER - 1)];
+				int p = (i % (MAX_PLAYER - 1)) + 1;
+				char buf[MAX_PACKET_LEN];
+				memset(buf, 0, keys_packet_len);
+				Keys_Packet_t* keys = (Keys_Packet_t*)buf;
+				keys->head.flags = PF_KEYS;
+				keys->head.player_id = (char)p;
+				keys->head.session_id = (unsigned short)g;
+				keys->px_loc = (float)p / MAX_PLAYER;
+				keys->py_loc = (float)(sent % 100) / 100.0f;
+				rc_echo_get(&(echoes[g][p]), now_us, &(keys->echo_seq), &(keys->echo_us), &(keys->echo_hold), &(keys->recv_count));
+				struct sockaddr_in a = player_addr(g, p);
+				int w = ss_route(&ss, buf, keys_packet_len, &a);
+				if(w != -1){
+					touched |= 1 << (w & 31);
+				}
+				sent++;
+			}
+			for(int i=0; i<workers && touched; i++){
+				if(touched & (1 << (i & 31))){
+					ss_wake(&(ss.workers[i]));
+				}
+			}
+			Sleep(1);
+		}
+		unsigned long long busy1 = 0;
+		for(int i=0; i<workers; i++){
+			busy1 += ss.workers[i].busy_ns;
+		}
+		double wall_s = (double)((get_mono_ns() / 1000) - t0) / 1e6;
+		double busy_frac = (double)(busy1 - busy0) / (wall_s * 1e9);
+		double us_per_game = ((double)(busy1 - busy0) / 1000.0) / wall_s / games;
+		//a step counts if every player still got (nearly) the full disp rate
+		double disp_pps = (double)(disp_count - disp0) / wall_s / players;
+		if(disp_pps >= 0.95 * MAX_SERVER_PPS && us_per_game > 0){
+			held = 1e6 / us_per_game;
+		}
+		printf("%8d %10.0f %10.1f %14.1f %14.0f %14.1f\n", games, (double)(sent - keys0) / wall_s, busy_frac * 100.0,
+				us_per_game, (us_per_game > 0) ? 1e6 / us_per_game : 0.0, disp_pps);
+		
+		//players quit (so closing does not wait on quit retransmits) then the games close
+		for(int g=0; g<games; g++){
+			for(int p=1; p<MAX_PLAYER; p++){
+				send_head(ids[g], p, PF_QUIT);
+			}
+			Sleep(0);
+		}
+		Sleep(200);
+		for(int g=0; g<games; g++){
+			ss_close_session(&ss, ids[g]);
+		}
+	}
+	printf("\nabout %.0f games per core at the full disp rate (busy time of the last step that kept it)\n", held);
+	printf("datagrams routed %llu, dropped for no game %llu, dropped for a full queue %llu\n", ss.received, ss.no_session, ss.queue_full);
+	
+	//close a game whose player has not acked its quit yet, open and count another meanwhile, then ack
+	int slow = ss_open_session(&ss);
+	send_head(slow, 1, PF_JOIN);
+	Sleep(100);
+	int close_ret = slow;
+	pthread_t closer;
+	pthread_create(&closer, NULL, closer_thread, (void*)&close_ret);
+	Sleep(100);
+	unsigned long long open_ns = get_mono_ns();
+	int other = ss_open_session(&ss);
+	int other_players = ss_session_players(&ss, other);
+	open_ns = get_mono_ns() - open_ns;
+	send_head(slow, 1, PF_QUIT);
+	pthread_join(closer, NULL);
+	int open_ok = (other != -1 && other_players == 0 && close_ret == 0 && open_ns < 50000000ULL);
+	printf("open during a close waiting on acks: %s (%.2f ms, close returned %d)\n", open_ok ? "ok" : "FAILED", open_ns / 1e6, close_ret);
+	ss_close_session(&ss, other);
+	
+	ss_quit(&ss);
+	sink_stop = 1;
+	pthread_join(sink_tid, NULL);
+	closesocket(sink);
+	return open_ok ? 0 : 1;
+}
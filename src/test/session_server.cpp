@@ -0,0 +1,132 @@
+/*
+** session_server.c -- dedicated server holding many independent games behind one port
+** opens the requested number of games, prints their ids and then the per worker load every few seconds
+**
+** usage: ./session_server [sessions] [workers] [-p port] [-k key_file] [-l lobby[:port]] [-t seconds]
+** e.g. ./session_server 200 4 then ./MarvelHeros join 127.0.0.1:3940/17 to play in game 17
+** (with -l every game is listed on the lobby, so ./MarvelHeros join @lobby finds an open one)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <thread>
+#include <string>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/SessionServer.h"
+#include "../inc/Lobby.h"
+
+#define STATS_TIME 5000	// the time (ms) between load prints
+
+Session_Server_t ss;
+static volatile int stop = 0;
+
+//ctrl-c quits every game before exiting
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char *argv[]){
+	int sessions = 16;
+	int workers = (int)std::thread::hardware_concurrency();
+	unsigned short port = SERVER_PORT;
+	double run_s = 0;
+	std::vector<std::string> args;
+	
+	//check arguments
+	for(int i=1; i<argc; i++){
+		std::string arg = argv[i];
+		if((arg == "-p" || arg == "-k" || arg == "-l" || arg == "-t") && i + 1 >= argc){
+			fprintf(stderr, "session_server: %s needs a value\n", argv[i]);
+			exit(1);
+		}
+		if(arg == "-p"){
+			port = (unsigned short)atoi(argv[++i]);
+		} else if(arg == "-k"){
+			if(crypt_load_psk(&(ss.crypt), argv[++i]) == -1){
+				fprintf(stderr, "session_server: key file must hold 32 hex characters\n");
+				exit(1);
+			}
+		} else if(arg == "-l"){
+			if(lobby_addr(argv[++i], &(ss.lobby)) == -1){
+				fprintf(stderr, "session_server: improper lobby address %s\n", argv[i]);
+				exit(1);
+			}
+			ss.use_lobby = 1;
+		} else if(arg == "-t"){
+			run_s = atof(argv[++i]);
+		} else{
+			args.push_back(arg);
+		}
+	}
+	if(args.size() > 2 || port == 0){
+		fprintf(stderr,"usage: %s [sessions] [workers] [-p port] [-k key_file] [-l lobby[:port]] [-t seconds]\n", argv[0]);
+		exit(1);
+	}
+	if(args.size() > 0){
+		sessions = atoi(args[0].c_str());
+	}
+	if(args.size() > 1){
+		workers = atoi(args[1].c_str());
+	}
+	if(workers < 1){
+		workers = 1;
+	}
+	if(sessions < 1 || sessions > MAX_SESSIONS){
+		fprintf(stderr, "session_server: between 1 and %d sessions\n", MAX_SESSIONS);
+		exit(1);
+	}
+	
+	if(ss_init(&ss, port, sessions, workers) != 0){
+		fprintf(stderr, "session_server: cannot listen on port %u (see log/*.err)\n", port);
+		exit(1);
+	}
+	for(int i=0; i<sessions; i++){
+		if(ss_open_session(&ss) == -1){
+			fprintf(stderr, "session_server: game %d not opened\n", i + 1);
+		}
+	}
+	signal(SIGINT, on_signal);
+	printf("%d games (ids 1 to %d) on port %u, %d workers%s\n", sessions, sessions, port, workers, ss.crypt.enabled ? ", encrypted" : "");
+	
+	//print the load of each worker until told to stop
+	unsigned long long start = get_mono_ms();
+	unsigned long long last = start;
+	std::vector<unsigned long long> last_busy(workers, 0), last_handled(workers, 0);
+	while(!stop && (run_s <= 0 || get_mono_ms() < start + (unsigned long long)(run_s * 1000.0))){
+		Sleep(100);
+		unsigned long long now = get_mono_ms();
+		if(now < last + STATS_TIME){
+			continue;
+		}
+		int players = 0;
+		for(int i=1; i<=sessions; i++){
+			int n = ss_session_players(&ss, i);
+			players += (n > 0) ? n : 0;
+		}
+		printf("%6.1f s: %d players, %llu datagrams (%llu for no game, %llu queue full)\n", (now - start) / 1000.0, players,
+				ss.received, ss.no_session, ss.queue_full);
+		for(int i=0; i<workers; i++){
+			Session_Worker_t* w = &(ss.workers[i]);
+			pthread_mutex_lock(&(w->lock));
+			unsigned games = (unsigned)w->sessions.size();
+			pthread_mutex_unlock(&(w->lock));
+			printf("  worker %d: %3u games, %8.0f pkt/s, busy %5.1f%%\n", i, games,
+					(double)(w->handled - last_handled[i]) * 1000.0 / (now - last), (double)(w->busy_ns - last_busy[i]) / ((now - last) * 10000.0));
+			last_handled[i] = w->handled;
+			last_busy[i] = w->busy_ns;
+		}
+		last = now;
+	}
+	
+	printf("quitting every game\n");
+	ss_quit(&ss);
+	return 0;
+}
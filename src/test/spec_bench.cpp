@@ -0,0 +1,225 @@
+/*
+** spec_bench.c -- host egress and spectator join time with a spectator node tree over loopback
+** starts a host sending its spectator stream to a root node, leaf nodes subscribed to the root and spectator
+** sockets spread over the leaves, then adds the spectators in waves. For each wave it reports what the host
+** sent (which should not move with the spectator count), what the nodes sent, how long the new spectators
+** took from subscribing to showing a frame (the node cache makes it two round trips, the cookie and then the
+** cached frames, not the wait for the next keyframe) and the share of the host's frames the spectators showed (new spectators also show the cached
+** keyframe and delta they join on, so a wave with joins can pass 100%). Last it checks a subscribe without a
+** cookie is answered with no more than it sent and no frames
+**
+** usage: ./spec_bench [spectators] [leaf nodes] [seconds per wave] (defaults to 2000, 4 and 3, 0 leaves
+** puts every spectator on the root)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+#include "../inc/HostConnect.h"
+#include "../inc/Spectate.h"
+
+#define BENCH_PORT 3956			// root node port (leaves take the ports after it)
+#define MAX_LEAVES 64
+#define WAVES 3
+#define SOCK_BUF (1 << 20)
+
+typedef struct Spectator {
+	SOCKET s;
+	struct sockaddr_in node;
+	Spec_View_t view;
+	Cookie_t cookie;
+	unsigned long long sub_ns, next_sub;
+	int shown;
+} Spectator_t;
+
+Conn_Info_t conn;
+HostConnect hc;
+Spec_Node_t root;
+Spec_Node_t leaves[MAX_LEAVES];
+static std::atomic<int> stop(0);
+
+//non-blocking loopback socket on an ephemeral port
+static SOCKET open_socket(){
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	unsigned long ul = 1;
+	int buf = SOCK_BUF;
+	ioctlsocket(s, FIONBIO, &ul);
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&buf, sizeof(buf));
+	struct sockaddr_in a;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = 0;
+	bind(s, (struct sockaddr*)&a, sizeof(a));
+	return s;
+}
+
+static struct sockaddr_in loopback(unsigned short port){
+	struct sockaddr_in a;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = htons(port);
+	return a;
+}
+
+//moves the host player in a circle so the stream has deltas to carry
+static void* mover(void*){
+	while(!stop){
+		double t = get_mono_ms() / 1000.0;
+		ps_post(&(conn.store.pos[0]), (float)(0.5 * cos(t)), (float)(0.5 * sin(t)));
+		Sleep(5);
+	}
+	return NULL;
+}
+
+//subscribes every spectator that is due, reads everything waiting on every socket
+static void poll_spectators(std::vector<Spectator_t>& specs, int count, Latency_Hist_t* join){
+	char buf[MAX_PACKET_LEN];
+	unsigned long long now = get_mono_ms();
+	for(int i=0; i<count; i++){
+		Spectator_t* sp = &(specs[i]);
+		if(now >= sp->next_sub){
+			int len = spec_sub_message(buf, SPEC_SUB, sp->view.key, &(sp->cookie));
+			sendto(sp->s, buf, len, 0, (struct sockaddr*)&(sp->node), sizeof(sp->node));
+			if(sp->sub_ns == 0){
+				sp->sub_ns = get_mono_ns();
+			}
+			sp->next_sub = now + (sp->shown ? SPEC_BEAT : REQ_TIMEOUT);
+		}
+		int len;
+		while((len = recvfrom(sp->s, buf, MAX_PACKET_LEN, 0, NULL, NULL)) != SOCKET_ERROR){
+			//a cookie is sent straight back
+			if(len == (int)spec_sub_len && ((Spec_Frame_t*)buf)->flags == SPEC_COOKIE){
+				memcpy(&(sp->cookie), buf + spec_head_len, COOKIE_LEN);
+				sp->next_sub = 0;
+			} else if(spec_apply(&(sp->view), buf, len) == 1 && !sp->shown){
+				sp->shown = 1;
+				lh_record(join, get_mono_ns() - sp->sub_ns);
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[]){
+	int count = 2000, leaf_count = 4, seconds = 3;
+	if(argc > 4 || (argc > 1 && (count = atoi(argv[1])) < 1) || (argc > 2 && ((leaf_count = atoi(argv[2])) < 0 || leaf_count > MAX_LEAVES))
+			|| (argc > 3 && (seconds = atoi(argv[3])) < 1)){
+		fprintf(stderr,"usage: %s [spectators] [leaf nodes (0 to %d)] [seconds per wave]\n", argv[0], MAX_LEAVES);
+		exit(1);
+	}
+	
+	//host streaming to the root, leaves under the root
+	struct sockaddr_in host_addr = loopback(SERVER_PORT);
+	if(spec_node_init(&root, BENCH_PORT, &host_addr, 0) != 0){
+		fprintf(stderr, "spec_bench: root node cannot listen on port %d\n", BENCH_PORT);
+		exit(1);
+	}
+	struct sockaddr_in root_addr = loopback(BENCH_PORT);
+	for(int l=0; l<leaf_count; l++){
+		if(spec_node_init(&(leaves[l]), BENCH_PORT + 1 + l, &root_addr, 1) != 0){
+			fprintf(stderr, "spec_bench: leaf node cannot listen on port %d\n", BENCH_PORT + 1 + l);
+			exit(1);
+		}
+	}
+	conn.use_spec = 1;
+	conn.spec = root_addr;
+	if(hc.init_host(&conn) != 0){
+		fprintf(stderr, "spec_bench: host not started\n");
+		exit(1);
+	}
+	pthread_t move_thread;
+	pthread_create(&move_thread, NULL, mover, NULL);
+	
+	std::vector<Spectator_t> specs(count);
+	for(int i=0; i<count; i++){
+		specs[i].s = open_socket();
+		specs[i].node = (leaf_count > 0) ? loopback(BENCH_PORT + 1 + (i % leaf_count)) : root_addr;
+		spec_view_init(&(specs[i].view));
+		memset((char*)&(specs[i].cookie), 0, sizeof(specs[i].cookie));
+		specs[i].sub_ns = 0;
+		specs[i].next_sub = 0;
+		specs[i].shown = 0;
+	}
+	
+	//wait for the stream to reach the leaves
+	Sleep(SPEC_DELAY + 3*SPEC_TIME);
+	printf("host streaming to the root node, %d leaf nodes, %d spectators in %d waves of %d s\n", leaf_count, count, WAVES, seconds);
+	int waves[WAVES] = {0, count / 10, count};
+	for(int w=0; w<WAVES; w++){
+		Latency_Hist_t join;
+		lh_init(&join);
+		unsigned long long frames0 = conn.feed.frames, bytes0 = conn.feed.bytes, start = get_mono_ms();
+		unsigned long long node0 = root.sent;
+		for(int l=0; l<leaf_count; l++){
+			node0 += leaves[l].sent;
+		}
+		std::vector<unsigned long long> shown0(waves[w]);
+		for(int i=0; i<waves[w]; i++){
+			shown0[i] = specs[i].view.frames;
+		}
+		
+		while(get_mono_ms() < start + seconds * 1000ULL){
+			poll_spectators(specs, waves[w], &join);
+			Sleep(1);
+		}
+		
+		double secs = (get_mono_ms() - start) / 1000.0;
+		unsigned long long frames = conn.feed.frames - frames0, node = root.sent;
+		for(int l=0; l<leaf_count; l++){
+			node += leaves[l].sent;
+		}
+		unsigned long long shown = 0;
+		for(int i=0; i<waves[w]; i++){
+			shown += specs[i].view.frames - shown0[i];
+		}
+		printf("%5d spectators: host sent %.1f frames/s (%.0f B/s), nodes sent %.0f pkt/s", waves[w], frames / secs,
+				(conn.feed.bytes - bytes0) / secs, (node - node0) / secs);
+		if(join.total > 0){
+			printf(", %llu joined in p50 %.2f ms p99 %.2f ms", join.total, lh_percentile(&join, 50.0) / 1e6, lh_percentile(&join, 99.0) / 1e6);
+		}
+		if(waves[w] > 0 && frames > 0){
+			printf(", showed %.1f%% of the frames", 100.0 * shown / ((double)frames * waves[w]));
+		}
+		printf("\n");
+	}
+	printf("root: %llu joined, %llu served from the cache, %llu cookies, %llu dropped\n", root.joins, root.cached, root.cookies, root.dropped);
+	
+	//a subscribe without a cookie (as a spoofed one would be) only gets a cookie back, never the stream
+	SOCKET bare = open_socket();
+	char buf[MAX_PACKET_LEN];
+	int sub_len = spec_sub_message(buf, SPEC_SUB, 0, NULL);
+	sendto(bare, buf, sub_len, 0, (struct sockaddr*)&root_addr, sizeof(root_addr));
+	Sleep(3*SPEC_TIME);
+	int answers = 0, larger = 0, frames = 0, len;
+	while((len = recvfrom(bare, buf, MAX_PACKET_LEN, 0, NULL, NULL)) != SOCKET_ERROR){
+		answers++;
+		larger += (len > sub_len);
+		frames += (((Spec_Frame_t*)buf)->flags != SPEC_COOKIE);
+	}
+	closesocket(bare);
+	int bare_ok = (answers == 1 && larger == 0 && frames == 0);
+	printf("subscribe without a cookie: %s (%d answers, %d larger than the subscribe, %d frames)\n", bare_ok ? "ok" : "FAILED",
+			answers, larger, frames);
+	
+	stop = 1;
+	pthread_join(move_thread, NULL);
+	for(int i=0; i<count; i++){
+		closesocket(specs[i].s);
+	}
+	hc.quit_host(&conn);
+	for(int l=0; l<leaf_count; l++){
+		spec_node_quit(&(leaves[l]));
+	}
+	spec_node_quit(&root);
+	return bare_ok ? 0 : 1;
+}
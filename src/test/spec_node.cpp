@@ -0,0 +1,84 @@
+/*
+** spec_node.c -- spectator node: fans one game's spectator stream out to spectators and child nodes
+** the root node takes the stream a host sends it (-h host address), a child node subscribes to a parent node
+** (-n parent address), so nodes stack into a tree as wide and deep as the spectators need
+** prints the subscriber and sent counts every few seconds
+**
+** usage: ./spec_node [-p port] -h host[:port] | -n node[:port]
+** e.g. ./spec_node -h 127.0.0.1 then ./MarvelHeros host -S 127.0.0.1 and ./MarvelHeros watch 127.0.0.1,
+** or under it ./spec_node -p 3956 -n 127.0.0.1 and ./MarvelHeros watch 127.0.0.1:3956
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <string>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Spectate.h"
+
+#define STATS_TIME 5000	// the time (ms) between prints
+
+Spec_Node_t sn;
+static volatile int stop = 0;
+
+//ctrl-c closes the node before exiting
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char *argv[]){
+	unsigned short port = SPEC_PORT;
+	struct sockaddr_in upstream;
+	int parent = -1;
+	
+	//check arguments
+	for(int i=1; i<argc; i++){
+		if(strcmp(argv[i], "-p") == 0 && i + 1 < argc){
+			port = (unsigned short)atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-h") == 0 && i + 1 < argc && parse_addr(argv[++i], SERVER_PORT, &upstream) == 0){
+			parent = 0;
+		} else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc && parse_addr(argv[++i], SPEC_PORT, &upstream) == 0){
+			parent = 1;
+		} else{
+			port = 0;
+		}
+	}
+	if(port == 0 || parent == -1){
+		fprintf(stderr,"usage: %s [-p port] -h host[:port] | -n node[:port]\n", argv[0]);
+		exit(1);
+	}
+	
+	if(spec_node_init(&sn, port, &upstream, parent) != 0){
+		fprintf(stderr, "spec_node: cannot listen on port %u\n", port);
+		exit(1);
+	}
+	signal(SIGINT, on_signal);
+	printf("spectator node on port %u, up to %d subscribers\n", port, SPEC_MAX_SUBS);
+	
+	unsigned long long last = get_mono_ms();
+	unsigned long long last_sent = 0, last_busy = 0;
+	while(!stop){
+		Sleep(100);
+		unsigned long long now = get_mono_ms();
+		if(now < last + STATS_TIME){
+			continue;
+		}
+		unsigned long long sent = sn.sent, busy = sn.busy_ns;
+		printf("%d subscribers, %llu frames in, %.0f pkt/s sent, busy %.1f%% (%llu joined, %llu served from the cache, %llu cookies, %llu dropped)\n",
+				sn.live_count, sn.frames, (double)(sent - last_sent) * 1000.0 / (now - last), (double)(busy - last_busy) / ((now - last) * 10000.0),
+				sn.joins, sn.cached, sn.cookies, sn.dropped);
+		last_sent = sent;
+		last_busy = busy;
+		last = now;
+	}
+	
+	spec_node_quit(&sn);
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+** store_bench.c -- player state layout costs: the per tick gather of every player's position (disp build and
+** snapshots) from the old per player structs (position beside the lock and connection info, one lock per player)
+** against the player store (one padded line per player, no locks), with the caches warm and after an eviction;
+** then the handler path, threads each writing their own player's position into neighbouring packed slots
+** (false sharing) against padded store slots
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <thread>
+#include <new>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/PlayerStore.h"
+
+#define GATHERS 2000
+#define COLD_GATHERS 200
+#define EVICT_BYTES (32 << 20)
+#define WRITES 5000000
+#define MAX_WRITERS 4
+
+//the previous player layout (hot position and flag in the same struct as the lock and connection info)
+typedef struct Old_Player {
+	pthread_mutex_t lock;
+	float px_loc;
+	float py_loc;
+	struct sockaddr_in p_addr;
+	int in_use;
+	Player_Info_t rest;
+} Old_Player_t;
+
+//positions packed side by side with no padding (neighbouring players share lines)
+typedef struct Packed_Pos {
+	std::atomic<unsigned long long> pos;
+} Packed_Pos_t;
+
+static char* evict_buf;
+static volatile unsigned long long evict_sink;
+
+//reads a buffer larger than the caches so the next gather starts cold
+static void evict(){
+	unsigned long long sum = 0;
+	for(int i=0; i<EVICT_BYTES; i+=CACHE_LINE){
+		sum += evict_buf[i];
+	}
+	evict_sink += sum;
+}
+
+static void old_gather(Old_Player_t* players, unsigned n, float* x, float* y, unsigned char* alive){
+	for(unsigned i=0; i<n; i++){
+		pthread_mutex_lock(&(players[i].lock));
+		alive[i] = (unsigned char)(players[i].in_use != 0);
+		x[i] = players[i].px_loc;
+		y[i] = players[i].py_loc;
+		pthread_mutex_unlock(&(players[i].lock));
+	}
+}
+
+typedef struct Writer {
+	int id;
+	Packed_Pos_t* packed;
+	Player_Inbox_t* padded;
+	int use_padded;
+} Writer_t;
+
+static void* writer_thread(void* input){
+	Writer_t* w = (Writer_t*) input;
+	for(int i=0; i<WRITES; i++){
+		float v = (float)i;
+		if(w->use_padded){
+			ps_post(&(w->padded[w->id]), v, v);
+		} else{
+			unsigned long long bits;
+			memcpy(&bits, &v, sizeof(v));
+			w->packed[w->id].pos.store((bits << 32) | bits, std::memory_order_release);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[]){
+	unsigned sizes[] = {8, 64, 512, 4096};
+	volatile float sink = 0;
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	evict_buf = new char[EVICT_BYTES];
+	memset(evict_buf, 1, EVICT_BYTES);
+	
+	printf("gather of every player (old struct %u bytes per player, store %u bytes per player)\n", (unsigned)sizeof(Old_Player_t), (unsigned)sizeof(Player_Inbox_t) + 1);
+	printf("%8s %14s %14s %14s %14s %12s %12s\n", "players", "old warm ns", "store warm ns", "old cold ns", "store cold ns", "old lines", "store lines");
+	for(unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		unsigned n = sizes[s];
+		Old_Player_t* old = new Old_Player_t[n];
+		//new[] of an over aligned type is not aligned before c++17, so line the store up by hand
+		char* raw = new char[(n + 1) * sizeof(Player_Inbox_t)];
+		Player_Inbox_t* pos = (Player_Inbox_t*)(((unsigned long long)raw + CACHE_LINE - 1) & ~(unsigned long long)(CACHE_LINE - 1));
+		for(unsigned i=0; i<n; i++){
+			new(&pos[i]) Player_Inbox_t();
+		}
+		std::atomic<unsigned char>* in_use = new std::atomic<unsigned char>[n];
+		for(unsigned i=0; i<n; i++){
+			pthread_mutex_init(&(old[i].lock), NULL);
+			old[i].px_loc = (float)i;
+			old[i].py_loc = (float)i;
+			old[i].in_use = 1;
+			ps_post(&pos[i], (float)i, (float)i);
+			in_use[i] = 1;
+		}
+		float* x = new float[n];
+		float* y = new float[n];
+		unsigned char* alive = new unsigned char[n];
+		
+		unsigned long long t0 = get_mono_ns();
+		for(int g=0; g<GATHERS; g++){
+			old_gather(old, n, x, y, alive);
+			sink += x[g % n];
+		}
+		unsigned long long t1 = get_mono_ns();
+		for(int g=0; g<GATHERS; g++){
+			ps_gather(pos, in_use, n, x, y, alive);
+			sink += x[g % n];
+		}
+		unsigned long long t2 = get_mono_ns();
+		
+		//cold: time only the gather after each eviction
+		unsigned long long old_cold = 0, store_cold = 0;
+		for(int g=0; g<COLD_GATHERS; g++){
+			evict();
+			unsigned long long a = get_mono_ns();
+			old_gather(old, n, x, y, alive);
+			old_cold += get_mono_ns() - a;
+			evict();
+			a = get_mono_ns();
+			ps_gather(pos, in_use, n, x, y, alive);
+			store_cold += get_mono_ns() - a;
+			sink += x[g % n];
+		}
+		
+		//lines touched per gather: old reads the lock and the position lines of each struct, the store one
+		//line per player plus the packed flags
+		unsigned long long old_lines = 0;
+		for(unsigned i=0; i<n; i++){
+			unsigned long long lock_line = (unsigned long long)&(old[i].lock) / CACHE_LINE;
+			unsigned long long end_line = ((unsigned long long)&(old[i].in_use) + sizeof(int) - 1) / CACHE_LINE;
+			old_lines += end_line - lock_line + 1;
+		}
+		unsigned long long store_lines = n + ((n + CACHE_LINE - 1) / CACHE_LINE);
+		
+		printf("%8u %14.1f %14.1f %14.1f %14.1f %12llu %12llu\n", n, (double)(t1 - t0) / GATHERS, (double)(t2 - t1) / GATHERS,
+				(double)old_cold / COLD_GATHERS, (double)store_cold / COLD_GATHERS, old_lines, store_lines);
+		
+		for(unsigned i=0; i<n; i++){
+			pthread_mutex_destroy(&(old[i].lock));
+		}
+		delete[] old;
+		delete[] raw;
+		delete[] in_use;
+		delete[] x;
+		delete[] y;
+		delete[] alive;
+	}
+	
+	//handler path: each thread owns one player and keeps writing its position
+	unsigned cores = std::thread::hardware_concurrency();
+	printf("\nposition writes by threads owning neighbouring players (%u cores, false sharing needs two or more)\n", cores);
+	printf("%8s %16s %16s\n", "threads", "packed Mw/s", "padded Mw/s");
+	Packed_Pos_t packed[MAX_WRITERS];
+	Player_Inbox_t padded[MAX_WRITERS];
+	for(int threads=1; threads<=MAX_WRITERS; threads*=2){
+		double rate[2];
+		for(int use_padded=0; use_padded<2; use_padded++){
+			pthread_t tid[MAX_WRITERS];
+			Writer_t w[MAX_WRITERS];
+			unsigned long long t0 = get_mono_ns();
+			for(int t=0; t<threads; t++){
+				w[t].id = t;
+				w[t].packed = packed;
+				w[t].padded = padded;
+				w[t].use_padded = use_padded;
+				pthread_create(&tid[t], NULL, writer_thread, (void*)&w[t]);
+			}
+			for(int t=0; t<threads; t++){
+				pthread_join(tid[t], NULL);
+			}
+			rate[use_padded] = ((double)WRITES * threads) / ((double)(get_mono_ns() - t0) / 1000.0);
+		}
+		printf("%8d %16.1f %16.1f\n", threads, rate[0], rate[1]);
+	}
+	
+	delete[] evict_buf;
+	return sink == -1.0f;
+}
@@ -0,0 +1,217 @@
+/*
+** thread_bench.c -- recv wakeup to handle latency under each thread placement setting
+** a sender thread sends a loopback datagram every ms to a recv thread that polls its non-blocking socket and
+** starts a handler thread per packet (like host_recv), while busy load threads stand in for the render loop
+** and other work competing for the cores. each run places the threads differently (the scheduler's choice,
+** recv pinned, recv at time critical priority, recv pinned with the load isolated from its core, and a
+** config file if given) and reports where each packet waited: in the socket buffer (from the network stack's
+** receive timestamp where it has them), for its handler thread to start, and in total from the wire
+**
+** usage: ./thread_bench [seconds per run] [load threads] [threads.cfg]
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/ThreadConfig.h"
+#include "../inc/RecvStamp.h"
+
+#define SEND_US 1000			// time between datagrams
+
+static Thread_Config_t tc;
+static SOCKET recv_s, send_s;
+static struct sockaddr_in recv_addr;
+static Recv_Stamp_t stamp;
+static std::atomic<int> stop(0);
+
+static pthread_mutex_t lat_lock;
+static Latency_Hist_t kernel_lat, wake_lat, wire_lat;
+
+typedef struct Bench_Packet {
+	unsigned long long send_ns, recv_ns;
+} Bench_Packet_t;
+
+//non-blocking loopback socket on an ephemeral port
+static SOCKET open_socket(){
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	unsigned long ul = 1;
+	ioctlsocket(s, FIONBIO, &ul);
+	struct sockaddr_in a;
+	memset((char*)&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = 0;
+	bind(s, (struct sockaddr*)&a, sizeof(a));
+	return s;
+}
+
+static void* handler(void* input){
+	Bench_Packet_t* pkt = (Bench_Packet_t*) input;
+	tc_apply(&tc, THREAD_RECV);
+	unsigned long long now = get_mono_ns();
+	pthread_mutex_lock(&lat_lock);
+	lh_record(&wake_lat, now - pkt->recv_ns);
+	lh_record(&wire_lat, now - pkt->send_ns);
+	pthread_mutex_unlock(&lat_lock);
+	delete pkt;
+	return NULL;
+}
+
+//polls the socket and hands each packet to a new thread, like host_recv
+static void* recv_loop(void*){
+	pthread_attr_t attr;
+	tc_apply(&tc, THREAD_RECV);
+	tc_attr(&tc, THREAD_RECV, &attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	char buf[MAX_PACKET_LEN];
+	struct sockaddr_in from;
+	while(!stop){
+		int fromlen = sizeof(from);
+		unsigned long long arrive_ns;
+		int numbytes = rs_recvfrom(&stamp, recv_s, buf, MAX_PACKET_LEN, &from, &fromlen, &arrive_ns);
+		if(numbytes == (int)sizeof(unsigned long long)){
+			Bench_Packet_t* pkt = new Bench_Packet_t;
+			pkt->recv_ns = get_mono_ns();
+			pthread_mutex_lock(&lat_lock);
+			lh_record(&kernel_lat, (pkt->recv_ns > arrive_ns) ? pkt->recv_ns - arrive_ns : 0);
+			pthread_mutex_unlock(&lat_lock);
+			memcpy(&(pkt->send_ns), buf, sizeof(pkt->send_ns));
+			pthread_t t;
+			if(pthread_create(&t, &attr, handler, (void*)pkt) != 0){
+				delete pkt;
+			}
+		}
+	}
+	pthread_attr_destroy(&attr);
+	return NULL;
+}
+
+static void* send_loop(void*){
+	tc_apply(&tc, THREAD_SEND);
+	unsigned long long next = get_mono_ns();
+	while(!stop){
+		unsigned long long now = get_mono_ns();
+		if(now >= next){
+			next += SEND_US * 1000ULL;
+			sendto(send_s, (const char*)&now, sizeof(now), 0, (struct sockaddr*)&recv_addr, sizeof(recv_addr));
+		} else if(next - now > 200000){
+			Sleep(0);
+		}
+	}
+	return NULL;
+}
+
+//stand in for the render loop
+static void* load_loop(void*){
+	tc_apply(&tc, THREAD_RENDER);
+	volatile unsigned long long spin = 0;
+	while(!stop){
+		spin++;
+	}
+	return NULL;
+}
+
+static void run(const char* name, double run_s, int loads){
+	lh_init(&kernel_lat);
+	lh_init(&wake_lat);
+	lh_init(&wire_lat);
+	stop = 0;
+	pthread_t recv_t, send_t;
+	std::vector<pthread_t> load_t(loads);
+	for(int i=0; i<loads; i++){
+		pthread_create(&(load_t[i]), NULL, load_loop, NULL);
+	}
+	pthread_attr_t attr;
+	tc_attr(&tc, THREAD_RECV, &attr);
+	pthread_create(&recv_t, &attr, recv_loop, NULL);
+	pthread_attr_destroy(&attr);
+	tc_attr(&tc, THREAD_SEND, &attr);
+	pthread_create(&send_t, &attr, send_loop, NULL);
+	pthread_attr_destroy(&attr);
+	
+	Sleep((DWORD)(run_s * 1000));
+	stop = 1;
+	pthread_join(send_t, NULL);
+	pthread_join(recv_t, NULL);
+	for(int i=0; i<loads; i++){
+		pthread_join(load_t[i], NULL);
+	}
+	Sleep(50);
+	
+	pthread_mutex_lock(&lat_lock);
+	printf("%s\n\t%s\n\t%s\n\tsocket to recv:    %s\n\tpacket to handler: %s\n\twire to handler:   %s\n", name,
+			tc_describe(&tc, THREAD_RECV).c_str(), tc_describe(&tc, THREAD_RENDER).c_str(), lh_summary(&kernel_lat).c_str(),
+			lh_summary(&wake_lat).c_str(), lh_summary(&wire_lat).c_str());
+	pthread_mutex_unlock(&lat_lock);
+}
+
+int main(int argc, char *argv[]){
+	double run_s = 2.0;
+	int loads = -1;
+	
+	//check arguments
+	if(argc > 4 || (argc > 1 && (run_s = atof(argv[1])) <= 0) || (argc > 2 && (loads = atoi(argv[2])) < 0)){
+		fprintf(stderr,"usage: %s [seconds per run] [load threads] [threads.cfg]\n", argv[0]);
+		exit(1);
+	}
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int cores = (int)info.dwNumberOfProcessors;
+	if(loads < 0){
+		loads = cores;
+	}
+	int last = (cores > 64 ? 64 : cores) - 1;
+	printf("%d cores, %d load threads, a datagram every %d us, %.1f s per run\n", cores, loads, SEND_US, run_s);
+	
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2,2), &wsa);
+	recv_s = open_socket();
+	send_s = open_socket();
+	int slen = sizeof(recv_addr);
+	getsockname(recv_s, (struct sockaddr*)&recv_addr, &slen);
+	printf("receive timestamps from the %s\n", rs_source_name(rs_init(&stamp, recv_s)));
+	pthread_mutex_init(&lat_lock, NULL);
+	
+	tc_init(&tc);
+	run("scheduler placed", run_s, loads);
+	
+	tc_init(&tc);
+	tc.roles[THREAD_RECV].cpus = 1ULL << last;
+	run("recv pinned", run_s, loads);
+	
+	tc_init(&tc);
+	tc.roles[THREAD_RECV].priority = THREAD_PRIORITY_TIME_CRITICAL;
+	run("recv time critical", run_s, loads);
+	
+	tc_init(&tc);
+	tc.roles[THREAD_RECV].cpus = 1ULL << last;
+	tc.roles[THREAD_RECV].priority = THREAD_PRIORITY_TIME_CRITICAL;
+	tc.isolate = 1;
+	run("recv pinned time critical, load isolated", run_s, loads);
+	
+	if(argc > 3){
+		std::string error;
+		tc_init(&tc);
+		if(tc_load(&tc, argv[3], &error) == -1){
+			fprintf(stderr, "%s\n", error.c_str());
+			exit(1);
+		}
+		if(tc_apply_process(&tc) == -1){
+			printf("priority class refused\n");
+		}
+		run(argv[3], run_s, loads);
+	}
+	
+	closesocket(recv_s);
+	closesocket(send_s);
+	WSACleanup();
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+** timer_bench.c -- insert, cancel and expire cost of the timer wheel with many active timers
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/TimerWheel.h"
+
+#define ROUNDS 5
+#define MAX_DELAY 60000		// timers spread over the next minute of 1 ms ticks
+
+static unsigned long fired = 0;
+
+static void count_fire(void* arg){
+	(void)arg;
+	fired++;
+}
+
+int main(int argc, char *argv[]){
+	int sizes[] = {1000, 10000, 100000};
+	Timer_Wheel_t* tw = new Timer_Wheel_t;
+	
+	//check arguments
+	if (argc != 1) {
+		fprintf(stderr,"usage: %s\n", argv[0]);
+		exit(1);
+	}
+	
+	printf("%10s %14s %14s %14s %14s\n", "timers", "insert ns/op", "cancel ns/op", "expire ns/op", "turn ns/tick");
+	for(unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		int n = sizes[s];
+		Timer_t* timers = new Timer_t[n];
+		unsigned long long* delays = new unsigned long long[n];
+		double insert_ns = 0, cancel_ns = 0, expire_ns = 0, tick_ns = 0;
+		
+		srand(n);
+		for(int i=0; i<n; i++){
+			delays[i] = 1 + (rand() % MAX_DELAY);
+		}
+		
+		for(int r=0; r<ROUNDS; r++){
+			tw_init(tw, 0);
+			for(int i=0; i<n; i++){
+				timer_init(&timers[i], count_fire, NULL);
+			}
+			
+			//insert every timer
+			unsigned long long start = get_mono_ns();
+			for(int i=0; i<n; i++){
+				tw_add(tw, &timers[i], delays[i]);
+			}
+			insert_ns += (double)(get_mono_ns() - start) / n;
+			
+			//cancel half of them
+			start = get_mono_ns();
+			for(int i=0; i<n; i+=2){
+				tw_cancel(tw, &timers[i]);
+			}
+			cancel_ns += (double)(get_mono_ns() - start) / ((n + 1) / 2);
+			
+			//turn the wheel tick by tick until the rest have fired (expire cost includes the empty ticks and cascading)
+			fired = 0;
+			start = get_mono_ns();
+			for(unsigned long long t=1; t<=MAX_DELAY; t++){
+				tw_advance(tw, t);
+			}
+			unsigned long long turn = get_mono_ns() - start;
+			expire_ns += (double)turn / (fired ? fired : 1);
+			tick_ns += (double)turn / MAX_DELAY;
+			
+			if(fired != (unsigned long)(n / 2)){
+				printf("expected %d timers to fire, %lu did\n", n / 2, fired);
+			}
+			tw_destroy(tw);
+		}
+		
+		printf("%10d %14.1f %14.1f %14.1f %14.1f\n", n, insert_ns / ROUNDS, cancel_ns / ROUNDS, expire_ns / ROUNDS, tick_ns / ROUNDS);
+		delete[] timers;
+		delete[] delays;
+	}
+	
+	delete tw;
+	return 0;
+}
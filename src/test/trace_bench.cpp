@@ -0,0 +1,129 @@
+/*
+** trace_bench.c -- cost of a span site with tracing off and on, and dumping while threads trace
+** times a loop of span sites against the same loop without them (tracing off should only add its branch),
+** then with tracing on, then has writer threads trace as fast as they can while the main thread dumps,
+** checking each dump holds only whole spans in order
+**
+** usage: ./trace_bench [spans] [writer threads] (defaults to 10000000 and 4)
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../inc/ConnectStruct.h"
+#include "../inc/Trace.h"
+
+#define DUMP_PATH "trace_bench.json"
+#define DUMPS 5
+
+static std::atomic<int> stop(0);
+static volatile unsigned int sink = 0;
+
+//stand in for the work a span wraps
+static inline void work(unsigned int i){
+	sink = sink + i;
+}
+
+static double loop_plain(unsigned int n){
+	unsigned long long t0 = get_mono_ns();
+	for(unsigned int i=0; i<n; i++){
+		work(i);
+	}
+	return (double)(get_mono_ns() - t0) / n;
+}
+
+static double loop_traced(unsigned int n){
+	unsigned long long t0 = get_mono_ns();
+	for(unsigned int i=0; i<n; i++){
+		unsigned long long trace_ns = TRACE_NOW();
+		work(i);
+		TRACE_SPAN("work", trace_ns, i, 0);
+	}
+	return (double)(get_mono_ns() - t0) / n;
+}
+
+static void* writer(void*){
+	trace_thread("writer");
+	unsigned int i = 0;
+	while(!stop){
+		unsigned long long trace_ns = TRACE_NOW();
+		work(i);
+		TRACE_SPAN("work", trace_ns, i++, 0);
+	}
+	return NULL;
+}
+
+//every span line of a track has the next pkt number of the one before it (none torn or out of order)
+static int check_dump(int* spans){
+	std::ifstream in(DUMP_PATH);
+	std::string line;
+	std::vector<long long> last(TRACE_THREADS, -1);
+	int ok = 1, closed = 0;
+	*spans = 0;
+	while(std::getline(in, line)){
+		closed = (line == "]}");
+		int tid;
+		unsigned int pkt;
+		const char* x = strstr(line.c_str(), "\"ph\":\"X\"");
+		if(x == NULL){
+			continue;
+		}
+		if(sscanf(strstr(line.c_str(), "\"tid\":"), "\"tid\":%d", &tid) != 1 || sscanf(strstr(line.c_str(), "\"pkt\":"), "\"pkt\":%u", &pkt) != 1){
+			return 0;
+		}
+		if(last[tid] != -1 && pkt != (unsigned int)(last[tid] + 1)){
+			ok = 0;
+		}
+		last[tid] = pkt;
+		(*spans)++;
+	}
+	return ok && closed;
+}
+
+int main(int argc, char *argv[]){
+	unsigned int n = 10000000;
+	int writers = 4;
+	if(argc > 3 || (argc > 1 && (n = (unsigned int)atoi(argv[1])) == 0) || (argc > 2 && (writers = atoi(argv[2])) < 1)){
+		fprintf(stderr,"usage: %s [spans] [writer threads]\n", argv[0]);
+		exit(1);
+	}
+	
+	//span sites off and on against the bare loop
+	double plain = loop_plain(n);
+	trace_enable(0);
+	double off = loop_traced(n);
+	trace_enable(1);
+	double on = loop_traced(n);
+	printf("%u spans: bare loop %.2f ns, tracing off %.2f ns (+%.2f), tracing on %.2f ns (+%.2f) per span\n", n, plain, off,
+			off - plain, on, on - plain);
+	
+	//dump while the writers keep tracing
+	std::vector<pthread_t> threads(writers);
+	for(int i=0; i<writers; i++){
+		pthread_create(&(threads[i]), NULL, writer, NULL);
+	}
+	Sleep(100);
+	for(int d=0; d<DUMPS; d++){
+		unsigned long long t0 = get_mono_ns();
+		int written = trace_dump(DUMP_PATH);
+		double ms = (get_mono_ns() - t0) / 1e6;
+		int spans = 0;
+		int ok = check_dump(&spans);
+		printf("dump %d: %d spans in %.1f ms (%s)\n", d + 1, written, ms, (ok && spans == written) ? "whole and in order" : "TORN");
+		Sleep(50);
+	}
+	stop = 1;
+	for(int i=0; i<writers; i++){
+		pthread_join(threads[i], NULL);
+	}
+	remove(DUMP_PATH);
+	return 0;
+}